@@ -0,0 +1,218 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+// Microbenchmarks for the controller hot path.
+//
+// Each benchmark reports the number of heap allocations per iteration
+// in the 'allocs' counter. Use --benchmark_format=json or
+// --benchmark_out=<file> for machine readable results.
+
+#define CURIO_REALTIME_DEFINE_ALLOCATION_COUNTER
+#include <curio_realtime/allocation_counter.h>
+
+#include "ackermann_drive_controller/ackermann_drive_controller.h"
+#include "ackermann_drive_controller/loopback_robot_hw.h"
+#include "ackermann_drive_controller/odometry.h"
+#include "ackermann_drive_controller/speed_limiter.h"
+
+#include <benchmark/benchmark.h>
+#include <ros/ros.h>
+
+#include <cmath>
+#include <vector>
+
+using curio_realtime::AllocationCounter;
+
+namespace
+{
+    /// Report allocations per iteration, call after the benchmark loop
+    void reportAllocations(benchmark::State& state, uint64_t allocs_start)
+    {
+        state.counters["allocs"] = benchmark::Counter(
+            static_cast<double>(AllocationCounter::count() - allocs_start),
+            benchmark::Counter::kAvgIterations);
+    }
+
+    /// Curio geometry
+    const double WHEEL_RADIUS = 0.060;
+    const double MID_WHEEL_LAT_SEPARATION = 0.52;
+    const double FRONT_WHEEL_LAT_SEPARATION = 0.47;
+    const double FRONT_WHEEL_LON_SEPARATION = 0.28;
+    const double BACK_WHEEL_LAT_SEPARATION = 0.47;
+    const double BACK_WHEEL_LON_SEPARATION = 0.25;
+
+    /// Control loop period
+    const double PERIOD = 0.02;
+
+    void setCurioWheelParams(ackermann_drive_controller::Odometry& odometry)
+    {
+        odometry.setWheelParams(WHEEL_RADIUS,
+            MID_WHEEL_LAT_SEPARATION,
+            FRONT_WHEEL_LAT_SEPARATION, FRONT_WHEEL_LON_SEPARATION,
+            BACK_WHEEL_LAT_SEPARATION, BACK_WHEEL_LON_SEPARATION);
+    }
+} // namespace
+
+static void BM_TurningRadiusAndRate(benchmark::State& state)
+{
+    double v_b = 0.3, omega_b = 0.5;
+    const uint64_t allocs = AllocationCounter::count();
+    for (auto _ : state)
+    {
+        double r_p, omega_p;
+        benchmark::DoNotOptimize(v_b);
+        benchmark::DoNotOptimize(omega_b);
+        turningRadiusAndRate(v_b, omega_b, MID_WHEEL_LAT_SEPARATION, r_p, omega_p);
+        benchmark::DoNotOptimize(r_p);
+        benchmark::DoNotOptimize(omega_p);
+    }
+    reportAllocations(state, allocs);
+}
+BENCHMARK(BM_TurningRadiusAndRate);
+
+static void BM_SpeedLimiterLimit(benchmark::State& state)
+{
+    ackermann_drive_controller::SpeedLimiter limiter(
+        true, true, state.range(0) != 0,
+        -0.37, 0.37, -2.0, 2.0, -10.0, 10.0);
+    double v0 = 0.0, v1 = 0.0;
+    double target = 0.37;
+    const uint64_t allocs = AllocationCounter::count();
+    for (auto _ : state)
+    {
+        double v = target;
+        limiter.limit(v, v0, v1, PERIOD);
+        v1 = v0;
+        v0 = v;
+        if (std::fabs(v - target) < 1e-6)
+            target = -target;
+        benchmark::DoNotOptimize(v);
+    }
+    reportAllocations(state, allocs);
+}
+BENCHMARK(BM_SpeedLimiterLimit)->ArgName("jerk")->Arg(0)->Arg(1);
+
+static void BM_OdometryUpdate(benchmark::State& state)
+{
+    ackermann_drive_controller::Odometry odometry;
+    setCurioWheelParams(odometry);
+    ros::Time time(1.0);
+    odometry.init(time);
+
+    // Left and right mid wheels turning at different rates (an arc)
+    std::vector<double> wheel_pos(6, 0.0), steer_pos(4, 0.0);
+    const double left_vel = 4.0, right_vel = 6.0;
+    const uint64_t allocs = AllocationCounter::count();
+    for (auto _ : state)
+    {
+        time += ros::Duration(PERIOD);
+        for (size_t i = 0; i < 6; ++i)
+            wheel_pos[i] += (i % 2 == 0 ? left_vel : right_vel) * PERIOD;
+        odometry.update(wheel_pos, steer_pos, time);
+        benchmark::DoNotOptimize(odometry.getHeading());
+    }
+    reportAllocations(state, allocs);
+}
+BENCHMARK(BM_OdometryUpdate);
+
+// updateOpenLoop integrates with integrateExact, which falls back to
+// Runge-Kutta 2 when the angular displacement is negligible.
+static void BM_OdometryUpdateOpenLoop(benchmark::State& state)
+{
+    ackermann_drive_controller::Odometry odometry;
+    setCurioWheelParams(odometry);
+    ros::Time time(1.0);
+    odometry.init(time);
+
+    const double linear = 0.3;
+    const double angular = state.range(0) != 0 ? 0.5 : 0.0;
+    const uint64_t allocs = AllocationCounter::count();
+    for (auto _ : state)
+    {
+        time += ros::Duration(PERIOD);
+        odometry.updateOpenLoop(linear, angular, time);
+        benchmark::DoNotOptimize(odometry.getX());
+    }
+    reportAllocations(state, allocs);
+}
+BENCHMARK(BM_OdometryUpdateOpenLoop)->ArgName("turning")->Arg(0)->Arg(1);
+
+static void BM_ControllerUpdate(benchmark::State& state)
+{
+    ackermann_drive_controller::ControllerParams params;
+    params.wheel_radius = WHEEL_RADIUS;
+    params.mid_wheel_lat_separation = MID_WHEEL_LAT_SEPARATION;
+    params.front_wheel_lat_separation = FRONT_WHEEL_LAT_SEPARATION;
+    params.front_wheel_lon_separation = FRONT_WHEEL_LON_SEPARATION;
+    params.back_wheel_lat_separation = BACK_WHEEL_LAT_SEPARATION;
+    params.back_wheel_lon_separation = BACK_WHEEL_LON_SEPARATION;
+    params.cmd_vel_timeout = 1.0E9;
+    params.enable_statistics = state.range(0) != 0;
+
+    ackermann_drive_controller::LoopbackRobotHW robot_hw(params);
+    ackermann_drive_controller::AckermannDriveController controller;
+    if (!controller.init(&robot_hw, params))
+    {
+        state.SkipWithError("Failed to initialise the controller");
+        return;
+    }
+
+    ros::Time time(1.0);
+    controller.starting(time);
+
+    // A turning command so the full kinematics are exercised
+    controller.setCommand(0.3, 0.5, time, params.cmd_vel_timeout);
+
+    const ros::Duration period(PERIOD);
+    const uint64_t allocs = AllocationCounter::count();
+    for (auto _ : state)
+    {
+        time += period;
+        controller.update(time, period);
+        robot_hw.step(PERIOD);
+    }
+    reportAllocations(state, allocs);
+
+    controller.stopping(time);
+}
+BENCHMARK(BM_ControllerUpdate)->ArgName("statistics")->Arg(0)->Arg(1);
+
+BENCHMARK_MAIN();
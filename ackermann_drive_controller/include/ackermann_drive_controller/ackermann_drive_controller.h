@@ -84,12 +84,22 @@
 #define ACKERMANN_DRIVE_CONTROLLER_ACKERMANN_DRIVE_CONTROLLER_H_
 
 #include "ackermann_drive_controller/AckermannDriveControllerConfig.h"
+#include "ackermann_drive_controller/actuation_delay.h"
+#include "ackermann_drive_controller/command_trajectory.h"
+#include "ackermann_drive_controller/controller_params.h"
+#include "ackermann_drive_controller/controller_statistics.h"
+#include "ackermann_drive_controller/input_log.h"
 #include "ackermann_drive_controller/odometry.h"
 #include "ackermann_drive_controller/speed_limiter.h"
+#include "ackermann_drive_controller/state_publisher.h"
+#include "ackermann_drive_controller/triple_buffer.h"
 
 #include <control_msgs/JointTrajectoryControllerState.h>
 #include <controller_interface/controller.h>
 #include <controller_interface/multi_interface_controller.h>
+#include <curio_realtime/latency_trace.h>
+#include <curio_realtime/realtime_guard.h>
+#include <curio_realtime/snapshot_file.h>
 #include <dynamic_reconfigure/server.h>
 #include <geometry_msgs/TwistStamped.h>
 #include <hardware_interface/joint_command_interface.h>
@@ -98,8 +108,19 @@
 #include <pluginlib/class_list_macros.hpp>
 #include <realtime_tools/realtime_buffer.h>
 #include <realtime_tools/realtime_publisher.h>
+#include <std_srvs/Trigger.h>
 #include <tf/tfMessage.h>
 
+#include <atomic>
+
+/// \brief Calculate the turning radius and rate of turn.
+/// \param[in]   v_b     linear velocity of the base [m/s].
+/// \param[in]   omega_b angular velocity of the base [rad/s].
+/// \param[in]   d       distance between the fixed wheels [m].
+/// \param[out]  r_p     turning radius [m]
+/// \param[out]  omega_p turning rate [rad/s]
+void turningRadiusAndRate(double v_b, double omega_b, double d, double &r_p, double &omega_p);
+
 namespace ackermann_drive_controller
 {
     /**
@@ -139,6 +160,17 @@ namespace ackermann_drive_controller
             ros::NodeHandle& root_nh,
             ros::NodeHandle &controller_nh);
 
+        /**
+         * \brief Initialize controller without a ROS master.
+         *
+         * Nothing is subscribed, published or recorded. Commands are
+         * supplied with setCommand. Used to replay recorded inputs.
+         * \param hw     Hardware interface for the robot
+         * \param params Controller parameters
+         */
+        bool init(hardware_interface::RobotHW* robot_hw,
+            const ControllerParams& params);
+
         /**
          * \brief Updates controller, i.e. computes the odometry and sets the new velocity commands
          * \param time   Current time
@@ -158,6 +190,33 @@ namespace ackermann_drive_controller
          */
         void stopping(const ros::Time& /*time*/);
 
+        /**
+         * \brief Set the velocity command directly, bypassing the cmd_vel topic
+         * \param lin   Linear velocity [m/s]
+         * \param ang   Angular velocity [rad/s]
+         * \param stamp   Time the command was received
+         * \param timeout Time after which the command times out [s]
+         */
+        void setCommand(double lin, double ang, const ros::Time& stamp,
+            double timeout);
+
+        /**
+         * \brief Stage dynamic parameters directly, bypassing dynamic reconfigure
+         *
+         * The parameters are applied at the start of the next update.
+         * Used to replay recorded inputs.
+         * \param params The recorded dynamic parameters
+         */
+        void setDynamicParams(const InputParams& params);
+
+        /**
+         * \brief The odometry estimated by the controller
+         */
+        const Odometry& getOdometry() const
+        {
+            return odometry_;
+        }
+
     private:
         std::string name_;
 
@@ -191,19 +250,41 @@ namespace ackermann_drive_controller
             double lin;
             double ang;
             ros::Time stamp;
+            double timeout;
+            uint64_t trace_id;
 
-            Commands() : lin(0.0), ang(0.0), stamp(0.0) {}
+            Commands() : lin(0.0), ang(0.0), stamp(0.0), timeout(0.0), trace_id(0) {}
         };
         realtime_tools::RealtimeBuffer<Commands> command_;
         Commands command_struct_;
         ros::Subscriber sub_command_;
 
-        /// Publish executed commands
-        std::shared_ptr<realtime_tools::RealtimePublisher<geometry_msgs::TwistStamped> > cmd_vel_pub_;
+        /// Prioritised command sources, highest priority first:
+        struct CommandSource
+        {
+            CommandSourceParams params;
+            TripleBuffer<Commands> command;
+            ros::Subscriber sub;
+        };
+        std::vector<std::unique_ptr<CommandSource>> command_sources_;
+
+        /// Index of the source driving the rover, or one of:
+        static const int SOURCE_DEFAULT = -1;
+        static const int SOURCE_LOCKOUT = -2;
+        std::atomic<int> active_source_;
+
+        /// Timestamped command trajectory related:
+        realtime_tools::RealtimeBuffer<CommandTrajectory> trajectory_;
+        CommandTrajectory trajectory_struct_;
+        ros::Subscriber sub_trajectory_;
+        ros::Time trajectory_received_;
+        size_t trajectory_cursor_;
+
+        /// Publish odometry, tf and executed commands from a single thread:
+        std::shared_ptr<StatePublisher> state_pub_;
+        StateRecord state_record_;
 
         /// Odometry related:
-        std::shared_ptr<realtime_tools::RealtimePublisher<nav_msgs::Odometry> > odom_pub_;
-        std::shared_ptr<realtime_tools::RealtimePublisher<tf::tfMessage> > tf_odom_pub_;
         Odometry odometry_;
 
         /// Controller state publisher
@@ -230,10 +311,22 @@ namespace ackermann_drive_controller
         // Workspace for velocity and angle calculations
         std::vector<double> wheel_vel_, steer_ang_;
 
-        /// Wheel separation and radius calibration multipliers:
-        // double wheel_separation_multiplier_;
-        // double left_wheel_radius_multiplier_;
-        // double right_wheel_radius_multiplier_;
+        /// Wheel radius and separation calibration multipliers:
+        double wheel_radius_multiplier_;
+        double wheel_separation_multiplier_;
+        double wheel_base_multiplier_;
+
+        /// Geometry from the params, before the multipliers are applied:
+        struct Geometry
+        {
+            double wheel_radius;
+            double mid_wheel_lat_separation;
+            double front_wheel_lat_separation;
+            double front_wheel_lon_separation;
+            double back_wheel_lat_separation;
+            double back_wheel_lon_separation;
+        };
+        Geometry nominal_geometry_;
 
         /// Timeout to consider cmd_vel commands old:
         double cmd_vel_timeout_;
@@ -265,31 +358,65 @@ namespace ackermann_drive_controller
         /// Publish limited velocity:
         bool publish_cmd_;
 
+        /// Update loop statistics:
+        ControllerStatistics statistics_;
+        bool cmd_vel_timed_out_;
+        ros::ServiceServer dump_statistics_srv_;
+
+        /// Record inputs for offline replay:
+        std::shared_ptr<InputRecorder> input_recorder_;
+        InputRecord input_record_;
+
+        /// Command latency tracing:
+        std::shared_ptr<curio_realtime::LatencyTrace> latency_trace_;
+        uint64_t last_trace_id_;
+
+        /// Actuation latency compensation:
+        bool latency_compensation_;
+        double latency_max_delay_;
+        double latency_steer_delay_;
+        ActuationDelayEstimator drive_delay_;
+        ActuationDelayEstimator steer_delay_;
+        double mid_wheel_pos_prev_;
+        std::atomic<double> drive_delay_estimate_;
+        std::atomic<double> steer_delay_estimate_;
+
+        /// Pose snapshot for warm restarts:
+        struct PoseSnapshot
+        {
+            double x;
+            double y;
+            double heading;
+        };
+        std::shared_ptr<curio_realtime::SnapshotFile<PoseSnapshot> > pose_snapshot_;
+        PoseSnapshot pose_snapshot_record_;
+        bool restore_pose_;
+
         /// Publish wheel data:
         // bool publish_wheel_joint_controller_state_;    
 
-        // @TODO: enable dynamic reconfig
-        // A struct to hold dynamic parameters
-        // set from dynamic_reconfigure server
-        /*
+        /// A struct to hold dynamic parameters
+        /// set from dynamic_reconfigure server
         struct DynamicParams
         {
+            /// Set by the reconfigure callback, cleared when applied in update()
             bool update;
 
-            double left_wheel_radius_multiplier;
-            double right_wheel_radius_multiplier;
+            double wheel_radius_multiplier;
             double wheel_separation_multiplier;
-
-            bool publish_cmd;
+            double wheel_base_multiplier;
 
             double publish_rate;
             bool enable_odom_tf;
 
+            SpeedLimiter limiter_lin;
+            SpeedLimiter limiter_ang;
+
             DynamicParams() :
-                left_wheel_radius_multiplier(1.0),
-                right_wheel_radius_multiplier(1.0),
+                update(false),
+                wheel_radius_multiplier(1.0),
                 wheel_separation_multiplier(1.0),
-                publish_cmd(false),
+                wheel_base_multiplier(1.0),
                 publish_rate(50),
                 enable_odom_tf(true)
             {}
@@ -299,14 +426,27 @@ namespace ackermann_drive_controller
                 os << "DynamicParams:\n"
                 //
                 << "\tOdometry parameters:\n"
-                << "\t\tleft wheel radius multiplier: "   << params.left_wheel_radius_multiplier  << "\n"
-                << "\t\tright wheel radius multiplier: "  << params.right_wheel_radius_multiplier << "\n"
-                << "\t\twheel separation multiplier: "    << params.wheel_separation_multiplier   << "\n"
+                << "\t\twheel radius multiplier: "       << params.wheel_radius_multiplier     << "\n"
+                << "\t\twheel separation multiplier: "   << params.wheel_separation_multiplier << "\n"
+                << "\t\twheel base multiplier: "         << params.wheel_base_multiplier       << "\n"
                 //
                 << "\tPublication parameters:\n"
-                << "\t\tPublish executed velocity command: " << (params.publish_cmd?"enabled":"disabled") << "\n"
                 << "\t\tPublication rate: " << params.publish_rate                 << "\n"
-                << "\t\tPublish frame odom on tf: " << (params.enable_odom_tf?"enabled":"disabled");
+                << "\t\tPublish frame odom on tf: " << (params.enable_odom_tf?"enabled":"disabled") << "\n"
+                //
+                << "\tLimits:\n"
+                << "\t\tlinear/x velocity: ["     << params.limiter_lin.min_velocity     << ", " << params.limiter_lin.max_velocity     << "]"
+                << (params.limiter_lin.has_velocity_limits?"":" (disabled)")     << "\n"
+                << "\t\tlinear/x acceleration: [" << params.limiter_lin.min_acceleration << ", " << params.limiter_lin.max_acceleration << "]"
+                << (params.limiter_lin.has_acceleration_limits?"":" (disabled)") << "\n"
+                << "\t\tlinear/x jerk: ["         << params.limiter_lin.min_jerk         << ", " << params.limiter_lin.max_jerk         << "]"
+                << (params.limiter_lin.has_jerk_limits?"":" (disabled)")         << "\n"
+                << "\t\tangular/z velocity: ["     << params.limiter_ang.min_velocity     << ", " << params.limiter_ang.max_velocity     << "]"
+                << (params.limiter_ang.has_velocity_limits?"":" (disabled)")     << "\n"
+                << "\t\tangular/z acceleration: [" << params.limiter_ang.min_acceleration << ", " << params.limiter_ang.max_acceleration << "]"
+                << (params.limiter_ang.has_acceleration_limits?"":" (disabled)") << "\n"
+                << "\t\tangular/z jerk: ["         << params.limiter_ang.min_jerk         << ", " << params.limiter_ang.max_jerk         << "]"
+                << (params.limiter_ang.has_jerk_limits?"":" (disabled)");
 
                 return os;
             }
@@ -316,11 +456,39 @@ namespace ackermann_drive_controller
 
         /// Dynamic Reconfigure server
         typedef dynamic_reconfigure::Server<AckermannDriveControllerConfig> ReconfigureServer;
-        
+
         std::shared_ptr<ReconfigureServer> dyn_reconf_server_;
-        */
 
     private:
+        /**
+         * \brief Read the controller parameters from the parameter server
+         *
+         * The whole controller namespace is fetched in a single call and
+         * decoded and validated locally.
+         *
+         * \param controller_nh Node handle inside the controller namespace
+         * \param [out] params  The parameters read, defaults where not set
+         * \return false if the params could not be read or are invalid
+         */
+        bool loadParams(ros::NodeHandle& controller_nh, ControllerParams& params);
+
+        /**
+         * \brief Apply the parameters and get the joint handles
+         * \param hw     Hardware interface for the robot
+         * \param params Controller parameters
+         */
+        bool configure(hardware_interface::RobotHW* robot_hw,
+            const ControllerParams& params);
+
+        /**
+         * \brief Queue the inputs of this update for recording
+         * \param time    Current time
+         * \param period  Time since the last called to update
+         * \param command Velocity command read this cycle
+         */
+        void recordInputs(const ros::Time& time, const ros::Duration& period,
+            const Commands& command);
+
         /**
          * \brief Brakes the wheels, i.e. sets the velocity to 0
          */
@@ -332,6 +500,36 @@ namespace ackermann_drive_controller
          */
         void cmdVelCallback(const geometry_msgs::Twist& command);
 
+        /**
+         * \brief Prioritised command source callback
+         * \param command Velocity command message (twist)
+         * \param index   Index of the source in command_sources_
+         */
+        void commandSourceCallback(const geometry_msgs::Twist::ConstPtr& command, size_t index);
+
+        /**
+         * \brief Select the command of the highest priority active source
+         * \param time          Current time
+         * \param [in,out] cmd  The default command, replaced by the selected source
+         */
+        void arbitrateCommandSources(const ros::Time& time, Commands& cmd);
+
+        /**
+         * \brief Velocity command trajectory callback
+         * \param trajectory Timestamped velocity setpoints, the first
+         *                   velocity of each point is used
+         */
+        void cmdVelTrajectoryCallback(
+            const trajectory_msgs::MultiDOFJointTrajectory& trajectory);
+
+        /**
+         * \brief Report the update loop statistics (non-realtime)
+         * \param req Empty request
+         * \param res The statistics report in the message field
+         */
+        bool dumpStatisticsCallback(std_srvs::Trigger::Request& req,
+            std_srvs::Trigger::Response& res);
+
         // @TODO: enable setting params from URDF
         /**
          * \brief Sets odometry parameters from the URDF, i.e. the wheel radius and separation
@@ -351,8 +549,10 @@ namespace ackermann_drive_controller
          * \brief Sets the odometry publishing fields
          * \param root_nh Root node handle
          * \param controller_nh Node handle inside the controller namespace
+         * \param params Controller params with the covariance diagonals
          */
-        void setOdomPubFields(ros::NodeHandle& root_nh, ros::NodeHandle& controller_nh);
+        void setOdomPubFields(ros::NodeHandle& root_nh, ros::NodeHandle& controller_nh,
+            const ControllerParams& params);
 
         /**
          * \brief Callback for dynamic_reconfigure server
@@ -362,13 +562,27 @@ namespace ackermann_drive_controller
          */
         void reconfCallback(AckermannDriveControllerConfig& config, uint32_t /*level*/);
 
-        // @TODO: enable dynamic reconfig
         /**
-         * \brief Update the dynamic parameters in the RT loop
+         * \brief Apply new dynamic parameters in the RT loop
+         *
+         * Does nothing unless the reconfigure callback has staged new
+         * parameters. The kinematics are only rebuilt if the geometry
+         * multipliers changed. The applied parameters are recorded if
+         * inputs are being recorded.
+         * \param time Current time
          */
-        /*
-        void updateDynamicParams();
-        */
+        void updateDynamicParams(const ros::Time& time);
+
+        /**
+         * \brief Scale the nominal geometry and rebuild the joint positions
+         * and odometry parameters. Realtime safe once configured.
+         * \param wheel_radius_multiplier     Wheel radius multiplier
+         * \param wheel_separation_multiplier Lateral wheel separation multiplier
+         * \param wheel_base_multiplier       Longitudinal wheel separation multiplier
+         */
+        void setGeometry(double wheel_radius_multiplier,
+            double wheel_separation_multiplier,
+            double wheel_base_multiplier);
 
         // @TODO: enable publishing wheel and steer joint info.    
         /**
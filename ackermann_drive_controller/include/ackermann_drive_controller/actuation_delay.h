@@ -0,0 +1,128 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#ifndef ACKERMANN_DRIVE_CONTROLLER_ACTUATION_DELAY_H_
+#define ACKERMANN_DRIVE_CONTROLLER_ACTUATION_DELAY_H_
+
+#include <cstddef>
+
+namespace ackermann_drive_controller
+{
+    /**
+     * \brief Online estimate of the delay between a command and its effect.
+     *
+     * Each cycle the command sent to the joints is pushed into a fixed
+     * history, and the measured response is compared with the command
+     * from each of the last MAX_LAGS cycles. An exponentially weighted
+     * mean squared error is kept per lag, and the lag with the smallest
+     * error (refined by fitting a parabola through its neighbours) is the
+     * delay estimate.
+     *
+     * The errors are only updated while the command is changing, since a
+     * constant command matches every lag equally well. Neither update nor
+     * push allocate, so both may be called from the realtime loop.
+     */
+    class ActuationDelayEstimator
+    {
+    public:
+        /// Number of cycles of command history, must be a power of two
+        static const size_t MAX_LAGS = 64;
+
+        /**
+         * \brief Constructor
+         * \param min_excitation  Minimum change in the command across the
+         *                        history for the errors to be updated
+         * \param time_constant   Time constant of the error averages [s]
+         */
+        explicit ActuationDelayEstimator(double min_excitation = 0.02,
+            double time_constant = 10.0);
+
+        /**
+         * \brief Clear the history and the estimate
+         */
+        void reset();
+
+        /**
+         * \brief Compare a measurement with the command history
+         * \param measured The measured response this cycle
+         * \param dt       Time since the last cycle [s]
+         */
+        void update(double measured, double dt);
+
+        /**
+         * \brief Record the command sent this cycle
+         * \param command The command sent to the joints
+         */
+        void push(double command);
+
+        /**
+         * \brief Whether enough excited cycles have been seen for an estimate
+         */
+        bool isValid() const
+        {
+            return samples_ >= MAX_LAGS;
+        }
+
+        /**
+         * \brief The estimated delay [s], zero until the estimate is valid
+         */
+        double getDelay() const;
+
+    private:
+        double history(size_t lag) const
+        {
+            return history_[(head_ - lag) & (MAX_LAGS - 1)];
+        }
+
+        double min_excitation_;
+        double time_constant_;
+
+        double history_[MAX_LAGS];
+        size_t head_;
+        size_t count_;
+
+        double error_[MAX_LAGS];
+        double mean_dt_;
+        size_t samples_;
+    };
+
+} // namespace ackermann_drive_controller
+
+#endif // ACKERMANN_DRIVE_CONTROLLER_ACTUATION_DELAY_H_
@@ -0,0 +1,124 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#ifndef ACKERMANN_DRIVE_CONTROLLER_COMMAND_TRAJECTORY_H_
+#define ACKERMANN_DRIVE_CONTROLLER_COMMAND_TRAJECTORY_H_
+
+#include <ros/time.h>
+#include <trajectory_msgs/MultiDOFJointTrajectory.h>
+
+#include <cstddef>
+#include <string>
+
+namespace ackermann_drive_controller
+{
+    /**
+     * \brief A short horizon of timestamped velocity setpoints.
+     *
+     * Decoded from a trajectory message outside the realtime loop into
+     * fixed storage, so it may be passed through a RealtimeBuffer and
+     * sampled in the realtime loop without allocating.
+     */
+    struct CommandTrajectory
+    {
+        /// Maximum number of setpoints kept from a message
+        static const size_t MAX_POINTS = 32;
+
+        struct Point
+        {
+            ros::Time stamp;
+            double lin;
+            double ang;
+
+            Point() : stamp(0.0), lin(0.0), ang(0.0) {}
+        };
+
+        Point points[MAX_POINTS];
+        size_t size;
+
+        /// Time the trajectory was received
+        ros::Time received;
+
+        CommandTrajectory() : size(0), received(0.0) {}
+
+        /**
+         * \brief Decode a trajectory message
+         *
+         * The setpoint times are the header stamp plus each point's
+         * time_from_start; a zero header stamp means the time received.
+         * The linear x and angular z of the first velocity of each point
+         * are the setpoint. Points beyond MAX_POINTS are dropped.
+         *
+         * \param msg       The trajectory message
+         * \param received  Time the message was received
+         * \param [out] error Description of why the message was rejected
+         * \return false if the message has no points, a point without a
+         *         velocity, or setpoint times that do not increase
+         */
+        bool fromMsg(const trajectory_msgs::MultiDOFJointTrajectory& msg,
+            const ros::Time& received, std::string& error);
+
+        /**
+         * \brief The time of the last setpoint
+         */
+        const ros::Time& end() const
+        {
+            return points[size - 1].stamp;
+        }
+
+        /**
+         * \brief Interpolate the setpoints linearly at a time. Realtime safe.
+         *
+         * Before the first setpoint the first is held, and after the last
+         * setpoint the last is held.
+         *
+         * \param time            Time to sample at
+         * \param [in,out] cursor Index of the segment found by the previous
+         *                        sample, start at zero for a new trajectory
+         * \param [out] lin       Linear velocity [m/s]
+         * \param [out] ang       Angular velocity [rad/s]
+         */
+        void sample(const ros::Time& time, size_t& cursor,
+            double& lin, double& ang) const;
+    };
+
+} // namespace ackermann_drive_controller
+
+#endif // ACKERMANN_DRIVE_CONTROLLER_COMMAND_TRAJECTORY_H_
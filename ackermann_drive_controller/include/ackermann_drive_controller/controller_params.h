@@ -0,0 +1,229 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#ifndef ACKERMANN_DRIVE_CONTROLLER_CONTROLLER_PARAMS_H_
+#define ACKERMANN_DRIVE_CONTROLLER_CONTROLLER_PARAMS_H_
+
+#include "ackermann_drive_controller/speed_limiter.h"
+
+#include <string>
+#include <vector>
+
+namespace XmlRpc
+{
+    class XmlRpcValue;
+}
+
+namespace ackermann_drive_controller
+{
+    /**
+     * \brief A prioritised source of velocity commands.
+     *
+     * The active source with the highest priority drives the rover. A
+     * source is active while its last command is younger than its timeout.
+     * After it times out, lower priority sources are held at a stop for
+     * its lockout, so control is not handed over by a brief dropout.
+     */
+    struct CommandSourceParams
+    {
+        /// Name of the source, used in logs
+        std::string name;
+
+        /// Topic of geometry_msgs/Twist commands, relative to the controller
+        std::string topic;
+
+        /// Sources with a higher priority take precedence
+        int priority;
+
+        /// The source is active while its last command is younger than this [s]
+        double timeout;
+
+        /// Hold lower priority sources at a stop for this long after a timeout [s]
+        double lockout;
+
+        CommandSourceParams() : priority(0), timeout(0.5), lockout(0.0)
+        {
+        }
+    };
+
+    /**
+     * \brief Static configuration for the AckermannDriveController.
+     *
+     * The controller fetches its whole namespace from the parameter server
+     * in one call and decodes it with fromXmlRpc, or the params may be
+     * supplied directly to initialise the controller without a ROS master
+     * (for example when replaying recorded inputs). The defaults match
+     * the parameter server defaults.
+     */
+    struct ControllerParams
+    {
+        /// Joint names, indexed by AckermannWheelIndex and AckermannSteerIndex
+        std::string wheel_names[6];
+        std::string steer_names[4];
+
+        /// Odometry related:
+        double publish_rate;
+        bool open_loop;
+        int velocity_rolling_window_size;
+
+        /// Geometry:
+        double wheel_radius;
+        double mid_wheel_lat_separation;
+        double front_wheel_lat_separation;
+        double front_wheel_lon_separation;
+        double back_wheel_lat_separation;
+        double back_wheel_lon_separation;
+
+        /// Velocity commands:
+        double cmd_vel_timeout;
+        bool allow_multiple_cmd_vel_publishers;
+
+        /// Prioritised command sources in addition to cmd_vel, which has
+        /// the lowest priority
+        std::vector<CommandSourceParams> command_sources;
+
+        /// Frames:
+        std::string base_frame_id;
+        std::string odom_frame_id;
+        bool enable_odom_tf;
+
+        /// Speed limits:
+        SpeedLimiter limiter_lin;
+        SpeedLimiter limiter_ang;
+
+        /// Publish limited velocity:
+        bool publish_cmd;
+
+        /// Update loop statistics:
+        bool enable_statistics;
+
+        /// Record the inputs of each update to this file (disabled if empty)
+        std::string record_inputs;
+
+        /// Record command latency trace events to this file (disabled if empty)
+        std::string latency_trace;
+
+        /// Snapshot the pose to this file for warm restarts (disabled if empty)
+        std::string pose_snapshot;
+
+        /// Only resume from a pose snapshot younger than this [s]
+        double pose_snapshot_max_age;
+
+        /// Compensate for the measured actuation delay
+        bool latency_compensation;
+
+        /// Largest delay to compensate for [s]
+        double latency_max_delay;
+
+        /// Steering delay to compensate for [s], negative to estimate it
+        /// from the steering joint positions
+        double latency_steer_delay;
+
+        /// Diagonals of the odometry covariance matrices
+        double pose_covariance_diagonal[6];
+        double twist_covariance_diagonal[6];
+
+        ControllerParams() :
+            wheel_names{
+                "front_left_wheel_joint", "front_right_wheel_joint",
+                "mid_left_wheel_joint",   "mid_right_wheel_joint",
+                "back_left_wheel_joint",  "back_right_wheel_joint" },
+            steer_names{
+                "front_left_steer_joint", "front_right_steer_joint",
+                "back_left_steer_joint",  "back_right_steer_joint" },
+            publish_rate(50.0),
+            open_loop(false),
+            velocity_rolling_window_size(10),
+            wheel_radius(0.0),
+            mid_wheel_lat_separation(0.0),
+            front_wheel_lat_separation(0.0),
+            front_wheel_lon_separation(0.0),
+            back_wheel_lat_separation(0.0),
+            back_wheel_lon_separation(0.0),
+            cmd_vel_timeout(0.5),
+            allow_multiple_cmd_vel_publishers(true),
+            base_frame_id("base_link"),
+            odom_frame_id("odom"),
+            enable_odom_tf(true),
+            publish_cmd(false),
+            enable_statistics(false),
+            pose_snapshot_max_age(60.0),
+            latency_compensation(false),
+            latency_max_delay(0.5),
+            latency_steer_delay(-1.0),
+            pose_covariance_diagonal{ 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 },
+            twist_covariance_diagonal{ 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 }
+        {
+        }
+
+        /**
+         * \brief Decode the params from the controller namespace
+         *
+         * Params that are not present keep their current value, except
+         * the covariance diagonals which are required.
+         *
+         * \param value        The controller namespace as an XmlRpc struct
+         * \param [out] error  Description of the first invalid param
+         * \return false if a param is missing or has the wrong type
+         */
+        bool fromXmlRpc(XmlRpc::XmlRpcValue& value, std::string& error);
+
+        /**
+         * \brief Check the params are in range
+         * \param [out] error  Description of the first invalid param
+         * \return false if a param is out of range
+         */
+        bool validate(std::string& error) const;
+
+        /**
+         * \brief Check the minimum limits of a speed limiter do not exceed its maximum limits
+         * \param name        Name of the limited velocity, e.g. "linear/x"
+         * \param limiter     The speed limiter
+         * \param [out] error  Description of the invalid limits
+         * \return false if an enabled minimum limit exceeds its maximum
+         */
+        static bool validateLimiter(const std::string& name,
+            const SpeedLimiter& limiter, std::string& error);
+    };
+
+} // namespace ackermann_drive_controller
+
+#endif // ACKERMANN_DRIVE_CONTROLLER_CONTROLLER_PARAMS_H_
@@ -0,0 +1,226 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#ifndef ACKERMANN_DRIVE_CONTROLLER_CONTROLLER_STATISTICS_H_
+#define ACKERMANN_DRIVE_CONTROLLER_CONTROLLER_STATISTICS_H_
+
+#include <curio_realtime/latency_histogram.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// USDT probes are available to perf / bpftrace / systemtap when the
+// systemtap sdt header is installed (e.g. systemtap-sdt-dev). A probe
+// that is not attached costs a single nop.
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define ACKERMANN_DRIVE_CONTROLLER_PROBE(name) \
+    DTRACE_PROBE(ackermann_drive_controller, name)
+#define ACKERMANN_DRIVE_CONTROLLER_PROBE2(name, arg1, arg2) \
+    DTRACE_PROBE2(ackermann_drive_controller, name, arg1, arg2)
+#else
+#define ACKERMANN_DRIVE_CONTROLLER_PROBE(name)
+#define ACKERMANN_DRIVE_CONTROLLER_PROBE2(name, arg1, arg2)
+#endif
+
+namespace ackermann_drive_controller
+{
+    /**
+     * \brief Timing and event statistics for the controller update loop.
+     *
+     * Each call to update() is divided into phases. When enabled, the
+     * duration of each phase is recorded into a latency histogram along
+     * with the total update time and the period between updates.
+     * When disabled each call reduces to a single branch.
+     */
+    class ControllerStatistics
+    {
+    public:
+        /// The phases of AckermannDriveController::update()
+        enum Phase
+        {
+            PHASE_READ       = 0,   ///< Read joint positions
+            PHASE_ODOMETRY   = 1,   ///< Update odometry
+            PHASE_LIMIT      = 2,   ///< Read command, check timeout, apply speed limits
+            PHASE_PUBLISH    = 3,   ///< Queue state for publishing
+            PHASE_KINEMATICS = 4,   ///< Compute wheel velocities and steering angles
+            PHASE_WRITE      = 5,   ///< Write joint commands
+            NUM_PHASES       = 6
+        };
+
+        ControllerStatistics();
+
+        /**
+         * \brief Enable or disable the statistics
+         */
+        void setEnabled(bool enabled)
+        {
+            enabled_ = enabled;
+        }
+
+        /**
+         * \brief Check whether statistics are enabled
+         */
+        bool isEnabled() const
+        {
+            return enabled_;
+        }
+
+        /**
+         * \brief Mark the start of an update cycle
+         * \param period Period since the previous update [ns]
+         */
+        void beginCycle(int64_t period)
+        {
+            ACKERMANN_DRIVE_CONTROLLER_PROBE(update__entry);
+            if (!enabled_)
+                return;
+
+            cycle_start_ = last_mark_ = curio_realtime::monotonicNanoseconds();
+            last_period_ = period;
+            recordPeriod(period);
+        }
+
+        /**
+         * \brief Mark the end of a phase
+         * \param phase The phase that has just completed
+         */
+        void mark(Phase phase)
+        {
+            if (!enabled_)
+                return;
+
+            const uint64_t now = curio_realtime::monotonicNanoseconds();
+            const uint64_t elapsed = now - last_mark_;
+            phases_[phase].record(elapsed);
+            last_mark_ = now;
+            ACKERMANN_DRIVE_CONTROLLER_PROBE2(phase, static_cast<int>(phase), elapsed);
+        }
+
+        /**
+         * \brief Mark the end of an update cycle
+         */
+        void endCycle()
+        {
+            ACKERMANN_DRIVE_CONTROLLER_PROBE(update__return);
+            if (!enabled_)
+                return;
+
+            const uint64_t elapsed = curio_realtime::monotonicNanoseconds() - cycle_start_;
+            update_.record(elapsed);
+            ACKERMANN_DRIVE_CONTROLLER_PROBE2(update, elapsed, last_period_);
+        }
+
+        /**
+         * \brief Count a transition into the cmd_vel timeout state
+         */
+        void countCmdVelTimeout()
+        {
+            cmd_vel_timeouts_.store(cmd_vel_timeouts_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+            ACKERMANN_DRIVE_CONTROLLER_PROBE(cmd_vel__timeout);
+        }
+
+        /**
+         * \brief Count a state record the publisher failed to accept
+         */
+        void countPublishFailure()
+        {
+            publish_failures_.store(publish_failures_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+            ACKERMANN_DRIVE_CONTROLLER_PROBE(publish__failure);
+        }
+
+        /**
+         * \brief Count the realtime guard violations of an update cycle
+         * \param violations Number of violations, see curio_realtime::RealtimeGuard
+         */
+        void countRealtimeViolations(uint64_t violations)
+        {
+            realtime_violations_.store(realtime_violations_.load(std::memory_order_relaxed) + violations,
+                std::memory_order_relaxed);
+            realtime_violation_cycles_.store(realtime_violation_cycles_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+            ACKERMANN_DRIVE_CONTROLLER_PROBE(realtime__violation);
+        }
+
+        /**
+         * \brief Clear the histograms and counters (non-realtime)
+         */
+        void reset();
+
+        /**
+         * \brief Format a report of the histograms and counters (non-realtime)
+         */
+        std::string report() const;
+
+        /**
+         * \brief Name of a phase
+         */
+        static const char* phaseName(Phase phase);
+
+    private:
+        /**
+         * \brief Record the update period and its deviation from the running mean
+         */
+        void recordPeriod(int64_t period);
+
+        bool enabled_;
+        uint64_t cycle_start_;
+        uint64_t last_mark_;
+        int64_t last_period_;
+        double mean_period_;
+
+        curio_realtime::LatencyHistogram phases_[NUM_PHASES];
+        curio_realtime::LatencyHistogram update_;
+        curio_realtime::LatencyHistogram period_;
+        curio_realtime::LatencyHistogram jitter_;
+
+        std::atomic<uint64_t> cmd_vel_timeouts_;
+        std::atomic<uint64_t> publish_failures_;
+        std::atomic<uint64_t> realtime_violations_;
+        std::atomic<uint64_t> realtime_violation_cycles_;
+    };
+
+} // namespace ackermann_drive_controller
+
+#endif // ACKERMANN_DRIVE_CONTROLLER_CONTROLLER_STATISTICS_H_
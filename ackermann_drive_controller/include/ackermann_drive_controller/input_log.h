@@ -0,0 +1,294 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#ifndef ACKERMANN_DRIVE_CONTROLLER_INPUT_LOG_H_
+#define ACKERMANN_DRIVE_CONTROLLER_INPUT_LOG_H_
+
+#include "ackermann_drive_controller/controller_params.h"
+
+#include <curio_realtime/realtime_queue.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include <semaphore.h>
+
+namespace ackermann_drive_controller
+{
+    /**
+     * \brief Input log file header.
+     *
+     * Contains the parameters that affect update() when the log was
+     * opened. Later dynamic reconfigure changes are logged as TYPE_PARAMS
+     * records. Joint names, frame ids and publishing options are not
+     * recorded.
+     */
+    struct InputLogHeader
+    {
+        static const uint32_t VERSION = 4;
+
+        struct Limits
+        {
+            double min_velocity;
+            double max_velocity;
+            double min_acceleration;
+            double max_acceleration;
+            double min_jerk;
+            double max_jerk;
+            uint8_t has_velocity_limits;
+            uint8_t has_acceleration_limits;
+            uint8_t has_jerk_limits;
+            uint8_t reserved[5];
+
+            /**
+             * \brief Copy the limits of a speed limiter
+             */
+            void fromLimiter(const SpeedLimiter& limiter);
+
+            /**
+             * \brief Copy the limits into a speed limiter
+             */
+            void toLimiter(SpeedLimiter& limiter) const;
+        };
+
+        char magic[8];
+        uint32_t version;
+        uint32_t record_size;
+
+        double publish_rate;
+        double cmd_vel_timeout;
+        double wheel_radius;
+        double mid_wheel_lat_separation;
+        double front_wheel_lat_separation;
+        double front_wheel_lon_separation;
+        double back_wheel_lat_separation;
+        double back_wheel_lon_separation;
+        int32_t velocity_rolling_window_size;
+        uint8_t open_loop;
+        uint8_t enable_odom_tf;
+        uint8_t publish_cmd;
+        uint8_t latency_compensation;
+        Limits limits_lin;
+        Limits limits_ang;
+        double latency_max_delay;
+        double latency_steer_delay;
+
+        /**
+         * \brief Initialise a header from the controller parameters
+         */
+        void fromParams(const ControllerParams& params);
+
+        /**
+         * \brief Copy the recorded parameters into params
+         */
+        void toParams(ControllerParams& params) const;
+
+        /**
+         * \brief True if the magic, version and record size match
+         */
+        bool isValid() const;
+    };
+
+    /**
+     * \brief The parameters that dynamic reconfigure can change.
+     */
+    struct InputParams
+    {
+        double wheel_radius_multiplier;
+        double wheel_separation_multiplier;
+        double wheel_base_multiplier;
+        double publish_rate;
+        uint8_t enable_odom_tf;
+        uint8_t reserved[7];
+        InputLogHeader::Limits limits_lin;
+        InputLogHeader::Limits limits_ang;
+    };
+
+    /**
+     * \brief The inputs to one call of starting() or update(), or a change
+     * of the dynamic parameters.
+     *
+     * Together with the parameters in the log header these determine
+     * the controller output exactly, so a log can be replayed offline.
+     * A TYPE_PARAMS record applies to the updates that follow it.
+     */
+    struct InputRecord
+    {
+        enum Type
+        {
+            TYPE_STARTING = 1,
+            TYPE_UPDATE   = 2,
+            TYPE_PARAMS   = 3
+        };
+
+        int64_t time_ns;
+        int64_t period_ns;
+        uint32_t type;
+        uint32_t reserved;
+
+        /// Joint positions read from the hardware
+        double wheel_pos[6];
+        double steer_pos[4];
+
+        /// Velocity command read from the realtime buffer
+        double cmd_lin;
+        double cmd_ang;
+        int64_t cmd_stamp_ns;
+        double cmd_timeout;
+
+        /// Dynamic parameters applied from the next update (TYPE_PARAMS)
+        InputParams params;
+    };
+
+    /**
+     * \brief Write controller inputs to a binary log file.
+     *
+     * The realtime loop pushes records into a lock-free queue; a writer
+     * thread drains the queue to the file. Records that do not fit in
+     * the queue are dropped and counted.
+     */
+    class InputRecorder
+    {
+    public:
+        /// Queue capacity in records
+        static const size_t QUEUE_SIZE = 256;
+
+        InputRecorder();
+
+        ~InputRecorder();
+
+        /**
+         * \brief Create the log file, write the header and start the writer thread
+         * \param path   Log file path, an existing file is overwritten
+         * \param params The controller parameters stored in the header
+         * \return false if the file could not be written
+         */
+        bool open(const std::string& path, const ControllerParams& params);
+
+        /**
+         * \brief Write any queued records, stop the writer thread and close the file
+         */
+        void close();
+
+        /**
+         * \brief Queue a record for writing. Realtime safe.
+         * \param record The inputs to log
+         * \return false if the queue was full and the record was dropped
+         */
+        bool record(const InputRecord& record);
+
+        /**
+         * \brief Number of records dropped because the queue was full
+         */
+        uint64_t getDroppedCount() const
+        {
+            return dropped_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        /**
+         * \brief Writer thread main loop
+         */
+        void run();
+
+        /**
+         * \brief Write the queued records to the file
+         */
+        void drain();
+
+        curio_realtime::RealtimeQueue<InputRecord, QUEUE_SIZE> queue_;
+        sem_t wakeup_;
+        std::thread thread_;
+        std::atomic<bool> running_;
+        std::atomic<uint64_t> dropped_;
+        uint64_t dropped_reported_;
+        std::string path_;
+        FILE* file_;
+    };
+
+    /**
+     * \brief Read a log written by InputRecorder
+     */
+    class InputLogReader
+    {
+    public:
+        InputLogReader();
+
+        ~InputLogReader();
+
+        /**
+         * \brief Open a log file and validate its header
+         * \param path Log file path
+         * \return false if the file could not be read or is not an input log
+         */
+        bool open(const std::string& path);
+
+        /**
+         * \brief Close the log file
+         */
+        void close();
+
+        /**
+         * \brief The log file header
+         */
+        const InputLogHeader& getHeader() const
+        {
+            return header_;
+        }
+
+        /**
+         * \brief Read the next record
+         * \param [out] record The record read from the log
+         * \return false at the end of the log
+         */
+        bool read(InputRecord& record);
+
+    private:
+        InputLogHeader header_;
+        FILE* file_;
+    };
+
+} // namespace ackermann_drive_controller
+
+#endif // ACKERMANN_DRIVE_CONTROLLER_INPUT_LOG_H_
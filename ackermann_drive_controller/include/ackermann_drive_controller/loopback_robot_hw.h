@@ -0,0 +1,127 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#ifndef ACKERMANN_DRIVE_CONTROLLER_LOOPBACK_ROBOT_HW_H_
+#define ACKERMANN_DRIVE_CONTROLLER_LOOPBACK_ROBOT_HW_H_
+
+#include "ackermann_drive_controller/controller_params.h"
+
+#include <hardware_interface/joint_command_interface.h>
+#include <hardware_interface/joint_state_interface.h>
+#include <hardware_interface/robot_hw.h>
+
+#include <cstddef>
+
+namespace ackermann_drive_controller
+{
+    /**
+     * \brief A RobotHW with the joints required by the controller and no hardware.
+     *
+     * Joint positions are either set directly (replaying recorded inputs) or
+     * follow the commands (benchmarks). Wheel joints use indices 0-5 and
+     * steer joints 6-9, in the order of the names in ControllerParams.
+     */
+    class LoopbackRobotHW : public hardware_interface::RobotHW
+    {
+    public:
+        static const size_t NUM_WHEELS = 6;
+        static const size_t NUM_STEERS = 4;
+        static const size_t NUM_JOINTS = NUM_WHEELS + NUM_STEERS;
+
+        /**
+         * \brief Register the joints named in params
+         * \param params Controller parameters providing the joint names
+         */
+        explicit LoopbackRobotHW(const ControllerParams& params = ControllerParams())
+        {
+            for (size_t i = 0; i < NUM_JOINTS; ++i)
+            {
+                pos_[i] = vel_[i] = eff_[i] = cmd_[i] = 0.0;
+            }
+            for (size_t i = 0; i < NUM_WHEELS; ++i)
+            {
+                hardware_interface::JointStateHandle handle(params.wheel_names[i], &pos_[i], &vel_[i], &eff_[i]);
+                state_if_.registerHandle(handle);
+                vel_if_.registerHandle(hardware_interface::JointHandle(handle, &cmd_[i]));
+            }
+            for (size_t i = 0; i < NUM_STEERS; ++i)
+            {
+                const size_t j = NUM_WHEELS + i;
+                hardware_interface::JointStateHandle handle(params.steer_names[i], &pos_[j], &vel_[j], &eff_[j]);
+                state_if_.registerHandle(handle);
+                pos_if_.registerHandle(hardware_interface::JointHandle(handle, &cmd_[j]));
+            }
+            registerInterface(&state_if_);
+            registerInterface(&vel_if_);
+            registerInterface(&pos_if_);
+        }
+
+        /**
+         * \brief Move the joints as commanded: wheels integrate velocity, steers jump to position
+         * \param dt Time step [s]
+         */
+        void step(double dt)
+        {
+            for (size_t i = 0; i < NUM_WHEELS; ++i)
+                pos_[i] += cmd_[i] * dt;
+            for (size_t i = NUM_WHEELS; i < NUM_JOINTS; ++i)
+                pos_[i] = cmd_[i];
+        }
+
+        double getPosition(size_t i) const { return pos_[i]; }
+
+        void setPosition(size_t i, double position) { pos_[i] = position; }
+
+        double getCommand(size_t i) const { return cmd_[i]; }
+
+    private:
+        hardware_interface::JointStateInterface state_if_;
+        hardware_interface::VelocityJointInterface vel_if_;
+        hardware_interface::PositionJointInterface pos_if_;
+        double pos_[NUM_JOINTS];
+        double vel_[NUM_JOINTS];
+        double eff_[NUM_JOINTS];
+        double cmd_[NUM_JOINTS];
+    };
+
+} // namespace ackermann_drive_controller
+
+#endif // ACKERMANN_DRIVE_CONTROLLER_LOOPBACK_ROBOT_HW_H_
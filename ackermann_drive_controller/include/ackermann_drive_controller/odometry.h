@@ -133,6 +133,23 @@ namespace ackermann_drive_controller
         // bool update(double left_pos, double right_pos, const ros::Time &time);
         bool update(const std::vector<double>& wheel_pos, const std::vector<double>& steer_pos, const ros::Time &time);
 
+        /**
+         * \brief Set the pose, for example when resuming from a snapshot
+         * \param x       x position [m]
+         * \param y       y position [m]
+         * \param heading heading [rad]
+         */
+        void setPose(double x, double y, double heading);
+
+        /**
+         * \brief Set the reference wheel positions for the next update
+         *
+         * Call when starting with wheel positions that are not zero, so the
+         * first update does not integrate the whole position as motion.
+         * \param wheel_pos Wheel positions [rad]
+         */
+        void setWheelPositions(const std::vector<double>& wheel_pos);
+
         /**
          * \brief Updates the odometry class with latest velocity command
          * \param linear  Linear velocity [m/s]
@@ -188,8 +205,8 @@ namespace ackermann_drive_controller
 
         /**
          * \brief Sets the wheel and steering geometry
-         * \param wheel_radius  Wheel radius [m]
-         * 
+         * \param wheel_radius  Wheel radius [m], the previous wheel positions are
+         *                      rescaled so a change does not cause a jump
          * \param mid_wheel_lat_separation  Separation between left and right mid wheels [m]
          * \param front_wheel_lat_separation  Separation between left and right front wheels [m]
          * \param front_wheel_lon_separation  Separation between mid and front wheel axis [m]
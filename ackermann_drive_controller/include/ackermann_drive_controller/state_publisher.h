@@ -0,0 +1,187 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#ifndef ACKERMANN_DRIVE_CONTROLLER_STATE_PUBLISHER_H_
+#define ACKERMANN_DRIVE_CONTROLLER_STATE_PUBLISHER_H_
+
+#include <curio_realtime/realtime_queue.h>
+#include <geometry_msgs/TwistStamped.h>
+#include <nav_msgs/Odometry.h>
+#include <ros/ros.h>
+#include <tf/tfMessage.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include <semaphore.h>
+
+namespace ackermann_drive_controller
+{
+    /**
+     * \brief Fixed size snapshot of the controller state for one control cycle.
+     *
+     * The flags select which messages the publisher thread generates
+     * from the record.
+     */
+    struct StateRecord
+    {
+        enum Flags
+        {
+            PUBLISH_ODOM    = 1 << 0,
+            PUBLISH_TF      = 1 << 1,
+            PUBLISH_CMD_VEL = 1 << 2
+        };
+
+        ros::Time stamp;
+        uint32_t flags;
+
+        // Odometry
+        double x;
+        double y;
+        double heading;
+        double linear;
+        double angular;
+
+        // Executed (limited) velocity command
+        double cmd_lin;
+        double cmd_ang;
+
+        StateRecord() :
+            stamp(0.0), flags(0),
+            x(0.0), y(0.0), heading(0.0), linear(0.0), angular(0.0),
+            cmd_lin(0.0), cmd_ang(0.0)
+        {}
+    };
+
+    /**
+     * \brief Publish odometry, tf and executed commands from a single thread.
+     *
+     * Replaces one realtime_tools::RealtimePublisher per topic. The realtime
+     * loop pushes a StateRecord into a lock-free queue and posts a semaphore;
+     * the publisher thread sleeps until woken, drains the queue and fans each
+     * record out to preallocated messages. Records that do not fit in the
+     * queue are dropped and counted.
+     */
+    class StatePublisher
+    {
+    public:
+        /// Queue capacity in records
+        static const size_t QUEUE_SIZE = 64;
+
+        StatePublisher();
+
+        ~StatePublisher();
+
+        /**
+         * \brief Advertise topics and set the constant message fields
+         * \param root_nh            Node handle at root namespace (for /tf)
+         * \param controller_nh      Node handle inside the controller namespace
+         * \param odom_frame_id      Frame id for odometry and the odom tf
+         * \param base_frame_id      Frame id of the robot base
+         * \param pose_covariance    Diagonal of the pose covariance (6 elements)
+         * \param twist_covariance   Diagonal of the twist covariance (6 elements)
+         * \param publish_cmd        Advertise cmd_vel_out if true
+         */
+        void init(ros::NodeHandle& root_nh,
+            ros::NodeHandle& controller_nh,
+            const std::string& odom_frame_id,
+            const std::string& base_frame_id,
+            const double pose_covariance[6],
+            const double twist_covariance[6],
+            bool publish_cmd);
+
+        /**
+         * \brief Start the publisher thread
+         */
+        void start();
+
+        /**
+         * \brief Stop and join the publisher thread
+         */
+        void stop();
+
+        /**
+         * \brief Queue a record for publishing. Realtime safe.
+         * \param record The controller state to publish
+         * \return false if the queue was full and the record was dropped
+         */
+        bool enqueue(const StateRecord& record);
+
+        /**
+         * \brief Number of records dropped because the queue was full
+         */
+        uint64_t getDroppedCount() const
+        {
+            return dropped_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        /**
+         * \brief Publisher thread main loop
+         */
+        void run();
+
+        /**
+         * \brief Fan a record out to the enabled publishers
+         */
+        void publish(const StateRecord& record);
+
+        curio_realtime::RealtimeQueue<StateRecord, QUEUE_SIZE> queue_;
+        sem_t wakeup_;
+        std::thread thread_;
+        std::atomic<bool> running_;
+        std::atomic<uint64_t> dropped_;
+        uint64_t dropped_reported_;
+
+        ros::Publisher odom_pub_;
+        ros::Publisher tf_odom_pub_;
+        ros::Publisher cmd_vel_pub_;
+
+        /// Preallocated messages
+        nav_msgs::Odometry odom_msg_;
+        tf::tfMessage tf_odom_msg_;
+        geometry_msgs::TwistStamped cmd_vel_msg_;
+    };
+
+} // namespace ackermann_drive_controller
+
+#endif // ACKERMANN_DRIVE_CONTROLLER_STATE_PUBLISHER_H_
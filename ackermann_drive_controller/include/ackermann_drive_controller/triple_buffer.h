@@ -0,0 +1,105 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#ifndef ACKERMANN_DRIVE_CONTROLLER_TRIPLE_BUFFER_H_
+#define ACKERMANN_DRIVE_CONTROLLER_TRIPLE_BUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+
+namespace ackermann_drive_controller
+{
+    /**
+     * \brief A wait-free, single producer single consumer latest value.
+     *
+     * The writer and reader each own one of three buffers and swap it
+     * with the third, shared buffer in a single atomic exchange. Neither
+     * side ever waits for the other, unlike realtime_tools::RealtimeBuffer
+     * whose reader skips an update while the writer holds the lock.
+     * Intermediate values written between two reads are lost.
+     *
+     * \tparam T Value type, should be cheap to copy
+     */
+    template <typename T>
+    class TripleBuffer
+    {
+    public:
+        TripleBuffer() : shared_(1), write_(0), read_(2)
+        {
+        }
+
+        TripleBuffer(const TripleBuffer&) = delete;
+        TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+        /**
+         * \brief Publish a new value (producer only)
+         */
+        void write(const T& value)
+        {
+            buffers_[write_] = value;
+            write_ = shared_.exchange(write_ | DIRTY, std::memory_order_acq_rel) & INDEX;
+        }
+
+        /**
+         * \brief The latest value written, or a default constructed value
+         * if nothing has been written (consumer only)
+         */
+        const T& read()
+        {
+            if (shared_.load(std::memory_order_relaxed) & DIRTY)
+            {
+                read_ = shared_.exchange(read_, std::memory_order_acq_rel) & INDEX;
+            }
+            return buffers_[read_];
+        }
+
+    private:
+        static const uint8_t INDEX = 0x3;
+        static const uint8_t DIRTY = 0x4;
+
+        T buffers_[3];
+        std::atomic<uint8_t> shared_;
+        uint8_t write_;
+        uint8_t read_;
+    };
+
+} // namespace ackermann_drive_controller
+
+#endif // ACKERMANN_DRIVE_CONTROLLER_TRIPLE_BUFFER_H_
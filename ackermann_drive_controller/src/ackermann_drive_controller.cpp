@@ -83,11 +83,14 @@
 #include "ackermann_drive_controller/ackermann_drive_controller.h"
 #include "ackermann_drive_controller/ackermann_drive_enums.h"
 
+#include <boost/bind.hpp>
 #include <tf/transform_datatypes.h>
 #include <urdf/urdfdom_compatibility.h>
 #include <urdf_parser/urdf_parser.h>
+#include <algorithm>
 #include <cmath>
 #include <limits>
+#include <sstream>
 
 /*
 static double euclideanOfVectors(const urdf::Vector3& vec1, const urdf::Vector3& vec2)
@@ -234,20 +237,80 @@ void turningRadiusAndRate(double v_b, double omega_b, double d, double &r_p, dou
     }
 }
 
+/// \brief Predict the pose after moving at a constant velocity.
+/// \param[in]      lin     linear velocity of the base [m/s].
+/// \param[in]      ang     angular velocity of the base [rad/s].
+/// \param[in]      dt      prediction horizon [s].
+/// \param[in,out]  x       x position [m].
+/// \param[in,out]  y       y position [m].
+/// \param[in,out]  heading heading [rad].
+static void predictPose(double lin, double ang, double dt,
+    double &x, double &y, double &heading)
+{
+    if (std::fabs(ang) < 1e-6)
+    {
+        x += lin * dt * std::cos(heading);
+        y += lin * dt * std::sin(heading);
+    }
+    else
+    {
+        const double r = lin / ang;
+        const double heading_new = heading + ang * dt;
+        x += r * (std::sin(heading_new) - std::sin(heading));
+        y -= r * (std::cos(heading_new) - std::cos(heading));
+        heading = heading_new;
+    }
+}
+
+/// \brief Lead a limited command by the actuation delay.
+///
+/// The limited command ramps towards the target at the limiter's
+/// acceleration. The command sent to the joints is taken from further
+/// along the same ramp, so that once the delay has elapsed the joints
+/// execute the motion at the time it was commanded.
+///
+/// \param[in]  limiter the limiter applied to the command.
+/// \param[in]  v       limited command [m/s] or [rad/s].
+/// \param[in]  target  command before limiting [m/s] or [rad/s].
+/// \param[in]  lead    actuation delay to lead by [s].
+/// \return the command to send to the joints.
+static double leadCommand(const ackermann_drive_controller::SpeedLimiter &limiter,
+    double v, double target, double lead)
+{
+    double dv = target - v;
+    if (limiter.has_acceleration_limits)
+    {
+        dv = std::min(std::max(dv, limiter.min_acceleration * lead),
+            limiter.max_acceleration * lead);
+    }
+    double v_lead = v + dv;
+    if (limiter.has_velocity_limits)
+    {
+        v_lead = std::min(std::max(v_lead, limiter.min_velocity),
+            limiter.max_velocity);
+    }
+    return v_lead;
+}
+
 namespace ackermann_drive_controller
 {
     AckermannDriveController::AckermannDriveController():
         open_loop_(false),
         command_struct_(),
+        active_source_(SOURCE_DEFAULT),
+        trajectory_struct_(),
+        trajectory_received_(0.0),
+        trajectory_cursor_(0),
         wheel_radius_(0.0),
         mid_wheel_lat_separation_(0.0),
         front_wheel_lat_separation_(0.0),
         front_wheel_lon_separation_(0.0),
         back_wheel_lat_separation_(0.0),
         back_wheel_lon_separation_(0.0),
-        // wheel_separation_multiplier_(1.0),
-        // left_wheel_radius_multiplier_(1.0),
-        // right_wheel_radius_multiplier_(1.0),
+        wheel_radius_multiplier_(1.0),
+        wheel_separation_multiplier_(1.0),
+        wheel_base_multiplier_(1.0),
+        nominal_geometry_(),
         cmd_vel_timeout_(0.5),
         allow_multiple_cmd_vel_publishers_(true),
         base_frame_id_("base_link"),
@@ -255,7 +318,20 @@ namespace ackermann_drive_controller
         enable_odom_tf_(true),
         wheel_joints_size_(0),
         steer_joints_size_(0),
-        publish_cmd_(false)
+        publish_cmd_(false),
+        cmd_vel_timed_out_(false),
+        input_record_(),
+        last_trace_id_(0),
+        latency_compensation_(false),
+        latency_max_delay_(0.5),
+        latency_steer_delay_(-1.0),
+        drive_delay_(0.02),
+        steer_delay_(0.02),
+        mid_wheel_pos_prev_(0.0),
+        drive_delay_estimate_(0.0),
+        steer_delay_estimate_(0.0),
+        pose_snapshot_record_(),
+        restore_pose_(false)
         // publish_wheel_joint_controller_state_(false)
     {
     }
@@ -266,6 +342,172 @@ namespace ackermann_drive_controller
         // hardware_interface::VelocityJointInterface* hw,
         ros::NodeHandle& root_nh,
         ros::NodeHandle &controller_nh)
+    {
+        const std::string complete_ns = controller_nh.getNamespace();
+        std::size_t id = complete_ns.find_last_of("/");
+        name_ = complete_ns.substr(id + 1);
+
+        ControllerParams params;
+        if (!loadParams(controller_nh, params) || !configure(robot_hw, params))
+        {
+            return false;
+        }
+
+        setOdomPubFields(root_nh, controller_nh, params);
+
+        if (curio_realtime::RealtimeGuard::isLoaded())
+        {
+            ROS_WARN_STREAM_NAMED(name_, "Realtime guard loaded, allocations, locks and "
+                                  "blocking calls in update() will be counted once started.");
+        }
+
+        sub_command_ = controller_nh.subscribe("cmd_vel", 1, &AckermannDriveController::cmdVelCallback, this);
+        sub_trajectory_ = controller_nh.subscribe("cmd_vel_trajectory", 1,
+            &AckermannDriveController::cmdVelTrajectoryCallback, this);
+        for (size_t i = 0; i < command_sources_.size(); ++i)
+        {
+            command_sources_[i]->sub = controller_nh.subscribe<geometry_msgs::Twist>(
+                command_sources_[i]->params.topic, 1,
+                boost::bind(&AckermannDriveController::commandSourceCallback, this, _1, i));
+        }
+
+        state_pub_->start();
+
+        dump_statistics_srv_ = controller_nh.advertiseService("dump_statistics",
+            &AckermannDriveController::dumpStatisticsCallback, this);
+
+        // Record inputs for offline replay:
+        if (!params.record_inputs.empty())
+        {
+            input_recorder_.reset(new InputRecorder());
+            if (input_recorder_->open(params.record_inputs, params))
+            {
+                ROS_INFO_STREAM_NAMED(name_, "Recording inputs to " << params.record_inputs);
+            }
+            else
+            {
+                input_recorder_.reset();
+            }
+        }
+
+        // Trace command latency:
+        if (!params.latency_trace.empty())
+        {
+            latency_trace_.reset(new curio_realtime::LatencyTrace());
+            if (latency_trace_->open(params.latency_trace))
+            {
+                ROS_INFO_STREAM_NAMED(name_, "Tracing command latency to " << params.latency_trace);
+            }
+            else
+            {
+                latency_trace_.reset();
+            }
+        }
+
+        // Resume the pose from the last snapshot if it is recent:
+        if (!params.pose_snapshot.empty())
+        {
+            pose_snapshot_.reset(new curio_realtime::SnapshotFile<PoseSnapshot>());
+            if (pose_snapshot_->open(params.pose_snapshot, "ADCPOSE"))
+            {
+                double age = 0.0;
+                restore_pose_ = pose_snapshot_->read(pose_snapshot_record_,
+                    params.pose_snapshot_max_age, age);
+                if (restore_pose_)
+                {
+                    ROS_INFO_STREAM_NAMED(name_, "Resuming pose from snapshot " << params.pose_snapshot
+                        << " (age " << age << " s): x: " << pose_snapshot_record_.x
+                        << ", y: " << pose_snapshot_record_.y
+                        << ", heading: " << pose_snapshot_record_.heading);
+                }
+                else
+                {
+                    ROS_INFO_STREAM_NAMED(name_, "No recent pose snapshot in " << params.pose_snapshot);
+                }
+            }
+            else
+            {
+                pose_snapshot_.reset();
+            }
+        }
+
+        // Initialize dynamic_reconfigure server with the current values
+        AckermannDriveControllerConfig config;
+        config.wheel_radius_multiplier     = wheel_radius_multiplier_;
+        config.wheel_separation_multiplier = wheel_separation_multiplier_;
+        config.wheel_base_multiplier       = wheel_base_multiplier_;
+
+        config.publish_rate = params.publish_rate;
+        config.enable_odom_tf = enable_odom_tf_;
+
+        config.linear_x_has_velocity_limits     = limiter_lin_.has_velocity_limits;
+        config.linear_x_has_acceleration_limits = limiter_lin_.has_acceleration_limits;
+        config.linear_x_has_jerk_limits         = limiter_lin_.has_jerk_limits;
+        config.linear_x_max_velocity            = limiter_lin_.max_velocity;
+        config.linear_x_min_velocity            = limiter_lin_.min_velocity;
+        config.linear_x_max_acceleration        = limiter_lin_.max_acceleration;
+        config.linear_x_min_acceleration        = limiter_lin_.min_acceleration;
+        config.linear_x_max_jerk                = limiter_lin_.max_jerk;
+        config.linear_x_min_jerk                = limiter_lin_.min_jerk;
+
+        config.angular_z_has_velocity_limits     = limiter_ang_.has_velocity_limits;
+        config.angular_z_has_acceleration_limits = limiter_ang_.has_acceleration_limits;
+        config.angular_z_has_jerk_limits         = limiter_ang_.has_jerk_limits;
+        config.angular_z_max_velocity            = limiter_ang_.max_velocity;
+        config.angular_z_min_velocity            = limiter_ang_.min_velocity;
+        config.angular_z_max_acceleration        = limiter_ang_.max_acceleration;
+        config.angular_z_min_acceleration        = limiter_ang_.min_acceleration;
+        config.angular_z_max_jerk                = limiter_ang_.max_jerk;
+        config.angular_z_min_jerk                = limiter_ang_.min_jerk;
+
+        dyn_reconf_server_ = std::make_shared<ReconfigureServer>(controller_nh);
+        dyn_reconf_server_->updateConfig(config);
+        dyn_reconf_server_->setCallback(boost::bind(&AckermannDriveController::reconfCallback, this, _1, _2));
+
+        return true;
+    }
+
+    bool AckermannDriveController::init(
+        hardware_interface::RobotHW* robot_hw,
+        const ControllerParams& params)
+    {
+        name_ = "ackermann_drive_controller";
+
+        std::string error;
+        if (!params.validate(error))
+        {
+            ROS_ERROR_STREAM_NAMED(name_, "Invalid parameter: " << error);
+            return false;
+        }
+        return configure(robot_hw, params);
+    }
+
+    bool AckermannDriveController::loadParams(
+        ros::NodeHandle& controller_nh,
+        ControllerParams& params)
+    {
+        // One round trip to the parameter server for the whole namespace
+        XmlRpc::XmlRpcValue value;
+        if (!controller_nh.getParam(controller_nh.getNamespace(), value))
+        {
+            ROS_ERROR_STREAM_NAMED(name_, "Failed to read the parameters in "
+                << controller_nh.getNamespace());
+            return false;
+        }
+
+        std::string error;
+        if (!params.fromXmlRpc(value, error) || !params.validate(error))
+        {
+            ROS_ERROR_STREAM_NAMED(name_, "Invalid parameter in "
+                << controller_nh.getNamespace() << ": " << error);
+            return false;
+        }
+        return true;
+    }
+
+    bool AckermannDriveController::configure(
+        hardware_interface::RobotHW* robot_hw,
+        const ControllerParams& params)
     {
         typedef hardware_interface::VelocityJointInterface VelIface;
         typedef hardware_interface::PositionJointInterface PosIface;
@@ -274,138 +516,107 @@ namespace ackermann_drive_controller
         VelIface *vel_joint_if = robot_hw->get<VelIface>(); // vel for wheels
         PosIface *pos_joint_if = robot_hw->get<PosIface>(); // pos for steers
 
-        const std::string complete_ns = controller_nh.getNamespace();
-        std::size_t id = complete_ns.find_last_of("/");
-        name_ = complete_ns.substr(id + 1);
-
-        // Get joint names from the parameter server
+        // Resize joint vectors
         wheel_joints_size_ = 6;
         steer_joints_size_ = 4;
-        std::vector<std::string> wheel_names(wheel_joints_size_), steer_names(steer_joints_size_);
-        controller_nh.param("front_left_wheel",  wheel_names[WHEEL_INDEX_FRONT_LEFT], std::string("front_left_wheel_joint"));
-        controller_nh.param("front_right_wheel", wheel_names[WHEEL_INDEX_FRONT_RIGHT], std::string("front_right_wheel_joint"));
-        controller_nh.param("mid_left_wheel",    wheel_names[WHEEL_INDEX_MID_LEFT], std::string("mid_left_wheel_joint"));
-        controller_nh.param("mid_right_wheel",   wheel_names[WHEEL_INDEX_MID_RIGHT], std::string("mid_right_wheel_joint"));
-        controller_nh.param("back_left_wheel",   wheel_names[WHEEL_INDEX_BACK_LEFT], std::string("back_left_wheel_joint"));
-        controller_nh.param("back_right_wheel",  wheel_names[WHEEL_INDEX_BACK_RIGHT], std::string("back_right_wheel_joint"));
-        controller_nh.param("front_left_steer",  steer_names[STEER_INDEX_FRONT_LEFT], std::string("front_left_steer_joint"));
-        controller_nh.param("front_right_steer", steer_names[STEER_INDEX_FRONT_RIGHT], std::string("front_right_steer_joint"));
-        controller_nh.param("back_left_steer",   steer_names[STEER_INDEX_BACK_LEFT], std::string("back_left_steer_joint"));
-        controller_nh.param("back_right_steer",  steer_names[STEER_INDEX_BACK_RIGHT], std::string("back_right_steer_joint"));
-
-        // Resize joint vectors
         wheel_joints_.resize(wheel_joints_size_);
         steer_joints_.resize(steer_joints_size_);
 
         // Odometry related:
-        double publish_rate;
-        controller_nh.param("publish_rate", publish_rate, 50.0);
         ROS_INFO_STREAM_NAMED(name_, "Controller state will be published at "
-                              << publish_rate << "Hz.");
-        publish_period_ = ros::Duration(1.0 / publish_rate);
-
-        controller_nh.param("open_loop", open_loop_, open_loop_);
-
-        // controller_nh.param("wheel_separation_multiplier", wheel_separation_multiplier_, wheel_separation_multiplier_);
-        // ROS_INFO_STREAM_NAMED(name_, "Wheel separation will be multiplied by "
-        //                       << wheel_separation_multiplier_ << ".");
-
-        // if (controller_nh.hasParam("wheel_radius_multiplier"))
-        // {
-        //     double wheel_radius_multiplier;
-        //     controller_nh.getParam("wheel_radius_multiplier", wheel_radius_multiplier);
-
-        //     left_wheel_radius_multiplier_  = wheel_radius_multiplier;
-        //     right_wheel_radius_multiplier_ = wheel_radius_multiplier;
-        // }
-        // else
-        // {
-        //     controller_nh.param("left_wheel_radius_multiplier", left_wheel_radius_multiplier_, left_wheel_radius_multiplier_);
-        //     controller_nh.param("right_wheel_radius_multiplier", right_wheel_radius_multiplier_, right_wheel_radius_multiplier_);
-        // }
-
-        // ROS_INFO_STREAM_NAMED(name_, "Left wheel radius will be multiplied by "
-        //                       << left_wheel_radius_multiplier_ << ".");
-        // ROS_INFO_STREAM_NAMED(name_, "Right wheel radius will be multiplied by "
-        //                       << right_wheel_radius_multiplier_ << ".");
-
-        int velocity_rolling_window_size = 10;
-        controller_nh.param("velocity_rolling_window_size", velocity_rolling_window_size, velocity_rolling_window_size);
-        ROS_INFO_STREAM_NAMED(name_, "Velocity rolling window size of "
-                              << velocity_rolling_window_size << ".");
+                              << params.publish_rate << "Hz.");
+        publish_period_ = ros::Duration(1.0 / params.publish_rate);
+        open_loop_ = params.open_loop;
 
-        odometry_.setVelocityRollingWindowSize(velocity_rolling_window_size);
+        ROS_INFO_STREAM_NAMED(name_, "Velocity rolling window size of "
+                              << params.velocity_rolling_window_size << ".");
+        odometry_.setVelocityRollingWindowSize(params.velocity_rolling_window_size);
 
         // Twist command related:
-        controller_nh.param("cmd_vel_timeout", cmd_vel_timeout_, cmd_vel_timeout_);
+        cmd_vel_timeout_ = params.cmd_vel_timeout;
         ROS_INFO_STREAM_NAMED(name_, "Velocity commands will be considered old if they are older than "
                               << cmd_vel_timeout_ << "s.");
 
-        controller_nh.param("allow_multiple_cmd_vel_publishers", allow_multiple_cmd_vel_publishers_, allow_multiple_cmd_vel_publishers_);
+        allow_multiple_cmd_vel_publishers_ = params.allow_multiple_cmd_vel_publishers;
         ROS_INFO_STREAM_NAMED(name_, "Allow mutiple cmd_vel publishers is "
                               << (allow_multiple_cmd_vel_publishers_?"enabled":"disabled"));
 
-        controller_nh.param("base_frame_id", base_frame_id_, base_frame_id_);
+        command_sources_.clear();
+        for (const CommandSourceParams& source_params : params.command_sources)
+        {
+            std::unique_ptr<CommandSource> source(new CommandSource());
+            source->params = source_params;
+            command_sources_.push_back(std::move(source));
+        }
+        std::sort(command_sources_.begin(), command_sources_.end(),
+            [](const std::unique_ptr<CommandSource>& a, const std::unique_ptr<CommandSource>& b)
+            {
+                return a->params.priority > b->params.priority;
+            });
+        for (const std::unique_ptr<CommandSource>& source : command_sources_)
+        {
+            ROS_INFO_STREAM_NAMED(name_, "Command source '" << source->params.name
+                                  << "' on " << source->params.topic
+                                  << ", priority " << source->params.priority
+                                  << ", timeout " << source->params.timeout
+                                  << "s, lockout " << source->params.lockout << "s.");
+        }
+
+        base_frame_id_ = params.base_frame_id;
         ROS_INFO_STREAM_NAMED(name_, "Base frame_id set to " << base_frame_id_);
 
-        controller_nh.param("odom_frame_id", odom_frame_id_, odom_frame_id_);
+        odom_frame_id_ = params.odom_frame_id;
         ROS_INFO_STREAM_NAMED(name_, "Odometry frame_id set to " << odom_frame_id_);
 
-        controller_nh.param("enable_odom_tf", enable_odom_tf_, enable_odom_tf_);
+        enable_odom_tf_ = params.enable_odom_tf;
         ROS_INFO_STREAM_NAMED(name_, "Publishing to tf is " << (enable_odom_tf_?"enabled":"disabled"));
 
         // Velocity and acceleration limits:
-        controller_nh.param("linear/x/has_velocity_limits"    , limiter_lin_.has_velocity_limits    , limiter_lin_.has_velocity_limits    );
-        controller_nh.param("linear/x/has_acceleration_limits", limiter_lin_.has_acceleration_limits, limiter_lin_.has_acceleration_limits);
-        controller_nh.param("linear/x/has_jerk_limits"        , limiter_lin_.has_jerk_limits        , limiter_lin_.has_jerk_limits        );
-        controller_nh.param("linear/x/max_velocity"           , limiter_lin_.max_velocity           ,  limiter_lin_.max_velocity          );
-        controller_nh.param("linear/x/min_velocity"           , limiter_lin_.min_velocity           , -limiter_lin_.max_velocity          );
-        controller_nh.param("linear/x/max_acceleration"       , limiter_lin_.max_acceleration       ,  limiter_lin_.max_acceleration      );
-        controller_nh.param("linear/x/min_acceleration"       , limiter_lin_.min_acceleration       , -limiter_lin_.max_acceleration      );
-        controller_nh.param("linear/x/max_jerk"               , limiter_lin_.max_jerk               ,  limiter_lin_.max_jerk              );
-        controller_nh.param("linear/x/min_jerk"               , limiter_lin_.min_jerk               , -limiter_lin_.max_jerk              );
-
-        controller_nh.param("angular/z/has_velocity_limits"    , limiter_ang_.has_velocity_limits    , limiter_ang_.has_velocity_limits    );
-        controller_nh.param("angular/z/has_acceleration_limits", limiter_ang_.has_acceleration_limits, limiter_ang_.has_acceleration_limits);
-        controller_nh.param("angular/z/has_jerk_limits"        , limiter_ang_.has_jerk_limits        , limiter_ang_.has_jerk_limits        );
-        controller_nh.param("angular/z/max_velocity"           , limiter_ang_.max_velocity           ,  limiter_ang_.max_velocity          );
-        controller_nh.param("angular/z/min_velocity"           , limiter_ang_.min_velocity           , -limiter_ang_.max_velocity          );
-        controller_nh.param("angular/z/max_acceleration"       , limiter_ang_.max_acceleration       ,  limiter_ang_.max_acceleration      );
-        controller_nh.param("angular/z/min_acceleration"       , limiter_ang_.min_acceleration       , -limiter_ang_.max_acceleration      );
-        controller_nh.param("angular/z/max_jerk"               , limiter_ang_.max_jerk               ,  limiter_ang_.max_jerk              );
-        controller_nh.param("angular/z/min_jerk"               , limiter_ang_.min_jerk               , -limiter_ang_.max_jerk              );
+        limiter_lin_ = params.limiter_lin;
+        limiter_ang_ = params.limiter_ang;
 
         // Publish limited velocity:
-        controller_nh.param("publish_cmd", publish_cmd_, publish_cmd_);
-
-        // Publish wheel data:
-        // controller_nh.param("publish_wheel_joint_controller_state", publish_wheel_joint_controller_state_, publish_wheel_joint_controller_state_);
-
-        // If either parameter is not available, we need to look up the value in the URDF
-        // bool lookup_wheel_separation = !controller_nh.getParam("wheel_separation", wheel_separation_);
-        // bool lookup_wheel_radius = !controller_nh.getParam("wheel_radius", wheel_radius_);
-        controller_nh.param("wheel_radius", wheel_radius_, wheel_radius_);
-        controller_nh.param("mid_wheel_lat_separation", mid_wheel_lat_separation_, mid_wheel_lat_separation_);
-        controller_nh.param("front_wheel_lat_separation", front_wheel_lat_separation_, front_wheel_lat_separation_);
-        controller_nh.param("front_wheel_lon_separation", front_wheel_lon_separation_, front_wheel_lon_separation_);
-        controller_nh.param("back_wheel_lat_separation", back_wheel_lat_separation_, back_wheel_lat_separation_);
-        controller_nh.param("back_wheel_lon_separation", back_wheel_lon_separation_, back_wheel_lon_separation_);
-
-        // Set up positions of wheels and steering joints
-        wheel_positions_.resize(wheel_joints_size_);
-        steer_positions_.resize(steer_joints_size_);
+        publish_cmd_ = params.publish_cmd;
 
-        wheel_positions_[WHEEL_INDEX_FRONT_LEFT]  = Pos(front_wheel_lon_separation_, front_wheel_lat_separation_/2.0);
-        wheel_positions_[WHEEL_INDEX_FRONT_RIGHT] = Pos(front_wheel_lon_separation_, -front_wheel_lat_separation_/2.0);
-        wheel_positions_[WHEEL_INDEX_MID_LEFT]    = Pos(0.0, mid_wheel_lat_separation_/2.0);
-        wheel_positions_[WHEEL_INDEX_MID_RIGHT]   = Pos(0.0, -mid_wheel_lat_separation_/2.0);
-        wheel_positions_[WHEEL_INDEX_BACK_LEFT]   = Pos(-back_wheel_lon_separation_, back_wheel_lat_separation_/2.0);
-        wheel_positions_[WHEEL_INDEX_BACK_RIGHT]  = Pos(-back_wheel_lon_separation_, -back_wheel_lat_separation_/2.0);
+        // Actuation latency compensation:
+        latency_compensation_ = params.latency_compensation && !open_loop_;
+        latency_max_delay_ = params.latency_max_delay;
+        latency_steer_delay_ = params.latency_steer_delay;
+        if (params.latency_compensation && open_loop_)
+        {
+            ROS_WARN_STREAM_NAMED(name_, "Latency compensation requires joint "
+                "feedback and is disabled in open loop.");
+        }
+        ROS_INFO_STREAM_NAMED(name_, "Latency compensation is "
+                              << (latency_compensation_ ? "enabled" : "disabled"));
+        if (latency_compensation_)
+        {
+            if (latency_steer_delay_ < 0.0)
+            {
+                ROS_INFO_STREAM_NAMED(name_, "Steering delay is estimated from the steering joint positions");
+            }
+            else
+            {
+                ROS_INFO_STREAM_NAMED(name_, "Steering delay is set to " << latency_steer_delay_ << " s");
+            }
+        }
 
-        steer_positions_[STEER_INDEX_FRONT_LEFT]  = Pos(front_wheel_lon_separation_, front_wheel_lat_separation_/2.0);
-        steer_positions_[STEER_INDEX_FRONT_RIGHT] = Pos(front_wheel_lon_separation_, -front_wheel_lat_separation_/2.0);
-        steer_positions_[STEER_INDEX_BACK_LEFT]   = Pos(-back_wheel_lon_separation_, back_wheel_lat_separation_/2.0);
-        steer_positions_[STEER_INDEX_BACK_RIGHT]  = Pos(-back_wheel_lon_separation_, -back_wheel_lat_separation_/2.0);
+        // Update loop statistics:
+        statistics_.setEnabled(params.enable_statistics);
+        ROS_INFO_STREAM_NAMED(name_, "Update loop statistics will be "
+                              << (params.enable_statistics ? "enabled" : "disabled"));
+
+        // Geometry:
+        nominal_geometry_.wheel_radius = params.wheel_radius;
+        nominal_geometry_.mid_wheel_lat_separation = params.mid_wheel_lat_separation;
+        nominal_geometry_.front_wheel_lat_separation = params.front_wheel_lat_separation;
+        nominal_geometry_.front_wheel_lon_separation = params.front_wheel_lon_separation;
+        nominal_geometry_.back_wheel_lat_separation = params.back_wheel_lat_separation;
+        nominal_geometry_.back_wheel_lon_separation = params.back_wheel_lon_separation;
+
+        // Positions of wheels and steering joints, set in setGeometry
+        wheel_positions_.resize(wheel_joints_size_);
+        steer_positions_.resize(steer_joints_size_);
 
         // Velocity and angle calculation workspace.
         wheel_vel_.resize(wheel_joints_size_);
@@ -437,25 +648,20 @@ namespace ackermann_drive_controller
                               << ", left wheel radius "  << lwr
                               << ", right wheel radius " << rwr);
         */
-       // Odometry workspace
-       wheel_joints_pos_.resize(wheel_joints_size_);
-       steer_joints_pos_.resize(steer_joints_size_);
+        // Odometry workspace
+        wheel_joints_pos_.resize(wheel_joints_size_);
+        steer_joints_pos_.resize(steer_joints_size_);
 
-        // Set odometry parameters
-        odometry_.setWheelParams(
-            wheel_radius_,
-            mid_wheel_lat_separation_,
-            front_wheel_lat_separation_, 
-            front_wheel_lon_separation_,
-            back_wheel_lat_separation_,
-            back_wheel_lon_separation_);
-
-        setOdomPubFields(root_nh, controller_nh);
+        // Set the joint positions and odometry parameters
+        setGeometry(1.0, 1.0, 1.0);
 
-        if (publish_cmd_)
-        {
-            cmd_vel_pub_.reset(new realtime_tools::RealtimePublisher<geometry_msgs::TwistStamped>(controller_nh, "cmd_vel_out", 100));
-        }
+        // Initial dynamic parameters, nothing to apply until reconfigured
+        DynamicParams dynamic_params;
+        dynamic_params.publish_rate = params.publish_rate;
+        dynamic_params.enable_odom_tf = enable_odom_tf_;
+        dynamic_params.limiter_lin = limiter_lin_;
+        dynamic_params.limiter_ang = limiter_ang_;
+        dynamic_params_.initRT(dynamic_params);
 
         // @TODO: enable publishing wheel and steer joint info.
         // Wheel joint controller state:
@@ -497,68 +703,34 @@ namespace ackermann_drive_controller
         // Get the joint object to use in the realtime loop
         for (size_t i = 0; i < wheel_joints_size_; ++i)
         {
-            ROS_INFO_STREAM_NAMED(name_, "Adding wheel with joint name: " << wheel_names[i]);
-            wheel_joints_[i] = vel_joint_if->getHandle(wheel_names[i]);  // throws on failure
+            ROS_INFO_STREAM_NAMED(name_, "Adding wheel with joint name: " << params.wheel_names[i]);
+            wheel_joints_[i] = vel_joint_if->getHandle(params.wheel_names[i]);  // throws on failure
         }
 
         for (size_t i = 0; i < steer_joints_size_; ++i)
         {
-            ROS_INFO_STREAM_NAMED(name_, "Adding steer with joint name: " << steer_names[i]);
-            steer_joints_[i] = pos_joint_if->getHandle(steer_names[i]);  // throws on failure
+            ROS_INFO_STREAM_NAMED(name_, "Adding steer with joint name: " << params.steer_names[i]);
+            steer_joints_[i] = pos_joint_if->getHandle(params.steer_names[i]);  // throws on failure
         }
 
-        sub_command_ = controller_nh.subscribe("cmd_vel", 1, &AckermannDriveController::cmdVelCallback, this);
-
-        // @TODO: enable dynamic reconfig
-        /*
-        // Initialize dynamic parameters
-        DynamicParams dynamic_params;
-        dynamic_params.left_wheel_radius_multiplier  = left_wheel_radius_multiplier_;
-        dynamic_params.right_wheel_radius_multiplier = right_wheel_radius_multiplier_;
-        dynamic_params.wheel_separation_multiplier   = wheel_separation_multiplier_;
-
-        dynamic_params.publish_rate = publish_rate;
-        dynamic_params.enable_odom_tf = enable_odom_tf_;
-
-        dynamic_params_.writeFromNonRT(dynamic_params);
-
-        // Initialize dynamic_reconfigure server
-        AckermannDriveControllerConfig config;
-        config.left_wheel_radius_multiplier  = left_wheel_radius_multiplier_;
-        config.right_wheel_radius_multiplier = right_wheel_radius_multiplier_;
-        config.wheel_separation_multiplier   = wheel_separation_multiplier_;
-
-        config.publish_rate = publish_rate;
-        config.enable_odom_tf = enable_odom_tf_;
-
-        dyn_reconf_server_ = std::make_shared<ReconfigureServer>(controller_nh);
-        dyn_reconf_server_->updateConfig(config);
-        dyn_reconf_server_->setCallback(boost::bind(&AckermannDriveController::reconfCallback, this, _1, _2));
-        */
-
         return true;
     }
 
     // @TODO: CHANGE
     void AckermannDriveController::update(const ros::Time& time, const ros::Duration& period)
     {
-        // @TODO: enable dynamic reconfig
-        // update parameter from dynamic reconf
-        // updateDynamicParams();
+        // Count allocations, locks and blocking calls if the guard is loaded
+        curio_realtime::RealtimeGuard::Scope realtime_guard;
 
-        // @TODO: enable odometry
-        // Apply (possibly new) multipliers:
-        /*
-        const double ws  = wheel_separation_multiplier_   * wheel_separation_;
-        const double lwr = left_wheel_radius_multiplier_  * wheel_radius_;
-        const double rwr = right_wheel_radius_multiplier_ * wheel_radius_;
+        // Apply parameters staged by dynamic reconfigure
+        updateDynamicParams(time);
 
-        odometry_.setWheelParams(ws, lwr, rwr);
-        */
+        statistics_.beginCycle(period.toNSec());
 
         // COMPUTE AND PUBLISH ODOMETRY
         if (open_loop_)
         {
+            statistics_.mark(ControllerStatistics::PHASE_READ);
             odometry_.updateOpenLoop(last0_cmd_.lin, last0_cmd_.ang, time);
         }
         else
@@ -571,57 +743,149 @@ namespace ackermann_drive_controller
             {
                 steer_joints_pos_[i] = steer_joints_[i].getPosition();
             }
+            statistics_.mark(ControllerStatistics::PHASE_READ);
 
             // Estimate linear and angular velocity using joint information
             odometry_.update(wheel_joints_pos_, steer_joints_pos_, time);
+
+            // Compare the joint response with the commands sent earlier.
+            // The drive speed is differenced from the recorded positions
+            // so that input replays reproduce the estimate.
+            if (latency_compensation_)
+            {
+                const double dt = period.toSec();
+                const double mid_wheel_pos = 0.5
+                    * (wheel_joints_pos_[WHEEL_INDEX_MID_LEFT]
+                    + wheel_joints_pos_[WHEEL_INDEX_MID_RIGHT]);
+                if (dt > 0.0)
+                {
+                    drive_delay_.update(wheel_radius_
+                        * (mid_wheel_pos - mid_wheel_pos_prev_) / dt, dt);
+                }
+                mid_wheel_pos_prev_ = mid_wheel_pos;
+                drive_delay_estimate_.store(drive_delay_.getDelay(), std::memory_order_relaxed);
+
+                // Hardware that reports the commanded steering angle
+                // instead of reading it sets a fixed steering delay.
+                if (latency_steer_delay_ < 0.0)
+                {
+                    steer_delay_.update(0.5
+                        * (steer_joints_pos_[STEER_INDEX_FRONT_LEFT]
+                        + steer_joints_pos_[STEER_INDEX_FRONT_RIGHT]), dt);
+                    steer_delay_estimate_.store(steer_delay_.getDelay(), std::memory_order_relaxed);
+                }
+            }
         }
 
-        // Publish odometry message
+        // Delays to compensate for this cycle
+        double drive_delay = 0.0;
+        double steer_delay = 0.0;
+        if (latency_compensation_)
+        {
+            drive_delay = std::min(drive_delay_.getDelay(), latency_max_delay_);
+            steer_delay = std::min(latency_steer_delay_ < 0.0
+                ? steer_delay_.getDelay() : latency_steer_delay_, latency_max_delay_);
+        }
+        if (pose_snapshot_)
+        {
+            pose_snapshot_record_.x = odometry_.getX();
+            pose_snapshot_record_.y = odometry_.getY();
+            pose_snapshot_record_.heading = odometry_.getHeading();
+            pose_snapshot_->write(pose_snapshot_record_);
+        }
+        statistics_.mark(ControllerStatistics::PHASE_ODOMETRY);
+
+        // Collect the state to publish this cycle
+        state_record_.flags = 0;
+        state_record_.stamp = time;
         if (last_state_publish_time_ + publish_period_ < time)
         {
             last_state_publish_time_ += publish_period_;
-            // Compute and store orientation info
-            const geometry_msgs::Quaternion orientation(
-                tf::createQuaternionMsgFromYaw(odometry_.getHeading()));
-
-            // Populate odom message and publish
-            if (odom_pub_->trylock())
+            state_record_.x = odometry_.getX();
+            state_record_.y = odometry_.getY();
+            state_record_.heading = odometry_.getHeading();
+            if (drive_delay > 0.0)
             {
-                odom_pub_->msg_.header.stamp = time;
-                odom_pub_->msg_.pose.pose.position.x = odometry_.getX();
-                odom_pub_->msg_.pose.pose.position.y = odometry_.getY();
-                odom_pub_->msg_.pose.pose.orientation = orientation;
-                odom_pub_->msg_.twist.twist.linear.x  = odometry_.getLinear();
-                odom_pub_->msg_.twist.twist.angular.z = odometry_.getAngular();
-                odom_pub_->unlockAndPublish();
+                // The measured pose lags the commands already sent by the
+                // actuation delay, predict where they will have taken it.
+                predictPose(last0_cmd_.lin, last0_cmd_.ang, drive_delay,
+                    state_record_.x, state_record_.y, state_record_.heading);
             }
-
-            // Publish tf /odom frame
-            if (enable_odom_tf_ && tf_odom_pub_->trylock())
+            state_record_.linear = odometry_.getLinear();
+            state_record_.angular = odometry_.getAngular();
+            state_record_.flags |= StateRecord::PUBLISH_ODOM;
+            if (enable_odom_tf_)
             {
-                geometry_msgs::TransformStamped& odom_frame = tf_odom_pub_->msg_.transforms[0];
-                odom_frame.header.stamp = time;
-                odom_frame.transform.translation.x = odometry_.getX();
-                odom_frame.transform.translation.y = odometry_.getY();
-                odom_frame.transform.rotation = orientation;
-                tf_odom_pub_->unlockAndPublish();
+                state_record_.flags |= StateRecord::PUBLISH_TF;
             }
         }
 
         // MOVE ROBOT
         // Retreive current velocity command and time step:
         Commands curr_cmd = *(command_.readFromRT());
+
+        // Follow the command trajectory if it arrived after the last cmd_vel
+        const CommandTrajectory& trajectory = *(trajectory_.readFromRT());
+        if (trajectory.size > 0 && trajectory.received > curr_cmd.stamp)
+        {
+            if (trajectory.received != trajectory_received_)
+            {
+                trajectory_received_ = trajectory.received;
+                trajectory_cursor_ = 0;
+            }
+            trajectory.sample(time, trajectory_cursor_, curr_cmd.lin, curr_cmd.ang);
+
+            // The command times out once the horizon has run out
+            curr_cmd.stamp = trajectory.end();
+            curr_cmd.timeout = cmd_vel_timeout_;
+            curr_cmd.trace_id = 0;
+        }
+
+        // Prioritised command sources take precedence over cmd_vel
+        if (!command_sources_.empty())
+        {
+            arbitrateCommandSources(time, curr_cmd);
+        }
+
+        // Trace the first cycle to consume a command
+        const bool trace_command = latency_trace_ && curr_cmd.trace_id != 0
+            && curr_cmd.trace_id != last_trace_id_;
+        if (trace_command)
+        {
+            last_trace_id_ = curr_cmd.trace_id;
+            latency_trace_->record(curr_cmd.trace_id, curio_realtime::LatencyTrace::STAGE_UPDATE);
+        }
+
+        // Record the inputs of this cycle for offline replay
+        if (input_recorder_)
+        {
+            recordInputs(time, period, curr_cmd);
+        }
+
         const double dt = (time - curr_cmd.stamp).toSec();
 
-        // Brake if cmd_vel has timeout:
-        if (dt > cmd_vel_timeout_)
+        // Brake if the command has timed out:
+        if (dt > curr_cmd.timeout)
         {
             curr_cmd.lin = 0.0;
             curr_cmd.ang = 0.0;
+
+            // Count each transition into timeout rather than every cycle
+            if (!cmd_vel_timed_out_)
+            {
+                statistics_.countCmdVelTimeout();
+                cmd_vel_timed_out_ = true;
+            }
+        }
+        else
+        {
+            cmd_vel_timed_out_ = false;
         }
 
         // Limit velocities and accelerations:
         const double cmd_dt(period.toSec());
+        const double target_lin = curr_cmd.lin;
+        const double target_ang = curr_cmd.ang;
 
         limiter_lin_.limit(curr_cmd.lin, last0_cmd_.lin, last1_cmd_.lin, cmd_dt);
         limiter_ang_.limit(curr_cmd.ang, last0_cmd_.ang, last1_cmd_.ang, cmd_dt);
@@ -629,14 +893,34 @@ namespace ackermann_drive_controller
         last1_cmd_ = last0_cmd_;
         last0_cmd_ = curr_cmd;
 
+        // Shift the limited command forward by the actuation delay. The
+        // turn rate is set by both the steering and the drive.
+        if (drive_delay > 0.0 || steer_delay > 0.0)
+        {
+            curr_cmd.lin = leadCommand(limiter_lin_, curr_cmd.lin, target_lin,
+                drive_delay);
+            curr_cmd.ang = leadCommand(limiter_ang_, curr_cmd.ang, target_ang,
+                std::max(drive_delay, steer_delay));
+        }
+        statistics_.mark(ControllerStatistics::PHASE_LIMIT);
+
         // Publish limited velocity:
-        if (publish_cmd_ && cmd_vel_pub_ && cmd_vel_pub_->trylock())
+        if (publish_cmd_)
+        {
+            state_record_.cmd_lin = curr_cmd.lin;
+            state_record_.cmd_ang = curr_cmd.ang;
+            state_record_.flags |= StateRecord::PUBLISH_CMD_VEL;
+        }
+
+        // Hand the state over to the publisher thread
+        if (state_record_.flags != 0 && state_pub_)
         {
-            cmd_vel_pub_->msg_.header.stamp = time;
-            cmd_vel_pub_->msg_.twist.linear.x = curr_cmd.lin;
-            cmd_vel_pub_->msg_.twist.angular.z = curr_cmd.ang;
-            cmd_vel_pub_->unlockAndPublish();
+            if (!state_pub_->enqueue(state_record_))
+            {
+                statistics_.countPublishFailure();
+            }
         }
+        statistics_.mark(ControllerStatistics::PHASE_PUBLISH);
 
         // ACKERMAN DRIVE / STEERING
         // Note the output velocity command for this controller is the angular velocity
@@ -702,6 +986,7 @@ namespace ackermann_drive_controller
                 ROS_DEBUG_STREAM_NAMED(name_, "steer[" << i << "]: angle: " << angle);
             }
         }
+        statistics_.mark(ControllerStatistics::PHASE_KINEMATICS);
 
         // Set velocities.
         for (size_t i = 0; i < wheel_joints_size_; ++i)
@@ -715,9 +1000,35 @@ namespace ackermann_drive_controller
             steer_joints_[i].setCommand(steer_ang_[i]);
         }
 
+        // The hardware tags its next write with the traced command
+        if (trace_command)
+        {
+            latency_trace_->setConsumed(curr_cmd.trace_id);
+        }
+
+        // Record the commands sent for the delay estimates
+        if (latency_compensation_)
+        {
+            drive_delay_.push(curr_cmd.lin);
+            if (latency_steer_delay_ < 0.0)
+            {
+                steer_delay_.push(0.5 * (steer_ang_[STEER_INDEX_FRONT_LEFT]
+                    + steer_ang_[STEER_INDEX_FRONT_RIGHT]));
+            }
+        }
+        statistics_.mark(ControllerStatistics::PHASE_WRITE);
+
         // @TODO: enable publishing wheel and steer joint info.
         // publishWheelData(time, period, curr_cmd, ws, lwr, rwr);
         time_previous_ = time;
+
+        statistics_.endCycle();
+
+        const uint64_t violations = realtime_guard.violations();
+        if (violations != 0)
+        {
+            statistics_.countRealtimeViolations(violations);
+        }
     }
 
     void AckermannDriveController::starting(const ros::Time& time)
@@ -729,10 +1040,42 @@ namespace ackermann_drive_controller
         time_previous_ = time;
 
         odometry_.init(time);
+
+        // The wheel positions need not start at zero, e.g. when the
+        // hardware has resumed its encoder counts.
+        for (size_t i=0; i<wheel_joints_size_; ++i)
+        {
+            wheel_joints_pos_[i] = wheel_joints_[i].getPosition();
+        }
+        odometry_.setWheelPositions(wheel_joints_pos_);
+
+        drive_delay_.reset();
+        steer_delay_.reset();
+        mid_wheel_pos_prev_ = 0.5 * (wheel_joints_pos_[WHEEL_INDEX_MID_LEFT]
+            + wheel_joints_pos_[WHEEL_INDEX_MID_RIGHT]);
+
+        if (restore_pose_)
+        {
+            odometry_.setPose(pose_snapshot_record_.x, pose_snapshot_record_.y,
+                pose_snapshot_record_.heading);
+            restore_pose_ = false;
+        }
+
+        if (input_recorder_)
+        {
+            input_record_.type = InputRecord::TYPE_STARTING;
+            input_record_.time_ns = time.toNSec();
+            input_record_.period_ns = 0;
+            input_recorder_->record(input_record_);
+        }
+
+        // Updates from here on must be realtime safe
+        curio_realtime::RealtimeGuard::arm();
     }
 
     void AckermannDriveController::stopping(const ros::Time& /*time*/)
     {
+        curio_realtime::RealtimeGuard::disarm();
         brake();
     }
 
@@ -751,6 +1094,38 @@ namespace ackermann_drive_controller
         }
     }
 
+    void AckermannDriveController::setCommand(double lin, double ang, const ros::Time& stamp,
+        double timeout)
+    {
+        command_struct_.lin   = lin;
+        command_struct_.ang   = ang;
+        command_struct_.stamp = stamp;
+        command_struct_.timeout = timeout;
+        command_struct_.trace_id = 0;
+        command_.writeFromNonRT(command_struct_);
+    }
+
+    void AckermannDriveController::recordInputs(const ros::Time& time,
+        const ros::Duration& period, const Commands& command)
+    {
+        input_record_.type = InputRecord::TYPE_UPDATE;
+        input_record_.time_ns = time.toNSec();
+        input_record_.period_ns = period.toNSec();
+        for (size_t i = 0; i < wheel_joints_size_; ++i)
+        {
+            input_record_.wheel_pos[i] = wheel_joints_[i].getPosition();
+        }
+        for (size_t i = 0; i < steer_joints_size_; ++i)
+        {
+            input_record_.steer_pos[i] = steer_joints_[i].getPosition();
+        }
+        input_record_.cmd_lin = command.lin;
+        input_record_.cmd_ang = command.ang;
+        input_record_.cmd_stamp_ns = command.stamp.toNSec();
+        input_record_.cmd_timeout = command.timeout;
+        input_recorder_->record(input_record_);
+    }
+
     void AckermannDriveController::cmdVelCallback(const geometry_msgs::Twist& command)
     {
         if (isRunning())
@@ -767,6 +1142,14 @@ namespace ackermann_drive_controller
             command_struct_.ang   = command.angular.z;
             command_struct_.lin   = command.linear.x;
             command_struct_.stamp = ros::Time::now();
+            command_struct_.timeout = cmd_vel_timeout_;
+            command_struct_.trace_id = 0;
+            if (latency_trace_)
+            {
+                command_struct_.trace_id = latency_trace_->matchPublished(
+                    command_struct_.lin, command_struct_.ang);
+                latency_trace_->record(command_struct_.trace_id, curio_realtime::LatencyTrace::STAGE_CMD_RECEIVED);
+            }
             command_.writeFromNonRT (command_struct_);
             ROS_DEBUG_STREAM_NAMED(name_,
                                     "Added values to command. "
@@ -780,6 +1163,135 @@ namespace ackermann_drive_controller
         }
     }
 
+    void AckermannDriveController::commandSourceCallback(
+        const geometry_msgs::Twist::ConstPtr& command, size_t index)
+    {
+        if (!isRunning())
+        {
+            ROS_ERROR_NAMED(name_, "Can't accept new commands. Controller is not running.");
+            return;
+        }
+
+        // Each source has a single subscriber thread writing its buffer
+        Commands source_cmd;
+        source_cmd.lin   = command->linear.x;
+        source_cmd.ang   = command->angular.z;
+        source_cmd.stamp = ros::Time::now();
+        source_cmd.timeout = command_sources_[index]->params.timeout;
+        if (latency_trace_)
+        {
+            source_cmd.trace_id = latency_trace_->matchPublished(source_cmd.lin, source_cmd.ang);
+            latency_trace_->record(source_cmd.trace_id, curio_realtime::LatencyTrace::STAGE_CMD_RECEIVED);
+        }
+        command_sources_[index]->command.write(source_cmd);
+        ROS_DEBUG_STREAM_NAMED(name_,
+                                "Added values to command source '"
+                                << command_sources_[index]->params.name << "'. "
+                                << "Ang: "   << source_cmd.ang << ", "
+                                << "Lin: "   << source_cmd.lin << ", "
+                                << "Stamp: " << source_cmd.stamp);
+    }
+
+    void AckermannDriveController::arbitrateCommandSources(const ros::Time& time, Commands& cmd)
+    {
+        for (size_t i = 0; i < command_sources_.size(); ++i)
+        {
+            const CommandSourceParams& params = command_sources_[i]->params;
+            const Commands& source_cmd = command_sources_[i]->command.read();
+            if (source_cmd.stamp.isZero())
+                continue;
+
+            const double age = (time - source_cmd.stamp).toSec();
+            if (age <= params.timeout)
+            {
+                cmd = source_cmd;
+                active_source_.store(static_cast<int>(i), std::memory_order_relaxed);
+                return;
+            }
+            if (age <= params.timeout + params.lockout)
+            {
+                // Hold lower priority sources at a stop
+                cmd.lin = 0.0;
+                cmd.ang = 0.0;
+                cmd.stamp = time;
+                cmd.timeout = cmd_vel_timeout_;
+                cmd.trace_id = 0;
+                active_source_.store(SOURCE_LOCKOUT, std::memory_order_relaxed);
+                return;
+            }
+        }
+        active_source_.store(SOURCE_DEFAULT, std::memory_order_relaxed);
+    }
+
+    void AckermannDriveController::cmdVelTrajectoryCallback(
+        const trajectory_msgs::MultiDOFJointTrajectory& trajectory)
+    {
+        if (!isRunning())
+        {
+            ROS_ERROR_NAMED(name_, "Can't accept new commands. Controller is not running.");
+            return;
+        }
+
+        std::string error;
+        if (!trajectory_struct_.fromMsg(trajectory, ros::Time::now(), error))
+        {
+            ROS_ERROR_STREAM_THROTTLE_NAMED(1.0, name_, "Rejected command trajectory: " << error);
+            return;
+        }
+        if (trajectory.points.size() > CommandTrajectory::MAX_POINTS)
+        {
+            ROS_WARN_STREAM_THROTTLE_NAMED(1.0, name_, "Command trajectory truncated from "
+                << trajectory.points.size() << " to " << CommandTrajectory::MAX_POINTS << " points.");
+        }
+        trajectory_.writeFromNonRT(trajectory_struct_);
+        ROS_DEBUG_STREAM_NAMED(name_,
+                                "Added command trajectory. "
+                                << "Points: " << trajectory_struct_.size << ", "
+                                << "End: "    << trajectory_struct_.end());
+    }
+
+    bool AckermannDriveController::dumpStatisticsCallback(
+        std_srvs::Trigger::Request& /*req*/,
+        std_srvs::Trigger::Response& res)
+    {
+        // The command source and actuation delay are reported even when
+        // the update loop statistics are disabled
+        if (statistics_.isEnabled())
+        {
+            res.message = statistics_.report();
+        }
+        else
+        {
+            res.message = "Update loop statistics are disabled. Set the parameter 'enable_statistics' to enable.\n";
+        }
+        res.success = statistics_.isEnabled() || !command_sources_.empty() || latency_compensation_;
+        if (!command_sources_.empty())
+        {
+            const int active = active_source_.load(std::memory_order_relaxed);
+            res.message += "\nCommand source: ";
+            if (active >= 0)
+                res.message += command_sources_[active]->params.name + "\n";
+            else if (active == SOURCE_LOCKOUT)
+                res.message += "locked out\n";
+            else
+                res.message += "cmd_vel\n";
+        }
+        if (latency_compensation_)
+        {
+            std::ostringstream os;
+            os << "\nActuation delay: drive "
+               << drive_delay_estimate_.load(std::memory_order_relaxed) * 1000.0
+               << " ms, steer ";
+            if (latency_steer_delay_ < 0.0)
+                os << steer_delay_estimate_.load(std::memory_order_relaxed) * 1000.0 << " ms\n";
+            else
+                os << latency_steer_delay_ * 1000.0 << " ms (configured)\n";
+            res.message += os.str();
+        }
+        ROS_INFO_STREAM_NAMED(name_, "Update loop statistics:\n" << res.message);
+        return true;
+    }
+
     // @TODO: enable setting params from URDF
     /*
     bool AckermannDriveController::setOdomParamsFromUrdf(ros::NodeHandle& root_nh,
@@ -852,84 +1364,157 @@ namespace ackermann_drive_controller
     }
     */
 
-    void AckermannDriveController::setOdomPubFields(ros::NodeHandle& root_nh, ros::NodeHandle& controller_nh)
+    void AckermannDriveController::setOdomPubFields(ros::NodeHandle& root_nh, ros::NodeHandle& controller_nh,
+        const ControllerParams& params)
     {
-        // Get and check params for covariances
-        XmlRpc::XmlRpcValue pose_cov_list;
-        controller_nh.getParam("pose_covariance_diagonal", pose_cov_list);
-        ROS_ASSERT(pose_cov_list.getType() == XmlRpc::XmlRpcValue::TypeArray);
-        ROS_ASSERT(pose_cov_list.size() == 6);
-        for (int i = 0; i < pose_cov_list.size(); ++i)
-            ROS_ASSERT(pose_cov_list[i].getType() == XmlRpc::XmlRpcValue::TypeDouble);
-
-        XmlRpc::XmlRpcValue twist_cov_list;
-        controller_nh.getParam("twist_covariance_diagonal", twist_cov_list);
-        ROS_ASSERT(twist_cov_list.getType() == XmlRpc::XmlRpcValue::TypeArray);
-        ROS_ASSERT(twist_cov_list.size() == 6);
-        for (int i = 0; i < twist_cov_list.size(); ++i)
-            ROS_ASSERT(twist_cov_list[i].getType() == XmlRpc::XmlRpcValue::TypeDouble);
-
-        // Setup odometry realtime publisher + odom message constant fields
-        odom_pub_.reset(new realtime_tools::RealtimePublisher<nav_msgs::Odometry>(controller_nh, "odom", 100));
-        odom_pub_->msg_.header.frame_id = odom_frame_id_;
-        odom_pub_->msg_.child_frame_id = base_frame_id_;
-        odom_pub_->msg_.pose.pose.position.z = 0;
-        odom_pub_->msg_.pose.covariance = {
-            static_cast<double>(pose_cov_list[0]), 0., 0., 0., 0., 0.,
-            0., static_cast<double>(pose_cov_list[1]), 0., 0., 0., 0.,
-            0., 0., static_cast<double>(pose_cov_list[2]), 0., 0., 0.,
-            0., 0., 0., static_cast<double>(pose_cov_list[3]), 0., 0.,
-            0., 0., 0., 0., static_cast<double>(pose_cov_list[4]), 0.,
-            0., 0., 0., 0., 0., static_cast<double>(pose_cov_list[5]) };
-        odom_pub_->msg_.twist.twist.linear.y  = 0;
-        odom_pub_->msg_.twist.twist.linear.z  = 0;
-        odom_pub_->msg_.twist.twist.angular.x = 0;
-        odom_pub_->msg_.twist.twist.angular.y = 0;
-        odom_pub_->msg_.twist.covariance = {
-            static_cast<double>(twist_cov_list[0]), 0., 0., 0., 0., 0.,
-            0., static_cast<double>(twist_cov_list[1]), 0., 0., 0., 0.,
-            0., 0., static_cast<double>(twist_cov_list[2]), 0., 0., 0.,
-            0., 0., 0., static_cast<double>(twist_cov_list[3]), 0., 0.,
-            0., 0., 0., 0., static_cast<double>(twist_cov_list[4]), 0.,
-            0., 0., 0., 0., 0., static_cast<double>(twist_cov_list[5]) };
-        tf_odom_pub_.reset(new realtime_tools::RealtimePublisher<tf::tfMessage>(root_nh, "/tf", 100));
-        tf_odom_pub_->msg_.transforms.resize(1);
-        tf_odom_pub_->msg_.transforms[0].transform.translation.z = 0.0;
-        tf_odom_pub_->msg_.transforms[0].child_frame_id = base_frame_id_;
-        tf_odom_pub_->msg_.transforms[0].header.frame_id = odom_frame_id_;
+        // Setup the odometry, tf and executed command publisher thread
+        state_pub_.reset(new StatePublisher());
+        state_pub_->init(root_nh, controller_nh,
+            odom_frame_id_, base_frame_id_,
+            params.pose_covariance_diagonal, params.twist_covariance_diagonal,
+            publish_cmd_);
     }
 
-    // @TODO: enable dynamic reconfig
-    /*
-    void AckermannDriveController::reconfCallback(AckermannDriveControllerConfig& config, uint32_t level)
+    void AckermannDriveController::reconfCallback(AckermannDriveControllerConfig& config, uint32_t /*level*/)
     {
         DynamicParams dynamic_params;
-        dynamic_params.left_wheel_radius_multiplier  = config.left_wheel_radius_multiplier;
-        dynamic_params.right_wheel_radius_multiplier = config.right_wheel_radius_multiplier;
-        dynamic_params.wheel_separation_multiplier   = config.wheel_separation_multiplier;
+        dynamic_params.update = true;
+        dynamic_params.wheel_radius_multiplier     = config.wheel_radius_multiplier;
+        dynamic_params.wheel_separation_multiplier = config.wheel_separation_multiplier;
+        dynamic_params.wheel_base_multiplier       = config.wheel_base_multiplier;
 
         dynamic_params.publish_rate = config.publish_rate;
 
         dynamic_params.enable_odom_tf = config.enable_odom_tf;
 
+        SpeedLimiter& limiter_lin = dynamic_params.limiter_lin;
+        limiter_lin.has_velocity_limits     = config.linear_x_has_velocity_limits;
+        limiter_lin.has_acceleration_limits = config.linear_x_has_acceleration_limits;
+        limiter_lin.has_jerk_limits         = config.linear_x_has_jerk_limits;
+        limiter_lin.max_velocity            = config.linear_x_max_velocity;
+        limiter_lin.min_velocity            = config.linear_x_min_velocity;
+        limiter_lin.max_acceleration        = config.linear_x_max_acceleration;
+        limiter_lin.min_acceleration        = config.linear_x_min_acceleration;
+        limiter_lin.max_jerk                = config.linear_x_max_jerk;
+        limiter_lin.min_jerk                = config.linear_x_min_jerk;
+
+        SpeedLimiter& limiter_ang = dynamic_params.limiter_ang;
+        limiter_ang.has_velocity_limits     = config.angular_z_has_velocity_limits;
+        limiter_ang.has_acceleration_limits = config.angular_z_has_acceleration_limits;
+        limiter_ang.has_jerk_limits         = config.angular_z_has_jerk_limits;
+        limiter_ang.max_velocity            = config.angular_z_max_velocity;
+        limiter_ang.min_velocity            = config.angular_z_min_velocity;
+        limiter_ang.max_acceleration        = config.angular_z_max_acceleration;
+        limiter_ang.min_acceleration        = config.angular_z_min_acceleration;
+        limiter_ang.max_jerk                = config.angular_z_max_jerk;
+        limiter_ang.min_jerk                = config.angular_z_min_jerk;
+
+        // Keep the current limits if a minimum exceeds its maximum
+        std::string error;
+        if (!ControllerParams::validateLimiter("linear/x", limiter_lin, error)
+            || !ControllerParams::validateLimiter("angular/z", limiter_ang, error))
+        {
+            ROS_ERROR_STREAM_NAMED(name_, "Ignoring dynamic reconfigure: " << error);
+            return;
+        }
+
+        // Staged here, swapped in at the start of the next update()
         dynamic_params_.writeFromNonRT(dynamic_params);
 
         ROS_INFO_STREAM_NAMED(name_, "Dynamic Reconfigure:\n" << dynamic_params);
     }
 
-    void AckermannDriveController::updateDynamicParams()
+    void AckermannDriveController::updateDynamicParams(const ros::Time& time)
     {
         // Retreive dynamic params:
-        const DynamicParams dynamic_params = *(dynamic_params_.readFromRT());
-
-        left_wheel_radius_multiplier_  = dynamic_params.left_wheel_radius_multiplier;
-        right_wheel_radius_multiplier_ = dynamic_params.right_wheel_radius_multiplier;
-        wheel_separation_multiplier_   = dynamic_params.wheel_separation_multiplier;
+        DynamicParams& dynamic_params = *(dynamic_params_.readFromRT());
+        if (!dynamic_params.update)
+            return;
+        dynamic_params.update = false;
+
+        // Only rebuild the kinematics if the geometry changed
+        if (dynamic_params.wheel_radius_multiplier != wheel_radius_multiplier_
+            || dynamic_params.wheel_separation_multiplier != wheel_separation_multiplier_
+            || dynamic_params.wheel_base_multiplier != wheel_base_multiplier_)
+        {
+            setGeometry(dynamic_params.wheel_radius_multiplier,
+                dynamic_params.wheel_separation_multiplier,
+                dynamic_params.wheel_base_multiplier);
+        }
 
         publish_period_ = ros::Duration(1.0 / dynamic_params.publish_rate);
         enable_odom_tf_ = dynamic_params.enable_odom_tf;
+        limiter_lin_ = dynamic_params.limiter_lin;
+        limiter_ang_ = dynamic_params.limiter_ang;
+
+        // Record the change so a replay applies it at the same update
+        if (input_recorder_)
+        {
+            InputParams& params = input_record_.params;
+            input_record_.type = InputRecord::TYPE_PARAMS;
+            input_record_.time_ns = time.toNSec();
+            input_record_.period_ns = 0;
+            params.wheel_radius_multiplier     = dynamic_params.wheel_radius_multiplier;
+            params.wheel_separation_multiplier = dynamic_params.wheel_separation_multiplier;
+            params.wheel_base_multiplier       = dynamic_params.wheel_base_multiplier;
+            params.publish_rate                = dynamic_params.publish_rate;
+            params.enable_odom_tf              = dynamic_params.enable_odom_tf;
+            params.limits_lin.fromLimiter(dynamic_params.limiter_lin);
+            params.limits_ang.fromLimiter(dynamic_params.limiter_ang);
+            input_recorder_->record(input_record_);
+        }
+    }
+
+    void AckermannDriveController::setDynamicParams(const InputParams& params)
+    {
+        DynamicParams dynamic_params;
+        dynamic_params.update = true;
+        dynamic_params.wheel_radius_multiplier     = params.wheel_radius_multiplier;
+        dynamic_params.wheel_separation_multiplier = params.wheel_separation_multiplier;
+        dynamic_params.wheel_base_multiplier       = params.wheel_base_multiplier;
+        dynamic_params.publish_rate                = params.publish_rate;
+        dynamic_params.enable_odom_tf              = params.enable_odom_tf != 0;
+        params.limits_lin.toLimiter(dynamic_params.limiter_lin);
+        params.limits_ang.toLimiter(dynamic_params.limiter_ang);
+        dynamic_params_.writeFromNonRT(dynamic_params);
+    }
+
+    void AckermannDriveController::setGeometry(double wheel_radius_multiplier,
+        double wheel_separation_multiplier,
+        double wheel_base_multiplier)
+    {
+        wheel_radius_multiplier_ = wheel_radius_multiplier;
+        wheel_separation_multiplier_ = wheel_separation_multiplier;
+        wheel_base_multiplier_ = wheel_base_multiplier;
+
+        const Geometry& g = nominal_geometry_;
+        wheel_radius_ = g.wheel_radius * wheel_radius_multiplier;
+        mid_wheel_lat_separation_ = g.mid_wheel_lat_separation * wheel_separation_multiplier;
+        front_wheel_lat_separation_ = g.front_wheel_lat_separation * wheel_separation_multiplier;
+        front_wheel_lon_separation_ = g.front_wheel_lon_separation * wheel_base_multiplier;
+        back_wheel_lat_separation_ = g.back_wheel_lat_separation * wheel_separation_multiplier;
+        back_wheel_lon_separation_ = g.back_wheel_lon_separation * wheel_base_multiplier;
+
+        wheel_positions_[WHEEL_INDEX_FRONT_LEFT]  = Pos(front_wheel_lon_separation_, front_wheel_lat_separation_/2.0);
+        wheel_positions_[WHEEL_INDEX_FRONT_RIGHT] = Pos(front_wheel_lon_separation_, -front_wheel_lat_separation_/2.0);
+        wheel_positions_[WHEEL_INDEX_MID_LEFT]    = Pos(0.0, mid_wheel_lat_separation_/2.0);
+        wheel_positions_[WHEEL_INDEX_MID_RIGHT]   = Pos(0.0, -mid_wheel_lat_separation_/2.0);
+        wheel_positions_[WHEEL_INDEX_BACK_LEFT]   = Pos(-back_wheel_lon_separation_, back_wheel_lat_separation_/2.0);
+        wheel_positions_[WHEEL_INDEX_BACK_RIGHT]  = Pos(-back_wheel_lon_separation_, -back_wheel_lat_separation_/2.0);
+
+        steer_positions_[STEER_INDEX_FRONT_LEFT]  = Pos(front_wheel_lon_separation_, front_wheel_lat_separation_/2.0);
+        steer_positions_[STEER_INDEX_FRONT_RIGHT] = Pos(front_wheel_lon_separation_, -front_wheel_lat_separation_/2.0);
+        steer_positions_[STEER_INDEX_BACK_LEFT]   = Pos(-back_wheel_lon_separation_, back_wheel_lat_separation_/2.0);
+        steer_positions_[STEER_INDEX_BACK_RIGHT]  = Pos(-back_wheel_lon_separation_, -back_wheel_lat_separation_/2.0);
+
+        odometry_.setWheelParams(
+            wheel_radius_,
+            mid_wheel_lat_separation_,
+            front_wheel_lat_separation_,
+            front_wheel_lon_separation_,
+            back_wheel_lat_separation_,
+            back_wheel_lon_separation_);
     }
-    */
 
     // @TODO: enable publishing wheel and steer joint info.    
     /*
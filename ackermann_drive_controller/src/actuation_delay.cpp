@@ -0,0 +1,121 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#include "ackermann_drive_controller/actuation_delay.h"
+
+#include <algorithm>
+
+namespace ackermann_drive_controller
+{
+    ActuationDelayEstimator::ActuationDelayEstimator(double min_excitation, double time_constant) :
+        min_excitation_(min_excitation),
+        time_constant_(time_constant)
+    {
+        reset();
+    }
+
+    void ActuationDelayEstimator::reset()
+    {
+        std::fill(history_, history_ + MAX_LAGS, 0.0);
+        std::fill(error_, error_ + MAX_LAGS, 0.0);
+        head_ = 0;
+        count_ = 0;
+        mean_dt_ = 0.0;
+        samples_ = 0;
+    }
+
+    void ActuationDelayEstimator::push(double command)
+    {
+        head_ = (head_ + 1) & (MAX_LAGS - 1);
+        history_[head_] = command;
+        if (count_ < MAX_LAGS)
+            ++count_;
+    }
+
+    void ActuationDelayEstimator::update(double measured, double dt)
+    {
+        // Wait for a full history so every lag has the same weight
+        if (count_ < MAX_LAGS || dt <= 0.0)
+            return;
+
+        const double alpha = std::min(1.0, dt / time_constant_);
+        mean_dt_ = mean_dt_ > 0.0 ? mean_dt_ + alpha * (dt - mean_dt_) : dt;
+
+        double lo = history(0);
+        double hi = lo;
+        for (size_t k = 1; k < MAX_LAGS; ++k)
+        {
+            lo = std::min(lo, history(k));
+            hi = std::max(hi, history(k));
+        }
+        if (hi - lo < min_excitation_)
+            return;
+
+        for (size_t k = 0; k < MAX_LAGS; ++k)
+        {
+            const double e = measured - history(k);
+            error_[k] += alpha * (e * e - error_[k]);
+        }
+        if (samples_ < MAX_LAGS)
+            ++samples_;
+    }
+
+    double ActuationDelayEstimator::getDelay() const
+    {
+        if (!isValid())
+            return 0.0;
+
+        const size_t best = std::min_element(error_, error_ + MAX_LAGS) - error_;
+
+        // Sub-cycle refinement from the neighbouring errors
+        double offset = 0.0;
+        if (best > 0 && best + 1 < MAX_LAGS)
+        {
+            const double e0 = error_[best - 1];
+            const double e1 = error_[best];
+            const double e2 = error_[best + 1];
+            const double curvature = e0 - 2.0 * e1 + e2;
+            if (curvature > 0.0)
+                offset = std::max(-0.5, std::min(0.5, 0.5 * (e0 - e2) / curvature));
+        }
+        return std::max(0.0, (best + offset) * mean_dt_);
+    }
+
+} // namespace ackermann_drive_controller
@@ -0,0 +1,122 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#include "ackermann_drive_controller/command_trajectory.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace ackermann_drive_controller
+{
+    const size_t CommandTrajectory::MAX_POINTS;
+
+    bool CommandTrajectory::fromMsg(
+        const trajectory_msgs::MultiDOFJointTrajectory& msg,
+        const ros::Time& received, std::string& error)
+    {
+        if (msg.points.empty())
+        {
+            error = "trajectory has no points";
+            return false;
+        }
+
+        const ros::Time start = msg.header.stamp.isZero() ? received : msg.header.stamp;
+        const size_t n = std::min(msg.points.size(), MAX_POINTS);
+        for (size_t i = 0; i < n; ++i)
+        {
+            const trajectory_msgs::MultiDOFJointTrajectoryPoint& point = msg.points[i];
+            if (point.velocities.empty())
+            {
+                std::ostringstream os;
+                os << "trajectory point " << i << " has no velocity";
+                error = os.str();
+                return false;
+            }
+
+            points[i].stamp = start + point.time_from_start;
+            points[i].lin = point.velocities[0].linear.x;
+            points[i].ang = point.velocities[0].angular.z;
+            if (i > 0 && points[i].stamp <= points[i - 1].stamp)
+            {
+                std::ostringstream os;
+                os << "trajectory point " << i << " is not later than the point before";
+                error = os.str();
+                return false;
+            }
+        }
+        size = n;
+        this->received = received;
+        return true;
+    }
+
+    void CommandTrajectory::sample(const ros::Time& time, size_t& cursor,
+        double& lin, double& ang) const
+    {
+        if (size == 0)
+        {
+            lin = 0.0;
+            ang = 0.0;
+            return;
+        }
+
+        if (cursor >= size || time < points[cursor].stamp)
+        {
+            cursor = 0;
+        }
+        while (cursor + 1 < size && points[cursor + 1].stamp <= time)
+        {
+            ++cursor;
+        }
+
+        const Point& p0 = points[cursor];
+        if (cursor + 1 == size || time <= p0.stamp)
+        {
+            lin = p0.lin;
+            ang = p0.ang;
+            return;
+        }
+
+        const Point& p1 = points[cursor + 1];
+        const double s = (time - p0.stamp).toSec() / (p1.stamp - p0.stamp).toSec();
+        lin = p0.lin + s * (p1.lin - p0.lin);
+        ang = p0.ang + s * (p1.ang - p0.ang);
+    }
+
+} // namespace ackermann_drive_controller
@@ -0,0 +1,375 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#include "ackermann_drive_controller/ackermann_drive_enums.h"
+#include "ackermann_drive_controller/controller_params.h"
+
+#include <xmlrpcpp/XmlRpcValue.h>
+
+#include <sstream>
+
+namespace ackermann_drive_controller
+{
+    namespace
+    {
+        /**
+         * \brief Typed lookup of params in a decoded XmlRpc struct.
+         *
+         * Keys may name nested members, e.g. "linear/x/max_velocity".
+         * A missing key leaves the output unchanged; a key of the wrong
+         * type records an error and fails.
+         */
+        class ParamDecoder
+        {
+        public:
+            ParamDecoder(XmlRpc::XmlRpcValue& root, std::string& error) :
+                root_(root), error_(error)
+            {
+            }
+
+            bool get(const std::string& key, std::string& value)
+            {
+                XmlRpc::XmlRpcValue* v = find(key);
+                if (v == nullptr)
+                    return true;
+                if (v->getType() != XmlRpc::XmlRpcValue::TypeString)
+                    return fail(key, "a string");
+                value = static_cast<std::string&>(*v);
+                return true;
+            }
+
+            bool get(const std::string& key, bool& value)
+            {
+                XmlRpc::XmlRpcValue* v = find(key);
+                if (v == nullptr)
+                    return true;
+                if (v->getType() != XmlRpc::XmlRpcValue::TypeBoolean)
+                    return fail(key, "a bool");
+                value = static_cast<bool&>(*v);
+                return true;
+            }
+
+            bool get(const std::string& key, int& value)
+            {
+                XmlRpc::XmlRpcValue* v = find(key);
+                if (v == nullptr)
+                    return true;
+                if (v->getType() != XmlRpc::XmlRpcValue::TypeInt)
+                    return fail(key, "an int");
+                value = static_cast<int&>(*v);
+                return true;
+            }
+
+            bool get(const std::string& key, double& value)
+            {
+                XmlRpc::XmlRpcValue* v = find(key);
+                if (v == nullptr)
+                    return true;
+                return toDouble(key, *v, value);
+            }
+
+            /// A fixed size list of numbers, required if 'required' is set
+            bool get(const std::string& key, double* values, int size, bool required)
+            {
+                XmlRpc::XmlRpcValue* v = find(key);
+                if (v == nullptr)
+                {
+                    if (required)
+                    {
+                        error_ = "'" + key + "' is required";
+                        return false;
+                    }
+                    return true;
+                }
+                if (v->getType() != XmlRpc::XmlRpcValue::TypeArray || v->size() != size)
+                {
+                    std::ostringstream ss;
+                    ss << "a list of " << size << " numbers";
+                    return fail(key, ss.str());
+                }
+                for (int i = 0; i < size; ++i)
+                {
+                    if (!toDouble(key, (*v)[i], values[i]))
+                        return false;
+                }
+                return true;
+            }
+
+            /// A struct of command sources keyed by name
+            bool get(const std::string& key, std::vector<CommandSourceParams>& sources)
+            {
+                XmlRpc::XmlRpcValue* v = find(key);
+                if (v == nullptr)
+                    return true;
+                if (v->getType() != XmlRpc::XmlRpcValue::TypeStruct)
+                    return fail(key, "a struct of command sources");
+
+                sources.clear();
+                for (XmlRpc::XmlRpcValue::iterator it = v->begin(); it != v->end(); ++it)
+                {
+                    CommandSourceParams source;
+                    source.name = it->first;
+                    source.topic = it->first + "/cmd_vel";
+                    const std::string prefix = key + "/" + it->first + "/";
+                    if (!get(prefix + "topic", source.topic)
+                        || !get(prefix + "priority", source.priority)
+                        || !get(prefix + "timeout", source.timeout)
+                        || !get(prefix + "lockout", source.lockout))
+                    {
+                        return false;
+                    }
+                    sources.push_back(source);
+                }
+                return true;
+            }
+
+            /// True if the key is present
+            bool has(const std::string& key)
+            {
+                return find(key) != nullptr;
+            }
+
+        private:
+            XmlRpc::XmlRpcValue* find(const std::string& key)
+            {
+                XmlRpc::XmlRpcValue* v = &root_;
+                std::string::size_type begin = 0;
+                while (begin <= key.size())
+                {
+                    std::string::size_type end = key.find('/', begin);
+                    if (end == std::string::npos)
+                        end = key.size();
+                    const std::string name = key.substr(begin, end - begin);
+                    if (v->getType() != XmlRpc::XmlRpcValue::TypeStruct || !v->hasMember(name))
+                        return nullptr;
+                    v = &(*v)[name];
+                    begin = end + 1;
+                }
+                return v;
+            }
+
+            bool toDouble(const std::string& key, XmlRpc::XmlRpcValue& v, double& value)
+            {
+                // Integer literals in yaml are loaded as ints.
+                if (v.getType() == XmlRpc::XmlRpcValue::TypeDouble)
+                    value = static_cast<double&>(v);
+                else if (v.getType() == XmlRpc::XmlRpcValue::TypeInt)
+                    value = static_cast<int&>(v);
+                else
+                    return fail(key, "a number");
+                return true;
+            }
+
+            bool fail(const std::string& key, const std::string& type)
+            {
+                error_ = "'" + key + "' must be " + type;
+                return false;
+            }
+
+            XmlRpc::XmlRpcValue& root_;
+            std::string& error_;
+        };
+
+        bool decodeLimiter(ParamDecoder& decoder, const std::string& prefix, SpeedLimiter& limiter)
+        {
+            if (!decoder.get(prefix + "has_velocity_limits", limiter.has_velocity_limits)
+                || !decoder.get(prefix + "has_acceleration_limits", limiter.has_acceleration_limits)
+                || !decoder.get(prefix + "has_jerk_limits", limiter.has_jerk_limits)
+                || !decoder.get(prefix + "max_velocity", limiter.max_velocity)
+                || !decoder.get(prefix + "max_acceleration", limiter.max_acceleration)
+                || !decoder.get(prefix + "max_jerk", limiter.max_jerk))
+            {
+                return false;
+            }
+
+            // The minimum limits default to the negative maximum limits
+            if (!decoder.has(prefix + "min_velocity"))
+                limiter.min_velocity = -limiter.max_velocity;
+            if (!decoder.has(prefix + "min_acceleration"))
+                limiter.min_acceleration = -limiter.max_acceleration;
+            if (!decoder.has(prefix + "min_jerk"))
+                limiter.min_jerk = -limiter.max_jerk;
+
+            return decoder.get(prefix + "min_velocity", limiter.min_velocity)
+                && decoder.get(prefix + "min_acceleration", limiter.min_acceleration)
+                && decoder.get(prefix + "min_jerk", limiter.min_jerk);
+        }
+    } // namespace
+
+    bool ControllerParams::fromXmlRpc(XmlRpc::XmlRpcValue& value, std::string& error)
+    {
+        if (value.getType() != XmlRpc::XmlRpcValue::TypeStruct)
+        {
+            error = "the controller namespace is not a struct";
+            return false;
+        }
+
+        ParamDecoder decoder(value, error);
+        return
+            // Joint names:
+            decoder.get("front_left_wheel",  wheel_names[WHEEL_INDEX_FRONT_LEFT])
+            && decoder.get("front_right_wheel", wheel_names[WHEEL_INDEX_FRONT_RIGHT])
+            && decoder.get("mid_left_wheel",    wheel_names[WHEEL_INDEX_MID_LEFT])
+            && decoder.get("mid_right_wheel",   wheel_names[WHEEL_INDEX_MID_RIGHT])
+            && decoder.get("back_left_wheel",   wheel_names[WHEEL_INDEX_BACK_LEFT])
+            && decoder.get("back_right_wheel",  wheel_names[WHEEL_INDEX_BACK_RIGHT])
+            && decoder.get("front_left_steer",  steer_names[STEER_INDEX_FRONT_LEFT])
+            && decoder.get("front_right_steer", steer_names[STEER_INDEX_FRONT_RIGHT])
+            && decoder.get("back_left_steer",   steer_names[STEER_INDEX_BACK_LEFT])
+            && decoder.get("back_right_steer",  steer_names[STEER_INDEX_BACK_RIGHT])
+
+            // Odometry related:
+            && decoder.get("publish_rate", publish_rate)
+            && decoder.get("open_loop", open_loop)
+            && decoder.get("velocity_rolling_window_size", velocity_rolling_window_size)
+            && decoder.get("pose_covariance_diagonal", pose_covariance_diagonal, 6, true)
+            && decoder.get("twist_covariance_diagonal", twist_covariance_diagonal, 6, true)
+
+            // Geometry:
+            && decoder.get("wheel_radius", wheel_radius)
+            && decoder.get("mid_wheel_lat_separation", mid_wheel_lat_separation)
+            && decoder.get("front_wheel_lat_separation", front_wheel_lat_separation)
+            && decoder.get("front_wheel_lon_separation", front_wheel_lon_separation)
+            && decoder.get("back_wheel_lat_separation", back_wheel_lat_separation)
+            && decoder.get("back_wheel_lon_separation", back_wheel_lon_separation)
+
+            // Twist command related:
+            && decoder.get("cmd_vel_timeout", cmd_vel_timeout)
+            && decoder.get("allow_multiple_cmd_vel_publishers", allow_multiple_cmd_vel_publishers)
+            && decoder.get("command_sources", command_sources)
+            && decoder.get("base_frame_id", base_frame_id)
+            && decoder.get("odom_frame_id", odom_frame_id)
+            && decoder.get("enable_odom_tf", enable_odom_tf)
+
+            // Velocity and acceleration limits:
+            && decodeLimiter(decoder, "linear/x/", limiter_lin)
+            && decodeLimiter(decoder, "angular/z/", limiter_ang)
+
+            // Publish limited velocity, statistics, recording and snapshots:
+            && decoder.get("publish_cmd", publish_cmd)
+            && decoder.get("enable_statistics", enable_statistics)
+            && decoder.get("record_inputs", record_inputs)
+            && decoder.get("latency_trace", latency_trace)
+            && decoder.get("pose_snapshot", pose_snapshot)
+            && decoder.get("pose_snapshot_max_age", pose_snapshot_max_age)
+
+            // Actuation latency compensation:
+            && decoder.get("latency_compensation", latency_compensation)
+            && decoder.get("latency_max_delay", latency_max_delay)
+            && decoder.get("latency_steer_delay", latency_steer_delay);
+    }
+
+    bool ControllerParams::validate(std::string& error) const
+    {
+        if (publish_rate <= 0.0)
+        {
+            error = "'publish_rate' must be positive";
+            return false;
+        }
+        if (velocity_rolling_window_size < 1)
+        {
+            error = "'velocity_rolling_window_size' must be at least 1";
+            return false;
+        }
+        if (cmd_vel_timeout <= 0.0)
+        {
+            error = "'cmd_vel_timeout' must be positive";
+            return false;
+        }
+        if (wheel_radius < 0.0
+            || mid_wheel_lat_separation < 0.0
+            || front_wheel_lat_separation < 0.0
+            || front_wheel_lon_separation < 0.0
+            || back_wheel_lat_separation < 0.0
+            || back_wheel_lon_separation < 0.0)
+        {
+            error = "the wheel radius and separations must not be negative";
+            return false;
+        }
+        for (size_t i = 0; i < command_sources.size(); ++i)
+        {
+            const CommandSourceParams& source = command_sources[i];
+            if (source.topic.empty() || source.timeout <= 0.0 || source.lockout < 0.0)
+            {
+                error = "command source '" + source.name
+                    + "' needs a topic, a positive timeout and a lockout that is not negative";
+                return false;
+            }
+            for (size_t j = 0; j < i; ++j)
+            {
+                if (command_sources[j].priority == source.priority)
+                {
+                    error = "command sources '" + command_sources[j].name + "' and '"
+                        + source.name + "' have the same priority";
+                    return false;
+                }
+            }
+        }
+        if (latency_max_delay < 0.0)
+        {
+            error = "'latency_max_delay' must not be negative";
+            return false;
+        }
+        for (int i = 0; i < 6; ++i)
+        {
+            if (pose_covariance_diagonal[i] < 0.0 || twist_covariance_diagonal[i] < 0.0)
+            {
+                error = "the covariance diagonals must not be negative";
+                return false;
+            }
+        }
+        return validateLimiter("linear/x", limiter_lin, error)
+            && validateLimiter("angular/z", limiter_ang, error);
+    }
+
+    bool ControllerParams::validateLimiter(const std::string& name,
+        const SpeedLimiter& limiter, std::string& error)
+    {
+        if ((limiter.has_velocity_limits && limiter.min_velocity > limiter.max_velocity)
+            || (limiter.has_acceleration_limits && limiter.min_acceleration > limiter.max_acceleration)
+            || (limiter.has_jerk_limits && limiter.min_jerk > limiter.max_jerk))
+        {
+            error = "'" + name + "' minimum limits must not exceed the maximum limits";
+            return false;
+        }
+        return true;
+    }
+
+} // namespace ackermann_drive_controller
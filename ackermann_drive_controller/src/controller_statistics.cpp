@@ -0,0 +1,127 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#include "ackermann_drive_controller/controller_statistics.h"
+
+#include <cmath>
+#include <sstream>
+
+namespace ackermann_drive_controller
+{
+    ControllerStatistics::ControllerStatistics() :
+        enabled_(false),
+        cycle_start_(0),
+        last_mark_(0),
+        last_period_(0),
+        mean_period_(0.0),
+        cmd_vel_timeouts_(0),
+        publish_failures_(0),
+        realtime_violations_(0),
+        realtime_violation_cycles_(0)
+    {
+    }
+
+    void ControllerStatistics::recordPeriod(int64_t period)
+    {
+        if (period <= 0)
+            return;
+
+        // Jitter is the deviation from an exponentially weighted mean
+        // period, so it follows changes to the controller rate.
+        const double alpha = 0.01;
+        const double p = static_cast<double>(period);
+        if (period_.count() == 0)
+            mean_period_ = p;
+        period_.record(static_cast<uint64_t>(period));
+        jitter_.record(static_cast<uint64_t>(std::fabs(p - mean_period_)));
+        mean_period_ += alpha * (p - mean_period_);
+    }
+
+    void ControllerStatistics::reset()
+    {
+        for (size_t i = 0; i < NUM_PHASES; ++i)
+            phases_[i].reset();
+        update_.reset();
+        period_.reset();
+        jitter_.reset();
+        last_period_ = 0;
+        mean_period_ = 0.0;
+        cmd_vel_timeouts_.store(0, std::memory_order_relaxed);
+        publish_failures_.store(0, std::memory_order_relaxed);
+        realtime_violations_.store(0, std::memory_order_relaxed);
+        realtime_violation_cycles_.store(0, std::memory_order_relaxed);
+    }
+
+    std::string ControllerStatistics::report() const
+    {
+        std::ostringstream os;
+        os << "update: " << update_.summary() << "\n";
+        for (size_t i = 0; i < NUM_PHASES; ++i)
+        {
+            os << phaseName(static_cast<Phase>(i)) << ": "
+                << phases_[i].summary() << "\n";
+        }
+        os << "period: " << period_.summary() << "\n"
+            << "jitter: " << jitter_.summary() << "\n"
+            << "cmd_vel timeouts: "
+            << cmd_vel_timeouts_.load(std::memory_order_relaxed) << "\n"
+            << "publish failures: "
+            << publish_failures_.load(std::memory_order_relaxed) << "\n"
+            << "realtime violations: "
+            << realtime_violations_.load(std::memory_order_relaxed) << " in "
+            << realtime_violation_cycles_.load(std::memory_order_relaxed) << " cycles";
+        return os.str();
+    }
+
+    const char* ControllerStatistics::phaseName(Phase phase)
+    {
+        switch (phase)
+        {
+            case PHASE_READ:        return "read";
+            case PHASE_ODOMETRY:    return "odometry";
+            case PHASE_LIMIT:       return "limit";
+            case PHASE_PUBLISH:     return "publish";
+            case PHASE_KINEMATICS:  return "kinematics";
+            case PHASE_WRITE:       return "write";
+            default:                return "unknown";
+        }
+    }
+
+} // namespace ackermann_drive_controller
@@ -0,0 +1,301 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#include "ackermann_drive_controller/input_log.h"
+
+#include <ros/ros.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace ackermann_drive_controller
+{
+    namespace
+    {
+        const char MAGIC[8] = { 'A', 'D', 'C', 'I', 'N', 'P', 'U', 'T' };
+
+        /// Size of the stdio buffer for log files
+        const size_t FILE_BUFFER_SIZE = 64 * 1024;
+    } // namespace
+
+    void InputLogHeader::Limits::fromLimiter(const SpeedLimiter& limiter)
+    {
+        min_velocity            = limiter.min_velocity;
+        max_velocity            = limiter.max_velocity;
+        min_acceleration        = limiter.min_acceleration;
+        max_acceleration        = limiter.max_acceleration;
+        min_jerk                = limiter.min_jerk;
+        max_jerk                = limiter.max_jerk;
+        has_velocity_limits     = limiter.has_velocity_limits;
+        has_acceleration_limits = limiter.has_acceleration_limits;
+        has_jerk_limits         = limiter.has_jerk_limits;
+    }
+
+    void InputLogHeader::Limits::toLimiter(SpeedLimiter& limiter) const
+    {
+        limiter.min_velocity            = min_velocity;
+        limiter.max_velocity            = max_velocity;
+        limiter.min_acceleration        = min_acceleration;
+        limiter.max_acceleration        = max_acceleration;
+        limiter.min_jerk                = min_jerk;
+        limiter.max_jerk                = max_jerk;
+        limiter.has_velocity_limits     = has_velocity_limits != 0;
+        limiter.has_acceleration_limits = has_acceleration_limits != 0;
+        limiter.has_jerk_limits         = has_jerk_limits != 0;
+    }
+
+    void InputLogHeader::fromParams(const ControllerParams& params)
+    {
+        std::memset(this, 0, sizeof(*this));
+        std::memcpy(magic, MAGIC, sizeof(magic));
+        version = VERSION;
+        record_size = sizeof(InputRecord);
+
+        publish_rate                 = params.publish_rate;
+        cmd_vel_timeout              = params.cmd_vel_timeout;
+        wheel_radius                 = params.wheel_radius;
+        mid_wheel_lat_separation     = params.mid_wheel_lat_separation;
+        front_wheel_lat_separation   = params.front_wheel_lat_separation;
+        front_wheel_lon_separation   = params.front_wheel_lon_separation;
+        back_wheel_lat_separation    = params.back_wheel_lat_separation;
+        back_wheel_lon_separation    = params.back_wheel_lon_separation;
+        velocity_rolling_window_size = params.velocity_rolling_window_size;
+        open_loop                    = params.open_loop;
+        enable_odom_tf               = params.enable_odom_tf;
+        publish_cmd                  = params.publish_cmd;
+        latency_compensation         = params.latency_compensation;
+        limits_lin.fromLimiter(params.limiter_lin);
+        limits_ang.fromLimiter(params.limiter_ang);
+        latency_max_delay            = params.latency_max_delay;
+        latency_steer_delay          = params.latency_steer_delay;
+    }
+
+    void InputLogHeader::toParams(ControllerParams& params) const
+    {
+        params.publish_rate                 = publish_rate;
+        params.cmd_vel_timeout              = cmd_vel_timeout;
+        params.wheel_radius                 = wheel_radius;
+        params.mid_wheel_lat_separation     = mid_wheel_lat_separation;
+        params.front_wheel_lat_separation   = front_wheel_lat_separation;
+        params.front_wheel_lon_separation   = front_wheel_lon_separation;
+        params.back_wheel_lat_separation    = back_wheel_lat_separation;
+        params.back_wheel_lon_separation    = back_wheel_lon_separation;
+        params.velocity_rolling_window_size = velocity_rolling_window_size;
+        params.open_loop                    = open_loop != 0;
+        params.enable_odom_tf               = enable_odom_tf != 0;
+        params.publish_cmd                  = publish_cmd != 0;
+        params.latency_compensation         = latency_compensation != 0;
+        limits_lin.toLimiter(params.limiter_lin);
+        limits_ang.toLimiter(params.limiter_ang);
+        params.latency_max_delay            = latency_max_delay;
+        params.latency_steer_delay          = latency_steer_delay;
+    }
+
+    bool InputLogHeader::isValid() const
+    {
+        return std::memcmp(magic, MAGIC, sizeof(magic)) == 0
+            && version == VERSION
+            && record_size == sizeof(InputRecord);
+    }
+
+    InputRecorder::InputRecorder() :
+        running_(false),
+        dropped_(0),
+        dropped_reported_(0),
+        file_(nullptr)
+    {
+        sem_init(&wakeup_, 0, 0);
+    }
+
+    InputRecorder::~InputRecorder()
+    {
+        close();
+        sem_destroy(&wakeup_);
+    }
+
+    bool InputRecorder::open(const std::string& path, const ControllerParams& params)
+    {
+        close();
+
+        file_ = std::fopen(path.c_str(), "wb");
+        if (file_ == nullptr)
+        {
+            ROS_ERROR_STREAM("Failed to open input log '" << path << "': " << std::strerror(errno));
+            return false;
+        }
+        std::setvbuf(file_, nullptr, _IOFBF, FILE_BUFFER_SIZE);
+
+        InputLogHeader header;
+        header.fromParams(params);
+        if (std::fwrite(&header, sizeof(header), 1, file_) != 1)
+        {
+            ROS_ERROR_STREAM("Failed to write input log header to '" << path << "'");
+            std::fclose(file_);
+            file_ = nullptr;
+            return false;
+        }
+
+        path_ = path;
+        running_.store(true);
+        thread_ = std::thread(&InputRecorder::run, this);
+        return true;
+    }
+
+    void InputRecorder::close()
+    {
+        if (running_.exchange(false))
+        {
+            sem_post(&wakeup_);
+            if (thread_.joinable())
+                thread_.join();
+        }
+
+        if (file_ != nullptr)
+        {
+            // Records pushed after the writer thread stopped
+            drain();
+            std::fclose(file_);
+            file_ = nullptr;
+        }
+    }
+
+    bool InputRecorder::record(const InputRecord& record)
+    {
+        if (!queue_.push(record))
+        {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // Wake the writer once a reasonable batch has accumulated
+        // rather than for every record.
+        if (queue_.size() >= QUEUE_SIZE / 4)
+        {
+            sem_post(&wakeup_);
+        }
+        return true;
+    }
+
+    void InputRecorder::run()
+    {
+        while (running_.load())
+        {
+            // Wake periodically so a slow control loop still gets logged
+            timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += 1;
+            if (sem_timedwait(&wakeup_, &deadline) != 0 && errno == EINTR)
+                continue;
+
+            drain();
+            std::fflush(file_);
+
+            const uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+            if (dropped != dropped_reported_)
+            {
+                ROS_WARN_STREAM("Input recorder queue full, dropped "
+                    << (dropped - dropped_reported_) << " records ("
+                    << dropped << " total). The log '" << path_
+                    << "' cannot be replayed exactly.");
+                dropped_reported_ = dropped;
+            }
+        }
+    }
+
+    void InputRecorder::drain()
+    {
+        InputRecord record;
+        while (queue_.pop(record))
+        {
+            if (std::fwrite(&record, sizeof(record), 1, file_) != 1)
+            {
+                ROS_ERROR_STREAM_THROTTLE(10.0, "Failed to write to input log '" << path_ << "'");
+            }
+        }
+    }
+
+    InputLogReader::InputLogReader() :
+        file_(nullptr)
+    {
+        std::memset(&header_, 0, sizeof(header_));
+    }
+
+    InputLogReader::~InputLogReader()
+    {
+        close();
+    }
+
+    bool InputLogReader::open(const std::string& path)
+    {
+        close();
+
+        file_ = std::fopen(path.c_str(), "rb");
+        if (file_ == nullptr)
+        {
+            ROS_ERROR_STREAM("Failed to open input log '" << path << "': " << std::strerror(errno));
+            return false;
+        }
+        std::setvbuf(file_, nullptr, _IOFBF, FILE_BUFFER_SIZE);
+
+        if (std::fread(&header_, sizeof(header_), 1, file_) != 1 || !header_.isValid())
+        {
+            ROS_ERROR_STREAM("'" << path << "' is not an input log (or was written by an incompatible version)");
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void InputLogReader::close()
+    {
+        if (file_ != nullptr)
+        {
+            std::fclose(file_);
+            file_ = nullptr;
+        }
+    }
+
+    bool InputLogReader::read(InputRecord& record)
+    {
+        return file_ != nullptr && std::fread(&record, sizeof(record), 1, file_) == 1;
+    }
+
+} // namespace ackermann_drive_controller
@@ -123,6 +123,21 @@ namespace ackermann_drive_controller
         timestamp_ = time;
     }
 
+    void Odometry::setPose(double x, double y, double heading)
+    {
+        x_ = x;
+        y_ = y;
+        heading_ = heading;
+    }
+
+    void Odometry::setWheelPositions(const std::vector<double>& wheel_pos)
+    {
+        for (size_t i=0; i<wheel_pos_size_; ++i)
+        {
+            wheel_old_pos_[i] = wheel_pos[i] * wheel_radius_;
+        }
+    }
+
     // @TODO: Current implementation only uses the odometry from the mid wheels (i.e. diff drive odometry)
     bool Odometry::update(const std::vector<double>& wheel_pos, const std::vector<double>& steer_pos, const ros::Time &time)
     {
@@ -182,6 +197,17 @@ namespace ackermann_drive_controller
         double back_wheel_lat_separation,
         double back_wheel_lon_separation)
     {
+        // The old wheel positions are linear, rescale them to the new radius
+        // so the next update does not see a jump in wheel travel.
+        if (wheel_radius_ > 0.0 && wheel_radius != wheel_radius_)
+        {
+            const double scale = wheel_radius / wheel_radius_;
+            for (size_t i=0; i<wheel_pos_size_; ++i)
+            {
+                wheel_old_pos_[i] *= scale;
+            }
+        }
+
         wheel_radius_ = wheel_radius;
         mid_wheel_lat_separation_ = mid_wheel_lat_separation;
         front_wheel_lat_separation_ = front_wheel_lat_separation;
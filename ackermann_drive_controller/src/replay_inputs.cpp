@@ -0,0 +1,172 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+// Replay a controller input log offline.
+//
+// Feeds each recorded cycle through AckermannDriveController::update()
+// as fast as possible, without a ROS master, and writes the controller
+// outputs as CSV for comparison between builds.
+//
+// Usage:
+//   ackermann_drive_controller_replay <input_log> [<output_csv>]
+//
+// Record a log by setting the controller parameter 'record_inputs'.
+
+#include "ackermann_drive_controller/ackermann_drive_controller.h"
+#include "ackermann_drive_controller/input_log.h"
+#include "ackermann_drive_controller/loopback_robot_hw.h"
+
+#include <curio_realtime/latency_histogram.h>
+#include <ros/ros.h>
+
+#include <cstdio>
+#include <iostream>
+
+using namespace ackermann_drive_controller;
+using curio_realtime::monotonicNanoseconds;
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argc > 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <input_log> [<output_csv>]" << std::endl;
+        return 1;
+    }
+
+    ros::Time::init();
+
+    InputLogReader reader;
+    if (!reader.open(argv[1]))
+    {
+        return 1;
+    }
+
+    FILE* output = stdout;
+    if (argc == 3)
+    {
+        output = std::fopen(argv[2], "w");
+        if (output == nullptr)
+        {
+            std::cerr << "Failed to open " << argv[2] << std::endl;
+            return 1;
+        }
+    }
+
+    // Only the parameters affecting update() are recorded,
+    // the joint names are the defaults for both controller and hardware.
+    ControllerParams params;
+    reader.getHeader().toParams(params);
+
+    LoopbackRobotHW robot_hw(params);
+    AckermannDriveController controller;
+    if (!controller.init(&robot_hw, params))
+    {
+        std::cerr << "Failed to initialise the controller" << std::endl;
+        return 1;
+    }
+
+    std::fprintf(output, "time,x,y,heading,linear,angular");
+    for (size_t i = 0; i < LoopbackRobotHW::NUM_WHEELS; ++i)
+        std::fprintf(output, ",wheel_cmd_%zu", i);
+    for (size_t i = 0; i < LoopbackRobotHW::NUM_STEERS; ++i)
+        std::fprintf(output, ",steer_cmd_%zu", i);
+    std::fprintf(output, "\n");
+
+    const uint64_t start_ns = monotonicNanoseconds();
+    uint64_t updates = 0;
+    uint64_t starts = 0;
+
+    InputRecord record;
+    while (reader.read(record))
+    {
+        ros::Time time;
+        time.fromNSec(record.time_ns);
+
+        if (record.type == InputRecord::TYPE_STARTING)
+        {
+            controller.starting(time);
+            ++starts;
+            continue;
+        }
+        if (record.type == InputRecord::TYPE_PARAMS)
+        {
+            controller.setDynamicParams(record.params);
+            continue;
+        }
+        if (record.type != InputRecord::TYPE_UPDATE)
+        {
+            std::cerr << "Unknown record type " << record.type << ", stopping" << std::endl;
+            break;
+        }
+
+        for (size_t i = 0; i < LoopbackRobotHW::NUM_WHEELS; ++i)
+            robot_hw.setPosition(i, record.wheel_pos[i]);
+        for (size_t i = 0; i < LoopbackRobotHW::NUM_STEERS; ++i)
+            robot_hw.setPosition(LoopbackRobotHW::NUM_WHEELS + i, record.steer_pos[i]);
+
+        ros::Time cmd_stamp;
+        cmd_stamp.fromNSec(record.cmd_stamp_ns);
+        controller.setCommand(record.cmd_lin, record.cmd_ang, cmd_stamp, record.cmd_timeout);
+
+        ros::Duration period;
+        period.fromNSec(record.period_ns);
+        controller.update(time, period);
+        ++updates;
+
+        const Odometry& odometry = controller.getOdometry();
+        std::fprintf(output, "%.9f,%.17g,%.17g,%.17g,%.17g,%.17g",
+            time.toSec(), odometry.getX(), odometry.getY(), odometry.getHeading(),
+            odometry.getLinear(), odometry.getAngular());
+        for (size_t i = 0; i < LoopbackRobotHW::NUM_JOINTS; ++i)
+            std::fprintf(output, ",%.17g", robot_hw.getCommand(i));
+        std::fprintf(output, "\n");
+    }
+
+    const double elapsed = (monotonicNanoseconds() - start_ns) * 1.0E-9;
+    std::cerr << "Replayed " << updates << " updates (" << starts << " starts) in "
+        << elapsed << " s" << std::endl;
+
+    if (output != stdout)
+    {
+        std::fclose(output);
+    }
+    return 0;
+}
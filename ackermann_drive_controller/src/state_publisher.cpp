@@ -0,0 +1,204 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#include "ackermann_drive_controller/state_publisher.h"
+
+#include <tf/transform_datatypes.h>
+
+#include <cerrno>
+
+namespace ackermann_drive_controller
+{
+    StatePublisher::StatePublisher() :
+        running_(false),
+        dropped_(0),
+        dropped_reported_(0)
+    {
+        sem_init(&wakeup_, 0, 0);
+    }
+
+    StatePublisher::~StatePublisher()
+    {
+        stop();
+        sem_destroy(&wakeup_);
+    }
+
+    void StatePublisher::init(ros::NodeHandle& root_nh,
+        ros::NodeHandle& controller_nh,
+        const std::string& odom_frame_id,
+        const std::string& base_frame_id,
+        const double pose_covariance[6],
+        const double twist_covariance[6],
+        bool publish_cmd)
+    {
+        // Odometry publisher + odom message constant fields
+        odom_pub_ = controller_nh.advertise<nav_msgs::Odometry>("odom", 100);
+        odom_msg_.header.frame_id = odom_frame_id;
+        odom_msg_.child_frame_id = base_frame_id;
+        odom_msg_.pose.pose.position.z = 0;
+        odom_msg_.pose.covariance = {
+            pose_covariance[0], 0., 0., 0., 0., 0.,
+            0., pose_covariance[1], 0., 0., 0., 0.,
+            0., 0., pose_covariance[2], 0., 0., 0.,
+            0., 0., 0., pose_covariance[3], 0., 0.,
+            0., 0., 0., 0., pose_covariance[4], 0.,
+            0., 0., 0., 0., 0., pose_covariance[5] };
+        odom_msg_.twist.twist.linear.y  = 0;
+        odom_msg_.twist.twist.linear.z  = 0;
+        odom_msg_.twist.twist.angular.x = 0;
+        odom_msg_.twist.twist.angular.y = 0;
+        odom_msg_.twist.covariance = {
+            twist_covariance[0], 0., 0., 0., 0., 0.,
+            0., twist_covariance[1], 0., 0., 0., 0.,
+            0., 0., twist_covariance[2], 0., 0., 0.,
+            0., 0., 0., twist_covariance[3], 0., 0.,
+            0., 0., 0., 0., twist_covariance[4], 0.,
+            0., 0., 0., 0., 0., twist_covariance[5] };
+
+        // tf publisher + odom frame constant fields. Always advertised
+        // as publishing to tf may be enabled with dynamic reconfigure.
+        tf_odom_pub_ = root_nh.advertise<tf::tfMessage>("/tf", 100);
+        tf_odom_msg_.transforms.resize(1);
+        tf_odom_msg_.transforms[0].transform.translation.z = 0.0;
+        tf_odom_msg_.transforms[0].child_frame_id = base_frame_id;
+        tf_odom_msg_.transforms[0].header.frame_id = odom_frame_id;
+
+        // Executed command publisher
+        if (publish_cmd)
+        {
+            cmd_vel_pub_ = controller_nh.advertise<geometry_msgs::TwistStamped>("cmd_vel_out", 100);
+        }
+    }
+
+    void StatePublisher::start()
+    {
+        if (running_.exchange(true))
+            return;
+
+        thread_ = std::thread(&StatePublisher::run, this);
+    }
+
+    void StatePublisher::stop()
+    {
+        if (!running_.exchange(false))
+            return;
+
+        sem_post(&wakeup_);
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+    bool StatePublisher::enqueue(const StateRecord& record)
+    {
+        if (!queue_.push(record))
+        {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // sem_post does not block and is async-signal-safe.
+        sem_post(&wakeup_);
+        return true;
+    }
+
+    void StatePublisher::run()
+    {
+        StateRecord record;
+        while (running_.load())
+        {
+            if (sem_wait(&wakeup_) != 0 && errno == EINTR)
+                continue;
+
+            while (queue_.pop(record))
+            {
+                publish(record);
+            }
+
+            const uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+            if (dropped != dropped_reported_)
+            {
+                ROS_WARN_STREAM("State publisher queue full, dropped "
+                    << (dropped - dropped_reported_) << " records ("
+                    << dropped << " total).");
+                dropped_reported_ = dropped;
+            }
+        }
+    }
+
+    void StatePublisher::publish(const StateRecord& record)
+    {
+        if (record.flags & (StateRecord::PUBLISH_ODOM | StateRecord::PUBLISH_TF))
+        {
+            // Compute orientation info
+            const geometry_msgs::Quaternion orientation(
+                tf::createQuaternionMsgFromYaw(record.heading));
+
+            if (record.flags & StateRecord::PUBLISH_ODOM)
+            {
+                odom_msg_.header.stamp = record.stamp;
+                odom_msg_.pose.pose.position.x = record.x;
+                odom_msg_.pose.pose.position.y = record.y;
+                odom_msg_.pose.pose.orientation = orientation;
+                odom_msg_.twist.twist.linear.x  = record.linear;
+                odom_msg_.twist.twist.angular.z = record.angular;
+                odom_pub_.publish(odom_msg_);
+            }
+
+            if (record.flags & StateRecord::PUBLISH_TF)
+            {
+                geometry_msgs::TransformStamped& odom_frame = tf_odom_msg_.transforms[0];
+                odom_frame.header.stamp = record.stamp;
+                odom_frame.transform.translation.x = record.x;
+                odom_frame.transform.translation.y = record.y;
+                odom_frame.transform.rotation = orientation;
+                tf_odom_pub_.publish(tf_odom_msg_);
+            }
+        }
+
+        if (record.flags & StateRecord::PUBLISH_CMD_VEL)
+        {
+            cmd_vel_msg_.header.stamp = record.stamp;
+            cmd_vel_msg_.twist.linear.x = record.cmd_lin;
+            cmd_vel_msg_.twist.angular.z = record.cmd_ang;
+            cmd_vel_pub_.publish(cmd_vel_msg_);
+        }
+    }
+
+} // namespace ackermann_drive_controller
@@ -0,0 +1,180 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#include "ackermann_drive_controller/command_trajectory.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+using ackermann_drive_controller::CommandTrajectory;
+
+namespace
+{
+    /// Add a setpoint at a time from the start of a trajectory
+    void addPoint(trajectory_msgs::MultiDOFJointTrajectory& msg,
+        double time_from_start, double lin, double ang)
+    {
+        trajectory_msgs::MultiDOFJointTrajectoryPoint point;
+        point.time_from_start = ros::Duration(time_from_start);
+        geometry_msgs::Twist velocity;
+        velocity.linear.x = lin;
+        velocity.angular.z = ang;
+        point.velocities.push_back(velocity);
+        msg.points.push_back(point);
+    }
+} // namespace
+
+TEST(CommandTrajectory, decodesFromReceivedTime)
+{
+    trajectory_msgs::MultiDOFJointTrajectory msg;
+    addPoint(msg, 0.0, 0.1, 0.0);
+    addPoint(msg, 0.5, 0.2, 0.4);
+
+    CommandTrajectory trajectory;
+    std::string error;
+    ASSERT_TRUE(trajectory.fromMsg(msg, ros::Time(10.0), error)) << error;
+    EXPECT_EQ(trajectory.size, 2u);
+    EXPECT_NEAR(trajectory.points[0].stamp.toSec(), 10.0, 1.0E-9);
+    EXPECT_NEAR(trajectory.end().toSec(), 10.5, 1.0E-9);
+    EXPECT_NEAR(trajectory.received.toSec(), 10.0, 1.0E-9);
+}
+
+TEST(CommandTrajectory, decodesFromHeaderStamp)
+{
+    trajectory_msgs::MultiDOFJointTrajectory msg;
+    msg.header.stamp = ros::Time(8.0);
+    addPoint(msg, 1.0, 0.1, 0.0);
+
+    CommandTrajectory trajectory;
+    std::string error;
+    ASSERT_TRUE(trajectory.fromMsg(msg, ros::Time(10.0), error)) << error;
+    EXPECT_NEAR(trajectory.end().toSec(), 9.0, 1.0E-9);
+}
+
+TEST(CommandTrajectory, rejectsInvalidMessages)
+{
+    CommandTrajectory trajectory;
+    std::string error;
+
+    trajectory_msgs::MultiDOFJointTrajectory empty;
+    EXPECT_FALSE(trajectory.fromMsg(empty, ros::Time(10.0), error));
+
+    trajectory_msgs::MultiDOFJointTrajectory no_velocity;
+    addPoint(no_velocity, 0.0, 0.1, 0.0);
+    no_velocity.points[0].velocities.clear();
+    EXPECT_FALSE(trajectory.fromMsg(no_velocity, ros::Time(10.0), error));
+
+    trajectory_msgs::MultiDOFJointTrajectory not_increasing;
+    addPoint(not_increasing, 0.5, 0.1, 0.0);
+    addPoint(not_increasing, 0.5, 0.2, 0.0);
+    EXPECT_FALSE(trajectory.fromMsg(not_increasing, ros::Time(10.0), error));
+}
+
+TEST(CommandTrajectory, truncatesLongMessages)
+{
+    trajectory_msgs::MultiDOFJointTrajectory msg;
+    for (size_t i = 0; i < CommandTrajectory::MAX_POINTS + 8; ++i)
+    {
+        addPoint(msg, 0.1 * i, 0.01 * i, 0.0);
+    }
+
+    CommandTrajectory trajectory;
+    std::string error;
+    ASSERT_TRUE(trajectory.fromMsg(msg, ros::Time(10.0), error)) << error;
+    EXPECT_EQ(trajectory.size, CommandTrajectory::MAX_POINTS);
+    EXPECT_NEAR(trajectory.end().toSec(), 10.0 + 0.1 * (CommandTrajectory::MAX_POINTS - 1), 1.0E-6);
+}
+
+TEST(CommandTrajectory, interpolatesAndHoldsEnds)
+{
+    trajectory_msgs::MultiDOFJointTrajectory msg;
+    addPoint(msg, 1.0, 0.0, 1.0);
+    addPoint(msg, 2.0, 0.2, 0.0);
+    addPoint(msg, 3.0, 0.4, -1.0);
+
+    CommandTrajectory trajectory;
+    std::string error;
+    ASSERT_TRUE(trajectory.fromMsg(msg, ros::Time(10.0), error)) << error;
+
+    size_t cursor = 0;
+    double lin = 0.0;
+    double ang = 0.0;
+
+    // The first setpoint is held before the start
+    trajectory.sample(ros::Time(10.5), cursor, lin, ang);
+    EXPECT_NEAR(lin, 0.0, 1.0E-9);
+    EXPECT_NEAR(ang, 1.0, 1.0E-9);
+
+    trajectory.sample(ros::Time(11.5), cursor, lin, ang);
+    EXPECT_NEAR(lin, 0.1, 1.0E-6);
+    EXPECT_NEAR(ang, 0.5, 1.0E-6);
+
+    trajectory.sample(ros::Time(12.25), cursor, lin, ang);
+    EXPECT_NEAR(lin, 0.25, 1.0E-6);
+    EXPECT_NEAR(ang, -0.25, 1.0E-6);
+
+    // The last setpoint is held after the end
+    trajectory.sample(ros::Time(14.0), cursor, lin, ang);
+    EXPECT_NEAR(lin, 0.4, 1.0E-9);
+    EXPECT_NEAR(ang, -1.0, 1.0E-9);
+
+    // A sample earlier than the cursor searches from the start
+    trajectory.sample(ros::Time(11.5), cursor, lin, ang);
+    EXPECT_NEAR(lin, 0.1, 1.0E-6);
+}
+
+TEST(CommandTrajectory, samplesEmptyAsStop)
+{
+    CommandTrajectory trajectory;
+    size_t cursor = 0;
+    double lin = 1.0;
+    double ang = 1.0;
+    trajectory.sample(ros::Time(10.0), cursor, lin, ang);
+    EXPECT_EQ(lin, 0.0);
+    EXPECT_EQ(ang, 0.0);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
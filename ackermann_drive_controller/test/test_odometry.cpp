@@ -0,0 +1,106 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#include "ackermann_drive_controller/odometry.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using ackermann_drive_controller::Odometry;
+
+namespace
+{
+    const double WHEEL_RADIUS = 0.06;
+    const double MID_WHEEL_LAT_SEPARATION = 0.52;
+
+    void setGeometry(Odometry& odometry, double wheel_radius)
+    {
+        odometry.setWheelParams(wheel_radius, MID_WHEEL_LAT_SEPARATION,
+            0.5, 0.3, 0.5, 0.3);
+    }
+} // namespace
+
+TEST(Odometry, integratesStraightLine)
+{
+    Odometry odometry;
+    setGeometry(odometry, WHEEL_RADIUS);
+    odometry.init(ros::Time(1.0));
+
+    std::vector<double> wheel_pos(6, 0.0);
+    const std::vector<double> steer_pos(4, 0.0);
+    odometry.setWheelPositions(wheel_pos);
+
+    wheel_pos.assign(6, 10.0);
+    odometry.update(wheel_pos, steer_pos, ros::Time(2.0));
+    EXPECT_NEAR(odometry.getX(), 10.0 * WHEEL_RADIUS, 1.0E-9);
+    EXPECT_NEAR(odometry.getY(), 0.0, 1.0E-9);
+    EXPECT_NEAR(odometry.getHeading(), 0.0, 1.0E-9);
+}
+
+TEST(Odometry, rescalesWheelPositionsOnRadiusChange)
+{
+    Odometry odometry;
+    setGeometry(odometry, WHEEL_RADIUS);
+    odometry.init(ros::Time(1.0));
+
+    // Large accumulated encoder position
+    std::vector<double> wheel_pos(6, 1000.0);
+    const std::vector<double> steer_pos(4, 0.0);
+    odometry.setWheelPositions(wheel_pos);
+
+    // A radius change with the wheels stationary does not move the rover
+    setGeometry(odometry, 1.1 * WHEEL_RADIUS);
+    odometry.update(wheel_pos, steer_pos, ros::Time(2.0));
+    EXPECT_NEAR(odometry.getX(), 0.0, 1.0E-9);
+    EXPECT_NEAR(odometry.getHeading(), 0.0, 1.0E-9);
+
+    // and later travel uses the new radius
+    wheel_pos.assign(6, 1001.0);
+    odometry.update(wheel_pos, steer_pos, ros::Time(3.0));
+    EXPECT_NEAR(odometry.getX(), 1.1 * WHEEL_RADIUS, 1.0E-9);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,160 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+// Microbenchmarks for the LX-16A protocol and encoder filter.
+//
+// Each benchmark reports the number of heap allocations per iteration
+// in the 'allocs' counter. Use --benchmark_format=json or
+// --benchmark_out=<file> for machine readable results.
+
+#define CURIO_REALTIME_DEFINE_ALLOCATION_COUNTER
+#include <curio_realtime/allocation_counter.h>
+
+#include "curio_base/lx16a_encoder_filter.h"
+#include "curio_base/lx16a_protocol.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <vector>
+
+using curio_realtime::AllocationCounter;
+
+namespace
+{
+    /// Report allocations per iteration, call after the benchmark loop
+    void reportAllocations(benchmark::State& state, uint64_t allocs_start)
+    {
+        state.counters["allocs"] = benchmark::Counter(
+            static_cast<double>(AllocationCounter::count() - allocs_start),
+            benchmark::Counter::kAvgIterations);
+    }
+
+    const uint8_t SERVO_MOVE_TIME_WRITE = 1;
+    const uint8_t SERVO_POS_READ = 28;
+} // namespace
+
+static void BM_Checksum(benchmark::State& state)
+{
+    uint8_t frame[curio_base::lx16a::MAX_FRAME_SIZE] = {
+        0x55, 0x55, 11, 7, SERVO_MOVE_TIME_WRITE, 0xF4, 0x01, 0x32, 0x00 };
+    const uint64_t allocs = AllocationCounter::count();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(frame);
+        benchmark::DoNotOptimize(curio_base::lx16a::checksum(frame));
+    }
+    reportAllocations(state, allocs);
+}
+BENCHMARK(BM_Checksum);
+
+static void BM_EncodeMoveFrame(benchmark::State& state)
+{
+    uint8_t frame[curio_base::lx16a::MAX_FRAME_SIZE];
+    int16_t position = 0;
+    const uint64_t allocs = AllocationCounter::count();
+    for (auto _ : state)
+    {
+        const uint16_t time = 50;
+        const uint8_t params[4] = {
+            static_cast<uint8_t>(position), static_cast<uint8_t>(position >> 8),
+            static_cast<uint8_t>(time), static_cast<uint8_t>(time >> 8) };
+        benchmark::DoNotOptimize(curio_base::lx16a::encode(frame, 11, SERVO_MOVE_TIME_WRITE, params, 4));
+        position = (position + 1) % 1000;
+    }
+    reportAllocations(state, allocs);
+}
+BENCHMARK(BM_EncodeMoveFrame);
+
+// Parse a stream of position responses from six servos,
+// with a byte of line noise between each frame.
+static void BM_ParsePositionResponses(benchmark::State& state)
+{
+    std::vector<uint8_t> stream;
+    const uint8_t ids[6] = { 11, 12, 13, 21, 22, 23 };
+    for (size_t i = 0; i < 6; ++i)
+    {
+        uint8_t frame[curio_base::lx16a::MAX_FRAME_SIZE];
+        const int16_t pos = static_cast<int16_t>(100 * i + 50);
+        const uint8_t params[2] = { static_cast<uint8_t>(pos), static_cast<uint8_t>(pos >> 8) };
+        const size_t n = curio_base::lx16a::encode(frame, ids[i], SERVO_POS_READ, params, 2);
+        stream.insert(stream.end(), frame, frame + n);
+        stream.push_back(0xFF);
+    }
+
+    curio_base::lx16a::FrameParser parser;
+    const uint64_t allocs = AllocationCounter::count();
+    for (auto _ : state)
+    {
+        int sum = 0;
+        for (uint8_t byte : stream)
+        {
+            if (parser.parse(byte) == curio_base::lx16a::FrameParser::FRAME)
+            {
+                sum += curio_base::lx16a::toInt16(parser.params());
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    reportAllocations(state, allocs);
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * stream.size()));
+}
+BENCHMARK(BM_ParsePositionResponses);
+
+// A wheel turning at constant speed, including passes through the
+// invalid band and the wrap at the end of the encoder range.
+static void BM_EncoderFilterUpdate(benchmark::State& state)
+{
+    curio_base::LX16AEncoderFilter filter;
+    filter.reset(0);
+    int pos = 0;
+    const uint64_t allocs = AllocationCounter::count();
+    for (auto _ : state)
+    {
+        pos = (pos + 30) % curio_base::LX16AEncoderFilter::ENCODER_MAX;
+        benchmark::DoNotOptimize(filter.update(500, pos));
+        benchmark::DoNotOptimize(filter.getAngularPosition());
+    }
+    reportAllocations(state, allocs);
+}
+BENCHMARK(BM_EncoderFilterUpdate);
+
+BENCHMARK_MAIN();
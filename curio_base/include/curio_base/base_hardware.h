@@ -0,0 +1,299 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#ifndef CURIO_BASE_BASE_HARDWARE_H_
+#define CURIO_BASE_BASE_HARDWARE_H_
+
+#include "curio_base/lx16a_bus_schedule.h"
+#include "curio_base/lx16a_driver.h"
+#include "curio_base/lx16a_encoder_filter.h"
+#include "curio_base/realtime_failsafe.h"
+#include "curio_base/servo_state_bus.h"
+
+#include <curio_realtime/latency_trace.h>
+#include <curio_realtime/snapshot_file.h>
+#include <geometry_msgs/Twist.h>
+#include <hardware_interface/joint_command_interface.h>
+#include <hardware_interface/joint_state_interface.h>
+#include <hardware_interface/robot_hw.h>
+#include <ros/ros.h>
+#include <std_srvs/Trigger.h>
+#include <trajectory_msgs/MultiDOFJointTrajectory.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace curio_base
+{
+    /**
+     * \brief ros_control hardware interface for the Curio mobile base.
+     *
+     * Exposes the six wheel joints through a VelocityJointInterface and
+     * the four corner (steering) joints through a PositionJointInterface
+     * as expected by the ackermann_drive_controller. All joints are also
+     * available through a JointStateInterface.
+     *
+     * The wheel servos are run in motor mode: the commanded wheel angular
+     * velocity is mapped to a servo duty and the wheel position is
+     * estimated from the servo position with an LX16AEncoderFilter.
+     * The steering servos are run in servo mode: the commanded angle is
+     * mapped to a servo position, with trim set from the steering servo
+     * angle offsets.
+     */
+    class BaseHardware : public hardware_interface::RobotHW
+    {
+    public:
+        static const size_t NUM_WHEELS = 6;
+        static const size_t NUM_STEERS = 4;
+
+        static constexpr double SERVO_ANG_VEL_MAX   = 2 * M_PI;  ///< Maximum wheel servo angular velocity [rad/s]
+        static constexpr double SERVO_DUTY_MAX      = 1000.0;    ///< Maximum wheel servo duty
+        static constexpr double REVERSE_SERVO_ANGLE = 90.0;      ///< Angle at which the steering reverses by 180 [deg]
+        static constexpr double SERVO_ANGLE_MAX     = 120.0;     ///< Maximum (abs) steering servo angle [deg]
+        static constexpr double SERVO_POS_MIN       = 0.0;       ///< Minimum steering servo position
+        static constexpr double SERVO_POS_MAX       = 1000.0;    ///< Maximum steering servo position
+
+        BaseHardware();
+
+        virtual ~BaseHardware();
+
+        /**
+         * \brief Load parameters, open the servo bus and register the joints
+         * \param root_nh      Node handle at root namespace
+         * \param robot_hw_nh  Node handle in the hardware namespace
+         */
+        virtual bool init(ros::NodeHandle& root_nh, ros::NodeHandle& robot_hw_nh);
+
+        /**
+         * \brief Read the wheel servo positions and update the joint states
+         * \param time   Current time
+         * \param period Time since the last call to read
+         */
+        virtual void read(const ros::Time& time, const ros::Duration& period);
+
+        /**
+         * \brief Write the joint commands to the servos
+         * \param time   Current time
+         * \param period Time since the last call to write
+         */
+        virtual void write(const ros::Time& time, const ros::Duration& period);
+
+        /**
+         * \brief Stop all wheel servos
+         */
+        void stop();
+
+        /**
+         * \brief Map a wheel angular velocity to a servo duty
+         * \param ang_vel     Wheel angular velocity [rad/s]
+         * \param orientation 1 or -1 depending on the side of the base
+         */
+        static int16_t wheelDuty(double ang_vel, int orientation);
+
+        /**
+         * \brief Map a steering angle to a servo position
+         * \param angle       Steering angle [rad]
+         * \param orientation 1 or -1
+         */
+        static int16_t steerPosition(double angle, int orientation);
+
+    private:
+        /// Servo configuration
+        struct Servo
+        {
+            uint8_t id;
+            std::string lon_label;
+            std::string lat_label;
+            int orientation;
+            int offset;
+
+            Servo() : id(0), orientation(1), offset(0) {}
+        };
+
+        /**
+         * \brief Load servo ids, labels (and offsets) from the parameter server
+         */
+        bool loadServos(ros::NodeHandle& nh, const std::string& prefix,
+            size_t expected, bool load_offsets, std::vector<Servo>& servos);
+
+        /**
+         * \brief Reset the encoder filters of some wheels from their current positions
+         * \param wheels Indices of the wheels to reset
+         */
+        void resetEncoders(const std::vector<size_t>& wheels);
+
+        /**
+         * \brief Write this cycle's servo state to the state bus
+         */
+        void publishState(const ros::Time& time);
+
+        /**
+         * \brief Load the failsafe parameters and subscribe to the command topics
+         */
+        bool initFailsafe(ros::NodeHandle& root_nh, ros::NodeHandle& robot_hw_nh);
+
+        /**
+         * \brief Check that the servo bus traffic of a cycle fits the control period
+         */
+        bool initBusSchedule(ros::NodeHandle& robot_hw_nh);
+
+        /**
+         * \brief Record the bus time of this cycle's read and write
+         * \param write_start The time write started
+         */
+        void recordBusTime(const std::chrono::steady_clock::time_point& write_start);
+
+        /**
+         * \brief Stop every servo with a broadcast frame
+         */
+        void safeStop();
+
+        /**
+         * \brief Return the servos to the commanded state after a failsafe stop
+         */
+        void recoverFromSafeStop();
+
+        /**
+         * \brief Stamp a command for the failsafe (non-realtime)
+         */
+        void failsafeCommandCallback(const geometry_msgs::Twist::ConstPtr& command);
+
+        /**
+         * \brief Stamp a command trajectory for the failsafe (non-realtime)
+         */
+        void failsafeTrajectoryCallback(
+            const trajectory_msgs::MultiDOFJointTrajectory::ConstPtr& trajectory);
+
+        /**
+         * \brief Request a reset of a tripped failsafe (non-realtime)
+         * \param req Empty request
+         * \param res The faults that tripped the failsafe in the message field
+         */
+        bool resetFailsafeCallback(std_srvs::Trigger::Request& req,
+            std_srvs::Trigger::Response& res);
+
+        std::string name_;
+
+        /// Servo driver
+        LX16ADriver servo_driver_;
+
+        /// Servos
+        std::vector<Servo> wheel_servos_;
+        std::vector<Servo> steer_servos_;
+
+        /// Encoder filters for the wheel servos
+        std::vector<LX16AEncoderFilter> encoder_filters_;
+
+        /// Encoder filter state, saved each cycle for warm restarts
+        struct EncoderSnapshot
+        {
+            int32_t count_offset[NUM_WHEELS];
+            int32_t revolutions[NUM_WHEELS];
+            int32_t last_valid_pos[NUM_WHEELS];
+        };
+        curio_realtime::SnapshotFile<EncoderSnapshot> encoder_snapshot_;
+        EncoderSnapshot encoder_snapshot_record_;
+
+        /// Hardware interfaces
+        hardware_interface::JointStateInterface joint_state_interface_;
+        hardware_interface::VelocityJointInterface vel_joint_interface_;
+        hardware_interface::PositionJointInterface pos_joint_interface_;
+
+        /// Joint state and commands
+        double wheel_pos_[NUM_WHEELS];
+        double wheel_vel_[NUM_WHEELS];
+        double wheel_eff_[NUM_WHEELS];
+        double wheel_cmd_[NUM_WHEELS];
+        double steer_pos_[NUM_STEERS];
+        double steer_vel_[NUM_STEERS];
+        double steer_eff_[NUM_STEERS];
+        double steer_cmd_[NUM_STEERS];
+
+        /// Last servo commands sent, used to skip unchanged writes
+        int16_t wheel_duty_[NUM_WHEELS];
+        int16_t steer_servo_pos_[NUM_STEERS];
+
+        /// Servo move time for steering commands [ms]
+        int steer_move_time_;
+
+        /// Resend unchanged commands after this many cycles (0 = every cycle)
+        int command_refresh_cycles_;
+        int cycles_since_refresh_;
+
+        /// Number of failed servo position reads
+        uint64_t read_failures_;
+
+        /// Servo state shared with local processes
+        ServoStateBus state_bus_;
+        ServoState state_record_;
+        int16_t wheel_servo_read_[NUM_WHEELS];
+        uint32_t wheel_responding_;
+
+        /// Failsafe checks, a trip stops the servos until it is reset
+        RealtimeFailsafe failsafe_;
+        bool failsafe_enabled_;
+        bool safe_stopped_;
+        uint32_t failsafe_reported_;
+        std::vector<ros::Subscriber> failsafe_command_subs_;
+        ros::Subscriber failsafe_trajectory_sub_;
+        ros::ServiceServer failsafe_reset_srv_;
+
+        /// Read the supply voltage every this many cycles (0 = never)
+        int vin_read_cycles_;
+
+        /// Schedule of the servo bus traffic, with the wheel index of each
+        /// task, the cycle count and the measured bus time of the reads
+        LX16ABusSchedule bus_schedule_;
+        std::vector<size_t> bus_task_wheel_;
+        uint64_t bus_cycle_;
+        double read_bus_time_;
+
+        /// Command latency tracing, tags the write of each traced command
+        curio_realtime::LatencyTrace latency_trace_;
+        uint64_t last_trace_id_;
+    };
+
+} // namespace curio_base
+
+#endif // CURIO_BASE_BASE_HARDWARE_H_
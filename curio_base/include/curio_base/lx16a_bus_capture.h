@@ -0,0 +1,221 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#ifndef CURIO_BASE_LX16A_BUS_CAPTURE_H_
+#define CURIO_BASE_LX16A_BUS_CAPTURE_H_
+
+#include <curio_realtime/realtime_queue.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+#include <semaphore.h>
+
+namespace curio_base
+{
+    /**
+     * \brief Capture file header.
+     *
+     * The header is followed by a sequence of chunks, each a
+     * BusCaptureChunk followed by 'length' bytes of bus data.
+     */
+    struct BusCaptureFileHeader
+    {
+        static const uint32_t VERSION = 1;
+
+        char magic[8];
+        uint32_t version;
+        uint32_t baudrate;
+
+        /// Wall clock and monotonic time at the start of the capture [ns],
+        /// chunk times are monotonic.
+        int64_t start_realtime_ns;
+        int64_t start_monotonic_ns;
+
+        /**
+         * \brief Initialise a header for a new capture
+         */
+        void init(uint32_t baudrate);
+
+        /**
+         * \brief True if the magic and version match
+         */
+        bool isValid() const;
+    };
+
+    /**
+     * \brief A run of bytes moving in one direction on the bus.
+     *
+     * Consecutive reads are merged into one chunk while the gap between
+     * them is less than a few byte times, so a servo response is usually
+     * a single chunk. The chunk records the times of its first and last
+     * bytes.
+     */
+    struct BusCaptureChunk
+    {
+        enum Direction
+        {
+            DIRECTION_TX = 1,
+            DIRECTION_RX = 2
+        };
+
+        /// Monotonic time of the first byte [ns]
+        int64_t time_ns;
+
+        /// Time from the first to the last byte [ns]
+        uint32_t duration_ns;
+
+        uint16_t length;
+        uint8_t direction;
+        uint8_t reserved;
+    };
+
+    /**
+     * \brief Passive capture of the LX-16A serial bus traffic.
+     *
+     * The driver calls recordWrite and recordRead for every write to and
+     * read from the serial port. Bytes are timestamped with the monotonic
+     * clock when the system call returns: the tty layer does not expose
+     * the kernel receive time as sockets do. Chunks are passed through a
+     * lock-free queue to a writer thread, so capturing does not block the
+     * control loop on disk I/O. Chunks that do not fit in the queue are
+     * dropped and counted.
+     */
+    class LX16ABusCapture
+    {
+    public:
+        /// Maximum number of bytes in a chunk
+        static const size_t MAX_CHUNK_SIZE = 32;
+
+        /// Queue capacity in chunks
+        static const size_t QUEUE_SIZE = 1024;
+
+        LX16ABusCapture();
+
+        ~LX16ABusCapture();
+
+        /**
+         * \brief Create the capture file and start the writer thread
+         * \param path      Capture file path, an existing file is overwritten
+         * \param baudrate  Bus baudrate, used to merge consecutive reads
+         * \return false if the file could not be written
+         */
+        bool open(const std::string& path, uint32_t baudrate);
+
+        /**
+         * \brief Write the captured data, stop the writer thread and close the file
+         */
+        void close();
+
+        /**
+         * \brief True if a capture is in progress
+         */
+        bool isOpen() const
+        {
+            return file_ != nullptr;
+        }
+
+        /**
+         * \brief Record bytes written to the bus (caller thread only)
+         */
+        void recordWrite(const uint8_t* data, size_t size);
+
+        /**
+         * \brief Record bytes read from the bus (caller thread only)
+         */
+        void recordRead(const uint8_t* data, size_t size);
+
+        /**
+         * \brief Number of chunks dropped because the queue was full
+         */
+        uint64_t getDroppedCount() const
+        {
+            return dropped_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct Entry
+        {
+            BusCaptureChunk chunk;
+            uint8_t data[MAX_CHUNK_SIZE];
+        };
+
+        /**
+         * \brief Append bytes to the pending chunk, starting a new one if required
+         */
+        void append(uint8_t direction, const uint8_t* data, size_t size, int64_t now_ns);
+
+        /**
+         * \brief Queue the pending chunk
+         */
+        void flush();
+
+        /**
+         * \brief Writer thread main loop
+         */
+        void run();
+
+        /**
+         * \brief Write the queued chunks to the file
+         */
+        void drain();
+
+        curio_realtime::RealtimeQueue<Entry, QUEUE_SIZE> queue_;
+        Entry pending_;
+        int64_t last_byte_ns_;
+        int64_t merge_gap_ns_;
+
+        sem_t wakeup_;
+        std::thread thread_;
+        std::atomic<bool> running_;
+        std::atomic<uint64_t> dropped_;
+        uint64_t dropped_reported_;
+        std::string path_;
+        FILE* file_;
+    };
+
+} // namespace curio_base
+
+#endif // CURIO_BASE_LX16A_BUS_CAPTURE_H_
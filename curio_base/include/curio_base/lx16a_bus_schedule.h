@@ -0,0 +1,301 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#ifndef CURIO_BASE_LX16A_BUS_SCHEDULE_H_
+#define CURIO_BASE_LX16A_BUS_SCHEDULE_H_
+
+#include "curio_base/lx16a_driver.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace curio_base
+{
+    /**
+     * \brief A periodic transaction on the servo bus, see LX16ABusSchedule
+     */
+    struct LX16ABusTask
+    {
+        uint8_t id;             ///< Servo id, or lx16a::BROADCAST_ID
+        uint8_t command;        ///< Command id, a read if the command has a reply
+        double rate;            ///< Required rate, 0 for every cycle [Hz]
+        int priority;           ///< Higher priority tasks are placed and run first
+
+        LX16ABusTask() : id(0), command(0), rate(0.0), priority(0)
+        {
+        }
+
+        LX16ABusTask(uint8_t id, uint8_t command, double rate, int priority) :
+            id(id), command(command), rate(rate), priority(priority)
+        {
+        }
+    };
+
+    /**
+     * \brief A static cyclic schedule of the servo bus transactions.
+     *
+     * Each task runs every n-th cycle of the control loop, with n the
+     * largest power of two number of periods that meets its rate, up to
+     * max_cycles. The schedule repeats after the largest n, whatever the
+     * rates and the period. Tasks are placed
+     * in priority order, each at the phase that keeps the busiest cycle
+     * least loaded, so for example the supply voltage reads of several
+     * servos fall in different cycles.
+     *
+     * The bus time of a transaction is estimated from the frame sizes at
+     * the baudrate (10 bits per byte) plus the turnaround from the end of
+     * a request to the start of its reply. A schedule is only built if
+     * every cycle fits in the usable part of the period, unless the budget
+     * is not enforced.
+     *
+     * At runtime the measured bus time of each cycle is recorded to track
+     * the slack left in the period and the overruns.
+     */
+    class LX16ABusSchedule
+    {
+    public:
+        struct Params
+        {
+            /// The control loop period [s]
+            double period;
+
+            /// The servo bus baudrate [bit/s]
+            uint32_t baudrate;
+
+            /// Time from the end of a request to the start of its reply [s]
+            double turnaround;
+
+            /// Fraction of the period the bus may be used
+            double max_utilisation;
+
+            /// Largest number of cycles between runs of a task
+            size_t max_cycles;
+
+            /// Refuse a schedule with a cycle over the budget
+            bool enforce;
+
+            Params() :
+                period(0.02),
+                baudrate(115200),
+                turnaround(0.001),
+                max_utilisation(0.8),
+                max_cycles(1000),
+                enforce(true)
+            {
+            }
+        };
+
+        LX16ABusSchedule();
+
+        /**
+         * \brief Compute the schedule for a set of tasks
+         * \param tasks       The bus transactions
+         * \param params      The period and bus timing
+         * \param [out] error Why the tasks do not fit, if they do not
+         * \return false if the tasks are invalid, or do not fit in the
+         *         period and the budget is enforced
+         */
+        bool build(const std::vector<LX16ABusTask>& tasks, const Params& params,
+            std::string& error);
+
+        /**
+         * \brief The shortest period that fits a set of tasks.
+         *
+         * Tasks with a rate of 0 run every cycle at whatever period
+         * is found. The dividers of the tasks change with the period, so
+         * the capacity is checked between each change rather than by
+         * bisection.
+         *
+         * \param tasks      The bus transactions
+         * \param params     The bus timing, the period is ignored
+         * \param max_period The longest period to consider [s]
+         * \return The period [s], or 0 if the tasks do not fit in max_period
+         */
+        static double findMinPeriod(const std::vector<LX16ABusTask>& tasks,
+            const Params& params, double max_period = 1.0);
+
+        /**
+         * \brief The estimated bus time of a transaction [s]
+         */
+        static double transactionTime(const LX16ABusTask& task, const Params& params);
+
+        /**
+         * \brief Measure the turnaround of a servo.
+         *
+         * Times a number of position reads and subtracts the time the
+         * frames take on the wire at the driver's baudrate.
+         *
+         * \param driver           An open servo driver
+         * \param id               The servo to read
+         * \param samples          Number of reads
+         * \param response_timeout Time to wait for each reply [s]
+         * \return The longest turnaround measured [s], or -1 if the
+         *         servo did not reply
+         */
+        static double measureTurnaround(LX16ADriver& driver, uint8_t id,
+            int samples, double response_timeout);
+
+        /**
+         * \brief Number of cycles before the schedule repeats
+         */
+        size_t getNumCycles() const;
+
+        /**
+         * \brief Number of transactions in a cycle
+         * \param cycle The cycle count, taken modulo getNumCycles
+         */
+        size_t getNumSlots(uint64_t cycle) const;
+
+        /**
+         * \brief Index into the tasks of a transaction in a cycle
+         * \param cycle The cycle count, taken modulo getNumCycles
+         * \param slot  The transaction in the cycle, in run order
+         */
+        size_t getTaskIndex(uint64_t cycle, size_t slot) const;
+
+        /**
+         * \brief The scheduled tasks, in the order passed to build
+         */
+        const std::vector<LX16ABusTask>& getTasks() const;
+
+        /**
+         * \brief The number of cycles between runs of each task
+         */
+        const std::vector<size_t>& getDividers() const;
+
+        /**
+         * \brief The estimated bus time of a cycle [s]
+         * \param cycle The cycle count, taken modulo getNumCycles
+         */
+        double getBusTime(uint64_t cycle) const;
+
+        /**
+         * \brief The estimated bus time of the busiest cycle [s]
+         */
+        double getMaxBusTime() const;
+
+        /**
+         * \brief The busiest cycle's share of the period
+         */
+        double getUtilisation() const;
+
+        /**
+         * \brief The period the schedule was built for [s]
+         */
+        double getPeriod() const;
+
+        /**
+         * \brief The largest number of transactions in a cycle
+         */
+        size_t getMaxSlots() const;
+
+        /**
+         * \brief Record the measured bus time of a cycle
+         * \param bus_time The time the cycle's transactions took [s]
+         * \return The slack left in the period, negative on an overrun [s]
+         */
+        double recordCycle(double bus_time);
+
+        /**
+         * \brief Slack of the last recorded cycle [s]
+         */
+        double getLastSlack() const;
+
+        /**
+         * \brief Least slack of any recorded cycle [s]
+         */
+        double getMinSlack() const;
+
+        /**
+         * \brief Number of recorded cycles
+         */
+        uint64_t getCycles() const;
+
+        /**
+         * \brief Number of recorded cycles that took longer than the period
+         */
+        uint64_t getOverruns() const;
+
+        /**
+         * \brief A one line summary of the schedule
+         */
+        std::string toString() const;
+
+    private:
+        /**
+         * \brief The number of cycles between runs of each task at a period
+         * \return false if a task is invalid or its rate above the loop rate
+         */
+        static bool computeDividers(const std::vector<LX16ABusTask>& tasks,
+            const Params& params, std::vector<size_t>& dividers, std::string& error);
+
+        /**
+         * \brief Place the tasks in the cycles of a schedule
+         * \param [out] bus_time    The estimated bus time of each cycle [s]
+         * \param [out] cycle_slots The task indices of each cycle in run order
+         */
+        static void place(const std::vector<LX16ABusTask>& tasks,
+            const Params& params, const std::vector<size_t>& dividers,
+            std::vector<double>& bus_time, std::vector<std::vector<size_t>>& cycle_slots);
+
+        Params params_;
+        std::vector<LX16ABusTask> tasks_;
+        std::vector<size_t> dividers_;
+
+        /// Transactions of each cycle in run order: the task indices of
+        /// cycle c are slots_[cycle_begin_[c]] to slots_[cycle_begin_[c + 1] - 1]
+        std::vector<size_t> cycle_begin_;
+        std::vector<size_t> slots_;
+        std::vector<double> bus_time_;
+        double max_bus_time_;
+        size_t max_slots_;
+
+        // Runtime statistics
+        uint64_t cycles_;
+        uint64_t overruns_;
+        double last_slack_;
+        double min_slack_;
+    };
+
+} // namespace curio_base
+
+#endif // CURIO_BASE_LX16A_BUS_SCHEDULE_H_
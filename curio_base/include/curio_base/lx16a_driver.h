@@ -41,13 +41,98 @@
 #ifndef CURIO_BASE_LX16A_DRIVER_H_
 #define CURIO_BASE_LX16A_DRIVER_H_
 
+#include "curio_base/lx16a_bus_capture.h"
+#include "curio_base/lx16a_protocol.h"
+
 #include <serial/serial.h>
 
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace curio_base
 {
+    /**
+     * \brief Startup configuration for one servo, see LX16ADriver::setup
+     */
+    struct LX16AServoSetup
+    {
+        uint8_t id;
+        uint8_t mode;           ///< 0 = servo mode, 1 = motor mode
+        int16_t duty;           ///< Motor mode duty [-1000, 1000]
+        bool set_offset;        ///< Adjust the angle offset
+        int8_t offset;          ///< Angle offset [-125, 125]
+        bool load;              ///< Power the motor (servo mode)
+
+        LX16AServoSetup() :
+            id(0), mode(0), duty(0), set_offset(false), offset(0), load(false)
+        {
+        }
+    };
+
+    /**
+     * \brief Result of LX16ADriver::setup for one servo
+     */
+    struct LX16AServoStatus
+    {
+        bool responding;        ///< The servo answered at least one read
+        bool verified;          ///< The read back mode and offset match the setup
+        int attempts;           ///< Number of times the configuration was written
+        int mode;               ///< Read back mode, -1 if not read
+        int offset;             ///< Read back angle offset, 0 if not read
+        int position;           ///< Position at the end of setup, -1 if not read
+
+        LX16AServoStatus() :
+            responding(false), verified(false), attempts(0),
+            mode(-1), offset(0), position(-1)
+        {
+        }
+    };
+
+    /**
+     * \brief A read request in a bus sweep, see LX16ADriver::sweep
+     */
+    struct LX16AQuery
+    {
+        uint8_t id;
+        uint8_t command;        ///< A read command, e.g. lx16a::POS_READ
+
+        LX16AQuery() : id(0), command(0)
+        {
+        }
+
+        LX16AQuery(uint8_t id, uint8_t command) : id(id), command(command)
+        {
+        }
+    };
+
+    /**
+     * \brief The reply to a read request in a bus sweep
+     */
+    struct LX16AReply
+    {
+        enum Status
+        {
+            OK,                 ///< A valid reply was received
+            TIMEOUT,            ///< No reply within the response timeout
+            CHECKSUM_ERROR      ///< A reply was received with an invalid checksum
+        };
+
+        Status status;
+        uint8_t params[lx16a::MAX_PARAMS];
+        size_t num_params;
+
+        /// Time the reply was received, or the wait for it ended
+        std::chrono::steady_clock::time_point stamp;
+
+        LX16AReply() : status(TIMEOUT), params(), num_params(0)
+        {
+        }
+    };
+
     class LX16ADriver
     {
     public:
@@ -64,6 +149,83 @@ namespace curio_base
         int readPosition(uint8_t id);
         int readVin(uint8_t id);
 
+        /// Maximum number of servos in one write of a group command
+        static const size_t MAX_GROUP_SIZE = 16;
+
+        /**
+         * \brief Stop every servo on the bus with one broadcast frame.
+         *
+         * All servos are switched to motor mode with zero duty, so servos
+         * in servo mode stop holding their position and go limp.
+         */
+        void broadcastStop();
+
+        /**
+         * \brief Move a group of servos so that they start together.
+         *
+         * A move-time-wait frame is staged on each servo and a single
+         * broadcast start frame then starts them all. The frames are sent
+         * in one write.
+         *
+         * \param ids       Servo ids
+         * \param positions Target positions [0, 1000]
+         * \param count     Number of servos
+         * \param time      Move time [ms]
+         */
+        void moveGroup(const uint8_t *ids, const int16_t *positions,
+            size_t count, uint16_t time);
+
+        /**
+         * \brief Set the mode and duty of a group of servos in one write
+         * \param ids       Servo ids
+         * \param mode      0 = servo mode, 1 = motor mode
+         * \param duties    Motor mode duty [-1000, 1000] for each servo
+         * \param count     Number of servos
+         */
+        void setModeGroup(const uint8_t *ids, uint8_t mode,
+            const int16_t *duties, size_t count);
+
+        /**
+         * \brief Send a sequence of read requests and collect the replies.
+         *
+         * The bus is half duplex so a request can only be sent once the
+         * previous reply is in. The sweep drains stale input once at the
+         * start, then sends each request as soon as the previous reply is
+         * complete, or its response timeout expires, and stamps each reply
+         * as it completes. Does not allocate.
+         *
+         * \param queries          The read requests
+         * \param [out] replies    One reply for each request
+         * \param count            Number of requests
+         * \param response_timeout Time to wait for each reply [s]
+         * \return The number of valid replies
+         */
+        size_t sweep(const LX16AQuery *queries, LX16AReply *replies,
+            size_t count, double response_timeout);
+
+        /**
+         * \brief Configure a set of servos and verify the configuration.
+         *
+         * The mode, offset and load commands for all servos are sent in a
+         * single write. One sweep then reads back the mode, offset and
+         * position of each servo, waiting at most response_timeout for each
+         * reply. Servos that do not verify are configured and checked again,
+         * up to max_attempts in total.
+         *
+         * \param setup             The configuration for each servo
+         * \param response_timeout  Time to wait for each reply [s]
+         * \param max_attempts      Maximum number of configuration writes per servo
+         * \param [out] status      The result for each servo, in the order of setup
+         * \return true if every servo was verified
+         */
+        bool setup(const std::vector<LX16AServoSetup> &setup,
+            double response_timeout, int max_attempts,
+            std::vector<LX16AServoStatus> &status);
+
+        // Bus capture, see LX16ABusCapture
+        bool startCapture(const std::string &path);
+        void stopCapture();
+
         // Serial interface
         void open();
         bool isOpen() const;
@@ -76,6 +238,7 @@ namespace curio_base
 
     private:
         serial::Serial serial_;
+        std::unique_ptr<LX16ABusCapture> capture_;
 
     };
 } // namespace curio_base
@@ -0,0 +1,186 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#ifndef CURIO_BASE_LX16A_ENCODER_FILTER_H_
+#define CURIO_BASE_LX16A_ENCODER_FILTER_H_
+
+#include <cstdint>
+
+namespace curio_base
+{
+    /**
+     * \brief An encoder filter for the LX-16A servo.
+     *
+     * The LX-16A has 1500 counts per revolution, but the position
+     * measurement is only valid over about 330 deg. Positions in the
+     * invalid region are noisy and are rejected by this filter using
+     * a fixed band and a limit on the change between samples (the
+     * Python filter uses a trained classifier instead).
+     *
+     * The filter maintains a count of the number of full revolutions
+     * made by the servo and uses this and the last valid position to
+     * determine the overall encoder count.
+     *
+     * If the wheel moves further than the jump limit while readings are
+     * missed, the filter re-syncs once several consecutive readings
+     * agree with each other, so the count does not freeze.
+     */
+    class LX16AEncoderFilter
+    {
+    public:
+        static const int ENCODER_MIN   = 0;      ///< Minimum servo position reading
+        static const int ENCODER_MAX   = 1500;   ///< Maximum servo position reading
+        static const int ENCODER_LOWER = 1190;   ///< Lower bound of the invalid range
+        static const int ENCODER_UPPER = 1310;   ///< Upper bound of the invalid range
+        static const int ENCODER_STEP  = 1000;   ///< Threshold for detecting a wrap
+
+        /**
+         * \brief Constructor
+         * \param max_delta      The largest plausible change in position
+         *                       between samples (after unwrapping) [counts]
+         * \param max_rejections The number of consecutive, consistent
+         *                       readings rejected as jumps before the
+         *                       filter re-syncs to them
+         */
+        explicit LX16AEncoderFilter(int max_delta = 300, int max_rejections = 3);
+
+        /**
+         * \brief Reset the encoder count to zero
+         * \param pos The (assumed valid) position of the servo
+         */
+        void reset(int pos);
+
+        /**
+         * \brief Resume the encoder count from a saved state
+         *
+         * If the servo position is not consistent with the saved state (the
+         * wheel moved while the filter was not running) the count continues
+         * from the saved count at the new position.
+         *
+         * \param count_offset   The saved count offset, see getCountOffset
+         * \param revolutions    The saved number of revolutions
+         * \param last_valid_pos The saved last valid position, see getLastValidPos
+         * \param pos            The current position of the servo
+         * \return true if the current position was consistent with the saved state
+         */
+        bool restore(int count_offset, int revolutions, int last_valid_pos, int pos);
+
+        /**
+         * \brief Update the filter with a new position reading
+         * \param duty The commanded duty
+         * \param pos  The servo position
+         * \return true if the position was accepted as valid
+         */
+        bool update(int16_t duty, int pos);
+
+        /**
+         * \brief Number of revolutions since reset
+         */
+        int getRevolutions() const;
+
+        /**
+         * \brief The current encoder count since reset (filtered)
+         */
+        int getCount() const;
+
+        /**
+         * \brief The servo position at reset, offset by any restore
+         */
+        int getCountOffset() const;
+
+        /**
+         * \brief The last position accepted as valid
+         */
+        int getLastValidPos() const;
+
+        /**
+         * \brief The commanded duty at the last update
+         */
+        int16_t getDuty() const;
+
+        /**
+         * \brief The angular position of the encoder (filtered) [rad]
+         */
+        double getAngularPosition() const;
+
+        /**
+         * \brief The last (unfiltered) servo position, mapped to [0, 1500)
+         */
+        int getServoPos() const;
+
+        /**
+         * \brief Whether the last servo position was accepted
+         */
+        bool isValid() const;
+
+        /**
+         * \brief Invert the direction of the encoder count
+         * \param is_inverted Set to true if the encoder count is reversed
+         */
+        void setInvert(bool is_inverted);
+
+        /**
+         * \brief Whether the encoder count is inverted
+         */
+        bool getInvert() const;
+
+    private:
+        /**
+         * \brief Unwrapped change from one position to another [counts]
+         */
+        static int unwrapDelta(int from, int to);
+
+        int max_delta_;         ///< The largest plausible change between samples
+        int max_rejections_;    ///< Consecutive rejections before a re-sync
+        int rejections_;        ///< Consecutive consistent rejections
+        int rejected_pos_;      ///< The last position rejected as a jump
+        int count_offset_;      ///< Set to ensure count=0 when reset
+        int revolutions_;       ///< Number of revolutions since reset
+        int prev_valid_pos_;    ///< The previous valid position
+        int servo_pos_;         ///< The last servo position
+        int16_t duty_;          ///< The last commanded duty
+        int invert_;            ///< 1 or -1
+        bool valid_;            ///< Whether the last servo position was valid
+    };
+
+} // namespace curio_base
+
+#endif // CURIO_BASE_LX16A_ENCODER_FILTER_H_
@@ -0,0 +1,226 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#ifndef CURIO_BASE_LX16A_PROTOCOL_H_
+#define CURIO_BASE_LX16A_PROTOCOL_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace curio_base
+{
+    /**
+     * \brief Encoding and decoding of LX-16A serial bus frames.
+     *
+     * A frame has the layout:
+     *
+     *   0x55 0x55 id length command params... checksum
+     *
+     * where length = number of params + 3 and the checksum is the
+     * inverted low byte of the sum of id, length, command and params.
+     * These functions do no I/O and do not allocate.
+     */
+    namespace lx16a
+    {
+        const uint8_t FRAME_HEADER = 0x55;
+
+        /// Servo id addressing every servo on the bus, which do not reply
+        const uint8_t BROADCAST_ID = 0xFE;
+
+        /// Size of the frame excluding the params
+        const size_t FRAME_OVERHEAD = 6;
+
+        /// Maximum number of params in a frame
+        const size_t MAX_PARAMS = 7;
+
+        /// Maximum size of a frame
+        const size_t MAX_FRAME_SIZE = FRAME_OVERHEAD + MAX_PARAMS;
+
+        /// Command ids used to sample and budget the bus traffic
+        const uint8_t MOVE_TIME_WAIT_WRITE  = 7;
+        const uint8_t MOVE_START            = 11;
+        const uint8_t TEMP_READ             = 26;
+        const uint8_t VIN_READ              = 27;
+        const uint8_t POS_READ              = 28;
+        const uint8_t OR_MOTOR_MODE_WRITE   = 29;
+
+        /**
+         * \brief True if the servo replies to the command (the read commands)
+         * \param command Command id
+         */
+        bool hasResponse(uint8_t command);
+
+        /**
+         * \brief Size of the frame sent for a command
+         * \param command Command id
+         * \return The frame size in bytes, 0 if the command is unknown
+         */
+        size_t requestSize(uint8_t command);
+
+        /**
+         * \brief Size of the reply frame to a command
+         * \param command Command id
+         * \return The frame size in bytes, 0 if the command has no reply
+         */
+        size_t responseSize(uint8_t command);
+
+        /**
+         * \brief Calculate the checksum of a frame
+         * \param buf A frame with at least the header, id and length set
+         */
+        uint8_t checksum(const uint8_t* buf);
+
+        /**
+         * \brief Encode a frame
+         * \param [out] buf   Buffer with space for num_params + FRAME_OVERHEAD bytes
+         * \param id          Servo id
+         * \param command     Command id
+         * \param params      Command parameters
+         * \param num_params  Number of parameters (at most MAX_PARAMS)
+         * \return The number of bytes written, 0 if there are too many params
+         */
+        size_t encode(uint8_t* buf, uint8_t id, uint8_t command,
+            const uint8_t* params, size_t num_params);
+
+        /**
+         * \brief A streaming frame parser.
+         *
+         * Bytes are pushed one at a time, typically as they arrive from
+         * the serial port. The parser synchronises on the double header
+         * byte and discards frames with an invalid length.
+         */
+        class FrameParser
+        {
+        public:
+            enum Result
+            {
+                INCOMPLETE,       ///< More bytes are needed
+                FRAME,            ///< A valid frame is available
+                CHECKSUM_ERROR    ///< A frame was received with an invalid checksum
+            };
+
+            FrameParser();
+
+            /**
+             * \brief Push a byte into the parser
+             * \return FRAME when a complete valid frame has been received
+             */
+            Result parse(uint8_t byte);
+
+            /**
+             * \brief Discard any partial frame
+             */
+            void reset();
+
+            /**
+             * \brief True if no partial frame has been received
+             */
+            bool isIdle() const
+            {
+                return count_ == 0;
+            }
+
+            /**
+             * \brief Servo id of the last frame
+             */
+            uint8_t id() const
+            {
+                return buf_[2];
+            }
+
+            /**
+             * \brief Command id of the last frame
+             */
+            uint8_t command() const
+            {
+                return buf_[4];
+            }
+
+            /**
+             * \brief Parameters of the last frame
+             */
+            const uint8_t* params() const
+            {
+                return buf_ + 5;
+            }
+
+            /**
+             * \brief Number of parameters in the last frame
+             */
+            size_t numParams() const
+            {
+                return buf_[3] - 3;
+            }
+
+            /**
+             * \brief The last frame including header and checksum
+             */
+            const uint8_t* frame() const
+            {
+                return buf_;
+            }
+
+            /**
+             * \brief Size of the last frame
+             */
+            size_t frameSize() const
+            {
+                return buf_[3] + 3;
+            }
+
+        private:
+            uint8_t buf_[MAX_FRAME_SIZE];
+            size_t count_;
+        };
+
+        /**
+         * \brief Read a signed 16 bit little endian value from the params
+         */
+        inline int16_t toInt16(const uint8_t* params)
+        {
+            return static_cast<int16_t>(static_cast<uint16_t>(params[0])
+                | (static_cast<uint16_t>(params[1]) << 8));
+        }
+
+    } // namespace lx16a
+} // namespace curio_base
+
+#endif // CURIO_BASE_LX16A_PROTOCOL_H_
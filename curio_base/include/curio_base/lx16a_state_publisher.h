@@ -0,0 +1,156 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#ifndef CURIO_BASE_LX16A_STATE_PUBLISHER_H_
+#define CURIO_BASE_LX16A_STATE_PUBLISHER_H_
+
+#include "curio_base/lx16a_bus_schedule.h"
+#include "curio_base/lx16a_driver.h"
+#include "curio_base/LX16ASweep.h"
+
+#include <ros/ros.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace curio_base
+{
+    /**
+     * \brief Sample the state of all wheel and steering servos and publish
+     *        it as one message per bus sweep.
+     *
+     * Each sweep reads the position of every servo back to back with
+     * LX16ADriver::sweep. The supply voltage and temperature are read at
+     * lower rates. The reads of each sweep come from an LX16ABusSchedule
+     * built in init, which spreads the telemetry over the sweeps and
+     * refuses rates that do not fit in the sweep period. The queries,
+     * replies and the message are allocated once in init.
+     *
+     * The publisher owns the servo bus, it cannot run alongside the
+     * curio_base_hardware node.
+     */
+    class LX16AStatePublisher
+    {
+    public:
+        /// Constructor
+        LX16AStatePublisher();
+
+        /**
+         * \brief Open the servo bus and advertise the sweep topic.
+         *
+         * Reads the servo bus settings, the wheel_servo_ids and
+         * steer_servo_ids and the sweep rates from the private node handle.
+         *
+         * \param nh         Node handle for the sweep topic
+         * \param private_nh Node handle for the parameters
+         * \return false if the parameters are missing, the bus
+         *         cannot be opened or the reads do not fit in the period
+         */
+        bool init(ros::NodeHandle &nh, ros::NodeHandle &private_nh);
+
+        /**
+         * \brief Sweep the servo bus and publish the servo state
+         * \param time The current time
+         */
+        void update(const ros::Time &time);
+
+        /**
+         * \brief The sweep period [s]
+         */
+        double getPeriod() const;
+
+        /**
+         * \brief The schedule of the reads in each sweep
+         */
+        const LX16ABusSchedule& getSchedule() const;
+
+        /**
+         * \brief Number of sweeps since start
+         */
+        uint64_t getSweeps() const;
+
+        /**
+         * \brief Number of position reads that failed since start
+         */
+        uint64_t getReadFailures() const;
+
+        /**
+         * \brief Mean time taken by a sweep since start [s]
+         */
+        double getMeanSweepTime() const;
+
+    private:
+        /**
+         * \brief Build the schedule of reads
+         * \param ids        The servo ids
+         * \param private_nh Node handle for the parameters
+         */
+        bool initSchedule(const std::vector<int> &ids, ros::NodeHandle &private_nh);
+
+        std::string name_;
+
+        // Servo bus
+        LX16ADriver servo_driver_;
+        double response_timeout_;
+
+        // Schedule of the reads, with the servo index of each task
+        LX16ABusSchedule schedule_;
+        std::vector<size_t> task_servo_;
+
+        // Queries and replies of one sweep
+        std::vector<LX16AQuery> queries_;
+        std::vector<LX16AReply> replies_;
+        size_t num_servos_;
+
+        // Statistics
+        uint64_t sweeps_;
+        uint64_t read_failures_;
+        double total_sweep_time_;
+
+        // Publisher and preallocated message
+        ros::Publisher sweep_pub_;
+        LX16ASweep sweep_msg_;
+    };
+
+} // namespace curio_base
+
+#endif // CURIO_BASE_LX16A_STATE_PUBLISHER_H_
@@ -0,0 +1,214 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#ifndef CURIO_BASE_REALTIME_FAILSAFE_H_
+#define CURIO_BASE_REALTIME_FAILSAFE_H_
+
+#include <ros/ros.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace curio_base
+{
+    /**
+     * \brief Failsafe checks run every cycle of the control loop.
+     *
+     * Replaces the polling base_failsafe node for the C++ base. The
+     * hardware interface reports each cycle's inputs: the loop period,
+     * which servos answered their position read, supply voltage reads and
+     * whether the wheels are being driven. Commands are stamped as they
+     * arrive on the subscriber threads. When any check fails the failsafe
+     * trips and stays tripped, with the faults that tripped it, until a
+     * reset is requested and the next cycle finds no fault.
+     *
+     * The checks do no I/O and do not allocate, the hardware interface
+     * performs the stop.
+     */
+    class RealtimeFailsafe
+    {
+    public:
+        enum Fault
+        {
+            FAULT_COMMAND_TIMEOUT = 1 << 0,  ///< The wheels are driven but no command arrived
+            FAULT_SERVO_RESPONSE  = 1 << 1,  ///< A servo failed to answer consecutive reads
+            FAULT_LOW_VOLTAGE     = 1 << 2,  ///< The supply voltage is below the minimum
+            FAULT_OVERRUN         = 1 << 3   ///< Consecutive control cycles overran
+        };
+
+        struct Params
+        {
+            /// Trip if the wheels are driven and the last command is older than this, 0 to disable [s]
+            double command_timeout;
+
+            /// Trip after this many consecutive failed reads of a servo, 0 to disable
+            int max_read_failures;
+
+            /// Trip if the supply voltage is below this, 0 to disable [mV]
+            int min_vin;
+
+            /// Trip after this many consecutive cycles longer than max_cycle_time, 0 to disable
+            int max_overruns;
+
+            /// A cycle longer than this is an overrun [s]
+            double max_cycle_time;
+
+            Params() :
+                command_timeout(2.0),
+                max_read_failures(5),
+                min_vin(6500),
+                max_overruns(3),
+                max_cycle_time(0.2)
+            {
+            }
+        };
+
+        RealtimeFailsafe();
+
+        /**
+         * \brief Set the parameters and clear the state
+         * \param params     The failsafe limits
+         * \param num_servos Number of servos with response checks
+         */
+        void configure(const Params& params, size_t num_servos);
+
+        /**
+         * \brief Stamp the arrival of a command. Thread safe.
+         * \param time Arrival time, or the end of a command trajectory
+         */
+        void commandReceived(const ros::Time& time);
+
+        /**
+         * \brief Record the result of a servo read
+         * \param index     Index of the servo
+         * \param responded True if the servo answered
+         */
+        void servoRead(size_t index, bool responded);
+
+        /**
+         * \brief Record a supply voltage read
+         * \param vin Supply voltage [mV], negative if the read failed
+         */
+        void vinRead(int vin);
+
+        /**
+         * \brief Check the command freshness and loop timing for this cycle
+         * and apply a pending reset
+         * \param time    Current time
+         * \param period  Time since the last cycle
+         * \param driving True if any wheel is commanded to move
+         * \return true if the failsafe is tripped and the base must stop
+         */
+        bool update(const ros::Time& time, const ros::Duration& period, bool driving);
+
+        /**
+         * \brief Request a reset, applied on the next cycle. Thread safe.
+         */
+        void requestReset();
+
+        /**
+         * \brief True if the failsafe is tripped. Thread safe.
+         */
+        bool isTripped() const
+        {
+            return faults_.load(std::memory_order_acquire) != 0;
+        }
+
+        /**
+         * \brief The faults that tripped the failsafe, 0 if not tripped. Thread safe.
+         */
+        uint32_t getFaults() const
+        {
+            return faults_.load(std::memory_order_acquire);
+        }
+
+        /**
+         * \brief Number of times the failsafe has tripped. Thread safe.
+         */
+        uint64_t getTrips() const
+        {
+            return trips_.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief Last supply voltage read [mV], -1 if none
+         */
+        int getVin() const
+        {
+            return vin_.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief Describe a set of faults
+         */
+        static std::string toString(uint32_t faults);
+
+    private:
+        /**
+         * \brief Latch a fault
+         */
+        void trip(uint32_t fault);
+
+        Params params_;
+
+        /// Last command arrival [ns]
+        std::atomic<int64_t> last_command_ns_;
+
+        /// Consecutive failed reads of each servo
+        std::vector<int> read_failures_;
+
+        /// Consecutive overrunning cycles
+        int overruns_;
+
+        /// Faults found since the last update
+        uint32_t pending_;
+
+        std::atomic<uint32_t> faults_;
+        std::atomic<bool> reset_requested_;
+        std::atomic<uint64_t> trips_;
+        std::atomic<int> vin_;
+    };
+
+} // namespace curio_base
+
+#endif // CURIO_BASE_REALTIME_FAILSAFE_H_
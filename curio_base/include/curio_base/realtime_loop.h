@@ -0,0 +1,162 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#ifndef CURIO_BASE_REALTIME_LOOP_H_
+#define CURIO_BASE_REALTIME_LOOP_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <time.h>
+
+namespace curio_base
+{
+    /**
+     * \brief A fixed rate loop runner with absolute deadlines.
+     *
+     * Each cycle sleeps with clock_nanosleep until an absolute
+     * CLOCK_MONOTONIC deadline, so the time spent in the loop body does
+     * not accumulate as drift. A cycle that finishes after its deadline
+     * is counted as an overrun and the missed deadlines are skipped.
+     *
+     * The calling thread can optionally be given a SCHED_FIFO priority
+     * and pinned to a CPU, and the process memory locked with the stack
+     * prefaulted to avoid page faults in the loop.
+     */
+    class RealtimeLoop
+    {
+    public:
+        /**
+         * \brief Constructor
+         * \param frequency The loop frequency [Hz]
+         */
+        explicit RealtimeLoop(double frequency);
+
+        /**
+         * \brief Set the SCHED_FIFO priority (0 to leave the scheduler unchanged)
+         */
+        void setPriority(int priority);
+
+        /**
+         * \brief Set the CPU to run on (-1 to leave the affinity unchanged)
+         */
+        void setCpu(int cpu);
+
+        /**
+         * \brief Lock current and future memory with mlockall
+         */
+        void setLockMemory(bool lock_memory);
+
+        /**
+         * \brief Set the size of stack to prefault (0 to disable) [bytes]
+         */
+        void setPrefaultStackSize(size_t size);
+
+        /**
+         * \brief Apply the scheduling and memory settings to the calling thread.
+         *
+         * Must be called from the thread that runs the loop. Settings that
+         * cannot be applied (usually for lack of privileges) are reported
+         * and skipped.
+         *
+         * \return true if all requested settings were applied
+         */
+        bool configure();
+
+        /**
+         * \brief Start timing, the first deadline is one period from now
+         */
+        void start();
+
+        /**
+         * \brief Sleep until the next deadline
+         * \return The measured time since the previous wake up [s]
+         */
+        double sleep();
+
+        /**
+         * \brief The nominal loop period [s]
+         */
+        double getPeriod() const;
+
+        /**
+         * \brief Number of completed cycles
+         */
+        uint64_t getCycles() const;
+
+        /**
+         * \brief Number of cycles that finished after their deadline
+         */
+        uint64_t getOverruns() const;
+
+        /**
+         * \brief Number of deadlines skipped because of overruns
+         */
+        uint64_t getMissedDeadlines() const;
+
+        /**
+         * \brief Largest lateness of a wake up relative to its deadline [s]
+         */
+        double getMaxLatency() const;
+
+    private:
+        /**
+         * \brief Touch the stack so its pages are mapped before the loop runs
+         */
+        static void prefaultStack(size_t size);
+
+        int64_t period_ns_;
+        int priority_;
+        int cpu_;
+        bool lock_memory_;
+        size_t prefault_stack_size_;
+
+        struct timespec deadline_;
+        int64_t last_wake_ns_;
+        int64_t max_latency_ns_;
+        uint64_t cycles_;
+        uint64_t overruns_;
+        uint64_t missed_deadlines_;
+    };
+
+} // namespace curio_base
+
+#endif // CURIO_BASE_REALTIME_LOOP_H_
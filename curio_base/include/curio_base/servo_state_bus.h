@@ -0,0 +1,203 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#ifndef CURIO_BASE_SERVO_STATE_BUS_H_
+#define CURIO_BASE_SERVO_STATE_BUS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace curio_base
+{
+    /**
+     * \brief Servo and joint state of one control cycle.
+     */
+    struct ServoState
+    {
+        static const size_t NUM_WHEELS = 6;
+        static const size_t NUM_STEERS = 4;
+
+        uint64_t cycle;                             ///< Control cycle number
+        uint64_t stamp_ns;                          ///< CLOCK_MONOTONIC when written [ns]
+        int64_t ros_stamp_ns;                       ///< ROS time of the cycle [ns]
+
+        double wheel_position[NUM_WHEELS];          ///< Wheel joint position [rad]
+        double wheel_velocity[NUM_WHEELS];          ///< Wheel joint velocity [rad/s]
+        double steer_position[NUM_STEERS];          ///< Steering joint position [rad]
+
+        int16_t wheel_servo_position[NUM_WHEELS];   ///< Last position read, -1 if the read failed
+        int16_t wheel_duty[NUM_WHEELS];             ///< Wheel servo duty sent [-1000, 1000]
+        int16_t steer_servo_position[NUM_STEERS];   ///< Steering servo position sent [0, 1000]
+
+        uint32_t wheel_responding;                  ///< Bit i set if wheel servo i answered this cycle
+        int32_t vin;                                ///< Last supply voltage read [mV], -1 if none
+        uint32_t failsafe_faults;                   ///< RealtimeFailsafe faults, 0 if not tripped
+        uint64_t read_failures;                     ///< Total failed servo reads
+    };
+
+    static_assert(std::is_trivially_copyable<ServoState>::value,
+        "ServoState must be trivially copyable");
+
+    /**
+     * \brief Share the servo state of each control cycle with local processes.
+     *
+     * The hardware interface creates a file (usually on /dev/shm) and
+     * writes the state at the end of every cycle. Any number of readers
+     * map the file read only and take the latest state, or follow an
+     * optional ring of recent states, without system calls or ROS
+     * serialisation. The latest state is guarded by a sequence lock and
+     * each ring slot has its own sequence number, so a reader retries if
+     * it raced the writer and can never block the control loop.
+     *
+     * There must be a single writer. A restarted writer replaces the file,
+     * so readers should reopen it if the cycle stops advancing.
+     */
+    class ServoStateBus
+    {
+    public:
+        /// Number of states in the history ring, must be a power of two
+        static const uint32_t HISTORY = 256;
+
+        static const uint32_t VERSION = 1;
+
+        ServoStateBus();
+
+        ~ServoStateBus();
+
+        ServoStateBus(const ServoStateBus&) = delete;
+        ServoStateBus& operator=(const ServoStateBus&) = delete;
+
+        /**
+         * \brief Create or reset the file and map it for writing
+         * \param path    File name, e.g. /dev/shm/curio_servo_state
+         * \param history Also append each state to the history ring
+         * \return false if the file could not be created or mapped
+         */
+        bool create(const std::string& path, bool history);
+
+        /**
+         * \brief Map an existing file for reading
+         * \param path File name
+         * \return false if the file does not exist or has another layout
+         */
+        bool open(const std::string& path);
+
+        /**
+         * \brief Unmap the file
+         */
+        void close();
+
+        bool isOpen() const
+        {
+            return file_ != nullptr;
+        }
+
+        /**
+         * \brief Publish a state, stamping it with the monotonic clock.
+         * Realtime safe, writer only.
+         */
+        void write(ServoState& state);
+
+        /**
+         * \brief Copy the latest state
+         * \param [out] state The latest state
+         * \return false if nothing has been written or the writer kept
+         *         updating the state while it was read
+         */
+        bool readLatest(ServoState& state) const;
+
+        /**
+         * \brief True if the writer appends to the history ring
+         */
+        bool hasHistory() const;
+
+        /**
+         * \brief Number of states appended to the history ring
+         */
+        uint64_t head() const;
+
+        /**
+         * \brief Copy a state from the history ring
+         * \param index The state number, less than head()
+         * \param [out] state The state
+         * \return false if the state is still being written or has
+         *         been overwritten
+         */
+        bool readHistory(uint64_t index, ServoState& state) const;
+
+    private:
+        /// The state is copied in 64 bit words so every access is atomic
+        static const size_t WORDS = (sizeof(ServoState) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+        struct Slot
+        {
+            /// Odd while being written, see ServoStateBus::write
+            std::atomic<uint64_t> sequence;
+            std::atomic<uint64_t> words[WORDS];
+        };
+
+        struct File
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t history;
+            uint32_t state_size;
+            uint32_t reserved;
+            std::atomic<uint64_t> head;
+
+            Slot latest;
+            Slot slots[HISTORY];
+        };
+
+        static void store(Slot& slot, const ServoState& state);
+
+        static void load(const Slot& slot, ServoState& state);
+
+        File* file_;
+        bool writer_;
+        bool history_;
+    };
+
+} // namespace curio_base
+
+#endif // CURIO_BASE_SERVO_STATE_BUS_H_
@@ -0,0 +1,175 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#ifndef CURIO_BASE_SIM_HARDWARE_H_
+#define CURIO_BASE_SIM_HARDWARE_H_
+
+#include "curio_base/lx16a_encoder_filter.h"
+
+#include <hardware_interface/joint_command_interface.h>
+#include <hardware_interface/joint_state_interface.h>
+#include <hardware_interface/robot_hw.h>
+#include <ros/ros.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace curio_base
+{
+    /**
+     * \brief A kinematic simulation of the Curio mobile base.
+     *
+     * Provides the same joints and interfaces as BaseHardware. Wheel
+     * positions are integrated from the commanded velocities and the
+     * steering joints track their commanded angles, with optional:
+     *
+     * - first order lag on the wheel velocity (servo response),
+     * - a rate limit on the steering joints,
+     * - encoder dead-zone noise: wheel positions are converted to LX-16A
+     *   servo readings, which are random in the invalid band, and passed
+     *   through an LX16AEncoderFilter.
+     *
+     * The ground truth pose of the base is integrated from the actual
+     * mid wheel velocities for comparison with the controller odometry.
+     * The simulation advances in write(), so it can be run at any rate.
+     */
+    class SimHardware : public hardware_interface::RobotHW
+    {
+    public:
+        static const size_t NUM_WHEELS = 6;
+        static const size_t NUM_STEERS = 4;
+
+        SimHardware();
+
+        /**
+         * \brief Load parameters and register the joints
+         * \param root_nh      Node handle at root namespace
+         * \param robot_hw_nh  Node handle in the hardware namespace
+         */
+        virtual bool init(ros::NodeHandle& root_nh, ros::NodeHandle& robot_hw_nh);
+
+        /**
+         * \brief Update the joint states from the simulation
+         * \param time   Current time
+         * \param period Time since the last call to read
+         */
+        virtual void read(const ros::Time& time, const ros::Duration& period);
+
+        /**
+         * \brief Apply the joint commands and advance the simulation by period
+         * \param time   Current time
+         * \param period Time step
+         */
+        virtual void write(const ros::Time& time, const ros::Duration& period);
+
+        /**
+         * \brief Ground truth x position of the base [m]
+         */
+        double getX() const;
+
+        /**
+         * \brief Ground truth y position of the base [m]
+         */
+        double getY() const;
+
+        /**
+         * \brief Ground truth heading of the base [rad]
+         */
+        double getHeading() const;
+
+        /**
+         * \brief Ground truth distance travelled by the base [m]
+         */
+        double getDistance() const;
+
+        /**
+         * \brief Number of encoder readings rejected by the encoder filters
+         */
+        uint64_t getRejectedReadings() const;
+
+    private:
+        std::string name_;
+
+        /// Geometry
+        double wheel_radius_;
+        double mid_wheel_lat_separation_;
+        size_t mid_left_index_;
+        size_t mid_right_index_;
+
+        /// Simulation options
+        double wheel_lag_;           ///< Wheel velocity time constant, 0 to disable [s]
+        double steer_rate_limit_;    ///< Steering rate limit, 0 to disable [rad/s]
+        bool encoder_noise_;         ///< Simulate the encoder dead zone
+
+        /// Hardware interfaces
+        hardware_interface::JointStateInterface joint_state_interface_;
+        hardware_interface::VelocityJointInterface vel_joint_interface_;
+        hardware_interface::PositionJointInterface pos_joint_interface_;
+
+        /// Joint state and commands
+        double wheel_pos_[NUM_WHEELS];
+        double wheel_vel_[NUM_WHEELS];
+        double wheel_eff_[NUM_WHEELS];
+        double wheel_cmd_[NUM_WHEELS];
+        double steer_pos_[NUM_STEERS];
+        double steer_vel_[NUM_STEERS];
+        double steer_eff_[NUM_STEERS];
+        double steer_cmd_[NUM_STEERS];
+
+        /// Simulation state
+        double wheel_true_pos_[NUM_WHEELS];
+        double wheel_true_vel_[NUM_WHEELS];
+        int encoder_offset_[NUM_WHEELS];
+        std::vector<LX16AEncoderFilter> encoder_filters_;
+        std::mt19937 rng_;
+        uint64_t rejected_readings_;
+
+        /// Ground truth pose
+        double x_;
+        double y_;
+        double heading_;
+        double distance_;
+    };
+
+} // namespace curio_base
+
+#endif // CURIO_BASE_SIM_HARDWARE_H_
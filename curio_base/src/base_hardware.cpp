@@ -0,0 +1,932 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#include "curio_base/base_hardware.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+namespace curio_base
+{
+    namespace
+    {
+        /// Servo modes for LX16ADriver::setMode
+        const uint8_t SERVO_MODE = 0;
+        const uint8_t MOTOR_MODE = 1;
+
+        /// Linear map of x from [in_min, in_max] to [out_min, out_max]
+        double map(double x, double in_min, double in_max, double out_min, double out_max)
+        {
+            return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+        }
+
+        double clamp(double x, double lower, double upper)
+        {
+            return std::min(std::max(x, lower), upper);
+        }
+
+        /// Decode a number as ControllerParams does, integer literals in yaml are loaded as ints
+        bool toDouble(XmlRpc::XmlRpcValue& v, double& value)
+        {
+            if (v.getType() == XmlRpc::XmlRpcValue::TypeDouble)
+                value = static_cast<double&>(v);
+            else if (v.getType() == XmlRpc::XmlRpcValue::TypeInt)
+                value = static_cast<int&>(v);
+            else
+                return false;
+            return true;
+        }
+    } // namespace
+
+    static_assert(ServoState::NUM_WHEELS == BaseHardware::NUM_WHEELS
+        && ServoState::NUM_STEERS == BaseHardware::NUM_STEERS,
+        "ServoState must hold every servo of the base");
+
+    constexpr double BaseHardware::SERVO_ANG_VEL_MAX;
+    constexpr double BaseHardware::SERVO_DUTY_MAX;
+    constexpr double BaseHardware::REVERSE_SERVO_ANGLE;
+    constexpr double BaseHardware::SERVO_ANGLE_MAX;
+    constexpr double BaseHardware::SERVO_POS_MIN;
+    constexpr double BaseHardware::SERVO_POS_MAX;
+
+    BaseHardware::BaseHardware() :
+        name_("base_hardware"),
+        encoder_snapshot_record_(),
+        steer_move_time_(50),
+        command_refresh_cycles_(50),
+        cycles_since_refresh_(0),
+        read_failures_(0),
+        state_record_(),
+        wheel_responding_(0),
+        failsafe_enabled_(false),
+        safe_stopped_(false),
+        failsafe_reported_(0),
+        vin_read_cycles_(0),
+        bus_cycle_(0),
+        read_bus_time_(0.0),
+        last_trace_id_(0)
+    {
+        std::fill(wheel_pos_, wheel_pos_ + NUM_WHEELS, 0.0);
+        std::fill(wheel_vel_, wheel_vel_ + NUM_WHEELS, 0.0);
+        std::fill(wheel_eff_, wheel_eff_ + NUM_WHEELS, 0.0);
+        std::fill(wheel_cmd_, wheel_cmd_ + NUM_WHEELS, 0.0);
+        std::fill(steer_pos_, steer_pos_ + NUM_STEERS, 0.0);
+        std::fill(steer_vel_, steer_vel_ + NUM_STEERS, 0.0);
+        std::fill(steer_eff_, steer_eff_ + NUM_STEERS, 0.0);
+        std::fill(steer_cmd_, steer_cmd_ + NUM_STEERS, 0.0);
+        std::fill(wheel_duty_, wheel_duty_ + NUM_WHEELS, 0);
+        std::fill(steer_servo_pos_, steer_servo_pos_ + NUM_STEERS, -1);
+        std::fill(wheel_servo_read_, wheel_servo_read_ + NUM_WHEELS, -1);
+    }
+
+    BaseHardware::~BaseHardware()
+    {
+        if (servo_driver_.isOpen())
+        {
+            stop();
+        }
+    }
+
+    bool BaseHardware::init(ros::NodeHandle& root_nh, ros::NodeHandle& robot_hw_nh)
+    {
+        // Servo configuration
+        if (!loadServos(robot_hw_nh, "wheel", NUM_WHEELS, false, wheel_servos_)
+            || !loadServos(robot_hw_nh, "steer", NUM_STEERS, true, steer_servos_))
+        {
+            return false;
+        }
+
+        // Wheels on the right side of the base are reversed,
+        // all steering servos are reversed.
+        for (auto& servo : wheel_servos_)
+        {
+            servo.orientation = servo.lat_label == "left" ? 1 : -1;
+        }
+        for (auto& servo : steer_servos_)
+        {
+            servo.orientation = -1;
+        }
+
+        robot_hw_nh.param("steer_move_time", steer_move_time_, steer_move_time_);
+        robot_hw_nh.param("command_refresh_cycles", command_refresh_cycles_, command_refresh_cycles_);
+
+        int max_delta = 300;
+        int max_rejections = 3;
+        robot_hw_nh.param("encoder_max_delta", max_delta, max_delta);
+        robot_hw_nh.param("encoder_max_rejections", max_rejections, max_rejections);
+
+        // LX-16A servo driver - port, baudrate and timeout are required
+        std::string port;
+        int baudrate = 0;
+        double timeout = 0.0;
+        if (!robot_hw_nh.getParam("port", port)
+            || !robot_hw_nh.getParam("baudrate", baudrate)
+            || !robot_hw_nh.getParam("timeout", timeout))
+        {
+            ROS_ERROR_STREAM_NAMED(name_, "Parameters 'port', 'baudrate' and 'timeout' are required.");
+            return false;
+        }
+
+        ROS_INFO_STREAM_NAMED(name_, "Opening connection to servo bus board...");
+        try
+        {
+            servo_driver_.setPort(port);
+            servo_driver_.setBaudrate(baudrate);
+            servo_driver_.setTimeout(static_cast<uint32_t>(timeout * 1000.0));
+            servo_driver_.open();
+        }
+        catch (const std::exception& e)
+        {
+            ROS_ERROR_STREAM_NAMED(name_, "Failed to open servo bus on " << port << ": " << e.what());
+            return false;
+        }
+        ROS_INFO_STREAM_NAMED(name_, "port: " << servo_driver_.getPort());
+        ROS_INFO_STREAM_NAMED(name_, "baudrate: " << servo_driver_.getBaudrate());
+        ROS_INFO_STREAM_NAMED(name_, "is_open: " << servo_driver_.isOpen());
+
+        // Optional capture of the servo bus traffic for lx16a_capture_decode
+        std::string bus_capture;
+        robot_hw_nh.param("bus_capture", bus_capture, bus_capture);
+        if (!bus_capture.empty() && servo_driver_.startCapture(bus_capture))
+        {
+            ROS_INFO_STREAM_NAMED(name_, "Capturing servo bus traffic to " << bus_capture);
+        }
+
+        // Optional command latency tracing, shared with the controller
+        std::string latency_trace;
+        robot_hw_nh.param("latency_trace", latency_trace, latency_trace);
+        if (!latency_trace.empty() && latency_trace_.open(latency_trace))
+        {
+            ROS_INFO_STREAM_NAMED(name_, "Tracing command latency to " << latency_trace);
+        }
+
+        // Optional servo state bus for local readers (logging, diagnostics)
+        std::string state_bus;
+        bool state_bus_history = true;
+        robot_hw_nh.param("state_bus", state_bus, state_bus);
+        robot_hw_nh.param("state_bus_history", state_bus_history, state_bus_history);
+        if (!state_bus.empty() && state_bus_.create(state_bus, state_bus_history))
+        {
+            ROS_INFO_STREAM_NAMED(name_, "Sharing servo state on " << state_bus
+                << (state_bus_history ? " with history" : ""));
+        }
+
+        // Configure all servos in one batch: the steering offsets centre the
+        // corner wheels, the wheels are stopped in motor mode. The read back
+        // wheel positions reset the encoders.
+        double response_timeout = 0.01;
+        robot_hw_nh.param("startup_response_timeout", response_timeout, response_timeout);
+
+        std::vector<LX16AServoSetup> setup(NUM_WHEELS + NUM_STEERS);
+        for (size_t i = 0; i < NUM_WHEELS; ++i)
+        {
+            setup[i].id = wheel_servos_[i].id;
+            setup[i].mode = MOTOR_MODE;
+            setup[i].duty = 0;
+            wheel_duty_[i] = 0;
+            wheel_cmd_[i] = 0.0;
+        }
+        for (size_t i = 0; i < NUM_STEERS; ++i)
+        {
+            LX16AServoSetup& s = setup[NUM_WHEELS + i];
+            s.id = steer_servos_[i].id;
+            s.mode = SERVO_MODE;
+            s.set_offset = true;
+            s.offset = static_cast<int8_t>(steer_servos_[i].offset);
+        }
+
+        const ros::WallTime setup_start = ros::WallTime::now();
+        std::vector<LX16AServoStatus> status;
+        const bool verified = servo_driver_.setup(setup, response_timeout, 2, status);
+        const double setup_ms = (ros::WallTime::now() - setup_start).toSec() * 1000.0;
+
+        // Resume the encoder counts from the last snapshot if it is recent
+        std::string encoder_snapshot;
+        double encoder_snapshot_max_age = 60.0;
+        robot_hw_nh.param("encoder_snapshot", encoder_snapshot, encoder_snapshot);
+        robot_hw_nh.param("encoder_snapshot_max_age", encoder_snapshot_max_age, encoder_snapshot_max_age);
+        bool resume = false;
+        if (!encoder_snapshot.empty() && encoder_snapshot_.open(encoder_snapshot, "LX16AENC"))
+        {
+            double age = 0.0;
+            resume = encoder_snapshot_.read(encoder_snapshot_record_, encoder_snapshot_max_age, age);
+            if (resume)
+            {
+                ROS_INFO_STREAM_NAMED(name_, "Resuming encoder counts from snapshot "
+                    << encoder_snapshot << " (age " << age << " s)");
+            }
+            else
+            {
+                ROS_INFO_STREAM_NAMED(name_, "No recent encoder snapshot in " << encoder_snapshot);
+            }
+        }
+
+        encoder_filters_.assign(NUM_WHEELS, LX16AEncoderFilter(max_delta, max_rejections));
+        std::vector<size_t> unread_wheels;
+        for (size_t i = 0; i < NUM_WHEELS; ++i)
+        {
+            LX16AEncoderFilter& filter = encoder_filters_[i];
+            filter.setInvert(wheel_servos_[i].orientation < 0);
+            if (resume)
+            {
+                // Assume a wheel that did not answer has not moved
+                const EncoderSnapshot& s = encoder_snapshot_record_;
+                const int pos = status[i].position != -1 ? status[i].position : s.last_valid_pos[i];
+                if (!filter.restore(s.count_offset[i], s.revolutions[i], s.last_valid_pos[i], pos))
+                {
+                    ROS_WARN_STREAM_NAMED(name_, "Servo: " << int(wheel_servos_[i].id)
+                        << " moved since the encoder snapshot, revolutions may be lost");
+                }
+            }
+            else
+            {
+                filter.reset(status[i].position);
+                if (status[i].position == -1)
+                {
+                    unread_wheels.push_back(i);
+                }
+            }
+            wheel_pos_[i] = filter.getAngularPosition();
+            wheel_vel_[i] = 0.0;
+        }
+
+        std::ostringstream failed;
+        for (size_t i = 0; i < setup.size(); ++i)
+        {
+            if (!status[i].verified)
+            {
+                failed << " " << int(setup[i].id)
+                    << (status[i].responding ? "" : " (no response)");
+            }
+        }
+        if (verified)
+        {
+            ROS_INFO_STREAM_NAMED(name_, "Configured " << setup.size()
+                << " servos in " << setup_ms << " ms");
+        }
+        else
+        {
+            ROS_WARN_STREAM_NAMED(name_, "Configured " << setup.size()
+                << " servos in " << setup_ms << " ms, failed to verify:" << failed.str());
+        }
+
+        // Fall back to the slow path for the wheels whose position was not read
+        if (!unread_wheels.empty())
+        {
+            resetEncoders(unread_wheels);
+        }
+
+        // Register joints
+        for (size_t i = 0; i < NUM_WHEELS; ++i)
+        {
+            const Servo& servo = wheel_servos_[i];
+            const std::string joint_name = servo.lon_label + "_" + servo.lat_label + "_wheel_joint";
+            ROS_INFO_STREAM_NAMED(name_, "Adding wheel joint: " << joint_name << ", id: " << int(servo.id));
+
+            hardware_interface::JointStateHandle state_handle(joint_name,
+                &wheel_pos_[i], &wheel_vel_[i], &wheel_eff_[i]);
+            joint_state_interface_.registerHandle(state_handle);
+            vel_joint_interface_.registerHandle(
+                hardware_interface::JointHandle(state_handle, &wheel_cmd_[i]));
+        }
+
+        for (size_t i = 0; i < NUM_STEERS; ++i)
+        {
+            const Servo& servo = steer_servos_[i];
+            const std::string joint_name = servo.lon_label + "_" + servo.lat_label + "_corner_joint";
+            ROS_INFO_STREAM_NAMED(name_, "Adding steer joint: " << joint_name << ", id: " << int(servo.id));
+
+            hardware_interface::JointStateHandle state_handle(joint_name,
+                &steer_pos_[i], &steer_vel_[i], &steer_eff_[i]);
+            joint_state_interface_.registerHandle(state_handle);
+            pos_joint_interface_.registerHandle(
+                hardware_interface::JointHandle(state_handle, &steer_cmd_[i]));
+        }
+
+        registerInterface(&joint_state_interface_);
+        registerInterface(&vel_joint_interface_);
+        registerInterface(&pos_joint_interface_);
+
+        return initFailsafe(root_nh, robot_hw_nh) && initBusSchedule(robot_hw_nh);
+    }
+
+    void BaseHardware::read(const ros::Time& /*time*/, const ros::Duration& period)
+    {
+        const std::chrono::steady_clock::time_point read_start = std::chrono::steady_clock::now();
+        const double dt = period.toSec();
+        wheel_responding_ = 0;
+
+        // Run the reads scheduled in this cycle: the wheel positions every
+        // cycle and the supply voltage of one wheel servo at a time
+        const size_t count = bus_schedule_.getNumSlots(bus_cycle_);
+        for (size_t slot = 0; slot < count; ++slot)
+        {
+            const size_t index = bus_schedule_.getTaskIndex(bus_cycle_, slot);
+            const LX16ABusTask& task = bus_schedule_.getTasks()[index];
+            if (task.command == lx16a::VIN_READ)
+            {
+                const int vin = servo_driver_.readVin(task.id);
+                failsafe_.vinRead(vin >= 0 ? vin : -1);
+                continue;
+            }
+            if (task.command != lx16a::POS_READ)
+                continue;
+
+            // A failed read returns -1, which is also a (rare) valid reading
+            // in motor mode. Either way skipping the sample is harmless.
+            const size_t i = bus_task_wheel_[index];
+            const int pos = servo_driver_.readPosition(task.id);
+            wheel_servo_read_[i] = static_cast<int16_t>(pos);
+            wheel_responding_ |= pos != -1 ? (1u << i) : 0u;
+            if (failsafe_enabled_)
+            {
+                failsafe_.servoRead(i, pos != -1);
+            }
+            if (pos == -1)
+            {
+                ++read_failures_;
+                ROS_WARN_STREAM_THROTTLE_NAMED(1.0, name_, "Failed to read position for servo: "
+                    << int(task.id) << " (" << read_failures_ << " failures)");
+                continue;
+            }
+
+            LX16AEncoderFilter& filter = encoder_filters_[i];
+            filter.update(wheel_duty_[i], pos);
+            const double theta = filter.getAngularPosition();
+            wheel_vel_[i] = dt > 0.0 ? (theta - wheel_pos_[i]) / dt : 0.0;
+            wheel_pos_[i] = theta;
+        }
+        ++bus_cycle_;
+        read_bus_time_ = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - read_start).count();
+
+        if (encoder_snapshot_.isOpen())
+        {
+            for (size_t i = 0; i < NUM_WHEELS; ++i)
+            {
+                const LX16AEncoderFilter& filter = encoder_filters_[i];
+                encoder_snapshot_record_.count_offset[i] = filter.getCountOffset();
+                encoder_snapshot_record_.revolutions[i] = filter.getRevolutions();
+                encoder_snapshot_record_.last_valid_pos[i] = filter.getLastValidPos();
+            }
+            encoder_snapshot_.write(encoder_snapshot_record_);
+        }
+
+        // The steering servos hold position, so report the commanded
+        // angle rather than spend bus time reading it back.
+        for (size_t i = 0; i < NUM_STEERS; ++i)
+        {
+            steer_vel_[i] = dt > 0.0 ? (steer_cmd_[i] - steer_pos_[i]) / dt : 0.0;
+            steer_pos_[i] = steer_cmd_[i];
+        }
+    }
+
+    void BaseHardware::write(const ros::Time& time, const ros::Duration& period)
+    {
+        const std::chrono::steady_clock::time_point write_start = std::chrono::steady_clock::now();
+
+        // The command the controller last consumed, if traced
+        const uint64_t trace_id = latency_trace_.getConsumed();
+
+        // Unchanged commands are only resent periodically in case
+        // a servo missed a packet. This saves bus time for reads.
+        bool refresh = false;
+        if (++cycles_since_refresh_ >= command_refresh_cycles_)
+        {
+            cycles_since_refresh_ = 0;
+            refresh = true;
+        }
+
+        if (failsafe_enabled_)
+        {
+            bool driving = false;
+            for (size_t i = 0; i < NUM_WHEELS; ++i)
+            {
+                driving = driving || wheelDuty(wheel_cmd_[i], wheel_servos_[i].orientation) != 0;
+            }
+
+            const bool tripped = failsafe_.update(time, period, driving);
+            const uint32_t faults = failsafe_.getFaults();
+            if (faults != failsafe_reported_)
+            {
+                if (faults != 0)
+                {
+                    ROS_ERROR_STREAM_NAMED(name_, "Failsafe tripped: "
+                        << RealtimeFailsafe::toString(faults) << ". Stopping until reset.");
+                }
+                failsafe_reported_ = faults;
+            }
+
+            // Repeat the stop every cycle in case a servo missed it
+            if (tripped)
+            {
+                safeStop();
+                recordBusTime(write_start);
+                publishState(time);
+                return;
+            }
+            if (safe_stopped_)
+            {
+                recoverFromSafeStop();
+                refresh = true;
+            }
+        }
+
+        // Changed steering positions are staged and started together
+        // so the corners turn in step.
+        uint8_t ids[NUM_WHEELS];
+        int16_t values[NUM_WHEELS];
+        size_t count = 0;
+        for (size_t i = 0; i < NUM_STEERS; ++i)
+        {
+            const Servo& servo = steer_servos_[i];
+            const int16_t pos = steerPosition(steer_cmd_[i], servo.orientation);
+            if (refresh || pos != steer_servo_pos_[i])
+            {
+                ROS_DEBUG_STREAM_NAMED(name_, "id: " << int(servo.id) << ", servo_pos: " << pos);
+                ids[count] = servo.id;
+                values[count] = pos;
+                ++count;
+                steer_servo_pos_[i] = pos;
+            }
+        }
+        if (count > 0)
+        {
+            servo_driver_.moveGroup(ids, values, count, steer_move_time_);
+        }
+
+        // Changed wheel duties are sent in a single write
+        count = 0;
+        for (size_t i = 0; i < NUM_WHEELS; ++i)
+        {
+            const Servo& servo = wheel_servos_[i];
+            const int16_t duty = wheelDuty(wheel_cmd_[i], servo.orientation);
+            if (refresh || duty != wheel_duty_[i])
+            {
+                ROS_DEBUG_STREAM_NAMED(name_, "id: " << int(servo.id) << ", duty: " << duty);
+                ids[count] = servo.id;
+                values[count] = duty;
+                ++count;
+                wheel_duty_[i] = duty;
+            }
+        }
+        if (count > 0)
+        {
+            servo_driver_.setModeGroup(ids, MOTOR_MODE, values, count);
+        }
+
+        if (trace_id != last_trace_id_)
+        {
+            latency_trace_.record(trace_id, curio_realtime::LatencyTrace::STAGE_WRITE);
+            last_trace_id_ = trace_id;
+        }
+
+        recordBusTime(write_start);
+        publishState(time);
+    }
+
+    void BaseHardware::recordBusTime(const std::chrono::steady_clock::time_point& write_start)
+    {
+        const double bus_time = read_bus_time_ + std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - write_start).count();
+        if (bus_schedule_.recordCycle(bus_time) < 0.0)
+        {
+            ROS_WARN_STREAM_THROTTLE_NAMED(1.0, name_, "Servo bus time " << bus_time * 1.0E3
+                << " ms overran the control period (" << bus_schedule_.getOverruns()
+                << " overruns in " << bus_schedule_.getCycles() << " cycles)");
+        }
+    }
+
+    void BaseHardware::publishState(const ros::Time& time)
+    {
+        if (!state_bus_.isOpen())
+            return;
+
+        ServoState& s = state_record_;
+        s.cycle++;
+        s.ros_stamp_ns = static_cast<int64_t>(time.toNSec());
+        for (size_t i = 0; i < NUM_WHEELS; ++i)
+        {
+            s.wheel_position[i] = wheel_pos_[i];
+            s.wheel_velocity[i] = wheel_vel_[i];
+            s.wheel_servo_position[i] = wheel_servo_read_[i];
+            s.wheel_duty[i] = wheel_duty_[i];
+        }
+        for (size_t i = 0; i < NUM_STEERS; ++i)
+        {
+            s.steer_position[i] = steer_pos_[i];
+            s.steer_servo_position[i] = steer_servo_pos_[i];
+        }
+        s.wheel_responding = wheel_responding_;
+        s.vin = failsafe_.getVin();
+        s.failsafe_faults = failsafe_.getFaults();
+        s.read_failures = read_failures_;
+        state_bus_.write(s);
+    }
+
+    void BaseHardware::stop()
+    {
+        ROS_INFO_STREAM_NAMED(name_, "Servo bus: cycles: " << bus_schedule_.getCycles()
+            << ", overruns: " << bus_schedule_.getOverruns()
+            << ", min slack: " << bus_schedule_.getMinSlack() * 1.0E3 << " ms");
+        ROS_INFO_STREAM_NAMED(name_, "Stopping all servos");
+        uint8_t ids[NUM_WHEELS];
+        int16_t duties[NUM_WHEELS];
+        for (size_t i = 0; i < wheel_servos_.size(); ++i)
+        {
+            ids[i] = wheel_servos_[i].id;
+            duties[i] = 0;
+            wheel_duty_[i] = 0;
+            wheel_cmd_[i] = 0.0;
+        }
+        servo_driver_.setModeGroup(ids, MOTOR_MODE, duties, wheel_servos_.size());
+    }
+
+    bool BaseHardware::initFailsafe(ros::NodeHandle& root_nh, ros::NodeHandle& robot_hw_nh)
+    {
+        ros::NodeHandle failsafe_nh(robot_hw_nh, "failsafe");
+        failsafe_nh.param("enabled", failsafe_enabled_, failsafe_enabled_);
+        if (!failsafe_enabled_)
+        {
+            ROS_INFO_STREAM_NAMED(name_, "Failsafe is disabled");
+            return true;
+        }
+
+        RealtimeFailsafe::Params params;
+        failsafe_nh.param("command_timeout", params.command_timeout, params.command_timeout);
+        failsafe_nh.param("max_read_failures", params.max_read_failures, params.max_read_failures);
+        failsafe_nh.param("min_vin", params.min_vin, params.min_vin);
+        failsafe_nh.param("max_overruns", params.max_overruns, params.max_overruns);
+        failsafe_nh.param("max_cycle_time", params.max_cycle_time, params.max_cycle_time);
+        failsafe_nh.param("vin_read_cycles", vin_read_cycles_, 20);
+        if (params.command_timeout < 0.0 || params.max_read_failures < 0 || params.min_vin < 0
+            || params.max_overruns < 0 || params.max_cycle_time <= 0.0 || vin_read_cycles_ < 0)
+        {
+            ROS_ERROR_STREAM_NAMED(name_, "Failsafe limits must not be negative "
+                "and 'max_cycle_time' must be positive.");
+            return false;
+        }
+        failsafe_.configure(params, NUM_WHEELS);
+
+        // Commands are stamped on arrival. By default these are the
+        // controller's cmd_vel and the topics of its command sources.
+        std::string controller_name = "ackermann_drive_controller";
+        failsafe_nh.param("controller", controller_name, controller_name);
+        ros::NodeHandle controller_nh(root_nh, controller_name);
+
+        std::vector<std::string> command_topics;
+        command_topics.push_back(controller_nh.resolveName("cmd_vel"));
+        double max_command_timeout = 0.5;
+        controller_nh.param("cmd_vel_timeout", max_command_timeout, max_command_timeout);
+
+        XmlRpc::XmlRpcValue sources;
+        if (controller_nh.getParam("command_sources", sources)
+            && sources.getType() == XmlRpc::XmlRpcValue::TypeStruct)
+        {
+            for (auto& source : sources)
+            {
+                XmlRpc::XmlRpcValue& value = source.second;
+                if (value.getType() != XmlRpc::XmlRpcValue::TypeStruct)
+                    continue;
+                if (value.hasMember("topic")
+                    && value["topic"].getType() == XmlRpc::XmlRpcValue::TypeString)
+                {
+                    command_topics.push_back(controller_nh.resolveName(
+                        static_cast<std::string>(value["topic"])));
+                }
+                double timeout = 0.0;
+                if (value.hasMember("timeout") && toDouble(value["timeout"], timeout))
+                {
+                    max_command_timeout = std::max(max_command_timeout, timeout);
+                }
+            }
+        }
+        failsafe_nh.param("command_topics", command_topics, command_topics);
+        failsafe_command_subs_.clear();
+        for (const std::string& topic : command_topics)
+        {
+            failsafe_command_subs_.push_back(root_nh.subscribe(topic, 1,
+                &BaseHardware::failsafeCommandCallback, this));
+        }
+
+        // A command trajectory drives the wheels until its last point
+        failsafe_trajectory_sub_ = controller_nh.subscribe("cmd_vel_trajectory", 1,
+            &BaseHardware::failsafeTrajectoryCallback, this);
+
+        // The controller brakes when its commands time out, and the wheels
+        // are still driven while the limiter ramps them down
+        if (params.command_timeout > 0.0 && params.command_timeout <= max_command_timeout)
+        {
+            ROS_WARN_STREAM_NAMED(name_, "Failsafe 'command_timeout' " << params.command_timeout
+                << " s is not longer than the controller's command timeout " << max_command_timeout
+                << " s, stopping the rover will trip the failsafe.");
+        }
+
+        failsafe_reset_srv_ = robot_hw_nh.advertiseService("reset_failsafe",
+            &BaseHardware::resetFailsafeCallback, this);
+
+        ROS_INFO_STREAM_NAMED(name_, "Failsafe: command_timeout: " << params.command_timeout
+            << " s, max_read_failures: " << params.max_read_failures
+            << ", min_vin: " << params.min_vin
+            << " mV, max_overruns: " << params.max_overruns
+            << ", max_cycle_time: " << params.max_cycle_time << " s");
+        return true;
+    }
+
+    bool BaseHardware::initBusSchedule(ros::NodeHandle& robot_hw_nh)
+    {
+        ros::NodeHandle bus_nh(robot_hw_nh, "bus_budget");
+        double turnaround = 0.0;
+        LX16ABusSchedule::Params params;
+        bus_nh.param("enforce", params.enforce, params.enforce);
+        bus_nh.param("turnaround", turnaround, turnaround);
+        bus_nh.param("max_utilisation", params.max_utilisation, params.max_utilisation);
+        params.baudrate = servo_driver_.getBaudrate();
+
+        double control_frequency = 50.0;
+        robot_hw_nh.param("control_frequency", control_frequency, control_frequency);
+        if (control_frequency <= 0.0)
+        {
+            ROS_ERROR_STREAM_NAMED(name_, "Parameter 'control_frequency' must be positive.");
+            return false;
+        }
+        params.period = 1.0 / control_frequency;
+
+        // The turnaround is measured unless set
+        if (turnaround > 0.0)
+        {
+            params.turnaround = turnaround;
+        }
+        else
+        {
+            turnaround = LX16ABusSchedule::measureTurnaround(
+                servo_driver_, wheel_servos_[0].id, 20, 0.01);
+            if (turnaround >= 0.0)
+            {
+                params.turnaround = turnaround;
+            }
+            else
+            {
+                ROS_WARN_STREAM_NAMED(name_, "Servo " << static_cast<int>(wheel_servos_[0].id)
+                    << " did not reply, using the default bus turnaround");
+            }
+        }
+        ROS_INFO_STREAM_NAMED(name_, "Bus turnaround: " << params.turnaround * 1.0E3 << " ms");
+
+        // The traffic of a cycle when every command is written: the
+        // wheel positions are read, the steering moves are staged and
+        // started, the wheel duties are set and one supply voltage is
+        // read every vin_read_cycles. The reads are run from the schedule,
+        // the writes only when a command changes.
+        std::vector<LX16ABusTask> tasks;
+        bus_task_wheel_.clear();
+        for (size_t i = 0; i < NUM_WHEELS; ++i)
+        {
+            tasks.push_back(LX16ABusTask(wheel_servos_[i].id, lx16a::POS_READ, 0.0, 2));
+            bus_task_wheel_.push_back(i);
+        }
+        for (const Servo& servo : steer_servos_)
+        {
+            tasks.push_back(LX16ABusTask(servo.id, lx16a::MOVE_TIME_WAIT_WRITE, 0.0, 1));
+            bus_task_wheel_.push_back(NUM_WHEELS);
+        }
+        tasks.push_back(LX16ABusTask(lx16a::BROADCAST_ID, lx16a::MOVE_START, 0.0, 1));
+        bus_task_wheel_.push_back(NUM_WHEELS);
+        for (size_t i = 0; i < NUM_WHEELS; ++i)
+        {
+            tasks.push_back(LX16ABusTask(wheel_servos_[i].id, lx16a::OR_MOTOR_MODE_WRITE, 0.0, 1));
+            bus_task_wheel_.push_back(i);
+        }
+        if (failsafe_enabled_ && vin_read_cycles_ > 0)
+        {
+            const double vin_rate = control_frequency / (vin_read_cycles_ * NUM_WHEELS);
+            for (size_t i = 0; i < NUM_WHEELS; ++i)
+            {
+                tasks.push_back(LX16ABusTask(wheel_servos_[i].id, lx16a::VIN_READ, vin_rate, 0));
+                bus_task_wheel_.push_back(i);
+            }
+        }
+
+        std::string error;
+        const bool built = bus_schedule_.build(tasks, params, error);
+        if (built && error.empty())
+        {
+            ROS_INFO_STREAM_NAMED(name_, "Servo bus: " << bus_schedule_.toString());
+            return true;
+        }
+
+        const double min_period = LX16ABusSchedule::findMinPeriod(tasks, params);
+        std::ostringstream ss;
+        ss << "The servo bus traffic does not fit the control period: " << error;
+        if (min_period > 0.0)
+        {
+            ss << ". The highest control_frequency that fits is " << 1.0 / min_period << " Hz";
+        }
+        if (!built)
+        {
+            if (params.enforce)
+            {
+                ss << ". Set bus_budget/enforce to false to run anyway";
+            }
+            ROS_ERROR_STREAM_NAMED(name_, ss.str());
+            return false;
+        }
+        ROS_WARN_STREAM_NAMED(name_, ss.str() << ". The control loop may overrun.");
+        ROS_INFO_STREAM_NAMED(name_, "Servo bus: " << bus_schedule_.toString());
+        return true;
+    }
+
+    void BaseHardware::safeStop()
+    {
+        // The steering servos are also left in motor mode and go limp.
+        servo_driver_.broadcastStop();
+        std::fill(wheel_duty_, wheel_duty_ + NUM_WHEELS, 0);
+        safe_stopped_ = true;
+    }
+
+    void BaseHardware::recoverFromSafeStop()
+    {
+        ROS_INFO_STREAM_NAMED(name_, "Failsafe reset, resuming commands");
+        uint8_t ids[NUM_STEERS];
+        int16_t duties[NUM_STEERS];
+        for (size_t i = 0; i < NUM_STEERS; ++i)
+        {
+            ids[i] = steer_servos_[i].id;
+            duties[i] = 0;
+            steer_servo_pos_[i] = -1;
+        }
+        servo_driver_.setModeGroup(ids, SERVO_MODE, duties, NUM_STEERS);
+        safe_stopped_ = false;
+    }
+
+    void BaseHardware::failsafeCommandCallback(const geometry_msgs::Twist::ConstPtr& /*command*/)
+    {
+        failsafe_.commandReceived(ros::Time::now());
+    }
+
+    void BaseHardware::failsafeTrajectoryCallback(
+        const trajectory_msgs::MultiDOFJointTrajectory::ConstPtr& trajectory)
+    {
+        // The trajectory is fresh until its last point
+        const ros::Time now = ros::Time::now();
+        if (trajectory->points.empty())
+            return;
+
+        const ros::Time start = trajectory->header.stamp.isZero() ? now : trajectory->header.stamp;
+        failsafe_.commandReceived(std::max(now, start + trajectory->points.back().time_from_start));
+    }
+
+    bool BaseHardware::resetFailsafeCallback(std_srvs::Trigger::Request& /*req*/,
+        std_srvs::Trigger::Response& res)
+    {
+        const uint32_t faults = failsafe_.getFaults();
+        if (faults == 0)
+        {
+            res.success = true;
+            res.message = "Failsafe is not tripped";
+            return true;
+        }
+
+        // The faults are checked again before the servos are commanded
+        failsafe_.requestReset();
+        res.success = true;
+        res.message = "Reset failsafe tripped by: " + RealtimeFailsafe::toString(faults)
+            + ", last supply voltage: " + std::to_string(failsafe_.getVin()) + " mV";
+        ROS_INFO_STREAM_NAMED(name_, res.message);
+        return true;
+    }
+
+    int16_t BaseHardware::wheelDuty(double ang_vel, int orientation)
+    {
+        // Map speed to servo duty [-1000, 1000]
+        const double duty = map(ang_vel * orientation,
+            -SERVO_ANG_VEL_MAX, SERVO_ANG_VEL_MAX,
+            -SERVO_DUTY_MAX, SERVO_DUTY_MAX);
+        return static_cast<int16_t>(clamp(duty, -SERVO_DUTY_MAX, SERVO_DUTY_MAX));
+    }
+
+    int16_t BaseHardware::steerPosition(double angle, int orientation)
+    {
+        double angle_deg = angle * 180.0 / M_PI;
+
+        // Transition from turning radius outside the base footprint to inside
+        // (i.e in-place turning)
+        if (angle_deg > REVERSE_SERVO_ANGLE)
+            angle_deg -= 180.0;
+        if (angle_deg < -REVERSE_SERVO_ANGLE)
+            angle_deg += 180.0;
+
+        // Map steering angle degrees [-120, 120] to servo position [0, 1000]
+        const double pos = map(angle_deg * orientation,
+            -SERVO_ANGLE_MAX, SERVO_ANGLE_MAX,
+            SERVO_POS_MIN, SERVO_POS_MAX);
+        return static_cast<int16_t>(clamp(pos, SERVO_POS_MIN, SERVO_POS_MAX));
+    }
+
+    bool BaseHardware::loadServos(ros::NodeHandle& nh, const std::string& prefix,
+        size_t expected, bool load_offsets, std::vector<Servo>& servos)
+    {
+        std::vector<int> ids;
+        std::vector<std::string> lon_labels;
+        std::vector<std::string> lat_labels;
+        std::vector<int> offsets;
+
+        const std::string ids_param = prefix + "_servo_ids";
+        const std::string lon_param = prefix + "_servo_lon_labels";
+        const std::string lat_param = prefix + "_servo_lat_labels";
+        const std::string offsets_param = prefix + "_servo_angle_offsets";
+
+        if (!nh.getParam(ids_param, ids)
+            || !nh.getParam(lon_param, lon_labels)
+            || !nh.getParam(lat_param, lat_labels)
+            || (load_offsets && !nh.getParam(offsets_param, offsets)))
+        {
+            ROS_ERROR_STREAM_NAMED(name_, "Missing " << prefix << " servo parameters.");
+            return false;
+        }
+
+        if (ids.size() != expected || lon_labels.size() != expected
+            || lat_labels.size() != expected
+            || (load_offsets && offsets.size() != expected))
+        {
+            ROS_ERROR_STREAM_NAMED(name_, "Parameters " << prefix
+                << "_servo_* must have length: " << expected);
+            return false;
+        }
+
+        servos.resize(expected);
+        for (size_t i = 0; i < expected; ++i)
+        {
+            Servo& servo = servos[i];
+            servo.id = static_cast<uint8_t>(ids[i]);
+            servo.lon_label = lon_labels[i];
+            servo.lat_label = lat_labels[i];
+            servo.offset = load_offsets ? offsets[i] : 0;
+            ROS_INFO_STREAM_NAMED(name_, "servo: id: " << ids[i]
+                << ", lon_label: " << servo.lon_label
+                << ", lat_label: " << servo.lat_label
+                << ", offset: " << servo.offset);
+        }
+        return true;
+    }
+
+    void BaseHardware::resetEncoders(const std::vector<size_t>& wheels)
+    {
+        for (size_t i : wheels)
+        {
+            int pos = -1;
+            for (int attempt = 0; attempt < 3 && pos == -1; ++attempt)
+            {
+                pos = servo_driver_.readPosition(wheel_servos_[i].id);
+            }
+            if (pos == -1)
+            {
+                ROS_WARN_STREAM_NAMED(name_, "Failed to read position for servo: "
+                    << int(wheel_servos_[i].id) << " while resetting encoders");
+            }
+            encoder_filters_[i].reset(pos);
+            wheel_pos_[i] = 0.0;
+            wheel_vel_[i] = 0.0;
+        }
+    }
+
+} // namespace curio_base
@@ -0,0 +1,158 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#include "curio_base/base_hardware.h"
+#include "curio_base/realtime_loop.h"
+
+#include <controller_manager/controller_manager.h>
+#include <curio_realtime/realtime_guard.h>
+#include <ros/ros.h>
+
+#include <algorithm>
+
+#include <unistd.h>
+
+using curio_realtime::RealtimeGuard;
+
+int main(int argc, char *argv[])
+{
+    // Initialise node.
+    ros::init(argc, argv, "curio_base_hardware");
+    ros::NodeHandle nh, private_nh("~");
+    ROS_INFO("Starting Curio base hardware");
+
+    // Service the controller_manager and controller callbacks
+    // on separate threads so they do not delay the control loop.
+    ros::AsyncSpinner spinner(2);
+    spinner.start();
+
+    curio_base::BaseHardware base_hardware;
+    if (!base_hardware.init(nh, private_nh))
+    {
+        ROS_FATAL("Failed to initialise base hardware");
+        return 1;
+    }
+
+    controller_manager::ControllerManager controller_manager(&base_hardware, nh);
+
+    double control_frequency = 50.0;
+    private_nh.param("control_frequency", control_frequency, control_frequency);
+    ROS_INFO_STREAM("control_frequency: " << control_frequency);
+
+    // Real-time settings for the control loop thread
+    int realtime_priority = 0;
+    int cpu_affinity = -1;
+    bool lock_memory = false;
+    int prefault_stack_size = 0;
+    private_nh.param("realtime_priority", realtime_priority, realtime_priority);
+    private_nh.param("cpu_affinity", cpu_affinity, cpu_affinity);
+    private_nh.param("lock_memory", lock_memory, lock_memory);
+    private_nh.param("prefault_stack_size", prefault_stack_size, prefault_stack_size);
+
+    curio_base::RealtimeLoop loop(control_frequency);
+    loop.setPriority(realtime_priority);
+    loop.setCpu(cpu_affinity);
+    loop.setLockMemory(lock_memory);
+    loop.setPrefaultStackSize(static_cast<size_t>(std::max(prefault_stack_size, 0)));
+    if (!loop.configure())
+    {
+        ROS_WARN("Running the control loop without all requested real-time settings");
+    }
+
+    // With the realtime guard preloaded, allocations anywhere in the cycle
+    // are counted once the controller has started. The servo bus I/O
+    // blocks by design, the controller checks its own update fully.
+    const bool realtime_guard = RealtimeGuard::isLoaded();
+    if (realtime_guard)
+    {
+        ROS_WARN("Realtime guard loaded, counting allocations in the control loop");
+    }
+    uint64_t violation_cycles = 0;
+
+    // Control loop. The loop sleeps to absolute deadlines and the period
+    // passed to the controllers is the measured time between wake ups.
+    loop.start();
+    ros::Duration period(loop.getPeriod());
+    uint64_t overruns_reported = 0;
+    while (ros::ok())
+    {
+        const ros::Time time = ros::Time::now();
+
+        uint64_t violations = 0;
+        {
+            RealtimeGuard::Scope guard(RealtimeGuard::CHECK_ALLOCATION);
+            base_hardware.read(time, period);
+            controller_manager.update(time, period);
+            base_hardware.write(time, period);
+            violations = guard.violations();
+        }
+        if (violations != 0)
+        {
+            ++violation_cycles;
+            ROS_WARN_STREAM_THROTTLE(1.0, "Realtime guard: " << violations
+                << " violations this cycle, " << violation_cycles << " cycles with violations");
+        }
+
+        period = ros::Duration(loop.sleep());
+
+        if (loop.getOverruns() != overruns_reported)
+        {
+            overruns_reported = loop.getOverruns();
+            ROS_WARN_STREAM_THROTTLE(1.0, "Control loop overrun: " << overruns_reported
+                << " overruns, " << loop.getMissedDeadlines() << " missed deadlines in "
+                << loop.getCycles() << " cycles");
+        }
+    }
+
+    ROS_INFO_STREAM("Control loop: cycles: " << loop.getCycles()
+        << ", overruns: " << loop.getOverruns()
+        << ", max wake up latency: " << loop.getMaxLatency() * 1.0E6 << " us");
+
+    if (realtime_guard)
+    {
+        RealtimeGuard::report(STDERR_FILENO);
+    }
+
+    base_hardware.stop();
+    spinner.stop();
+
+    return 0;
+}
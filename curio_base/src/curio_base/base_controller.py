@@ -50,6 +50,12 @@ else:
     from curio_msgs.msg import LX16AState
 
 from curio_base.lx16a_encoder_filter import LX16AEncoderFilter
+
+# Native servo driver and encoder filter (optional, requires pybind11)
+try:
+    from curio_base import lx16a_native
+except ImportError:
+    lx16a_native = None
 from curio_msgs.msg import CurioServoEncoders
 from curio_msgs.msg import LX16AEncoder
 
@@ -814,7 +820,20 @@ class BaseController(object):
             port      = rospy.get_param('~port')
             baudrate  = rospy.get_param('~baudrate')
             timeout   = rospy.get_param('~timeout')
-            self._servo_driver = LX16ADriver()
+
+            # Use the native driver if requested and available. It writes
+            # the commands for each group of servos in one batch.
+            self._native = rospy.get_param('~native_driver', False)
+            if self._native and lx16a_native is None:
+                rospy.logwarn('Native LX-16A driver not available, using the Python driver')
+                self._native = False
+
+            if self._native:
+                self._servo_driver = lx16a_native.LX16ADriver()
+            else:
+                self._servo_driver = LX16ADriver()
+            self._steer_updated = False
+            self._wheel_updated = False
             self._servo_driver.set_port(port)
             self._servo_driver.set_baudrate(baudrate)
             self._servo_driver.set_timeout(timeout)
@@ -835,6 +854,11 @@ class BaseController(object):
             '''
 
             servo = self._steer_servos[i]
+            state = self._steer_states[i]
+            state.command = position
+            if self._native:
+                self._steer_updated = True
+                return
             self._servo_driver.servo_mode_write(servo.id)
             self._servo_driver.move_time_write(servo.id, position, 50)
 
@@ -845,13 +869,33 @@ class BaseController(object):
             servo = self._wheel_servos[i]
             state = self._wheel_states[i]
             state.command = duty
+            if self._native:
+                self._wheel_updated = True
+                return
             self._servo_driver.motor_mode_write(servo.id, duty)
 
         def publish_commands(self):
             ''' Publish the servo commands
+
+            The native driver writes the commands set since the
+            last call in one batch for each group of servos.
             '''
 
-            pass
+            if not self._native:
+                return
+
+            if self._steer_updated:
+                steer_ids = [servo.id for servo in self._steer_servos]
+                self._servo_driver.servo_mode_write_group(steer_ids)
+                self._servo_driver.move_time_write_group(steer_ids,
+                    [state.command for state in self._steer_states], 50)
+                self._steer_updated = False
+
+            if self._wheel_updated:
+                wheel_ids = [servo.id for servo in self._wheel_servos]
+                self._servo_driver.motor_mode_write_group(wheel_ids,
+                    [state.command for state in self._wheel_states])
+                self._wheel_updated = False
 
         def get_wheel_position(self, i):
             ''' Get the servo position for the i-th wheel 
@@ -863,6 +907,19 @@ class BaseController(object):
             state.position = pos
             return pos
 
+        def get_wheel_positions(self):
+            ''' Get the servo positions for all wheels
+            '''
+
+            wheel_ids = [servo.id for servo in self._wheel_servos]
+            if self._native:
+                positions = self._servo_driver.pos_read_all(wheel_ids)
+            else:
+                positions = [self._servo_driver.pos_read(id) for id in wheel_ids]
+            for state, pos in zip(self._wheel_states, positions):
+                state.position = pos
+            return positions
+
         def set_angle_offset(self, i, deviation):
             ''' Set the steering angle offset (trim)
             '''
@@ -967,6 +1024,12 @@ class BaseController(object):
 
             return self._servo_pos_msg.wheel_positions[i]            
 
+        def get_wheel_positions(self):
+            ''' Get the servo positions for all wheels
+            '''
+
+            return list(self._servo_pos_msg.wheel_positions)
+
         def set_angle_offset(self, i, deviation):
             ''' Set the steering angle offset (trim)
             '''
@@ -1149,13 +1212,25 @@ class BaseController(object):
         self._regressor_filename = rospy.get_param('~regressor_filename')
 
         self._wheel_servo_duty = [0 for i in range(BaseController.NUM_WHEELS)]
-        self._encoder_filters = [
-            LX16AEncoderFilter(
-                classifier_filename = self._classifier_filename,
-                regressor_filename = self._regressor_filename,
-                window=self._classifier_window)
-            for i in range(BaseController.NUM_WHEELS)
-        ]
+
+        # The native encoder filters are updated together in one call and
+        # do not use the classifier and regressor models.
+        self._native_encoder_filter = rospy.get_param('~native_encoder_filter', False)
+        if self._native_encoder_filter and lx16a_native is None:
+            rospy.logwarn('Native LX-16A encoder filter not available, using the Python filter')
+            self._native_encoder_filter = False
+
+        if self._native_encoder_filter:
+            self._encoder_filters = lx16a_native.LX16AEncoderFilterArray(
+                BaseController.NUM_WHEELS)
+        else:
+            self._encoder_filters = [
+                LX16AEncoderFilter(
+                    classifier_filename = self._classifier_filename,
+                    regressor_filename = self._regressor_filename,
+                    window=self._classifier_window)
+                for i in range(BaseController.NUM_WHEELS)
+            ]
 
         for i in range(BaseController.NUM_WHEELS):
             # Invert the encoder filters on the right side
@@ -1442,6 +1517,20 @@ class BaseController(object):
             of each of the wheel servos [rad].
         '''
 
+        if self._native_encoder_filter:
+            # Read all positions and update all filters in two native calls
+            positions = self._servo_driver.get_wheel_positions()
+            self._encoder_filters.update(self._wheel_servo_duty, positions)
+            servo_positions = self._encoder_filters.get_angular_positions()
+            counts = self._encoder_filters.get_counts()
+
+            msg = 'time: {}, '.format(time)
+            for i in range (BaseController.NUM_WHEELS):
+                msg = msg + "{}: {}, ".format(self._wheel_servos[i].id, counts[i])
+
+            rospy.loginfo(msg)
+            return servo_positions
+
         servo_positions = [0 for i in range(BaseController.NUM_WHEELS)]
         msg = 'time: {}, '.format(time)
         for i in range (BaseController.NUM_WHEELS):
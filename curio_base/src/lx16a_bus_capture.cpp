@@ -0,0 +1,260 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#include "curio_base/lx16a_bus_capture.h"
+
+#include <ros/ros.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <time.h>
+
+namespace curio_base
+{
+    namespace
+    {
+        const char MAGIC[8] = { 'L', 'X', '1', '6', 'A', 'C', 'A', 'P' };
+
+        /// Size of the stdio buffer for the capture file
+        const size_t FILE_BUFFER_SIZE = 256 * 1024;
+
+        /// Merge reads separated by less than this many byte times
+        const int64_t MERGE_GAP_BYTES = 4;
+
+        int64_t clockNanoseconds(clockid_t clock)
+        {
+            struct timespec ts;
+            clock_gettime(clock, &ts);
+            return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+        }
+    } // namespace
+
+    void BusCaptureFileHeader::init(uint32_t baudrate)
+    {
+        std::memset(this, 0, sizeof(*this));
+        std::memcpy(magic, MAGIC, sizeof(magic));
+        version = VERSION;
+        this->baudrate = baudrate;
+        start_realtime_ns = clockNanoseconds(CLOCK_REALTIME);
+        start_monotonic_ns = clockNanoseconds(CLOCK_MONOTONIC);
+    }
+
+    bool BusCaptureFileHeader::isValid() const
+    {
+        return std::memcmp(magic, MAGIC, sizeof(magic)) == 0 && version == VERSION;
+    }
+
+    LX16ABusCapture::LX16ABusCapture() :
+        last_byte_ns_(0),
+        merge_gap_ns_(0),
+        running_(false),
+        dropped_(0),
+        dropped_reported_(0),
+        file_(nullptr)
+    {
+        std::memset(&pending_, 0, sizeof(pending_));
+        sem_init(&wakeup_, 0, 0);
+    }
+
+    LX16ABusCapture::~LX16ABusCapture()
+    {
+        close();
+        sem_destroy(&wakeup_);
+    }
+
+    bool LX16ABusCapture::open(const std::string& path, uint32_t baudrate)
+    {
+        close();
+
+        file_ = std::fopen(path.c_str(), "wb");
+        if (file_ == nullptr)
+        {
+            ROS_ERROR_STREAM("Failed to open bus capture '" << path << "': " << std::strerror(errno));
+            return false;
+        }
+        std::setvbuf(file_, nullptr, _IOFBF, FILE_BUFFER_SIZE);
+
+        BusCaptureFileHeader header;
+        header.init(baudrate);
+        if (std::fwrite(&header, sizeof(header), 1, file_) != 1)
+        {
+            ROS_ERROR_STREAM("Failed to write bus capture header to '" << path << "'");
+            std::fclose(file_);
+            file_ = nullptr;
+            return false;
+        }
+
+        // 10 bits per byte (start, 8 data, stop)
+        merge_gap_ns_ = baudrate > 0 ? MERGE_GAP_BYTES * 10 * 1000000000LL / baudrate : 0;
+        pending_.chunk.length = 0;
+        path_ = path;
+        running_.store(true);
+        thread_ = std::thread(&LX16ABusCapture::run, this);
+        return true;
+    }
+
+    void LX16ABusCapture::close()
+    {
+        if (file_ == nullptr)
+            return;
+
+        flush();
+        if (running_.exchange(false))
+        {
+            sem_post(&wakeup_);
+            if (thread_.joinable())
+                thread_.join();
+        }
+        drain();
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+
+    void LX16ABusCapture::recordWrite(const uint8_t* data, size_t size)
+    {
+        if (file_ == nullptr)
+            return;
+
+        // A write always starts a new chunk
+        flush();
+        append(BusCaptureChunk::DIRECTION_TX, data, size, clockNanoseconds(CLOCK_MONOTONIC));
+        flush();
+    }
+
+    void LX16ABusCapture::recordRead(const uint8_t* data, size_t size)
+    {
+        if (file_ == nullptr || size == 0)
+            return;
+
+        const int64_t now_ns = clockNanoseconds(CLOCK_MONOTONIC);
+        if (pending_.chunk.length > 0
+            && (pending_.chunk.direction != BusCaptureChunk::DIRECTION_RX
+                || now_ns - last_byte_ns_ > merge_gap_ns_))
+        {
+            flush();
+        }
+        append(BusCaptureChunk::DIRECTION_RX, data, size, now_ns);
+    }
+
+    void LX16ABusCapture::append(uint8_t direction, const uint8_t* data, size_t size, int64_t now_ns)
+    {
+        while (size > 0)
+        {
+            if (pending_.chunk.length == MAX_CHUNK_SIZE)
+            {
+                flush();
+            }
+            if (pending_.chunk.length == 0)
+            {
+                pending_.chunk.time_ns = now_ns;
+                pending_.chunk.direction = direction;
+            }
+
+            const size_t n = std::min(size, MAX_CHUNK_SIZE - pending_.chunk.length);
+            std::memcpy(pending_.data + pending_.chunk.length, data, n);
+            pending_.chunk.length = static_cast<uint16_t>(pending_.chunk.length + n);
+            pending_.chunk.duration_ns = static_cast<uint32_t>(now_ns - pending_.chunk.time_ns);
+            data += n;
+            size -= n;
+        }
+        last_byte_ns_ = now_ns;
+    }
+
+    void LX16ABusCapture::flush()
+    {
+        if (pending_.chunk.length == 0)
+            return;
+
+        if (queue_.push(pending_))
+        {
+            if (queue_.size() >= QUEUE_SIZE / 4)
+            {
+                sem_post(&wakeup_);
+            }
+        }
+        else
+        {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        pending_.chunk.length = 0;
+    }
+
+    void LX16ABusCapture::run()
+    {
+        while (running_.load())
+        {
+            // Wake periodically so a quiet bus still gets written out
+            timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += 1;
+            if (sem_timedwait(&wakeup_, &deadline) != 0 && errno == EINTR)
+                continue;
+
+            drain();
+            std::fflush(file_);
+
+            const uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+            if (dropped != dropped_reported_)
+            {
+                ROS_WARN_STREAM("Bus capture queue full, dropped "
+                    << (dropped - dropped_reported_) << " chunks ("
+                    << dropped << " total).");
+                dropped_reported_ = dropped;
+            }
+        }
+    }
+
+    void LX16ABusCapture::drain()
+    {
+        Entry entry;
+        while (queue_.pop(entry))
+        {
+            if (std::fwrite(&entry.chunk, sizeof(entry.chunk), 1, file_) != 1
+                || std::fwrite(entry.data, 1, entry.chunk.length, file_) != entry.chunk.length)
+            {
+                ROS_ERROR_STREAM_THROTTLE(10.0, "Failed to write to bus capture '" << path_ << "'");
+            }
+        }
+    }
+
+} // namespace curio_base
@@ -0,0 +1,424 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#include "curio_base/lx16a_bus_schedule.h"
+#include "curio_base/lx16a_protocol.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+namespace curio_base
+{
+    namespace
+    {
+        /// Bits on the wire for each byte: start, 8 data and stop
+        const double BITS_PER_BYTE = 10.0;
+
+        /// The largest power of two not above n, n > 0
+        size_t floorPowerOfTwo(size_t n)
+        {
+            size_t p = 1;
+            while (p <= n / 2)
+            {
+                p *= 2;
+            }
+            return p;
+        }
+
+        std::string describe(const LX16ABusTask& task)
+        {
+            std::ostringstream ss;
+            ss << "command " << int(task.command) << " to servo " << int(task.id);
+            return ss.str();
+        }
+    } // namespace
+
+    LX16ABusSchedule::LX16ABusSchedule() :
+        max_bus_time_(0.0),
+        max_slots_(0),
+        cycles_(0),
+        overruns_(0),
+        last_slack_(0.0),
+        min_slack_(std::numeric_limits<double>::infinity())
+    {
+        cycle_begin_.assign(2, 0);
+        bus_time_.assign(1, 0.0);
+    }
+
+    bool LX16ABusSchedule::build(const std::vector<LX16ABusTask>& tasks,
+        const Params& params, std::string& error)
+    {
+        if (params.period <= 0.0 || params.baudrate == 0 || params.turnaround < 0.0
+            || params.max_utilisation <= 0.0 || params.max_utilisation > 1.0
+            || params.max_cycles == 0)
+        {
+            error = "Invalid bus schedule parameters";
+            return false;
+        }
+
+        std::vector<size_t> dividers;
+        if (!computeDividers(tasks, params, dividers, error))
+            return false;
+
+        std::vector<double> bus_time;
+        std::vector<std::vector<size_t>> cycle_slots;
+        place(tasks, params, dividers, bus_time, cycle_slots);
+
+        // Every cycle must fit in the usable part of the period
+        error.clear();
+        const double budget = params.period * params.max_utilisation;
+        for (size_t c = 0; c < bus_time.size() && error.empty(); ++c)
+        {
+            if (bus_time[c] > budget)
+            {
+                std::ostringstream ss;
+                ss << std::fixed << std::setprecision(2)
+                    << "Cycle " << c << " needs " << bus_time[c] * 1.0E3
+                    << " ms of bus time, the budget is " << budget * 1.0E3
+                    << " ms (" << params.max_utilisation * 100.0 << "% of "
+                    << params.period * 1.0E3 << " ms). The lowest priority transaction is "
+                    << describe(tasks[cycle_slots[c].back()]);
+                error = ss.str();
+                if (params.enforce)
+                    return false;
+            }
+        }
+
+        params_ = params;
+        tasks_ = tasks;
+        dividers_ = dividers;
+        bus_time_ = bus_time;
+        cycle_begin_.assign(1, 0);
+        slots_.clear();
+        max_bus_time_ = 0.0;
+        max_slots_ = 0;
+        for (size_t c = 0; c < bus_time.size(); ++c)
+        {
+            slots_.insert(slots_.end(), cycle_slots[c].begin(), cycle_slots[c].end());
+            cycle_begin_.push_back(slots_.size());
+            max_bus_time_ = std::max(max_bus_time_, bus_time[c]);
+            max_slots_ = std::max(max_slots_, cycle_slots[c].size());
+        }
+
+        cycles_ = 0;
+        overruns_ = 0;
+        last_slack_ = 0.0;
+        min_slack_ = std::numeric_limits<double>::infinity();
+        return true;
+    }
+
+    double LX16ABusSchedule::findMinPeriod(const std::vector<LX16ABusTask>& tasks,
+        const Params& params, double max_period)
+    {
+        if (max_period <= 0.0 || params.max_utilisation <= 0.0)
+            return 0.0;
+
+        // The dividers only change where a task's rate is a power of two
+        // times the loop rate. Between these periods the placement and the
+        // busiest cycle are fixed, so the shortest period that fits in each
+        // interval is the busiest cycle over the utilisation.
+        std::vector<double> bounds(1, max_period);
+        for (const LX16ABusTask& task : tasks)
+        {
+            if (task.rate <= 0.0)
+                continue;
+            for (size_t k = 1; k <= params.max_cycles; k *= 2)
+            {
+                const double period = 1.0 / (task.rate * k);
+                if (period < max_period)
+                    bounds.push_back(period);
+            }
+        }
+        std::sort(bounds.begin(), bounds.end());
+        bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+        Params p(params);
+        p.enforce = true;
+        std::string error;
+        std::vector<size_t> dividers;
+        std::vector<double> bus_time;
+        std::vector<std::vector<size_t>> cycle_slots;
+        LX16ABusSchedule schedule;
+        double lo = 0.0;
+        for (double hi : bounds)
+        {
+            // The dividers of the interval (lo, hi] are those at hi
+            p.period = hi;
+            if (!computeDividers(tasks, p, dividers, error))
+                break;
+            place(tasks, p, dividers, bus_time, cycle_slots);
+
+            const double max_bus_time = bus_time.empty() ? 0.0
+                : *std::max_element(bus_time.begin(), bus_time.end());
+            double period = std::max(max_bus_time / params.max_utilisation,
+                std::nextafter(lo, hi));
+            // Allow for rounding in the budget of build
+            for (int attempt = 0; attempt < 2 && period <= hi; ++attempt)
+            {
+                p.period = period;
+                if (schedule.build(tasks, p, error))
+                    return period;
+                period = std::min(period * (1.0 + 1.0E-9), hi);
+            }
+            lo = hi;
+        }
+        return 0.0;
+    }
+
+    bool LX16ABusSchedule::computeDividers(const std::vector<LX16ABusTask>& tasks,
+        const Params& params, std::vector<size_t>& dividers, std::string& error)
+    {
+        // Power of two dividers are commensurate, so the schedule repeats
+        // after the largest of them however the rates relate to the period.
+        const size_t max_divider = floorPowerOfTwo(params.max_cycles);
+        dividers.assign(tasks.size(), 1);
+        for (size_t i = 0; i < tasks.size(); ++i)
+        {
+            const LX16ABusTask& task = tasks[i];
+            if (lx16a::requestSize(task.command) == 0)
+            {
+                error = "Unknown " + describe(task);
+                return false;
+            }
+            if (task.rate < 0.0)
+            {
+                error = "Negative rate for " + describe(task);
+                return false;
+            }
+            if (task.rate > 0.0)
+            {
+                const double cycles = 1.0 / (task.rate * params.period);
+                if (cycles < 1.0 - 1.0E-9)
+                {
+                    std::ostringstream ss;
+                    ss << "The rate " << task.rate << " Hz of " << describe(task)
+                        << " is above the loop rate " << 1.0 / params.period << " Hz";
+                    error = ss.str();
+                    return false;
+                }
+                const double whole = std::min(cycles + 1.0E-9, static_cast<double>(max_divider));
+                dividers[i] = floorPowerOfTwo(std::max<size_t>(1, static_cast<size_t>(whole)));
+            }
+        }
+        return true;
+    }
+
+    void LX16ABusSchedule::place(const std::vector<LX16ABusTask>& tasks,
+        const Params& params, const std::vector<size_t>& dividers,
+        std::vector<double>& bus_time, std::vector<std::vector<size_t>>& cycle_slots)
+    {
+        const size_t num_cycles = dividers.empty() ? 1
+            : *std::max_element(dividers.begin(), dividers.end());
+
+        // Place the tasks in priority order, then the most frequent first
+        std::vector<size_t> order(tasks.size());
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+        {
+            if (tasks[a].priority != tasks[b].priority)
+                return tasks[a].priority > tasks[b].priority;
+            return dividers[a] < dividers[b];
+        });
+
+        bus_time.assign(num_cycles, 0.0);
+        cycle_slots.assign(num_cycles, std::vector<size_t>());
+        for (size_t i : order)
+        {
+            // The phase that keeps the busiest of the task's cycles least loaded
+            const size_t k = dividers[i];
+            size_t best_phase = 0;
+            double best_peak = std::numeric_limits<double>::infinity();
+            for (size_t phase = 0; phase < k; ++phase)
+            {
+                double peak = 0.0;
+                for (size_t c = phase; c < num_cycles; c += k)
+                {
+                    peak = std::max(peak, bus_time[c]);
+                }
+                if (peak < best_peak)
+                {
+                    best_peak = peak;
+                    best_phase = phase;
+                }
+            }
+
+            const double time = transactionTime(tasks[i], params);
+            for (size_t c = best_phase; c < num_cycles; c += k)
+            {
+                bus_time[c] += time;
+                cycle_slots[c].push_back(i);
+            }
+        }
+    }
+
+    double LX16ABusSchedule::transactionTime(const LX16ABusTask& task, const Params& params)
+    {
+        const double byte_time = BITS_PER_BYTE / params.baudrate;
+        double time = lx16a::requestSize(task.command) * byte_time;
+        if (task.id != lx16a::BROADCAST_ID && lx16a::hasResponse(task.command))
+        {
+            time += params.turnaround + lx16a::responseSize(task.command) * byte_time;
+        }
+        return time;
+    }
+
+    double LX16ABusSchedule::measureTurnaround(LX16ADriver& driver, uint8_t id,
+        int samples, double response_timeout)
+    {
+        const double wire_time = BITS_PER_BYTE / driver.getBaudrate()
+            * (lx16a::requestSize(lx16a::POS_READ) + lx16a::responseSize(lx16a::POS_READ));
+
+        const LX16AQuery query(id, lx16a::POS_READ);
+        LX16AReply reply;
+        double turnaround = -1.0;
+        for (int i = 0; i < samples; ++i)
+        {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            if (driver.sweep(&query, &reply, 1, response_timeout) == 1)
+            {
+                const double elapsed = std::chrono::duration<double>(reply.stamp - start).count();
+                turnaround = std::max(turnaround, std::max(elapsed - wire_time, 0.0));
+            }
+        }
+        return turnaround;
+    }
+
+    size_t LX16ABusSchedule::getNumCycles() const
+    {
+        return cycle_begin_.size() - 1;
+    }
+
+    size_t LX16ABusSchedule::getNumSlots(uint64_t cycle) const
+    {
+        const size_t c = cycle % getNumCycles();
+        return cycle_begin_[c + 1] - cycle_begin_[c];
+    }
+
+    size_t LX16ABusSchedule::getTaskIndex(uint64_t cycle, size_t slot) const
+    {
+        return slots_[cycle_begin_[cycle % getNumCycles()] + slot];
+    }
+
+    const std::vector<LX16ABusTask>& LX16ABusSchedule::getTasks() const
+    {
+        return tasks_;
+    }
+
+    const std::vector<size_t>& LX16ABusSchedule::getDividers() const
+    {
+        return dividers_;
+    }
+
+    double LX16ABusSchedule::getBusTime(uint64_t cycle) const
+    {
+        return bus_time_[cycle % getNumCycles()];
+    }
+
+    double LX16ABusSchedule::getMaxBusTime() const
+    {
+        return max_bus_time_;
+    }
+
+    double LX16ABusSchedule::getUtilisation() const
+    {
+        return params_.period > 0.0 ? max_bus_time_ / params_.period : 0.0;
+    }
+
+    double LX16ABusSchedule::getPeriod() const
+    {
+        return params_.period;
+    }
+
+    size_t LX16ABusSchedule::getMaxSlots() const
+    {
+        return max_slots_;
+    }
+
+    double LX16ABusSchedule::recordCycle(double bus_time)
+    {
+        last_slack_ = params_.period - bus_time;
+        min_slack_ = std::min(min_slack_, last_slack_);
+        ++cycles_;
+        if (last_slack_ < 0.0)
+        {
+            ++overruns_;
+        }
+        return last_slack_;
+    }
+
+    double LX16ABusSchedule::getLastSlack() const
+    {
+        return last_slack_;
+    }
+
+    double LX16ABusSchedule::getMinSlack() const
+    {
+        return cycles_ == 0 ? 0.0 : min_slack_;
+    }
+
+    uint64_t LX16ABusSchedule::getCycles() const
+    {
+        return cycles_;
+    }
+
+    uint64_t LX16ABusSchedule::getOverruns() const
+    {
+        return overruns_;
+    }
+
+    std::string LX16ABusSchedule::toString() const
+    {
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(2)
+            << tasks_.size() << " transactions in " << getNumCycles()
+            << " cycles, busiest cycle " << max_bus_time_ * 1.0E3
+            << " ms of " << params_.period * 1.0E3 << " ms ("
+            << getUtilisation() * 100.0 << "%)";
+        return ss.str();
+    }
+
+} // namespace curio_base
@@ -0,0 +1,383 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+// Decode a capture of the LX-16A servo bus.
+//
+// Rebuilds the frames sent to and received from the servos, matches each
+// read request to its response and reports per servo response latency,
+// missing responses, retries and malformed frames.
+//
+// Usage:
+//   lx16a_capture_decode [-v] <capture_file>
+//
+//   -v  list each anomaly with its time from the start of the capture
+//
+// Capture the bus by setting the curio_base_hardware parameter 'bus_capture'.
+
+#include "curio_base/lx16a_bus_capture.h"
+#include "curio_base/lx16a_protocol.h"
+
+#include <curio_realtime/latency_histogram.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using curio_realtime::LatencyHistogram;
+using curio_base::BusCaptureChunk;
+using curio_base::BusCaptureFileHeader;
+namespace lx16a = curio_base::lx16a;
+
+namespace
+{
+    /// Transaction counts for one servo
+    struct ServoStats
+    {
+        uint64_t commands;
+        uint64_t requests;
+        uint64_t responses;
+        uint64_t missing;
+        uint64_t retries;
+        uint64_t checksum_errors;
+        uint64_t unexpected;
+        LatencyHistogram latency;
+
+        ServoStats() :
+            commands(0), requests(0), responses(0), missing(0),
+            retries(0), checksum_errors(0), unexpected(0)
+        {
+        }
+    };
+
+    /**
+     * \brief Match requests and responses in a stream of bus chunks
+     */
+    class CaptureDecoder
+    {
+    public:
+        CaptureDecoder(int64_t start_ns, bool verbose) :
+            start_ns_(start_ns),
+            verbose_(verbose),
+            tx_bytes_(0),
+            rx_bytes_(0),
+            rx_frame_bytes_(0),
+            tx_checksum_errors_(0),
+            chunks_(0),
+            first_ns_(0),
+            last_ns_(0),
+            pending_(false),
+            pending_id_(0),
+            pending_command_(0),
+            pending_ns_(0),
+            last_missing_(false),
+            rx_frame_start_ns_(0)
+        {
+        }
+
+        void decode(const BusCaptureChunk& chunk, const uint8_t* data)
+        {
+            if (chunks_++ == 0)
+                first_ns_ = chunk.time_ns;
+            last_ns_ = chunk.time_ns + chunk.duration_ns;
+
+            if (chunk.direction == BusCaptureChunk::DIRECTION_TX)
+            {
+                tx_bytes_ += chunk.length;
+                const int64_t end_ns = chunk.time_ns + chunk.duration_ns;
+                for (size_t i = 0; i < chunk.length; ++i)
+                {
+                    const lx16a::FrameParser::Result result = tx_.parse(data[i]);
+                    if (result == lx16a::FrameParser::FRAME)
+                        onRequest(end_ns);
+                    else if (result == lx16a::FrameParser::CHECKSUM_ERROR)
+                        ++tx_checksum_errors_;
+                }
+            }
+            else if (chunk.direction == BusCaptureChunk::DIRECTION_RX)
+            {
+                rx_bytes_ += chunk.length;
+                const size_t last = chunk.length > 1 ? chunk.length - 1 : 1;
+                for (size_t i = 0; i < chunk.length; ++i)
+                {
+                    // Interpolate the arrival time within the chunk
+                    if (rx_.isIdle())
+                        rx_frame_start_ns_ = chunk.time_ns + static_cast<int64_t>(chunk.duration_ns) * i / last;
+
+                    const lx16a::FrameParser::Result result = rx_.parse(data[i]);
+                    if (result != lx16a::FrameParser::INCOMPLETE)
+                        onResponse(result == lx16a::FrameParser::FRAME);
+                }
+            }
+        }
+
+        void finish()
+        {
+            if (pending_)
+                onMissing(last_ns_);
+        }
+
+        void report(std::ostream& os) const
+        {
+            const double duration = (last_ns_ - first_ns_) * 1.0E-9;
+            os << "Duration: " << duration << " s, chunks: " << chunks_
+               << ", tx bytes: " << tx_bytes_ << ", rx bytes: " << rx_bytes_ << "\n";
+            os << "Malformed: rx bytes outside frames: " << rx_bytes_ - rx_frame_bytes_
+               << ", tx checksum errors: " << tx_checksum_errors_ << "\n\n";
+
+            os << std::setw(4) << "id"
+               << std::setw(10) << "commands"
+               << std::setw(10) << "requests"
+               << std::setw(11) << "responses"
+               << std::setw(9) << "missing"
+               << std::setw(9) << "retries"
+               << std::setw(10) << "checksum"
+               << std::setw(12) << "unexpected"
+               << "  response latency\n";
+            for (size_t id = 0; id < 256; ++id)
+            {
+                const ServoStats& s = servos_[id];
+                if (s.commands == 0 && s.requests == 0 && s.responses == 0
+                    && s.checksum_errors == 0 && s.unexpected == 0)
+                    continue;
+
+                os << std::setw(4) << id
+                   << std::setw(10) << s.commands
+                   << std::setw(10) << s.requests
+                   << std::setw(11) << s.responses
+                   << std::setw(9) << s.missing
+                   << std::setw(9) << s.retries
+                   << std::setw(10) << s.checksum_errors
+                   << std::setw(12) << s.unexpected
+                   << "  " << s.latency.summary() << "\n";
+            }
+        }
+
+    private:
+        void onRequest(int64_t time_ns)
+        {
+            const uint8_t id = tx_.id();
+            const uint8_t command = tx_.command();
+
+            if (pending_)
+                onMissing(time_ns);
+
+            ServoStats& s = servos_[id];
+            if (!lx16a::hasResponse(command))
+            {
+                ++s.commands;
+                last_missing_ = false;
+                return;
+            }
+
+            // A repeat of a request that went unanswered
+            if (last_missing_ && id == pending_id_ && command == pending_command_)
+                ++s.retries;
+
+            ++s.requests;
+            pending_ = true;
+            pending_id_ = id;
+            pending_command_ = command;
+            pending_ns_ = time_ns;
+            last_missing_ = false;
+        }
+
+        void onMissing(int64_t time_ns)
+        {
+            ++servos_[pending_id_].missing;
+            anomaly(time_ns, pending_id_, "no response to command "
+                + std::to_string(pending_command_));
+            pending_ = false;
+            last_missing_ = true;
+        }
+
+        void onResponse(bool valid)
+        {
+            rx_frame_bytes_ += rx_.frameSize();
+            const uint8_t id = rx_.id();
+
+            if (!valid)
+            {
+                // Attribute a corrupt frame to the servo that was asked
+                const uint8_t blame = pending_ ? pending_id_ : id;
+                ++servos_[blame].checksum_errors;
+                anomaly(rx_frame_start_ns_, blame, "response checksum error");
+                pending_ = false;
+                return;
+            }
+
+            if (!pending_ || id != pending_id_ || rx_.command() != pending_command_)
+            {
+                ++servos_[id].unexpected;
+                anomaly(rx_frame_start_ns_, id, "unexpected response to command "
+                    + std::to_string(rx_.command()));
+                return;
+            }
+
+            ServoStats& s = servos_[id];
+            ++s.responses;
+            s.latency.record(static_cast<uint64_t>(std::max<int64_t>(0, rx_frame_start_ns_ - pending_ns_)));
+            pending_ = false;
+        }
+
+        void anomaly(int64_t time_ns, uint8_t id, const std::string& what)
+        {
+            if (verbose_)
+            {
+                std::cout << std::fixed << std::setprecision(6)
+                    << (time_ns - start_ns_) * 1.0E-9 << " id " << int(id) << ": " << what
+                    << std::defaultfloat << "\n";
+            }
+        }
+
+        int64_t start_ns_;
+        bool verbose_;
+
+        lx16a::FrameParser tx_;
+        lx16a::FrameParser rx_;
+        ServoStats servos_[256];
+
+        uint64_t tx_bytes_;
+        uint64_t rx_bytes_;
+        uint64_t rx_frame_bytes_;
+        uint64_t tx_checksum_errors_;
+        uint64_t chunks_;
+        int64_t first_ns_;
+        int64_t last_ns_;
+
+        /// The request awaiting a response
+        bool pending_;
+        uint8_t pending_id_;
+        uint8_t pending_command_;
+        int64_t pending_ns_;
+        bool last_missing_;
+
+        int64_t rx_frame_start_ns_;
+    };
+} // namespace
+
+int main(int argc, char** argv)
+{
+    bool verbose = false;
+    std::string path;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "-v") == 0)
+            verbose = true;
+        else
+            path = argv[i];
+    }
+    if (path.empty())
+    {
+        std::cerr << "Usage: " << argv[0] << " [-v] <capture_file>" << std::endl;
+        return 1;
+    }
+
+    // Map the whole file, the decoder makes a single sequential pass
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) != 0)
+    {
+        std::cerr << "Failed to open " << path << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    const size_t size = static_cast<size_t>(st.st_size);
+    if (size < sizeof(BusCaptureFileHeader))
+    {
+        std::cerr << path << " is not a bus capture" << std::endl;
+        return 1;
+    }
+    void* addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        std::cerr << "Failed to map " << path << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    ::madvise(addr, size, MADV_SEQUENTIAL);
+
+    const uint8_t* const begin = static_cast<const uint8_t*>(addr);
+    const uint8_t* const end = begin + size;
+
+    BusCaptureFileHeader header;
+    std::memcpy(&header, begin, sizeof(header));
+    if (!header.isValid())
+    {
+        std::cerr << path << " is not a bus capture (or was written by an incompatible version)" << std::endl;
+        return 1;
+    }
+
+    const uint64_t decode_start_ns = curio_realtime::monotonicNanoseconds();
+    CaptureDecoder decoder(header.start_monotonic_ns, verbose);
+    const uint8_t* p = begin + sizeof(header);
+    while (static_cast<size_t>(end - p) >= sizeof(BusCaptureChunk))
+    {
+        BusCaptureChunk chunk;
+        std::memcpy(&chunk, p, sizeof(chunk));
+        p += sizeof(chunk);
+        if (static_cast<size_t>(end - p) < chunk.length)
+        {
+            std::cerr << "Capture truncated in the last chunk" << std::endl;
+            break;
+        }
+        decoder.decode(chunk, p);
+        p += chunk.length;
+    }
+    decoder.finish();
+    const double decode_time = (curio_realtime::monotonicNanoseconds() - decode_start_ns) * 1.0E-9;
+
+    std::cout << "Capture: " << path << ", baudrate: " << header.baudrate
+              << ", started: " << header.start_realtime_ns / 1000000000LL << " (unix time)\n";
+    decoder.report(std::cout);
+    std::cout << "\nDecoded " << size << " bytes in " << decode_time << " s ("
+              << (decode_time > 0.0 ? size / decode_time * 1.0E-6 : 0.0) << " MB/s)" << std::endl;
+
+    ::munmap(addr, size);
+    return 0;
+}
@@ -34,10 +34,13 @@
 //  POSSIBILITY OF SUCH DAMAGE.
 //
 
+#include "curio_base/lx16a_bus_capture.h"
 #include "curio_base/lx16a_driver.h"
+#include "curio_base/lx16a_protocol.h"
 
 #include <ros/ros.h>
 
+#include <algorithm>
 #include <cstdarg>
 #include <chrono>
 #include <iostream>
@@ -84,22 +87,73 @@
 #define LOBOT_SERVO_LED_ERROR_WRITE      35
 #define LOBOT_SERVO_LED_ERROR_READ       36
 
-#define LOBOT_DEBUG 1  /*Debug ：print debug value*/
+// #define LOBOT_DEBUG 1  /*Debug ：print debug value*/
 
-uint8_t LobotCheckSum(uint8_t buf[])
+/// Serial port access for the Lobot functions, optionally capturing the bus traffic.
+class LobotSerial
 {
-  uint8_t i;
-  uint16_t temp = 0;
-  for (uint8_t i = 2; i < buf[3] + 2; ++i)
+public:
+  LobotSerial(serial::Serial &serial, curio_base::LX16ABusCapture *capture) :
+    serial_(serial), capture_(capture)
+  {
+  }
+
+  size_t available()
+  {
+    return serial_.available();
+  }
+
+  /// Block until input is available or the deadline has passed.
+  /// Returns true if input is available.
+  bool waitReadable(std::chrono::steady_clock::time_point deadline)
+  {
+    if (serial_.available() > 0)
+      return true;
+
+    // The port waits for up to its read timeout, in whole milliseconds
+    const std::chrono::steady_clock::duration remaining
+      = deadline - std::chrono::steady_clock::now();
+    if (remaining <= std::chrono::steady_clock::duration::zero())
+      return false;
+    const int64_t wait_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+      remaining + std::chrono::milliseconds(1) - std::chrono::nanoseconds(1)).count();
+
+    serial::Timeout timeout = serial_.getTimeout();
+    serial::Timeout wait = timeout;
+    wait.read_timeout_constant = static_cast<uint32_t>(wait_ms);
+    serial_.setTimeout(wait);
+    const bool readable = serial_.waitReadable();
+    serial_.setTimeout(timeout);
+    return readable;
+  }
+
+  size_t read(uint8_t *buffer, size_t size)
+  {
+    const size_t n = serial_.read(buffer, size);
+    if (capture_ != nullptr)
+      capture_->recordRead(buffer, n);
+    return n;
+  }
+
+  size_t write(const uint8_t *data, size_t size)
   {
-    temp += buf[i];
+    const size_t n = serial_.write(data, size);
+    if (capture_ != nullptr)
+      capture_->recordWrite(data, n);
+    return n;
   }
-  temp = ~temp;
-  i = (uint8_t)temp;
-  return i;
+
+private:
+  serial::Serial &serial_;
+  curio_base::LX16ABusCapture *capture_;
+};
+
+uint8_t LobotCheckSum(uint8_t buf[])
+{
+  return curio_base::lx16a::checksum(buf);
 }
 
-void LobotSerialServoMove(serial::Serial &SerialX, uint8_t id, int16_t position, uint16_t time)
+void LobotSerialServoMove(LobotSerial &SerialX, uint8_t id, int16_t position, uint16_t time)
 {
   uint8_t buf[10];
   if (position < 0)
@@ -122,7 +176,7 @@ void LobotSerialServoMove(serial::Serial &SerialX, uint8_t id, int16_t position,
   SerialX.write(buf, 10);
 }
 
-void LobotSerialServoStopMove(serial::Serial &SerialX, uint8_t id)
+void LobotSerialServoStopMove(LobotSerial &SerialX, uint8_t id)
 {
   uint8_t buf[6];
   buf[0] = buf[1] = LOBOT_SERVO_FRAME_HEADER;
@@ -133,7 +187,7 @@ void LobotSerialServoStopMove(serial::Serial &SerialX, uint8_t id)
   SerialX.write(buf, 6);
 }
 
-void LobotSerialServoAngleAdjust(serial::Serial &SerialX, uint8_t id, uint8_t deviation)
+void LobotSerialServoAngleAdjust(LobotSerial &SerialX, uint8_t id, uint8_t deviation)
 {
   uint8_t buf[7];
   buf[0] = buf[1] = LOBOT_SERVO_FRAME_HEADER;
@@ -145,7 +199,7 @@ void LobotSerialServoAngleAdjust(serial::Serial &SerialX, uint8_t id, uint8_t de
   SerialX.write(buf, 7);
 }
 
-void LobotSerialServoSetID(serial::Serial &SerialX, uint8_t oldID, uint8_t newID)
+void LobotSerialServoSetID(LobotSerial &SerialX, uint8_t oldID, uint8_t newID)
 {
   uint8_t buf[7];
   buf[0] = buf[1] = LOBOT_SERVO_FRAME_HEADER;
@@ -168,7 +222,7 @@ void LobotSerialServoSetID(serial::Serial &SerialX, uint8_t oldID, uint8_t newID
 #endif
 }
 
-void LobotSerialServoSetMode(serial::Serial &SerialX, uint8_t id, uint8_t Mode, int16_t Speed)
+void LobotSerialServoSetMode(LobotSerial &SerialX, uint8_t id, uint8_t Mode, int16_t Speed)
 {
   uint8_t buf[10];
 
@@ -192,11 +246,10 @@ void LobotSerialServoSetMode(serial::Serial &SerialX, uint8_t id, uint8_t Mode,
   }
   ROS_INFO_STREAM("" << ss.str());
 #endif
-  size_t cnt = SerialX.write(buf, 10);
-  ROS_INFO_STREAM("wrote: " << cnt);
+  SerialX.write(buf, 10);
 }
 
-void LobotSerialServoLoad(serial::Serial &SerialX, uint8_t id)
+void LobotSerialServoLoad(LobotSerial &SerialX, uint8_t id)
 {
   uint8_t buf[7];
   buf[0] = buf[1] = LOBOT_SERVO_FRAME_HEADER;
@@ -220,7 +273,7 @@ void LobotSerialServoLoad(serial::Serial &SerialX, uint8_t id)
 #endif
 }
 
-void LobotSerialServoUnload(serial::Serial &SerialX, uint8_t id)
+void LobotSerialServoUnload(LobotSerial &SerialX, uint8_t id)
 {
   uint8_t buf[7];
   buf[0] = buf[1] = LOBOT_SERVO_FRAME_HEADER;
@@ -244,82 +297,43 @@ void LobotSerialServoUnload(serial::Serial &SerialX, uint8_t id)
 #endif
 }
 
-int LobotSerialServoReceiveHandle(serial::Serial &SerialX, uint8_t *ret)
+int LobotSerialServoReceiveHandle(LobotSerial &SerialX, uint8_t *ret)
 {
-  bool frameStarted = false;
-  bool receiveFinished = false;
-  uint8_t frameCount = 0;
-  uint8_t dataCount = 0;
-  uint8_t dataLength = 2;
+  curio_base::lx16a::FrameParser parser;
   uint8_t rxBuf;
-  uint8_t recvBuf[32];
-  uint8_t i;
 
   while (SerialX.available())
   {
     SerialX.read(&rxBuf, 1);
-    // delayMicroseconds(100);
-    // ros::Duration(0.0001).sleep();
-    if (!frameStarted)
+    curio_base::lx16a::FrameParser::Result result = parser.parse(rxBuf);
+    if (result == curio_base::lx16a::FrameParser::INCOMPLETE)
     {
-      if (rxBuf == LOBOT_SERVO_FRAME_HEADER)
-      {
-        frameCount++;
-        if (frameCount == 2)
-        {
-          frameCount = 0;
-          frameStarted = true;
-          dataCount = 1;
-        }
-      }
-      else
-      {
-        frameStarted = false;
-        dataCount = 0;
-        frameCount = 0;
-      }
+      continue;
     }
-    if (frameStarted)
-    {
-      recvBuf[dataCount] = (uint8_t)rxBuf;
-      if (dataCount == 3)
-      {
-        dataLength = recvBuf[dataCount];
-        if (dataLength < 3 || dataCount > 7)
-        {
-          dataLength = 2;
-          frameStarted = false;
-        }
-      }
-      dataCount++;
-      if (dataCount == dataLength + 3)
-      {
+
 #ifdef LOBOT_DEBUG
-        std::stringstream ss;
-        ss << "RECEIVE_DATA:"; 
-        for (i = 0; i < dataCount; i++)
-        {
-          ss << "0x"  << std::uppercase << std::setfill('0')
-             << std::setw(2) << std::hex << int(recvBuf[i]) << ":";
-        }
-        ROS_INFO_STREAM("" << ss.str());
+    std::stringstream ss;
+    ss << "RECEIVE_DATA:"; 
+    for (size_t i = 0; i < parser.frameSize(); i++)
+    {
+      ss << "0x"  << std::uppercase << std::setfill('0')
+         << std::setw(2) << std::hex << int(parser.frame()[i]) << ":";
+    }
+    ROS_INFO_STREAM("" << ss.str());
 #endif
-        if (LobotCheckSum(recvBuf) == recvBuf[dataCount - 1])
-        {
+    if (result == curio_base::lx16a::FrameParser::FRAME)
+    {
 #ifdef LOBOT_DEBUG
-          ROS_INFO("Check SUM OK!!");
-          ROS_INFO("");
+      ROS_INFO("Check SUM OK!!");
+      ROS_INFO("");
 #endif
-          frameStarted = false;
-          memcpy(ret, recvBuf + 4, dataLength);
-          return 1;
-        }
+      std::copy(parser.frame() + 4, parser.frame() + 4 + parser.frame()[3], ret);
+      return 1;
+    }
 #ifdef LOBOT_DEBUG
-        ROS_INFO("LOBOT INVALID CHECKSUM");
+    ROS_INFO("LOBOT INVALID CHECKSUM");
 #endif
-        return -1;
-      }
-    }
+    return -1;
   }
 #ifdef LOBOT_DEBUG
   ROS_INFO("LOBOT NO DATA AVAILABLE");
@@ -327,7 +341,7 @@ int LobotSerialServoReceiveHandle(serial::Serial &SerialX, uint8_t *ret)
   return -1;
 }
 
-int LobotSerialServoReadPosition(serial::Serial &SerialX, uint8_t id)
+int LobotSerialServoReadPosition(LobotSerial &SerialX, uint8_t id)
 {
   int count = 100000;
   int16_t ret;
@@ -394,7 +408,7 @@ int LobotSerialServoReadPosition(serial::Serial &SerialX, uint8_t id)
   return ret;
 }
 
-int LobotSerialServoReadVin(serial::Serial &SerialX, uint8_t id)
+int LobotSerialServoReadVin(LobotSerial &SerialX, uint8_t id)
 {
   int count = 100000;
   int16_t ret;
@@ -448,6 +462,53 @@ int LobotSerialServoReadVin(serial::Serial &SerialX, uint8_t id)
   return ret;
 }
 
+void LobotSerialDrain(LobotSerial &SerialX)
+{
+  uint8_t rxBuf[64];
+  size_t n;
+  while ((n = SerialX.available()) > 0)
+  {
+    SerialX.read(rxBuf, n < sizeof(rxBuf) ? n : sizeof(rxBuf));
+  }
+}
+
+/// Send a read command and wait until the deadline for the matching reply.
+/// Returns the number of params in the reply, or -1 if there is none.
+int LobotSerialServoQuery(LobotSerial &SerialX, uint8_t id, uint8_t command,
+  uint8_t *params, std::chrono::steady_clock::duration timeout)
+{
+  uint8_t buf[curio_base::lx16a::MAX_FRAME_SIZE];
+  const size_t size = curio_base::lx16a::encode(buf, id, command, nullptr, 0);
+
+  LobotSerialDrain(SerialX);
+  SerialX.write(buf, size);
+
+  const std::chrono::steady_clock::time_point deadline
+    = std::chrono::steady_clock::now() + timeout;
+  curio_base::lx16a::FrameParser parser;
+  uint8_t rxBuf[32];
+  while (std::chrono::steady_clock::now() < deadline)
+  {
+    if (!SerialX.waitReadable(deadline))
+      continue;
+
+    size_t n = SerialX.available();
+    n = SerialX.read(rxBuf, n < sizeof(rxBuf) ? n : sizeof(rxBuf));
+    for (size_t i = 0; i < n; ++i)
+    {
+      if (parser.parse(rxBuf[i]) == curio_base::lx16a::FrameParser::FRAME
+        && parser.id() == id && parser.command() == command)
+      {
+        const size_t num_params = parser.numParams();
+        for (size_t j = 0; j < num_params; ++j)
+          params[j] = parser.params()[j];
+        return static_cast<int>(num_params);
+      }
+    }
+  }
+  return -1;
+}
+
 namespace curio_base
 {
     LX16ADriver::LX16ADriver()
@@ -456,37 +517,296 @@ namespace curio_base
 
     LX16ADriver::~LX16ADriver()
     {
+        stopCapture();
         serial_.close();
     }
 
     void LX16ADriver::move(uint8_t id, int16_t position, uint16_t time)
     {
-        LobotSerialServoMove(serial_, id, position, time);
+        LobotSerial bus(serial_, capture_.get());
+        LobotSerialServoMove(bus, id, position, time);
     }
 
     void LX16ADriver::stopMove(serial::Serial &SerialX, uint8_t id)
     {
-        LobotSerialServoStopMove(serial_, id);
+        LobotSerial bus(serial_, capture_.get());
+        LobotSerialServoStopMove(bus, id);
     }
 
     void LX16ADriver::angleAdjust(uint8_t id, uint8_t deviation)
     {
-        LobotSerialServoAngleAdjust(serial_, id, deviation);
+        LobotSerial bus(serial_, capture_.get());
+        LobotSerialServoAngleAdjust(bus, id, deviation);
     }
 
     void LX16ADriver::setMode(uint8_t id, uint8_t mode, int16_t duty)
     {
-        LobotSerialServoSetMode(serial_, id, mode, duty);
+        LobotSerial bus(serial_, capture_.get());
+        LobotSerialServoSetMode(bus, id, mode, duty);
     }
 
     int LX16ADriver::readPosition(uint8_t id)
     {
-        return LobotSerialServoReadPosition(serial_, id);
+        LobotSerial bus(serial_, capture_.get());
+        return LobotSerialServoReadPosition(bus, id);
     }
 
     int LX16ADriver::readVin(uint8_t id)
     {
-        return LobotSerialServoReadVin(serial_, id);
+        LobotSerial bus(serial_, capture_.get());
+        return LobotSerialServoReadVin(bus, id);
+    }
+
+    void LX16ADriver::broadcastStop()
+    {
+        LobotSerial bus(serial_, capture_.get());
+        LobotSerialServoSetMode(bus, lx16a::BROADCAST_ID, 1, 0);
+    }
+
+    void LX16ADriver::moveGroup(const uint8_t *ids, const int16_t *positions,
+        size_t count, uint16_t time)
+    {
+        LobotSerial bus(serial_, capture_.get());
+
+        // Staged moves and the start frame, written in as few writes as
+        // the buffer allows. The servos do not move until the start.
+        uint8_t frames[(MAX_GROUP_SIZE + 1) * lx16a::MAX_FRAME_SIZE];
+        size_t size = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (size + lx16a::MAX_FRAME_SIZE > MAX_GROUP_SIZE * lx16a::MAX_FRAME_SIZE)
+            {
+                bus.write(frames, size);
+                size = 0;
+            }
+            const int16_t position = std::min<int16_t>(std::max<int16_t>(positions[i], 0), 1000);
+            const uint8_t params[] = {
+                GET_LOW_BYTE(position), GET_HIGH_BYTE(position),
+                GET_LOW_BYTE(time), GET_HIGH_BYTE(time) };
+            size += lx16a::encode(frames + size, ids[i],
+                LOBOT_SERVO_MOVE_TIME_WAIT_WRITE, params, 4);
+        }
+        size += lx16a::encode(frames + size, lx16a::BROADCAST_ID,
+            LOBOT_SERVO_MOVE_START, nullptr, 0);
+        bus.write(frames, size);
+    }
+
+    void LX16ADriver::setModeGroup(const uint8_t *ids, uint8_t mode,
+        const int16_t *duties, size_t count)
+    {
+        LobotSerial bus(serial_, capture_.get());
+
+        uint8_t frames[MAX_GROUP_SIZE * lx16a::MAX_FRAME_SIZE];
+        size_t size = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (size + lx16a::MAX_FRAME_SIZE > sizeof(frames))
+            {
+                bus.write(frames, size);
+                size = 0;
+            }
+            const uint8_t params[] = {
+                mode, 0, GET_LOW_BYTE(duties[i]), GET_HIGH_BYTE(duties[i]) };
+            size += lx16a::encode(frames + size, ids[i],
+                LOBOT_SERVO_OR_MOTOR_MODE_WRITE, params, 4);
+        }
+        if (size > 0)
+        {
+            bus.write(frames, size);
+        }
+    }
+
+    size_t LX16ADriver::sweep(const LX16AQuery *queries, LX16AReply *replies,
+        size_t count, double response_timeout)
+    {
+        LobotSerial bus(serial_, capture_.get());
+        const std::chrono::steady_clock::duration timeout
+            = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(response_timeout));
+
+        // Only one request is outstanding at a time, so stale input
+        // is discarded once rather than before each request.
+        LobotSerialDrain(bus);
+
+        size_t num_ok = 0;
+        lx16a::FrameParser parser;
+        uint8_t frame[lx16a::MAX_FRAME_SIZE];
+        uint8_t rxBuf[32];
+        for (size_t i = 0; i < count; ++i)
+        {
+            const LX16AQuery &query = queries[i];
+            LX16AReply &reply = replies[i];
+            reply.num_params = 0;
+
+            const size_t size = lx16a::encode(frame, query.id, query.command, nullptr, 0);
+            bus.write(frame, size);
+
+            parser.reset();
+            bool done = false;
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            const std::chrono::steady_clock::time_point deadline = now + timeout;
+            while (!done && now < deadline)
+            {
+                size_t n = 0;
+                if (bus.waitReadable(deadline))
+                {
+                    n = bus.read(rxBuf, std::min(bus.available(), sizeof(rxBuf)));
+                }
+                now = std::chrono::steady_clock::now();
+                for (size_t j = 0; j < n && !done; ++j)
+                {
+                    const lx16a::FrameParser::Result result = parser.parse(rxBuf[j]);
+                    if (result == lx16a::FrameParser::CHECKSUM_ERROR)
+                    {
+                        reply.status = LX16AReply::CHECKSUM_ERROR;
+                        done = true;
+                    }
+                    else if (result == lx16a::FrameParser::FRAME
+                        && parser.id() == query.id && parser.command() == query.command)
+                    {
+                        reply.num_params = parser.numParams();
+                        std::copy(parser.params(), parser.params() + reply.num_params,
+                            reply.params);
+                        reply.status = LX16AReply::OK;
+                        ++num_ok;
+                        done = true;
+                    }
+                }
+            }
+            if (!done)
+            {
+                reply.status = LX16AReply::TIMEOUT;
+            }
+            reply.stamp = now;
+        }
+        return num_ok;
+    }
+
+    bool LX16ADriver::setup(const std::vector<LX16AServoSetup> &setup,
+        double response_timeout, int max_attempts,
+        std::vector<LX16AServoStatus> &status)
+    {
+        LobotSerial bus(serial_, capture_.get());
+        const std::chrono::steady_clock::duration timeout
+            = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(response_timeout));
+
+        status.assign(setup.size(), LX16AServoStatus());
+
+        // Up to three frames per servo: offset, mode and load.
+        std::vector<uint8_t> frames;
+        frames.reserve(setup.size() * 3 * lx16a::MAX_FRAME_SIZE);
+
+        bool all_verified = false;
+        for (int attempt = 0; attempt < max_attempts && !all_verified; ++attempt)
+        {
+            // Configure every unverified servo in a single write. None of
+            // these commands has a reply so there is no need to wait between
+            // them.
+            frames.clear();
+            for (size_t i = 0; i < setup.size(); ++i)
+            {
+                if (status[i].verified)
+                    continue;
+
+                const LX16AServoSetup &s = setup[i];
+                uint8_t frame[lx16a::MAX_FRAME_SIZE];
+                size_t size;
+                if (s.set_offset)
+                {
+                    const uint8_t params[] = { static_cast<uint8_t>(s.offset) };
+                    size = lx16a::encode(frame, s.id,
+                        LOBOT_SERVO_ANGLE_OFFSET_ADJUST, params, 1);
+                    frames.insert(frames.end(), frame, frame + size);
+                }
+                {
+                    const uint8_t params[] = {
+                        s.mode, 0, GET_LOW_BYTE(s.duty), GET_HIGH_BYTE(s.duty) };
+                    size = lx16a::encode(frame, s.id,
+                        LOBOT_SERVO_OR_MOTOR_MODE_WRITE, params, 4);
+                    frames.insert(frames.end(), frame, frame + size);
+                }
+                if (s.load)
+                {
+                    const uint8_t params[] = { 1 };
+                    size = lx16a::encode(frame, s.id,
+                        LOBOT_SERVO_LOAD_OR_UNLOAD_WRITE, params, 1);
+                    frames.insert(frames.end(), frame, frame + size);
+                }
+                status[i].attempts++;
+            }
+            if (!frames.empty())
+            {
+                bus.write(frames.data(), frames.size());
+            }
+
+            // One verification sweep. The bus is half duplex so the replies
+            // are collected back to back, each bounded by the response timeout.
+            all_verified = true;
+            for (size_t i = 0; i < setup.size(); ++i)
+            {
+                if (status[i].verified)
+                    continue;
+
+                const LX16AServoSetup &s = setup[i];
+                LX16AServoStatus &st = status[i];
+                uint8_t params[lx16a::MAX_PARAMS];
+
+                bool offset_ok = true;
+                if (s.set_offset)
+                {
+                    offset_ok = false;
+                    if (LobotSerialServoQuery(bus, s.id,
+                        LOBOT_SERVO_ANGLE_OFFSET_READ, params, timeout) >= 1)
+                    {
+                        st.responding = true;
+                        st.offset = static_cast<int8_t>(params[0]);
+                        offset_ok = (st.offset == s.offset);
+                    }
+                }
+
+                bool mode_ok = false;
+                if (LobotSerialServoQuery(bus, s.id,
+                    LOBOT_SERVO_OR_MOTOR_MODE_READ, params, timeout) >= 1)
+                {
+                    st.responding = true;
+                    st.mode = params[0];
+                    mode_ok = (st.mode == s.mode);
+                }
+
+                if (LobotSerialServoQuery(bus, s.id,
+                    LOBOT_SERVO_POS_READ, params, timeout) >= 2)
+                {
+                    st.responding = true;
+                    st.position = lx16a::toInt16(params);
+                }
+
+                st.verified = offset_ok && mode_ok;
+                all_verified = all_verified && st.verified;
+            }
+        }
+        return all_verified;
+    }
+
+    bool LX16ADriver::startCapture(const std::string &path)
+    {
+        stopCapture();
+        capture_.reset(new LX16ABusCapture());
+        if (!capture_->open(path, serial_.getBaudrate()))
+        {
+            capture_.reset();
+            return false;
+        }
+        return true;
+    }
+
+    void LX16ADriver::stopCapture()
+    {
+        if (capture_)
+        {
+            capture_->close();
+            capture_.reset();
+        }
     }
 
     // Serial
@@ -0,0 +1,204 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#include "curio_base/lx16a_encoder_filter.h"
+
+#include <cmath>
+#include <cstdlib>
+
+namespace curio_base
+{
+    namespace
+    {
+        /// Map a servo position to [0, ENCODER_MAX)
+        int wrapPosition(int pos)
+        {
+            int p = pos % LX16AEncoderFilter::ENCODER_MAX;
+            return p < 0 ? p + LX16AEncoderFilter::ENCODER_MAX : p;
+        }
+    } // namespace
+
+    LX16AEncoderFilter::LX16AEncoderFilter(int max_delta, int max_rejections) :
+        max_delta_(max_delta),
+        max_rejections_(max_rejections),
+        rejections_(0),
+        rejected_pos_(0),
+        count_offset_(0),
+        revolutions_(0),
+        prev_valid_pos_(0),
+        servo_pos_(0),
+        duty_(0),
+        invert_(1),
+        valid_(false)
+    {
+    }
+
+    void LX16AEncoderFilter::reset(int pos)
+    {
+        pos = wrapPosition(pos);
+        servo_pos_      = pos;
+        duty_           = 0;
+        count_offset_   = pos;
+        revolutions_    = 0;
+        prev_valid_pos_ = pos;
+        rejections_     = 0;
+        valid_          = true;
+    }
+
+    bool LX16AEncoderFilter::restore(int count_offset, int revolutions, int last_valid_pos, int pos)
+    {
+        count_offset_   = count_offset;
+        revolutions_    = revolutions;
+        prev_valid_pos_ = wrapPosition(last_valid_pos);
+        rejections_     = 0;
+        duty_           = 0;
+        if (update(0, pos))
+            return true;
+
+        // Keep the count where it was saved and track from the new position.
+        servo_pos_ = wrapPosition(pos);
+        if (servo_pos_ < ENCODER_LOWER || servo_pos_ > ENCODER_UPPER)
+        {
+            count_offset_ += servo_pos_ - prev_valid_pos_;
+            prev_valid_pos_ = servo_pos_;
+            valid_ = true;
+        }
+        return false;
+    }
+
+    bool LX16AEncoderFilter::update(int16_t duty, int pos)
+    {
+        pos = wrapPosition(pos);
+        servo_pos_ = pos;
+        duty_ = duty;
+
+        // Reject positions in the invalid band
+        valid_ = pos < ENCODER_LOWER || pos > ENCODER_UPPER;
+        if (!valid_)
+            return false;
+
+        // Reject implausible jumps: the unwrapped change must be small.
+        // After max_rejections consecutive readings that agree with each
+        // other the wheel has moved while readings were missed, so re-sync.
+        if (std::abs(unwrapDelta(prev_valid_pos_, pos)) > max_delta_)
+        {
+            if (rejections_ > 0 && std::abs(unwrapDelta(rejected_pos_, pos)) <= max_delta_)
+                rejections_ += 1;
+            else
+                rejections_ = 1;
+            rejected_pos_ = pos;
+            if (rejections_ < max_rejections_)
+            {
+                valid_ = false;
+                return false;
+            }
+        }
+        rejections_ = 0;
+
+        // Count a revolution when the shortest change crosses the wrap
+        const int delta = pos - prev_valid_pos_;
+        revolutions_ += (unwrapDelta(prev_valid_pos_, pos) - delta) / ENCODER_MAX;
+        prev_valid_pos_ = pos;
+        return true;
+    }
+
+    int LX16AEncoderFilter::unwrapDelta(int from, int to)
+    {
+        int delta = to - from;
+        if (delta > ENCODER_MAX / 2)
+            delta -= ENCODER_MAX;
+        if (delta < -ENCODER_MAX / 2)
+            delta += ENCODER_MAX;
+        return delta;
+    }
+
+    int LX16AEncoderFilter::getRevolutions() const
+    {
+        return revolutions_;
+    }
+
+    int LX16AEncoderFilter::getCount() const
+    {
+        const int count = prev_valid_pos_ + ENCODER_MAX * revolutions_;
+        return invert_ * (count - count_offset_);
+    }
+
+    int LX16AEncoderFilter::getCountOffset() const
+    {
+        return count_offset_;
+    }
+
+    int LX16AEncoderFilter::getLastValidPos() const
+    {
+        return prev_valid_pos_;
+    }
+
+    int16_t LX16AEncoderFilter::getDuty() const
+    {
+        return duty_;
+    }
+
+    double LX16AEncoderFilter::getAngularPosition() const
+    {
+        return 2.0 * M_PI * getCount() / ENCODER_MAX;
+    }
+
+    int LX16AEncoderFilter::getServoPos() const
+    {
+        return servo_pos_;
+    }
+
+    bool LX16AEncoderFilter::isValid() const
+    {
+        return valid_;
+    }
+
+    void LX16AEncoderFilter::setInvert(bool is_inverted)
+    {
+        invert_ = is_inverted ? -1 : 1;
+    }
+
+    bool LX16AEncoderFilter::getInvert() const
+    {
+        return invert_ < 0;
+    }
+
+} // namespace curio_base
@@ -0,0 +1,192 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#include "curio_base/lx16a_protocol.h"
+
+namespace curio_base
+{
+    namespace lx16a
+    {
+        bool hasResponse(uint8_t command)
+        {
+            switch (command)
+            {
+                case 2:     // SERVO_MOVE_TIME_READ
+                case 8:     // SERVO_MOVE_TIME_WAIT_READ
+                case 14:    // SERVO_ID_READ
+                case 19:    // SERVO_ANGLE_OFFSET_READ
+                case 21:    // SERVO_ANGLE_LIMIT_READ
+                case 23:    // SERVO_VIN_LIMIT_READ
+                case 25:    // SERVO_TEMP_MAX_LIMIT_READ
+                case 26:    // SERVO_TEMP_READ
+                case 27:    // SERVO_VIN_READ
+                case 28:    // SERVO_POS_READ
+                case 30:    // SERVO_OR_MOTOR_MODE_READ
+                case 32:    // SERVO_LOAD_OR_UNLOAD_READ
+                case 34:    // SERVO_LED_CTRL_READ
+                case 36:    // SERVO_LED_ERROR_READ
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        size_t requestSize(uint8_t command)
+        {
+            switch (command)
+            {
+                case 1:     // SERVO_MOVE_TIME_WRITE
+                case 7:     // SERVO_MOVE_TIME_WAIT_WRITE
+                case 20:    // SERVO_ANGLE_LIMIT_WRITE
+                case 22:    // SERVO_VIN_LIMIT_WRITE
+                case 29:    // SERVO_OR_MOTOR_MODE_WRITE
+                    return FRAME_OVERHEAD + 4;
+                case 13:    // SERVO_ID_WRITE
+                case 17:    // SERVO_ANGLE_OFFSET_ADJUST
+                case 24:    // SERVO_TEMP_MAX_LIMIT_WRITE
+                case 31:    // SERVO_LOAD_OR_UNLOAD_WRITE
+                case 33:    // SERVO_LED_CTRL_WRITE
+                case 35:    // SERVO_LED_ERROR_WRITE
+                    return FRAME_OVERHEAD + 1;
+                case 11:    // SERVO_MOVE_START
+                case 12:    // SERVO_MOVE_STOP
+                case 18:    // SERVO_ANGLE_OFFSET_WRITE
+                    return FRAME_OVERHEAD;
+                default:
+                    return hasResponse(command) ? FRAME_OVERHEAD : 0;
+            }
+        }
+
+        size_t responseSize(uint8_t command)
+        {
+            switch (command)
+            {
+                case 2:     // SERVO_MOVE_TIME_READ
+                case 8:     // SERVO_MOVE_TIME_WAIT_READ
+                case 21:    // SERVO_ANGLE_LIMIT_READ
+                case 23:    // SERVO_VIN_LIMIT_READ
+                case 30:    // SERVO_OR_MOTOR_MODE_READ
+                    return FRAME_OVERHEAD + 4;
+                case 27:    // SERVO_VIN_READ
+                case 28:    // SERVO_POS_READ
+                    return FRAME_OVERHEAD + 2;
+                case 14:    // SERVO_ID_READ
+                case 19:    // SERVO_ANGLE_OFFSET_READ
+                case 25:    // SERVO_TEMP_MAX_LIMIT_READ
+                case 26:    // SERVO_TEMP_READ
+                case 32:    // SERVO_LOAD_OR_UNLOAD_READ
+                case 34:    // SERVO_LED_CTRL_READ
+                case 36:    // SERVO_LED_ERROR_READ
+                    return FRAME_OVERHEAD + 1;
+                default:
+                    return 0;
+            }
+        }
+
+        uint8_t checksum(const uint8_t* buf)
+        {
+            uint16_t sum = 0;
+            for (size_t i = 2; i < static_cast<size_t>(buf[3]) + 2; ++i)
+            {
+                sum += buf[i];
+            }
+            return static_cast<uint8_t>(~sum);
+        }
+
+        size_t encode(uint8_t* buf, uint8_t id, uint8_t command,
+            const uint8_t* params, size_t num_params)
+        {
+            if (num_params > MAX_PARAMS)
+                return 0;
+
+            buf[0] = buf[1] = FRAME_HEADER;
+            buf[2] = id;
+            buf[3] = static_cast<uint8_t>(num_params + 3);
+            buf[4] = command;
+            for (size_t i = 0; i < num_params; ++i)
+            {
+                buf[5 + i] = params[i];
+            }
+            buf[5 + num_params] = checksum(buf);
+            return num_params + FRAME_OVERHEAD;
+        }
+
+        FrameParser::FrameParser() :
+            count_(0)
+        {
+            buf_[0] = buf_[1] = FRAME_HEADER;
+            buf_[2] = 0;
+            buf_[3] = 3;
+            buf_[4] = 0;
+        }
+
+        FrameParser::Result FrameParser::parse(uint8_t byte)
+        {
+            // Synchronise on the double header
+            if (count_ < 2)
+            {
+                count_ = byte == FRAME_HEADER ? count_ + 1 : 0;
+                return INCOMPLETE;
+            }
+
+            buf_[count_++] = byte;
+
+            // Validate the length as soon as it arrives
+            if (count_ == 4 && (byte < 3 || byte > MAX_PARAMS + 3))
+            {
+                count_ = 0;
+                return INCOMPLETE;
+            }
+
+            if (count_ < 4 || count_ < static_cast<size_t>(buf_[3]) + 3)
+                return INCOMPLETE;
+
+            count_ = 0;
+            return checksum(buf_) == buf_[buf_[3] + 2] ? FRAME : CHECKSUM_ERROR;
+        }
+
+        void FrameParser::reset()
+        {
+            count_ = 0;
+        }
+
+    } // namespace lx16a
+} // namespace curio_base
@@ -0,0 +1,323 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#include "curio_base/lx16a_state_publisher.h"
+#include "curio_base/lx16a_protocol.h"
+
+#include <chrono>
+#include <exception>
+
+namespace curio_base
+{
+    LX16AStatePublisher::LX16AStatePublisher() :
+        name_("lx16a_state_publisher"),
+        response_timeout_(0.01),
+        num_servos_(0),
+        sweeps_(0),
+        read_failures_(0),
+        total_sweep_time_(0.0)
+    {
+    }
+
+    bool LX16AStatePublisher::init(ros::NodeHandle &nh, ros::NodeHandle &private_nh)
+    {
+        // Servos: the wheels then the steering
+        std::vector<int> wheel_ids;
+        std::vector<int> steer_ids;
+        private_nh.param("wheel_servo_ids", wheel_ids, wheel_ids);
+        private_nh.param("steer_servo_ids", steer_ids, steer_ids);
+        std::vector<int> ids(wheel_ids);
+        ids.insert(ids.end(), steer_ids.begin(), steer_ids.end());
+        if (ids.empty())
+        {
+            ROS_ERROR_STREAM_NAMED(name_, "Parameters 'wheel_servo_ids' or 'steer_servo_ids' are required.");
+            return false;
+        }
+        for (int id : ids)
+        {
+            if (id < 0 || id >= lx16a::BROADCAST_ID)
+            {
+                ROS_ERROR_STREAM_NAMED(name_, "Invalid servo id: " << id);
+                return false;
+            }
+        }
+
+        private_nh.param("sweep_response_timeout", response_timeout_, response_timeout_);
+        ROS_INFO_STREAM_NAMED(name_, "sweep_response_timeout: " << response_timeout_);
+
+        // LX-16A servo driver - port, baudrate and timeout are required
+        std::string port;
+        int baudrate = 0;
+        double timeout = 0.0;
+        if (!private_nh.getParam("port", port)
+            || !private_nh.getParam("baudrate", baudrate)
+            || !private_nh.getParam("timeout", timeout))
+        {
+            ROS_ERROR_STREAM_NAMED(name_, "Parameters 'port', 'baudrate' and 'timeout' are required.");
+            return false;
+        }
+
+        ROS_INFO_STREAM_NAMED(name_, "Opening connection to servo bus board...");
+        try
+        {
+            servo_driver_.setPort(port);
+            servo_driver_.setBaudrate(baudrate);
+            servo_driver_.setTimeout(static_cast<uint32_t>(timeout * 1000.0));
+            servo_driver_.open();
+        }
+        catch (const std::exception& e)
+        {
+            ROS_ERROR_STREAM_NAMED(name_, "Failed to open servo bus on " << port << ": " << e.what());
+            return false;
+        }
+        ROS_INFO_STREAM_NAMED(name_, "port: " << servo_driver_.getPort());
+        ROS_INFO_STREAM_NAMED(name_, "baudrate: " << servo_driver_.getBaudrate());
+
+        num_servos_ = ids.size();
+        if (!initSchedule(ids, private_nh))
+            return false;
+
+        queries_.resize(schedule_.getMaxSlots());
+        replies_.resize(schedule_.getMaxSlots());
+
+        // Preallocate the message
+        sweep_msg_.header.frame_id = "base_link";
+        sweep_msg_.id.resize(num_servos_);
+        sweep_msg_.position.assign(num_servos_, 0);
+        sweep_msg_.stamp.resize(num_servos_);
+        sweep_msg_.status.assign(num_servos_, 0);
+        sweep_msg_.vin.assign(num_servos_, 0);
+        sweep_msg_.temperature.assign(num_servos_, 0);
+        for (size_t i = 0; i < num_servos_; ++i)
+        {
+            sweep_msg_.id[i] = static_cast<uint8_t>(ids[i]);
+        }
+
+        sweep_pub_ = nh.advertise<LX16ASweep>("servo/sweep", 10);
+        return true;
+    }
+
+    bool LX16AStatePublisher::initSchedule(const std::vector<int> &ids,
+        ros::NodeHandle &private_nh)
+    {
+        // Telemetry rates for each servo, 0 to disable
+        double vin_rate = 0.5;
+        double temperature_rate = 0.1;
+        private_nh.param("vin_rate", vin_rate, vin_rate);
+        private_nh.param("temperature_rate", temperature_rate, temperature_rate);
+        ROS_INFO_STREAM_NAMED(name_, "vin_rate: " << vin_rate);
+        ROS_INFO_STREAM_NAMED(name_, "temperature_rate: " << temperature_rate);
+
+        // Positions every sweep, then the telemetry
+        std::vector<LX16ABusTask> tasks;
+        task_servo_.clear();
+        for (size_t i = 0; i < ids.size(); ++i)
+        {
+            tasks.push_back(LX16ABusTask(ids[i], lx16a::POS_READ, 0.0, 2));
+            task_servo_.push_back(i);
+        }
+        for (size_t i = 0; i < ids.size() && vin_rate > 0.0; ++i)
+        {
+            tasks.push_back(LX16ABusTask(ids[i], lx16a::VIN_READ, vin_rate, 1));
+            task_servo_.push_back(i);
+        }
+        for (size_t i = 0; i < ids.size() && temperature_rate > 0.0; ++i)
+        {
+            tasks.push_back(LX16ABusTask(ids[i], lx16a::TEMP_READ, temperature_rate, 0));
+            task_servo_.push_back(i);
+        }
+
+        // Bus timing, the turnaround is measured unless set
+        LX16ABusSchedule::Params params;
+        params.baudrate = servo_driver_.getBaudrate();
+        double turnaround = 0.0;
+        private_nh.param("bus_turnaround", turnaround, turnaround);
+        private_nh.param("bus_max_utilisation", params.max_utilisation, params.max_utilisation);
+        if (turnaround > 0.0)
+        {
+            params.turnaround = turnaround;
+        }
+        else
+        {
+            turnaround = LX16ABusSchedule::measureTurnaround(
+                servo_driver_, static_cast<uint8_t>(ids[0]), 20, response_timeout_);
+            if (turnaround < 0.0)
+            {
+                ROS_WARN_STREAM_NAMED(name_, "Servo " << ids[0] << " did not reply,"
+                    << " using a bus turnaround of " << params.turnaround * 1.0E3 << " ms");
+            }
+            else
+            {
+                params.turnaround = turnaround;
+            }
+        }
+        ROS_INFO_STREAM_NAMED(name_, "bus_turnaround: " << params.turnaround * 1.0E3 << " ms");
+
+        // The sweep rate, or the highest rate the bus allows
+        double sweep_frequency = 0.0;
+        private_nh.param("sweep_frequency", sweep_frequency, sweep_frequency);
+        const double min_period = LX16ABusSchedule::findMinPeriod(tasks, params);
+        if (min_period > 0.0)
+        {
+            ROS_INFO_STREAM_NAMED(name_, "Bus capacity: " << 1.0 / min_period << " sweeps/s");
+        }
+        params.period = sweep_frequency > 0.0 ? 1.0 / sweep_frequency : min_period;
+        if (params.period <= 0.0)
+        {
+            ROS_ERROR_STREAM_NAMED(name_, "The servo reads do not fit on the bus at any sweep rate.");
+            return false;
+        }
+
+        std::string error;
+        if (!schedule_.build(tasks, params, error))
+        {
+            ROS_ERROR_STREAM_NAMED(name_, "The servo reads do not fit in the sweep period: " << error);
+            return false;
+        }
+        ROS_INFO_STREAM_NAMED(name_, "Bus schedule: " << schedule_.toString());
+        return true;
+    }
+
+    void LX16AStatePublisher::update(const ros::Time &time)
+    {
+        // The reads of this sweep
+        const size_t count = schedule_.getNumSlots(sweeps_);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const LX16ABusTask &task = schedule_.getTasks()[schedule_.getTaskIndex(sweeps_, i)];
+            queries_[i] = LX16AQuery(task.id, task.command);
+        }
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        servo_driver_.sweep(queries_.data(), replies_.data(), count, response_timeout_);
+
+        for (size_t i = 0; i < num_servos_; ++i)
+        {
+            sweep_msg_.status[i] = 0;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const LX16AQuery &query = queries_[i];
+            const LX16AReply &reply = replies_[i];
+            const size_t servo = task_servo_[schedule_.getTaskIndex(sweeps_, i)];
+            uint8_t &status = sweep_msg_.status[servo];
+            if (reply.status == LX16AReply::CHECKSUM_ERROR)
+            {
+                status |= LX16ASweep::STATUS_CHECKSUM_ERROR;
+            }
+
+            if (query.command == lx16a::POS_READ)
+            {
+                // Reply stamps are steady clock times, place them relative to time.
+                sweep_msg_.stamp[servo] = time + ros::Duration(
+                    std::chrono::duration<double>(reply.stamp - start).count());
+                if (reply.status == LX16AReply::OK && reply.num_params >= 2)
+                {
+                    sweep_msg_.position[servo] = lx16a::toInt16(reply.params);
+                    status |= LX16ASweep::STATUS_POSITION;
+                }
+                else
+                {
+                    ++read_failures_;
+                }
+            }
+            else if (reply.status != LX16AReply::OK)
+            {
+                continue;
+            }
+            else if (query.command == lx16a::VIN_READ && reply.num_params >= 2)
+            {
+                sweep_msg_.vin[servo] = static_cast<uint16_t>(lx16a::toInt16(reply.params));
+                status |= LX16ASweep::STATUS_VIN;
+            }
+            else if (query.command == lx16a::TEMP_READ && reply.num_params >= 1)
+            {
+                sweep_msg_.temperature[servo] = reply.params[0];
+                status |= LX16ASweep::STATUS_TEMPERATURE;
+            }
+        }
+
+        const double duration = count == 0 ? 0.0
+            : std::chrono::duration<double>(replies_[count - 1].stamp - start).count();
+        total_sweep_time_ += duration;
+        const double slack = schedule_.recordCycle(duration);
+        if (slack < 0.0)
+        {
+            ROS_WARN_STREAM_THROTTLE_NAMED(1.0, name_, "Sweep overran its period by "
+                << -slack * 1.0E3 << " ms (" << schedule_.getOverruns() << " overruns in "
+                << schedule_.getCycles() << " sweeps)");
+        }
+
+        sweep_msg_.header.stamp = time;
+        sweep_msg_.sweep = static_cast<uint32_t>(sweeps_);
+        sweep_msg_.duration = static_cast<float>(duration);
+        sweep_msg_.slack = static_cast<float>(slack);
+        sweep_pub_.publish(sweep_msg_);
+
+        ++sweeps_;
+    }
+
+    double LX16AStatePublisher::getPeriod() const
+    {
+        return schedule_.getPeriod();
+    }
+
+    const LX16ABusSchedule& LX16AStatePublisher::getSchedule() const
+    {
+        return schedule_;
+    }
+
+    uint64_t LX16AStatePublisher::getSweeps() const
+    {
+        return sweeps_;
+    }
+
+    uint64_t LX16AStatePublisher::getReadFailures() const
+    {
+        return read_failures_;
+    }
+
+    double LX16AStatePublisher::getMeanSweepTime() const
+    {
+        return sweeps_ == 0 ? 0.0 : total_sweep_time_ / sweeps_;
+    }
+
+} // namespace curio_base
@@ -0,0 +1,96 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#include "curio_base/lx16a_state_publisher.h"
+#include "curio_base/realtime_loop.h"
+
+#include <ros/ros.h>
+
+int main(int argc, char *argv[])
+{
+    // Initialise node.
+    ros::init(argc, argv, "lx16a_state_publisher");
+    ros::NodeHandle nh, private_nh("~");
+    ROS_INFO("Starting LX-16A state publisher");
+
+    curio_base::LX16AStatePublisher publisher;
+    if (!publisher.init(nh, private_nh))
+    {
+        ROS_FATAL("Failed to initialise LX-16A state publisher");
+        return 1;
+    }
+
+    // The sweep period is set by the sweep_frequency parameter, or
+    // computed from the bus capacity if it is zero.
+    int realtime_priority = 0;
+    int cpu_affinity = -1;
+    private_nh.param("realtime_priority", realtime_priority, realtime_priority);
+    private_nh.param("cpu_affinity", cpu_affinity, cpu_affinity);
+    ROS_INFO_STREAM("sweep_frequency: " << 1.0 / publisher.getPeriod());
+
+    curio_base::RealtimeLoop loop(1.0 / publisher.getPeriod());
+    loop.setPriority(realtime_priority);
+    loop.setCpu(cpu_affinity);
+    if (!loop.configure())
+    {
+        ROS_WARN("Running the sweep loop without all requested real-time settings");
+    }
+
+    loop.start();
+    while (ros::ok())
+    {
+        publisher.update(ros::Time::now());
+        loop.sleep();
+
+        ROS_INFO_STREAM_THROTTLE(10.0, "Sweeps: " << publisher.getSweeps()
+            << ", mean sweep time: " << publisher.getMeanSweepTime() * 1.0E3 << " ms"
+            << ", min slack: " << publisher.getSchedule().getMinSlack() * 1.0E3 << " ms"
+            << ", failed reads: " << publisher.getReadFailures());
+    }
+
+    ROS_INFO_STREAM("Sweeps: " << publisher.getSweeps()
+        << ", mean sweep time: " << publisher.getMeanSweepTime() * 1.0E3 << " ms"
+        << ", min slack: " << publisher.getSchedule().getMinSlack() * 1.0E3 << " ms"
+        << ", bus overruns: " << publisher.getSchedule().getOverruns()
+        << ", failed reads: " << publisher.getReadFailures()
+        << ", loop overruns: " << loop.getOverruns());
+
+    return 0;
+}
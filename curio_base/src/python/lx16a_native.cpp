@@ -0,0 +1,376 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+/**
+ * \brief Python bindings for the C++ LX-16A servo driver and encoder filter.
+ *
+ * The classes follow the interface of the pure Python modules
+ * curio_base.lx16a_driver and curio_base.lx16a_encoder_filter so they may
+ * be used in their place:
+ *
+ *   from curio_base.lx16a_native import LX16ADriver
+ *   from curio_base.lx16a_native import LX16AEncoderFilter
+ *
+ * Calls that talk to the servo bus release the GIL, and the batched calls
+ * (pos_read_all, LX16AEncoderFilterArray.update, ...) process every servo
+ * in a single call so other Python threads run while the bus is busy.
+ */
+
+#include "curio_base/lx16a_driver.h"
+#include "curio_base/lx16a_encoder_filter.h"
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace py = pybind11;
+
+namespace curio_base
+{
+    namespace
+    {
+        /**
+         * \brief The C++ LX-16A driver with the Python driver interface.
+         *
+         * Errors are reported as in the Python driver: failed reads return -1.
+         * The serial timeout is in seconds.
+         */
+        class PyLX16ADriver
+        {
+        public:
+            PyLX16ADriver() : timeout_(0.0)
+            {
+            }
+
+            void open() { driver_.open(); }
+
+            void close()
+            {
+                if (driver_.isOpen())
+                    driver_.close();
+            }
+
+            bool isOpen() const { return driver_.isOpen(); }
+
+            std::string getPort() const { return driver_.getPort(); }
+
+            void setPort(const std::string &port) { driver_.setPort(port); }
+
+            uint32_t getBaudrate() const { return driver_.getBaudrate(); }
+
+            void setBaudrate(uint32_t baudrate) { driver_.setBaudrate(baudrate); }
+
+            double getTimeout() const { return timeout_; }
+
+            void setTimeout(double timeout)
+            {
+                timeout_ = timeout;
+                driver_.setTimeout(static_cast<uint32_t>(std::lround(timeout * 1000.0)));
+            }
+
+            void moveTimeWrite(uint8_t servo_id, int16_t servo_pos, uint16_t move_time)
+            {
+                driver_.move(servo_id, servo_pos, move_time);
+            }
+
+            void angleOffsetAdjust(uint8_t servo_id, int deviation)
+            {
+                driver_.angleAdjust(servo_id, static_cast<uint8_t>(deviation));
+            }
+
+            int posRead(uint8_t servo_id)
+            {
+                return driver_.readPosition(servo_id);
+            }
+
+            double vinRead(uint8_t servo_id)
+            {
+                // A failed read is negative, the supply voltage never is
+                const int vin = driver_.readVin(servo_id);
+                return vin < 0 ? -1.0 : vin / 1000.0;
+            }
+
+            void motorModeWrite(uint8_t servo_id, int16_t duty)
+            {
+                driver_.setMode(servo_id, 1, duty);
+            }
+
+            void servoModeWrite(uint8_t servo_id)
+            {
+                driver_.setMode(servo_id, 0, 0);
+            }
+
+            std::vector<int> posReadAll(const std::vector<uint8_t> &ids)
+            {
+                std::vector<int> positions(ids.size());
+                for (size_t i = 0; i < ids.size(); ++i)
+                {
+                    positions[i] = posRead(ids[i]);
+                }
+                return positions;
+            }
+
+            void moveTimeWriteGroup(const std::vector<uint8_t> &ids,
+                const std::vector<int16_t> &positions, uint16_t move_time)
+            {
+                if (positions.size() != ids.size())
+                    throw std::invalid_argument("ids and positions must have the same length");
+                driver_.moveGroup(ids.data(), positions.data(), ids.size(), move_time);
+            }
+
+            void motorModeWriteGroup(const std::vector<uint8_t> &ids,
+                const std::vector<int16_t> &duties)
+            {
+                if (duties.size() != ids.size())
+                    throw std::invalid_argument("ids and duties must have the same length");
+                driver_.setModeGroup(ids.data(), 1, duties.data(), ids.size());
+            }
+
+            void servoModeWriteGroup(const std::vector<uint8_t> &ids)
+            {
+                const std::vector<int16_t> duties(ids.size(), 0);
+                driver_.setModeGroup(ids.data(), 0, duties.data(), ids.size());
+            }
+
+            void stopAll()
+            {
+                driver_.broadcastStop();
+            }
+
+        private:
+            LX16ADriver driver_;
+            double timeout_;
+        };
+
+        /**
+         * \brief Update a filter from a position read with the Python driver
+         *        interface, where -1 is a failed read. In motor mode other
+         *        negative positions are valid.
+         */
+        bool updateFilter(LX16AEncoderFilter &filter, int16_t duty, int pos)
+        {
+            if (pos == -1)
+                return false;
+            return filter.update(duty, pos);
+        }
+
+        /**
+         * \brief A fixed set of encoder filters updated together, one per wheel.
+         */
+        class LX16AEncoderFilterArray
+        {
+        public:
+            LX16AEncoderFilterArray(size_t size, int max_delta) :
+                filters_(size, LX16AEncoderFilter(max_delta))
+            {
+            }
+
+            size_t size() const { return filters_.size(); }
+
+            LX16AEncoderFilter &at(long i)
+            {
+                if (i < 0)
+                    i += static_cast<long>(filters_.size());
+                if (i < 0 || i >= static_cast<long>(filters_.size()))
+                    throw py::index_error("encoder filter index out of range");
+                return filters_[i];
+            }
+
+            void reset(const std::vector<int> &positions)
+            {
+                checkSize(positions.size());
+                for (size_t i = 0; i < filters_.size(); ++i)
+                {
+                    filters_[i].reset(positions[i]);
+                }
+            }
+
+            std::vector<bool> update(const std::vector<int16_t> &duties,
+                const std::vector<int> &positions)
+            {
+                checkSize(duties.size());
+                checkSize(positions.size());
+                std::vector<bool> valid(filters_.size());
+                for (size_t i = 0; i < filters_.size(); ++i)
+                {
+                    valid[i] = updateFilter(filters_[i], duties[i], positions[i]);
+                }
+                return valid;
+            }
+
+            std::vector<int> getCounts() const
+            {
+                std::vector<int> counts(filters_.size());
+                for (size_t i = 0; i < filters_.size(); ++i)
+                {
+                    counts[i] = filters_[i].getCount();
+                }
+                return counts;
+            }
+
+            std::vector<double> getAngularPositions() const
+            {
+                std::vector<double> angles(filters_.size());
+                for (size_t i = 0; i < filters_.size(); ++i)
+                {
+                    angles[i] = filters_[i].getAngularPosition();
+                }
+                return angles;
+            }
+
+        private:
+            void checkSize(size_t size) const
+            {
+                if (size != filters_.size())
+                    throw std::invalid_argument("expected one entry per encoder filter");
+            }
+
+            std::vector<LX16AEncoderFilter> filters_;
+        };
+    } // namespace
+} // namespace curio_base
+
+PYBIND11_MODULE(lx16a_native, m)
+{
+    using curio_base::LX16AEncoderFilter;
+    using curio_base::LX16AEncoderFilterArray;
+    using curio_base::PyLX16ADriver;
+    typedef py::call_guard<py::gil_scoped_release> release_gil;
+
+    m.doc() = "Native LX-16A servo driver and encoder filter";
+
+    py::class_<PyLX16ADriver>(m, "LX16ADriver",
+        "Serial driver for the Lewansoul LX-16A servo bus board")
+        .def(py::init<>())
+        .def("open", &PyLX16ADriver::open, release_gil())
+        .def("close", &PyLX16ADriver::close, release_gil())
+        .def("is_open", &PyLX16ADriver::isOpen)
+        .def("get_port", &PyLX16ADriver::getPort)
+        .def("set_port", &PyLX16ADriver::setPort, py::arg("port"))
+        .def("get_baudrate", &PyLX16ADriver::getBaudrate)
+        .def("set_baudrate", &PyLX16ADriver::setBaudrate, py::arg("baudrate"))
+        .def("get_timeout", &PyLX16ADriver::getTimeout)
+        .def("set_timeout", &PyLX16ADriver::setTimeout, py::arg("timeout"))
+        .def("move_time_write", &PyLX16ADriver::moveTimeWrite,
+            py::arg("servo_id"), py::arg("servo_pos"), py::arg("move_time") = 0,
+            release_gil())
+        .def("angle_offset_adjust", &PyLX16ADriver::angleOffsetAdjust,
+            py::arg("servo_id"), py::arg("deviation"), release_gil())
+        .def("pos_read", &PyLX16ADriver::posRead,
+            py::arg("servo_id"), release_gil())
+        .def("vin_read", &PyLX16ADriver::vinRead,
+            py::arg("servo_id"), release_gil())
+        .def("motor_mode_write", &PyLX16ADriver::motorModeWrite,
+            py::arg("servo_id"), py::arg("duty"), release_gil())
+        .def("servo_mode_write", &PyLX16ADriver::servoModeWrite,
+            py::arg("servo_id"), release_gil())
+        .def("pos_read_all", &PyLX16ADriver::posReadAll,
+            "Read the position of each servo, -1 for a failed read",
+            py::arg("servo_ids"), release_gil())
+        .def("move_time_write_group", &PyLX16ADriver::moveTimeWriteGroup,
+            "Move a group of servos so that they start together",
+            py::arg("servo_ids"), py::arg("servo_pos"), py::arg("move_time") = 0,
+            release_gil())
+        .def("motor_mode_write_group", &PyLX16ADriver::motorModeWriteGroup,
+            "Set a group of servos to motor mode with the given duties",
+            py::arg("servo_ids"), py::arg("duties"), release_gil())
+        .def("servo_mode_write_group", &PyLX16ADriver::servoModeWriteGroup,
+            "Set a group of servos to servo mode",
+            py::arg("servo_ids"), release_gil())
+        .def("stop_all", &PyLX16ADriver::stopAll,
+            "Stop every servo on the bus with one broadcast frame",
+            release_gil());
+
+    // The classifier arguments are accepted so the class can replace the
+    // Python filter, the native filter rejects invalid positions using a
+    // fixed band instead.
+    py::class_<LX16AEncoderFilter>(m, "LX16AEncoderFilter",
+        "An encoder filter for the LX-16A servo")
+        .def(py::init([](py::object, py::object, int, int max_delta)
+            {
+                return LX16AEncoderFilter(max_delta);
+            }),
+            py::arg("classifier_filename") = py::none(),
+            py::arg("regressor_filename") = py::none(),
+            py::arg("window") = 10,
+            py::arg("max_delta") = 300)
+        .def("update", [](LX16AEncoderFilter &self, py::object, int16_t duty, int pos)
+            {
+                return curio_base::updateFilter(self, duty, pos);
+            },
+            py::arg("ros_time"), py::arg("duty"), py::arg("pos"))
+        .def("reset", &LX16AEncoderFilter::reset, py::arg("pos"))
+        .def("get_revolutions", &LX16AEncoderFilter::getRevolutions)
+        .def("get_count", &LX16AEncoderFilter::getCount)
+        .def("get_duty", &LX16AEncoderFilter::getDuty)
+        .def("get_angular_position", &LX16AEncoderFilter::getAngularPosition)
+        .def("get_servo_pos", [](const LX16AEncoderFilter &self, bool)
+            {
+                // The native filter only keeps the mapped position.
+                return py::make_tuple(self.getServoPos(), self.isValid());
+            },
+            py::arg("map_pos") = true)
+        .def("get_invert", [](const LX16AEncoderFilter &self)
+            {
+                return self.getInvert() ? -1 : 1;
+            })
+        .def("set_invert", &LX16AEncoderFilter::setInvert, py::arg("is_inverted"));
+
+    py::class_<LX16AEncoderFilterArray>(m, "LX16AEncoderFilterArray",
+        "A fixed set of LX-16A encoder filters updated together")
+        .def(py::init<size_t, int>(), py::arg("size"), py::arg("max_delta") = 300)
+        .def("__len__", &LX16AEncoderFilterArray::size)
+        .def("__getitem__", &LX16AEncoderFilterArray::at,
+            py::return_value_policy::reference_internal, py::arg("i"))
+        .def("reset", &LX16AEncoderFilterArray::reset,
+            "Reset each filter to the given position",
+            py::arg("positions"), release_gil())
+        .def("update", &LX16AEncoderFilterArray::update,
+            "Update each filter, returns whether each position was accepted",
+            py::arg("duties"), py::arg("positions"), release_gil())
+        .def("get_counts", &LX16AEncoderFilterArray::getCounts, release_gil())
+        .def("get_angular_positions", &LX16AEncoderFilterArray::getAngularPositions,
+            release_gil());
+}
@@ -0,0 +1,164 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#include "curio_base/realtime_failsafe.h"
+
+namespace curio_base
+{
+    RealtimeFailsafe::RealtimeFailsafe() :
+        last_command_ns_(0),
+        overruns_(0),
+        pending_(0),
+        faults_(0),
+        reset_requested_(false),
+        trips_(0),
+        vin_(-1)
+    {
+    }
+
+    void RealtimeFailsafe::configure(const Params& params, size_t num_servos)
+    {
+        params_ = params;
+        read_failures_.assign(num_servos, 0);
+        overruns_ = 0;
+        pending_ = 0;
+        faults_.store(0, std::memory_order_release);
+        reset_requested_.store(false, std::memory_order_relaxed);
+    }
+
+    void RealtimeFailsafe::commandReceived(const ros::Time& time)
+    {
+        last_command_ns_.store(static_cast<int64_t>(time.toNSec()), std::memory_order_relaxed);
+    }
+
+    void RealtimeFailsafe::servoRead(size_t index, bool responded)
+    {
+        int& failures = read_failures_[index];
+        failures = responded ? 0 : failures + 1;
+        if (params_.max_read_failures > 0 && failures >= params_.max_read_failures)
+        {
+            pending_ |= FAULT_SERVO_RESPONSE;
+        }
+    }
+
+    void RealtimeFailsafe::vinRead(int vin)
+    {
+        // A failed read is left to the response check
+        if (vin < 0)
+            return;
+
+        vin_.store(vin, std::memory_order_relaxed);
+        if (params_.min_vin > 0 && vin < params_.min_vin)
+        {
+            pending_ |= FAULT_LOW_VOLTAGE;
+        }
+    }
+
+    bool RealtimeFailsafe::update(const ros::Time& time, const ros::Duration& period, bool driving)
+    {
+        if (reset_requested_.exchange(false, std::memory_order_acq_rel))
+        {
+            faults_.store(0, std::memory_order_release);
+            overruns_ = 0;
+        }
+
+        // The wheels should stop by themselves when commands stop, so only
+        // a stale command that still drives them is a fault.
+        if (params_.command_timeout > 0.0 && driving)
+        {
+            const int64_t age_ns = static_cast<int64_t>(time.toNSec())
+                - last_command_ns_.load(std::memory_order_relaxed);
+            if (age_ns > static_cast<int64_t>(params_.command_timeout * 1.0E9))
+            {
+                pending_ |= FAULT_COMMAND_TIMEOUT;
+            }
+        }
+
+        overruns_ = period.toSec() > params_.max_cycle_time ? overruns_ + 1 : 0;
+        if (params_.max_overruns > 0 && overruns_ >= params_.max_overruns)
+        {
+            pending_ |= FAULT_OVERRUN;
+        }
+
+        if (pending_ != 0)
+        {
+            trip(pending_);
+            pending_ = 0;
+        }
+        return isTripped();
+    }
+
+    void RealtimeFailsafe::requestReset()
+    {
+        reset_requested_.store(true, std::memory_order_release);
+    }
+
+    std::string RealtimeFailsafe::toString(uint32_t faults)
+    {
+        if (faults == 0)
+            return "none";
+
+        std::string s;
+        const auto append = [&s](const char* name)
+        {
+            s += s.empty() ? name : std::string(", ") + name;
+        };
+        if (faults & FAULT_COMMAND_TIMEOUT)
+            append("command timeout");
+        if (faults & FAULT_SERVO_RESPONSE)
+            append("servo not responding");
+        if (faults & FAULT_LOW_VOLTAGE)
+            append("low supply voltage");
+        if (faults & FAULT_OVERRUN)
+            append("control loop overrun");
+        return s;
+    }
+
+    void RealtimeFailsafe::trip(uint32_t fault)
+    {
+        const uint32_t previous = faults_.fetch_or(fault, std::memory_order_acq_rel);
+        if (previous == 0)
+        {
+            trips_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+} // namespace curio_base
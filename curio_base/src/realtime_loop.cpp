@@ -0,0 +1,255 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#include "curio_base/realtime_loop.h"
+
+#include <ros/ros.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <alloca.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace curio_base
+{
+    namespace
+    {
+        const int64_t NSEC_PER_SEC = 1000000000LL;
+
+        int64_t toNanoseconds(const struct timespec& ts)
+        {
+            return static_cast<int64_t>(ts.tv_sec) * NSEC_PER_SEC + ts.tv_nsec;
+        }
+
+        struct timespec fromNanoseconds(int64_t ns)
+        {
+            struct timespec ts;
+            ts.tv_sec = ns / NSEC_PER_SEC;
+            ts.tv_nsec = ns % NSEC_PER_SEC;
+            return ts;
+        }
+
+        int64_t monotonicNow()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return toNanoseconds(ts);
+        }
+    } // namespace
+
+    RealtimeLoop::RealtimeLoop(double frequency) :
+        period_ns_(static_cast<int64_t>(NSEC_PER_SEC / frequency)),
+        priority_(0),
+        cpu_(-1),
+        lock_memory_(false),
+        prefault_stack_size_(0),
+        last_wake_ns_(0),
+        max_latency_ns_(0),
+        cycles_(0),
+        overruns_(0),
+        missed_deadlines_(0)
+    {
+        deadline_.tv_sec = 0;
+        deadline_.tv_nsec = 0;
+    }
+
+    void RealtimeLoop::setPriority(int priority)
+    {
+        priority_ = priority;
+    }
+
+    void RealtimeLoop::setCpu(int cpu)
+    {
+        cpu_ = cpu;
+    }
+
+    void RealtimeLoop::setLockMemory(bool lock_memory)
+    {
+        lock_memory_ = lock_memory;
+    }
+
+    void RealtimeLoop::setPrefaultStackSize(size_t size)
+    {
+        prefault_stack_size_ = size;
+    }
+
+    bool RealtimeLoop::configure()
+    {
+        bool ok = true;
+
+        if (lock_memory_)
+        {
+            if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+            {
+                ROS_WARN_STREAM("mlockall failed: " << std::strerror(errno));
+                ok = false;
+            }
+            else
+            {
+                ROS_INFO_STREAM("Locked process memory");
+            }
+        }
+
+        if (prefault_stack_size_ > 0)
+        {
+            prefaultStack(prefault_stack_size_);
+            ROS_INFO_STREAM("Prefaulted " << prefault_stack_size_ << " bytes of stack");
+        }
+
+        if (cpu_ >= 0)
+        {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(cpu_, &cpuset);
+            const int err = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+            if (err != 0)
+            {
+                ROS_WARN_STREAM("Failed to set CPU affinity to " << cpu_ << ": " << std::strerror(err));
+                ok = false;
+            }
+            else
+            {
+                ROS_INFO_STREAM("Set CPU affinity: " << cpu_);
+            }
+        }
+
+        if (priority_ > 0)
+        {
+            struct sched_param param;
+            std::memset(&param, 0, sizeof(param));
+            param.sched_priority = priority_;
+            const int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+            if (err != 0)
+            {
+                ROS_WARN_STREAM("Failed to set SCHED_FIFO priority " << priority_ << ": " << std::strerror(err)
+                    << ". Check the rtprio limit for this user.");
+                ok = false;
+            }
+            else
+            {
+                ROS_INFO_STREAM("Set SCHED_FIFO priority: " << priority_);
+            }
+        }
+
+        return ok;
+    }
+
+    void RealtimeLoop::start()
+    {
+        last_wake_ns_ = monotonicNow();
+        deadline_ = fromNanoseconds(last_wake_ns_ + period_ns_);
+    }
+
+    double RealtimeLoop::sleep()
+    {
+        int64_t deadline_ns = toNanoseconds(deadline_);
+
+        // Detect an overrun and skip the deadlines that have been missed
+        // rather than running a burst of short cycles to catch up.
+        const int64_t now = monotonicNow();
+        if (now > deadline_ns)
+        {
+            const int64_t missed = (now - deadline_ns) / period_ns_ + 1;
+            ++overruns_;
+            missed_deadlines_ += missed;
+            deadline_ns += missed * period_ns_;
+            deadline_ = fromNanoseconds(deadline_ns);
+        }
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline_, NULL) == EINTR)
+        {
+        }
+
+        const int64_t wake = monotonicNow();
+        const int64_t latency = wake - deadline_ns;
+        if (latency > max_latency_ns_)
+        {
+            max_latency_ns_ = latency;
+        }
+
+        const double period = static_cast<double>(wake - last_wake_ns_) / NSEC_PER_SEC;
+        last_wake_ns_ = wake;
+        deadline_ = fromNanoseconds(deadline_ns + period_ns_);
+        ++cycles_;
+        return period;
+    }
+
+    double RealtimeLoop::getPeriod() const
+    {
+        return static_cast<double>(period_ns_) / NSEC_PER_SEC;
+    }
+
+    uint64_t RealtimeLoop::getCycles() const
+    {
+        return cycles_;
+    }
+
+    uint64_t RealtimeLoop::getOverruns() const
+    {
+        return overruns_;
+    }
+
+    uint64_t RealtimeLoop::getMissedDeadlines() const
+    {
+        return missed_deadlines_;
+    }
+
+    double RealtimeLoop::getMaxLatency() const
+    {
+        return static_cast<double>(max_latency_ns_) / NSEC_PER_SEC;
+    }
+
+    void RealtimeLoop::prefaultStack(size_t size)
+    {
+        // volatile prevents the writes being optimised away
+        volatile char* stack = static_cast<volatile char*>(alloca(size));
+        const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        for (size_t i = 0; i < size; i += page_size)
+        {
+            stack[i] = 0;
+        }
+    }
+
+} // namespace curio_base
@@ -0,0 +1,277 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#include "curio_base/servo_state_bus.h"
+
+#include <ros/console.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace curio_base
+{
+    namespace
+    {
+        const char MAGIC[8] = { 'S', 'E', 'R', 'V', 'O', 'B', 'U', 'S' };
+
+        /// Attempts to read a consistent latest state before giving up
+        const int MAX_READ_ATTEMPTS = 16;
+
+        uint64_t monotonicNanoseconds()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+        }
+    }
+
+    const size_t ServoState::NUM_WHEELS;
+    const size_t ServoState::NUM_STEERS;
+    const uint32_t ServoStateBus::HISTORY;
+    const uint32_t ServoStateBus::VERSION;
+
+    ServoStateBus::ServoStateBus() :
+        file_(nullptr),
+        writer_(false),
+        history_(false)
+    {
+    }
+
+    ServoStateBus::~ServoStateBus()
+    {
+        close();
+    }
+
+    bool ServoStateBus::create(const std::string& path, bool history)
+    {
+        close();
+
+        // Replace rather than truncate the file of a previous run: readers
+        // that still map it keep a valid (stale) mapping instead of
+        // faulting, and reopen the path to follow the new writer.
+        unlink(path.c_str());
+        const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0)
+        {
+            ROS_ERROR_STREAM("Failed to create servo state bus " << path
+                << ": " << std::strerror(errno));
+            return false;
+        }
+
+        bool ok = ftruncate(fd, sizeof(File)) == 0;
+        void* addr = ok ? mmap(nullptr, sizeof(File), PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0) : MAP_FAILED;
+        const int error = errno;
+        ::close(fd);
+        if (addr == MAP_FAILED)
+        {
+            ROS_ERROR_STREAM("Failed to map servo state bus " << path
+                << ": " << std::strerror(error));
+            return false;
+        }
+        file_ = static_cast<File*>(addr);
+        writer_ = true;
+        history_ = history;
+
+        // The new file is zero filled. The magic is written last so readers
+        // never accept a partial header.
+        file_->version = VERSION;
+        file_->history = history ? HISTORY : 0;
+        file_->state_size = sizeof(ServoState);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(file_->magic, MAGIC, sizeof(MAGIC));
+        return true;
+    }
+
+    bool ServoStateBus::open(const std::string& path)
+    {
+        close();
+
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            ROS_ERROR_STREAM("Failed to open servo state bus " << path
+                << ": " << std::strerror(errno));
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size != static_cast<off_t>(sizeof(File)))
+        {
+            ROS_ERROR_STREAM("Servo state bus " << path << " has an unexpected size");
+            ::close(fd);
+            return false;
+        }
+        void* addr = mmap(nullptr, sizeof(File), PROT_READ, MAP_SHARED, fd, 0);
+        const int error = errno;
+        ::close(fd);
+        if (addr == MAP_FAILED)
+        {
+            ROS_ERROR_STREAM("Failed to map servo state bus " << path
+                << ": " << std::strerror(error));
+            return false;
+        }
+        file_ = static_cast<File*>(addr);
+        writer_ = false;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (std::memcmp(file_->magic, MAGIC, sizeof(MAGIC)) != 0
+            || file_->version != VERSION || file_->state_size != sizeof(ServoState))
+        {
+            ROS_ERROR_STREAM("Servo state bus " << path << " has a different layout");
+            close();
+            return false;
+        }
+        history_ = file_->history != 0;
+        return true;
+    }
+
+    void ServoStateBus::close()
+    {
+        if (file_ != nullptr)
+        {
+            munmap(file_, sizeof(File));
+            file_ = nullptr;
+        }
+        writer_ = false;
+        history_ = false;
+    }
+
+    void ServoStateBus::write(ServoState& state)
+    {
+        if (file_ == nullptr || !writer_)
+            return;
+
+        state.stamp_ns = monotonicNanoseconds();
+
+        // Single writer: the sequence is odd while the state is updated
+        const uint64_t sequence = file_->latest.sequence.load(std::memory_order_relaxed);
+        file_->latest.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        store(file_->latest, state);
+        file_->latest.sequence.store(sequence + 2, std::memory_order_release);
+
+        if (history_)
+        {
+            // Slot sequence is 2 * index + 1 while written, 2 * index + 2 when complete
+            const uint64_t index = file_->head.load(std::memory_order_relaxed);
+            Slot& slot = file_->slots[index & (HISTORY - 1)];
+            slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            store(slot, state);
+            slot.sequence.store(2 * index + 2, std::memory_order_release);
+            file_->head.store(index + 1, std::memory_order_release);
+        }
+    }
+
+    bool ServoStateBus::readLatest(ServoState& state) const
+    {
+        if (file_ == nullptr)
+            return false;
+
+        for (int attempt = 0; attempt < MAX_READ_ATTEMPTS; ++attempt)
+        {
+            const uint64_t sequence = file_->latest.sequence.load(std::memory_order_acquire);
+            if (sequence == 0)
+                return false;
+            if (sequence & 1)
+                continue;
+
+            load(file_->latest, state);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (file_->latest.sequence.load(std::memory_order_relaxed) == sequence)
+                return true;
+        }
+        return false;
+    }
+
+    bool ServoStateBus::hasHistory() const
+    {
+        return history_;
+    }
+
+    uint64_t ServoStateBus::head() const
+    {
+        return file_ != nullptr ? file_->head.load(std::memory_order_acquire) : 0;
+    }
+
+    bool ServoStateBus::readHistory(uint64_t index, ServoState& state) const
+    {
+        if (file_ == nullptr || !history_)
+            return false;
+
+        const Slot& slot = file_->slots[index & (HISTORY - 1)];
+        const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * index + 2)
+            return false;
+
+        load(slot, state);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.sequence.load(std::memory_order_relaxed) == sequence;
+    }
+
+    void ServoStateBus::store(Slot& slot, const ServoState& state)
+    {
+        uint64_t words[WORDS] = {};
+        std::memcpy(words, &state, sizeof(ServoState));
+        for (size_t i = 0; i < WORDS; ++i)
+        {
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        }
+    }
+
+    void ServoStateBus::load(const Slot& slot, ServoState& state)
+    {
+        uint64_t words[WORDS];
+        for (size_t i = 0; i < WORDS; ++i)
+        {
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        std::memcpy(&state, words, sizeof(ServoState));
+    }
+
+} // namespace curio_base
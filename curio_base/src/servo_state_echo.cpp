@@ -0,0 +1,167 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+// Print the servo state shared by the hardware interface.
+//
+// By default prints the latest state at the given rate. With -f follows
+// the history ring and prints every state, reporting any it missed.
+//
+// Usage:
+//   servo_state_echo [-f] <state_bus_file> [<rate>]
+//
+//   -f  follow the history ring
+//
+// Share the servo state by setting the curio_base_hardware parameter 'state_bus'.
+
+#include "curio_base/servo_state_bus.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+using curio_base::ServoState;
+using curio_base::ServoStateBus;
+
+namespace
+{
+    volatile std::sig_atomic_t g_running = 1;
+
+    void handleSignal(int)
+    {
+        g_running = 0;
+    }
+
+    void print(const ServoState& s)
+    {
+        std::cout << "cycle: " << s.cycle
+            << std::fixed << std::setprecision(3)
+            << ", stamp: " << s.ros_stamp_ns * 1.0E-9
+            << ", vin: " << s.vin
+            << ", faults: " << s.failsafe_faults
+            << ", read failures: " << s.read_failures << "\n";
+        for (size_t i = 0; i < ServoState::NUM_WHEELS; ++i)
+        {
+            std::cout << "  wheel " << i
+                << ": pos: " << s.wheel_position[i]
+                << ", vel: " << s.wheel_velocity[i]
+                << ", servo: " << s.wheel_servo_position[i]
+                << ", duty: " << s.wheel_duty[i]
+                << ((s.wheel_responding & (1u << i)) ? "" : " (no response)") << "\n";
+        }
+        for (size_t i = 0; i < ServoState::NUM_STEERS; ++i)
+        {
+            std::cout << "  steer " << i
+                << ": pos: " << s.steer_position[i]
+                << ", servo: " << s.steer_servo_position[i] << "\n";
+        }
+        std::cout << std::flush;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool follow = false;
+    std::string path;
+    double rate = 1.0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "-f") == 0)
+            follow = true;
+        else if (path.empty())
+            path = argv[i];
+        else
+            rate = std::atof(argv[i]);
+    }
+    if (path.empty() || rate <= 0.0)
+    {
+        std::cerr << "Usage: " << argv[0] << " [-f] <state_bus_file> [<rate>]" << std::endl;
+        return 1;
+    }
+
+    ServoStateBus bus;
+    if (!bus.open(path))
+    {
+        return 1;
+    }
+    if (follow && !bus.hasHistory())
+    {
+        std::cerr << path << " has no history, set 'state_bus_history'" << std::endl;
+        return 1;
+    }
+
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+
+    ServoState state;
+    uint64_t next = bus.head();
+    while (g_running)
+    {
+        if (!follow)
+        {
+            if (bus.readLatest(state))
+                print(state);
+            usleep(static_cast<useconds_t>(1.0E6 / rate));
+            continue;
+        }
+
+        // Skip states overwritten before they were read
+        const uint64_t head = bus.head();
+        if (head - next > ServoStateBus::HISTORY)
+        {
+            std::cout << "missed " << head - next - ServoStateBus::HISTORY << " states\n";
+            next = head - ServoStateBus::HISTORY;
+        }
+        for (; next < head; ++next)
+        {
+            if (bus.readHistory(next, state))
+                print(state);
+            else
+                std::cout << "missed state " << next << "\n";
+        }
+        usleep(10000);
+    }
+    return 0;
+}
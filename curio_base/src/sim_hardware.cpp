@@ -0,0 +1,284 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#include "curio_base/sim_hardware.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace curio_base
+{
+    SimHardware::SimHardware() :
+        name_("sim_hardware"),
+        wheel_radius_(0.06),
+        mid_wheel_lat_separation_(0.52),
+        mid_left_index_(0),
+        mid_right_index_(0),
+        wheel_lag_(0.0),
+        steer_rate_limit_(0.0),
+        encoder_noise_(false),
+        rng_(0),
+        rejected_readings_(0),
+        x_(0.0),
+        y_(0.0),
+        heading_(0.0),
+        distance_(0.0)
+    {
+        std::fill(wheel_pos_, wheel_pos_ + NUM_WHEELS, 0.0);
+        std::fill(wheel_vel_, wheel_vel_ + NUM_WHEELS, 0.0);
+        std::fill(wheel_eff_, wheel_eff_ + NUM_WHEELS, 0.0);
+        std::fill(wheel_cmd_, wheel_cmd_ + NUM_WHEELS, 0.0);
+        std::fill(steer_pos_, steer_pos_ + NUM_STEERS, 0.0);
+        std::fill(steer_vel_, steer_vel_ + NUM_STEERS, 0.0);
+        std::fill(steer_eff_, steer_eff_ + NUM_STEERS, 0.0);
+        std::fill(steer_cmd_, steer_cmd_ + NUM_STEERS, 0.0);
+        std::fill(wheel_true_pos_, wheel_true_pos_ + NUM_WHEELS, 0.0);
+        std::fill(wheel_true_vel_, wheel_true_vel_ + NUM_WHEELS, 0.0);
+        std::fill(encoder_offset_, encoder_offset_ + NUM_WHEELS, 0);
+    }
+
+    bool SimHardware::init(ros::NodeHandle& /*root_nh*/, ros::NodeHandle& robot_hw_nh)
+    {
+        std::vector<std::string> wheel_lon_labels, wheel_lat_labels;
+        std::vector<std::string> steer_lon_labels, steer_lat_labels;
+        if (!robot_hw_nh.getParam("wheel_servo_lon_labels", wheel_lon_labels)
+            || !robot_hw_nh.getParam("wheel_servo_lat_labels", wheel_lat_labels)
+            || !robot_hw_nh.getParam("steer_servo_lon_labels", steer_lon_labels)
+            || !robot_hw_nh.getParam("steer_servo_lat_labels", steer_lat_labels))
+        {
+            ROS_ERROR_STREAM_NAMED(name_, "Missing servo label parameters.");
+            return false;
+        }
+        if (wheel_lon_labels.size() != NUM_WHEELS || wheel_lat_labels.size() != NUM_WHEELS
+            || steer_lon_labels.size() != NUM_STEERS || steer_lat_labels.size() != NUM_STEERS)
+        {
+            ROS_ERROR_STREAM_NAMED(name_, "Servo label parameters must have length "
+                << NUM_WHEELS << " (wheels) and " << NUM_STEERS << " (steering).");
+            return false;
+        }
+
+        robot_hw_nh.param("wheel_radius", wheel_radius_, wheel_radius_);
+        robot_hw_nh.param("mid_wheel_lat_separation", mid_wheel_lat_separation_, mid_wheel_lat_separation_);
+        robot_hw_nh.param("sim/wheel_lag", wheel_lag_, wheel_lag_);
+        robot_hw_nh.param("sim/steer_rate_limit", steer_rate_limit_, steer_rate_limit_);
+        robot_hw_nh.param("sim/encoder_noise", encoder_noise_, encoder_noise_);
+        int seed = 0;
+        robot_hw_nh.param("sim/seed", seed, seed);
+        rng_.seed(static_cast<std::mt19937::result_type>(seed));
+
+        ROS_INFO_STREAM_NAMED(name_, "wheel_lag: " << wheel_lag_
+            << ", steer_rate_limit: " << steer_rate_limit_
+            << ", encoder_noise: " << (encoder_noise_ ? "enabled" : "disabled"));
+
+        // Start each encoder at a random servo position
+        std::uniform_int_distribution<int> offset_dist(0, LX16AEncoderFilter::ENCODER_MAX - 1);
+        encoder_filters_.assign(NUM_WHEELS, LX16AEncoderFilter());
+        for (size_t i = 0; i < NUM_WHEELS; ++i)
+        {
+            int offset = offset_dist(rng_);
+            while (offset >= LX16AEncoderFilter::ENCODER_LOWER && offset <= LX16AEncoderFilter::ENCODER_UPPER)
+            {
+                offset = offset_dist(rng_);
+            }
+            encoder_offset_[i] = offset;
+            encoder_filters_[i].reset(offset);
+        }
+
+        // Register joints
+        bool have_mid_left = false, have_mid_right = false;
+        for (size_t i = 0; i < NUM_WHEELS; ++i)
+        {
+            const std::string joint_name = wheel_lon_labels[i] + "_" + wheel_lat_labels[i] + "_wheel_joint";
+            ROS_INFO_STREAM_NAMED(name_, "Adding wheel joint: " << joint_name);
+
+            if (wheel_lon_labels[i] == "mid" && wheel_lat_labels[i] == "left")
+            {
+                mid_left_index_ = i;
+                have_mid_left = true;
+            }
+            if (wheel_lon_labels[i] == "mid" && wheel_lat_labels[i] == "right")
+            {
+                mid_right_index_ = i;
+                have_mid_right = true;
+            }
+
+            hardware_interface::JointStateHandle state_handle(joint_name,
+                &wheel_pos_[i], &wheel_vel_[i], &wheel_eff_[i]);
+            joint_state_interface_.registerHandle(state_handle);
+            vel_joint_interface_.registerHandle(
+                hardware_interface::JointHandle(state_handle, &wheel_cmd_[i]));
+        }
+        if (!have_mid_left || !have_mid_right)
+        {
+            ROS_ERROR_STREAM_NAMED(name_, "Wheel labels must include mid left and mid right.");
+            return false;
+        }
+
+        for (size_t i = 0; i < NUM_STEERS; ++i)
+        {
+            const std::string joint_name = steer_lon_labels[i] + "_" + steer_lat_labels[i] + "_corner_joint";
+            ROS_INFO_STREAM_NAMED(name_, "Adding steer joint: " << joint_name);
+
+            hardware_interface::JointStateHandle state_handle(joint_name,
+                &steer_pos_[i], &steer_vel_[i], &steer_eff_[i]);
+            joint_state_interface_.registerHandle(state_handle);
+            pos_joint_interface_.registerHandle(
+                hardware_interface::JointHandle(state_handle, &steer_cmd_[i]));
+        }
+
+        registerInterface(&joint_state_interface_);
+        registerInterface(&vel_joint_interface_);
+        registerInterface(&pos_joint_interface_);
+
+        return true;
+    }
+
+    void SimHardware::read(const ros::Time& /*time*/, const ros::Duration& /*period*/)
+    {
+        for (size_t i = 0; i < NUM_WHEELS; ++i)
+        {
+            wheel_vel_[i] = wheel_true_vel_[i];
+            if (!encoder_noise_)
+            {
+                wheel_pos_[i] = wheel_true_pos_[i];
+                continue;
+            }
+
+            // Convert to a servo reading, which is random in the invalid band
+            const double counts = wheel_true_pos_[i] / (2.0 * M_PI) * LX16AEncoderFilter::ENCODER_MAX;
+            int pos = (static_cast<int>(std::floor(counts)) + encoder_offset_[i]) % LX16AEncoderFilter::ENCODER_MAX;
+            if (pos < 0)
+                pos += LX16AEncoderFilter::ENCODER_MAX;
+            if (pos >= LX16AEncoderFilter::ENCODER_LOWER && pos <= LX16AEncoderFilter::ENCODER_UPPER)
+            {
+                std::uniform_int_distribution<int> noise(0, LX16AEncoderFilter::ENCODER_MAX - 1);
+                pos = noise(rng_);
+            }
+
+            LX16AEncoderFilter& filter = encoder_filters_[i];
+            if (!filter.update(0, pos))
+            {
+                ++rejected_readings_;
+            }
+            wheel_pos_[i] = filter.getAngularPosition();
+        }
+
+        for (size_t i = 0; i < NUM_STEERS; ++i)
+        {
+            steer_vel_[i] = 0.0;
+        }
+    }
+
+    void SimHardware::write(const ros::Time& /*time*/, const ros::Duration& period)
+    {
+        const double dt = period.toSec();
+        if (dt <= 0.0)
+            return;
+
+        // Wheels: first order lag on velocity
+        const double alpha = wheel_lag_ > 0.0 ? 1.0 - std::exp(-dt / wheel_lag_) : 1.0;
+        for (size_t i = 0; i < NUM_WHEELS; ++i)
+        {
+            wheel_true_vel_[i] += alpha * (wheel_cmd_[i] - wheel_true_vel_[i]);
+            wheel_true_pos_[i] += wheel_true_vel_[i] * dt;
+        }
+
+        // Steering: rate limited tracking
+        for (size_t i = 0; i < NUM_STEERS; ++i)
+        {
+            double step = steer_cmd_[i] - steer_pos_[i];
+            if (steer_rate_limit_ > 0.0)
+            {
+                const double max_step = steer_rate_limit_ * dt;
+                step = std::min(std::max(step, -max_step), max_step);
+            }
+            steer_pos_[i] += step;
+        }
+
+        // Ground truth: exact integration of the mid wheel differential drive
+        const double left  = wheel_true_vel_[mid_left_index_] * wheel_radius_ * dt;
+        const double right = wheel_true_vel_[mid_right_index_] * wheel_radius_ * dt;
+        const double linear  = (right + left) * 0.5;
+        const double angular = (right - left) / mid_wheel_lat_separation_;
+        if (std::fabs(angular) < 1e-6)
+        {
+            const double direction = heading_ + angular * 0.5;
+            x_ += linear * std::cos(direction);
+            y_ += linear * std::sin(direction);
+            heading_ += angular;
+        }
+        else
+        {
+            const double heading_old = heading_;
+            const double r = linear / angular;
+            heading_ += angular;
+            x_ +=  r * (std::sin(heading_) - std::sin(heading_old));
+            y_ += -r * (std::cos(heading_) - std::cos(heading_old));
+        }
+        distance_ += std::fabs(linear);
+    }
+
+    double SimHardware::getX() const
+    {
+        return x_;
+    }
+
+    double SimHardware::getY() const
+    {
+        return y_;
+    }
+
+    double SimHardware::getHeading() const
+    {
+        return heading_;
+    }
+
+    double SimHardware::getDistance() const
+    {
+        return distance_;
+    }
+
+    uint64_t SimHardware::getRejectedReadings() const
+    {
+        return rejected_readings_;
+    }
+
+} // namespace curio_base
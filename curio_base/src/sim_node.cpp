@@ -0,0 +1,301 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#include "curio_base/sim_hardware.h"
+
+#include <controller_manager/controller_manager.h>
+#include <curio_realtime/realtime_guard.h>
+#include <geometry_msgs/Twist.h>
+#include <nav_msgs/Odometry.h>
+#include <ros/ros.h>
+#include <rosgraph_msgs/Clock.h>
+#include <tf/transform_datatypes.h>
+
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <unistd.h>
+
+using curio_realtime::RealtimeGuard;
+
+namespace
+{
+    /// A constant velocity command held for a duration
+    struct Segment
+    {
+        double duration;
+        double linear;
+        double angular;
+    };
+
+    /// Load the scenario: a list of [duration, linear, angular] segments
+    bool loadScenario(ros::NodeHandle& nh, std::vector<Segment>& segments)
+    {
+        XmlRpc::XmlRpcValue scenario;
+        if (!nh.getParam("scenario", scenario))
+            return false;
+
+        if (scenario.getType() != XmlRpc::XmlRpcValue::TypeArray)
+        {
+            ROS_ERROR("Parameter 'scenario' must be a list of [duration, linear, angular]");
+            return false;
+        }
+
+        auto toDouble = [](XmlRpc::XmlRpcValue& v) -> double
+        {
+            return v.getType() == XmlRpc::XmlRpcValue::TypeInt
+                ? static_cast<double>(static_cast<int>(v)) : static_cast<double>(v);
+        };
+
+        for (int i = 0; i < scenario.size(); ++i)
+        {
+            XmlRpc::XmlRpcValue& s = scenario[i];
+            if (s.getType() != XmlRpc::XmlRpcValue::TypeArray || s.size() != 3)
+            {
+                ROS_ERROR_STREAM("Scenario segment " << i << " must be [duration, linear, angular]");
+                return false;
+            }
+            Segment segment;
+            segment.duration = toDouble(s[0]);
+            segment.linear   = toDouble(s[1]);
+            segment.angular  = toDouble(s[2]);
+            segments.push_back(segment);
+        }
+        return true;
+    }
+
+    /// The latest odometry published by the controller
+    std::mutex odom_mutex;
+    nav_msgs::Odometry odom_msg;
+    bool have_odom = false;
+
+    void odomCallback(const nav_msgs::Odometry::ConstPtr& msg)
+    {
+        std::lock_guard<std::mutex> lock(odom_mutex);
+        odom_msg = *msg;
+        have_odom = true;
+    }
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // Initialise node.
+    ros::init(argc, argv, "curio_base_sim");
+    ros::NodeHandle nh, private_nh("~");
+    ROS_INFO("Starting Curio base simulation");
+
+    curio_base::SimHardware sim_hardware;
+    if (!sim_hardware.init(nh, private_nh))
+    {
+        ROS_FATAL("Failed to initialise simulated hardware");
+        return 1;
+    }
+
+    controller_manager::ControllerManager controller_manager(&sim_hardware, nh);
+
+    double control_frequency = 50.0;
+    double real_time_factor = 0.0;
+    double cmd_vel_period = 0.1;
+    double settle_time = 2.0;
+    int repeat = 1;
+    private_nh.param("control_frequency", control_frequency, control_frequency);
+    private_nh.param("real_time_factor", real_time_factor, real_time_factor);
+    private_nh.param("cmd_vel_period", cmd_vel_period, cmd_vel_period);
+    private_nh.param("settle_time", settle_time, settle_time);
+    private_nh.param("repeat", repeat, repeat);
+
+    std::vector<Segment> scenario;
+    const bool have_scenario = loadScenario(private_nh, scenario) && !scenario.empty();
+
+    // This node is the clock source: the simulated time is set directly
+    // (so the controller callbacks see it) and published for other nodes.
+    ros::Publisher clock_pub = nh.advertise<rosgraph_msgs::Clock>("/clock", 10);
+    ros::Publisher cmd_vel_pub = nh.advertise<geometry_msgs::Twist>("ackermann_drive_controller/cmd_vel", 10);
+    ros::Subscriber odom_sub = nh.subscribe("ackermann_drive_controller/odom", 10, odomCallback);
+
+    const ros::Duration period(1.0 / control_frequency);
+    ros::Time time(1.0);
+    ros::Time::setNow(time);
+    rosgraph_msgs::Clock clock_msg;
+
+    // Advance the simulation by one control cycle
+    auto step = [&]()
+    {
+        time += period;
+        ros::Time::setNow(time);
+        if (clock_pub.getNumSubscribers() > 0)
+        {
+            clock_msg.clock = time;
+            clock_pub.publish(clock_msg);
+        }
+
+        ros::spinOnce();
+
+        // The simulated hardware does no I/O, so the whole cycle is checked
+        RealtimeGuard::Scope guard;
+        sim_hardware.read(time, period);
+        controller_manager.update(time, period);
+        sim_hardware.write(time, period);
+    };
+
+    // Run in real time until the controller is publishing odometry,
+    // so that the controller spawner can load and start it.
+    ROS_INFO("Waiting for controllers...");
+    ros::WallRate wall_rate(control_frequency);
+    while (ros::ok())
+    {
+        {
+            std::lock_guard<std::mutex> lock(odom_mutex);
+            if (have_odom)
+                break;
+        }
+        step();
+        wall_rate.sleep();
+    }
+
+    if (!have_scenario)
+    {
+        // Interactive: run at the requested real time factor (default 1)
+        // using commands from other nodes.
+        ROS_INFO("No scenario, running with external commands");
+        const double factor = real_time_factor > 0.0 ? real_time_factor : 1.0;
+        ros::WallRate rate(control_frequency * factor);
+        while (ros::ok())
+        {
+            step();
+            rate.sleep();
+        }
+        RealtimeGuard::report(STDERR_FILENO);
+        return 0;
+    }
+
+    // Scenario: feed each segment to the controller, as fast as possible
+    // unless a real time factor is given.
+    const ros::Time start_time = time;
+    const std::chrono::steady_clock::time_point wall_start = std::chrono::steady_clock::now();
+    const double x0 = sim_hardware.getX();
+    const double y0 = sim_hardware.getY();
+    const double heading0 = sim_hardware.getHeading();
+    const double distance0 = sim_hardware.getDistance();
+    uint64_t cycles = 0;
+
+    std::unique_ptr<ros::WallRate> rate;
+    if (real_time_factor > 0.0)
+    {
+        rate.reset(new ros::WallRate(control_frequency * real_time_factor));
+    }
+
+    geometry_msgs::Twist cmd_vel_msg;
+    auto runSegment = [&](double duration, double linear, double angular)
+    {
+        cmd_vel_msg.linear.x = linear;
+        cmd_vel_msg.angular.z = angular;
+        const ros::Time end = time + ros::Duration(duration);
+        ros::Time next_cmd = time;
+        while (ros::ok() && time < end)
+        {
+            if (time >= next_cmd)
+            {
+                cmd_vel_pub.publish(cmd_vel_msg);
+                next_cmd += ros::Duration(cmd_vel_period);
+            }
+            step();
+            ++cycles;
+            if (rate)
+                rate->sleep();
+        }
+    };
+
+    for (int r = 0; r < repeat && ros::ok(); ++r)
+    {
+        for (const Segment& segment : scenario)
+        {
+            runSegment(segment.duration, segment.linear, segment.angular);
+        }
+    }
+    runSegment(settle_time, 0.0, 0.0);
+
+    const double wall_elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - wall_start).count();
+    const double sim_elapsed = (time - start_time).toSec();
+
+    // Let the controller publisher thread deliver the final odometry
+    ros::WallDuration(0.2).sleep();
+    ros::spinOnce();
+
+    // The odometry was reset when the controller started,
+    // compare against the ground truth motion since then.
+    double odom_x, odom_y, odom_heading;
+    {
+        std::lock_guard<std::mutex> lock(odom_mutex);
+        odom_x = odom_msg.pose.pose.position.x;
+        odom_y = odom_msg.pose.pose.position.y;
+        odom_heading = tf::getYaw(odom_msg.pose.pose.orientation);
+    }
+    const double true_x = sim_hardware.getX() - x0;
+    const double true_y = sim_hardware.getY() - y0;
+    const double true_heading = sim_hardware.getHeading() - heading0;
+    const double distance = sim_hardware.getDistance() - distance0;
+    const double position_error = std::hypot(odom_x - true_x, odom_y - true_y);
+    const double heading_error = std::atan2(std::sin(odom_heading - true_heading),
+        std::cos(odom_heading - true_heading));
+
+    ROS_INFO_STREAM("Scenario complete:"
+        << "\n\tcycles: " << cycles
+        << "\n\tsim time: " << sim_elapsed << " s"
+        << "\n\twall time: " << wall_elapsed << " s"
+        << "\n\treal time factor: " << (wall_elapsed > 0.0 ? sim_elapsed / wall_elapsed : 0.0)
+        << "\n\tground truth: x: " << true_x << ", y: " << true_y << ", heading: " << true_heading
+        << "\n\todometry: x: " << odom_x << ", y: " << odom_y << ", heading: " << odom_heading
+        << "\n\tdistance: " << distance << " m"
+        << "\n\tposition error: " << position_error << " m"
+        << " (" << (distance > 0.0 ? 100.0 * position_error / distance : 0.0) << " % of distance)"
+        << "\n\theading error: " << heading_error << " rad"
+        << "\n\trejected encoder readings: " << sim_hardware.getRejectedReadings()
+        << "\n\trealtime violations: " << RealtimeGuard::getViolations());
+    RealtimeGuard::report(STDERR_FILENO);
+
+    ros::shutdown();
+    return 0;
+}
@@ -0,0 +1,214 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#include "curio_base/lx16a_bus_schedule.h"
+#include "curio_base/lx16a_protocol.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using curio_base::LX16ABusSchedule;
+using curio_base::LX16ABusTask;
+namespace lx16a = curio_base::lx16a;
+
+namespace
+{
+    /// The traffic of the base: wheel reads and writes, steering moves and
+    /// supply voltage reads at rates unrelated to the period
+    std::vector<LX16ABusTask> baseTasks()
+    {
+        std::vector<LX16ABusTask> tasks;
+        for (uint8_t id = 11; id <= 16; ++id)
+        {
+            tasks.push_back(LX16ABusTask(id, lx16a::POS_READ, 0.0, 2));
+        }
+        for (uint8_t id = 21; id <= 24; ++id)
+        {
+            tasks.push_back(LX16ABusTask(id, lx16a::MOVE_TIME_WAIT_WRITE, 0.0, 1));
+        }
+        tasks.push_back(LX16ABusTask(lx16a::BROADCAST_ID, lx16a::MOVE_START, 0.0, 1));
+        for (uint8_t id = 11; id <= 16; ++id)
+        {
+            tasks.push_back(LX16ABusTask(id, lx16a::OR_MOTOR_MODE_WRITE, 0.0, 1));
+        }
+        for (uint8_t id = 11; id <= 16; ++id)
+        {
+            tasks.push_back(LX16ABusTask(id, lx16a::VIN_READ, 0.3 + 0.07 * id, 0));
+        }
+        for (uint8_t id = 21; id <= 24; ++id)
+        {
+            tasks.push_back(LX16ABusTask(id, lx16a::POS_READ, 3.3, 0));
+        }
+        return tasks;
+    }
+
+    LX16ABusSchedule::Params baseParams(double period)
+    {
+        LX16ABusSchedule::Params params;
+        params.period = period;
+        params.turnaround = 0.0005;
+        return params;
+    }
+} // namespace
+
+TEST(LX16ABusSchedule, buildsNonRoundPeriods)
+{
+    const std::vector<LX16ABusTask> tasks = baseTasks();
+    LX16ABusSchedule schedule;
+    std::string error;
+    for (int tenths = 310; tenths <= 2000; ++tenths)
+    {
+        const double period = tenths * 1.0E-4;
+        EXPECT_TRUE(schedule.build(tasks, baseParams(period), error))
+            << "period " << period << " s: " << error;
+        EXPECT_LE(schedule.getNumCycles(), baseParams(period).max_cycles);
+    }
+}
+
+TEST(LX16ABusSchedule, dividersMeetRates)
+{
+    const std::vector<LX16ABusTask> tasks = baseTasks();
+    const double period = 0.0337;
+    LX16ABusSchedule schedule;
+    std::string error;
+    ASSERT_TRUE(schedule.build(tasks, baseParams(period), error)) << error;
+
+    size_t max_divider = 1;
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        const size_t divider = schedule.getDividers()[i];
+        EXPECT_EQ(divider & (divider - 1), 0u) << "divider " << divider;
+        if (tasks[i].rate > 0.0)
+        {
+            EXPECT_LE(divider * period, 1.0 / tasks[i].rate);
+        }
+        else
+        {
+            EXPECT_EQ(divider, 1u);
+        }
+        max_divider = std::max(max_divider, divider);
+    }
+    EXPECT_EQ(schedule.getNumCycles(), max_divider);
+}
+
+TEST(LX16ABusSchedule, runsEachTaskEveryDivider)
+{
+    const std::vector<LX16ABusTask> tasks = baseTasks();
+    LX16ABusSchedule schedule;
+    std::string error;
+    ASSERT_TRUE(schedule.build(tasks, baseParams(0.0413), error)) << error;
+
+    std::vector<size_t> runs(tasks.size(), 0);
+    for (size_t c = 0; c < schedule.getNumCycles(); ++c)
+    {
+        for (size_t slot = 0; slot < schedule.getNumSlots(c); ++slot)
+        {
+            ++runs[schedule.getTaskIndex(c, slot)];
+        }
+    }
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        EXPECT_EQ(runs[i] * schedule.getDividers()[i], schedule.getNumCycles());
+    }
+}
+
+TEST(LX16ABusSchedule, findsShortestPeriod)
+{
+    const std::vector<LX16ABusTask> tasks = baseTasks();
+    const LX16ABusSchedule::Params params = baseParams(0.0);
+    const double min_period = LX16ABusSchedule::findMinPeriod(tasks, params);
+    ASSERT_GT(min_period, 0.0);
+
+    LX16ABusSchedule schedule;
+    std::string error;
+    LX16ABusSchedule::Params p(params);
+    p.period = min_period;
+    EXPECT_TRUE(schedule.build(tasks, p, error)) << error;
+
+    // No shorter period fits, on a 10 us grid
+    for (p.period = 1.0E-5; p.period < min_period - 1.0E-6; p.period += 1.0E-5)
+    {
+        EXPECT_FALSE(schedule.build(tasks, p, error)) << "period " << p.period << " s";
+    }
+}
+
+TEST(LX16ABusSchedule, rejectsRateAboveLoopRate)
+{
+    std::vector<LX16ABusTask> tasks;
+    tasks.push_back(LX16ABusTask(1, lx16a::VIN_READ, 60.0, 0));
+    LX16ABusSchedule schedule;
+    std::string error;
+    EXPECT_FALSE(schedule.build(tasks, baseParams(0.02), error));
+
+    const double min_period = LX16ABusSchedule::findMinPeriod(tasks, baseParams(0.0));
+    EXPECT_GT(min_period, 0.0);
+    EXPECT_LE(min_period, 1.0 / 60.0);
+}
+
+TEST(LX16ABusSchedule, buildsOverBudgetUnlessEnforced)
+{
+    const std::vector<LX16ABusTask> tasks = baseTasks();
+    LX16ABusSchedule::Params params = baseParams(0.01);
+    LX16ABusSchedule schedule;
+    std::string error;
+    EXPECT_FALSE(schedule.build(tasks, params, error));
+    EXPECT_FALSE(error.empty());
+
+    // Every task is still scheduled, with the overrun reported
+    params.enforce = false;
+    error.clear();
+    ASSERT_TRUE(schedule.build(tasks, params, error));
+    EXPECT_FALSE(error.empty());
+    EXPECT_EQ(schedule.getTasks().size(), tasks.size());
+    EXPECT_GT(schedule.getMaxBusTime(), params.period * params.max_utilisation);
+
+    params.period = 0.05;
+    ASSERT_TRUE(schedule.build(tasks, params, error));
+    EXPECT_TRUE(error.empty());
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
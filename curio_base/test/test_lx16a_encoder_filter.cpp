@@ -0,0 +1,135 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#include "curio_base/lx16a_encoder_filter.h"
+
+#include <gtest/gtest.h>
+
+using curio_base::LX16AEncoderFilter;
+
+TEST(LX16AEncoderFilter, countsSmallSteps)
+{
+    LX16AEncoderFilter filter;
+    filter.reset(100);
+    for (int pos = 110; pos <= 500; pos += 10)
+    {
+        EXPECT_TRUE(filter.update(500, pos));
+    }
+    EXPECT_EQ(filter.getCount(), 400);
+}
+
+TEST(LX16AEncoderFilter, countsRevolutions)
+{
+    LX16AEncoderFilter filter;
+    filter.reset(1000);
+    int pos = 1000;
+    for (int i = 0; i < 200; ++i)
+    {
+        pos += 50;
+        filter.update(500, pos);
+    }
+    // 10000 counts forward, skipping the readings in the invalid band
+    EXPECT_EQ(filter.getRevolutions(), 7);
+    EXPECT_EQ(filter.getCount(), 10000);
+}
+
+TEST(LX16AEncoderFilter, rejectsInvalidBand)
+{
+    LX16AEncoderFilter filter;
+    filter.reset(1150);
+    EXPECT_FALSE(filter.update(500, 1250));
+    EXPECT_FALSE(filter.isValid());
+    EXPECT_EQ(filter.getCount(), 0);
+    EXPECT_TRUE(filter.update(500, 1350));
+    EXPECT_EQ(filter.getCount(), 200);
+}
+
+TEST(LX16AEncoderFilter, rejectsSingleJump)
+{
+    LX16AEncoderFilter filter;
+    filter.reset(100);
+    EXPECT_FALSE(filter.update(500, 700));
+    EXPECT_TRUE(filter.update(500, 120));
+    EXPECT_EQ(filter.getCount(), 20);
+}
+
+TEST(LX16AEncoderFilter, resyncsAfterMissedReadings)
+{
+    // The wheel moved 500 counts while readings were missed
+    LX16AEncoderFilter filter(300, 3);
+    filter.reset(100);
+    EXPECT_FALSE(filter.update(500, 600));
+    EXPECT_FALSE(filter.update(500, 620));
+    EXPECT_TRUE(filter.update(500, 640));
+    EXPECT_EQ(filter.getCount(), 540);
+
+    // and keeps counting afterwards
+    EXPECT_TRUE(filter.update(500, 660));
+    EXPECT_EQ(filter.getCount(), 560);
+}
+
+TEST(LX16AEncoderFilter, resyncsAcrossWrap)
+{
+    // Moving backwards from 100 to 1000 is a change of -600 counts
+    LX16AEncoderFilter filter(300, 3);
+    filter.reset(100);
+    filter.update(-500, 1000);
+    filter.update(-500, 990);
+    EXPECT_TRUE(filter.update(-500, 980));
+    EXPECT_EQ(filter.getRevolutions(), -1);
+    EXPECT_EQ(filter.getCount(), -620);
+}
+
+TEST(LX16AEncoderFilter, ignoresInconsistentJumps)
+{
+    LX16AEncoderFilter filter(300, 3);
+    filter.reset(100);
+    EXPECT_FALSE(filter.update(500, 600));
+    EXPECT_FALSE(filter.update(500, 1000));
+    EXPECT_FALSE(filter.update(500, 600));
+    EXPECT_EQ(filter.getCount(), 0);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,204 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#include "curio_base/realtime_failsafe.h"
+
+#include <gtest/gtest.h>
+
+using curio_base::RealtimeFailsafe;
+
+namespace
+{
+    const ros::Duration PERIOD(0.02);
+
+    RealtimeFailsafe::Params defaultParams()
+    {
+        RealtimeFailsafe::Params params;
+        params.command_timeout = 2.0;
+        params.max_read_failures = 3;
+        params.min_vin = 6500;
+        params.max_overruns = 3;
+        params.max_cycle_time = 0.1;
+        return params;
+    }
+} // namespace
+
+TEST(RealtimeFailsafe, tripsOnStaleCommandWhileDriving)
+{
+    RealtimeFailsafe failsafe;
+    failsafe.configure(defaultParams(), 6);
+    failsafe.commandReceived(ros::Time(10.0));
+
+    EXPECT_FALSE(failsafe.update(ros::Time(11.9), PERIOD, true));
+    EXPECT_TRUE(failsafe.update(ros::Time(12.1), PERIOD, true));
+    EXPECT_EQ(failsafe.getFaults(), static_cast<uint32_t>(RealtimeFailsafe::FAULT_COMMAND_TIMEOUT));
+    EXPECT_EQ(failsafe.getTrips(), 1u);
+}
+
+TEST(RealtimeFailsafe, holdsTrajectoryUntilItsEnd)
+{
+    RealtimeFailsafe failsafe;
+    failsafe.configure(defaultParams(), 6);
+
+    // A command trajectory is stamped with the time of its last point
+    failsafe.commandReceived(ros::Time(15.0));
+    EXPECT_FALSE(failsafe.update(ros::Time(12.0), PERIOD, true));
+    EXPECT_FALSE(failsafe.update(ros::Time(16.9), PERIOD, true));
+    EXPECT_TRUE(failsafe.update(ros::Time(17.1), PERIOD, true));
+}
+
+TEST(RealtimeFailsafe, ignoresStaleCommandWhenStopped)
+{
+    RealtimeFailsafe failsafe;
+    failsafe.configure(defaultParams(), 6);
+    failsafe.commandReceived(ros::Time(10.0));
+    EXPECT_FALSE(failsafe.update(ros::Time(20.0), PERIOD, false));
+}
+
+TEST(RealtimeFailsafe, tripsOnConsecutiveReadFailures)
+{
+    RealtimeFailsafe failsafe;
+    failsafe.configure(defaultParams(), 6);
+    failsafe.commandReceived(ros::Time(10.0));
+
+    // A successful read restarts the count
+    failsafe.servoRead(2, false);
+    failsafe.servoRead(2, false);
+    failsafe.servoRead(2, true);
+    failsafe.servoRead(2, false);
+    EXPECT_FALSE(failsafe.update(ros::Time(10.0), PERIOD, false));
+
+    failsafe.servoRead(2, false);
+    failsafe.servoRead(2, false);
+    EXPECT_TRUE(failsafe.update(ros::Time(10.0), PERIOD, false));
+    EXPECT_EQ(failsafe.getFaults(), static_cast<uint32_t>(RealtimeFailsafe::FAULT_SERVO_RESPONSE));
+}
+
+TEST(RealtimeFailsafe, tripsOnLowVoltage)
+{
+    RealtimeFailsafe failsafe;
+    failsafe.configure(defaultParams(), 6);
+
+    // A failed read is left to the response check
+    failsafe.vinRead(-1);
+    EXPECT_FALSE(failsafe.update(ros::Time(10.0), PERIOD, false));
+    EXPECT_EQ(failsafe.getVin(), -1);
+
+    failsafe.vinRead(7400);
+    EXPECT_FALSE(failsafe.update(ros::Time(10.0), PERIOD, false));
+    failsafe.vinRead(6400);
+    EXPECT_TRUE(failsafe.update(ros::Time(10.0), PERIOD, false));
+    EXPECT_EQ(failsafe.getFaults(), static_cast<uint32_t>(RealtimeFailsafe::FAULT_LOW_VOLTAGE));
+    EXPECT_EQ(failsafe.getVin(), 6400);
+}
+
+TEST(RealtimeFailsafe, tripsOnConsecutiveOverruns)
+{
+    RealtimeFailsafe failsafe;
+    failsafe.configure(defaultParams(), 6);
+    const ros::Duration overrun(0.15);
+
+    EXPECT_FALSE(failsafe.update(ros::Time(10.0), overrun, false));
+    EXPECT_FALSE(failsafe.update(ros::Time(10.0), overrun, false));
+    EXPECT_FALSE(failsafe.update(ros::Time(10.0), PERIOD, false));
+    EXPECT_FALSE(failsafe.update(ros::Time(10.0), overrun, false));
+    EXPECT_FALSE(failsafe.update(ros::Time(10.0), overrun, false));
+    EXPECT_TRUE(failsafe.update(ros::Time(10.0), overrun, false));
+    EXPECT_EQ(failsafe.getFaults(), static_cast<uint32_t>(RealtimeFailsafe::FAULT_OVERRUN));
+}
+
+TEST(RealtimeFailsafe, latchesUntilReset)
+{
+    RealtimeFailsafe failsafe;
+    failsafe.configure(defaultParams(), 6);
+    failsafe.vinRead(6000);
+    EXPECT_TRUE(failsafe.update(ros::Time(10.0), PERIOD, false));
+
+    // The fault has cleared, but the failsafe stays tripped
+    failsafe.vinRead(7400);
+    EXPECT_TRUE(failsafe.update(ros::Time(10.0), PERIOD, false));
+
+    failsafe.requestReset();
+    EXPECT_FALSE(failsafe.update(ros::Time(10.0), PERIOD, false));
+    EXPECT_EQ(failsafe.getTrips(), 1u);
+}
+
+TEST(RealtimeFailsafe, retripsAfterResetIfFaultPersists)
+{
+    RealtimeFailsafe failsafe;
+    failsafe.configure(defaultParams(), 6);
+    failsafe.commandReceived(ros::Time(10.0));
+    EXPECT_TRUE(failsafe.update(ros::Time(13.0), PERIOD, true));
+
+    failsafe.requestReset();
+    EXPECT_TRUE(failsafe.update(ros::Time(13.0), PERIOD, true));
+    EXPECT_EQ(failsafe.getTrips(), 2u);
+}
+
+TEST(RealtimeFailsafe, disabledChecksDoNotTrip)
+{
+    RealtimeFailsafe::Params params;
+    params.command_timeout = 0.0;
+    params.max_read_failures = 0;
+    params.min_vin = 0;
+    params.max_overruns = 0;
+
+    RealtimeFailsafe failsafe;
+    failsafe.configure(params, 6);
+    for (int i = 0; i < 10; ++i)
+    {
+        failsafe.servoRead(0, false);
+        failsafe.vinRead(1000);
+        EXPECT_FALSE(failsafe.update(ros::Time(100.0), ros::Duration(1.0), true));
+    }
+}
+
+TEST(RealtimeFailsafe, describesFaults)
+{
+    EXPECT_EQ(RealtimeFailsafe::toString(0), "none");
+    EXPECT_EQ(RealtimeFailsafe::toString(RealtimeFailsafe::FAULT_COMMAND_TIMEOUT
+        | RealtimeFailsafe::FAULT_LOW_VOLTAGE), "command timeout, low supply voltage");
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,130 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#ifndef CURIO_REALTIME_ALLOCATION_COUNTER_H_
+#define CURIO_REALTIME_ALLOCATION_COUNTER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace curio_realtime
+{
+    /**
+     * \brief Count heap allocations made through operator new.
+     *
+     * The replacement operators are only defined in the translation unit
+     * that defines CURIO_REALTIME_DEFINE_ALLOCATION_COUNTER
+     * before including this header. This must be done in exactly one
+     * file of an executable (for example a benchmark), never in a library.
+     */
+    class AllocationCounter
+    {
+    public:
+        /**
+         * \brief Number of allocations since the program started
+         */
+        static uint64_t count()
+        {
+            return counter().load(std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief Record an allocation
+         */
+        static void increment()
+        {
+            counter().fetch_add(1, std::memory_order_relaxed);
+        }
+
+    private:
+        static std::atomic<uint64_t>& counter()
+        {
+            static std::atomic<uint64_t> count(0);
+            return count;
+        }
+    };
+
+} // namespace curio_realtime
+
+#ifdef CURIO_REALTIME_DEFINE_ALLOCATION_COUNTER
+
+// The operators are kept out of line so the compiler does not pair an
+// inlined malloc with an inlined free and warn about a mismatch.
+
+__attribute__((noinline)) void* operator new(std::size_t size)
+{
+    curio_realtime::AllocationCounter::increment();
+    if (void* p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    curio_realtime::AllocationCounter::increment();
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+#endif // CURIO_REALTIME_DEFINE_ALLOCATION_COUNTER
+
+#endif // CURIO_REALTIME_ALLOCATION_COUNTER_H_
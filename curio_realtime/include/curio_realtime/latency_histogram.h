@@ -0,0 +1,239 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+
+#ifndef CURIO_REALTIME_LATENCY_HISTOGRAM_H_
+#define CURIO_REALTIME_LATENCY_HISTOGRAM_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+
+#include <time.h>
+
+namespace curio_realtime
+{
+    /**
+     * \brief Read the monotonic clock.
+     * \return Time since an arbitrary epoch [ns]
+     */
+    inline uint64_t monotonicNanoseconds()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+    }
+
+    /**
+     * \brief A fixed bucket latency histogram.
+     *
+     * Buckets are logarithmic with a resolution of 256 ns in the first bucket:
+     * bucket 0 counts samples below 256 ns and bucket k > 0 counts samples in
+     * [256 * 2^(k-1), 256 * 2^k) ns. The histogram also tracks the count,
+     * min, max, mean and standard deviation of the samples.
+     *
+     * There must be a single writer (usually the realtime loop). Readers on
+     * other threads see a consistent value for each field, but the fields
+     * may be from slightly different points in time.
+     */
+    class LatencyHistogram
+    {
+    public:
+        /// Number of buckets
+        static const size_t NUM_BUCKETS = 32;
+
+        /// Width of the first bucket as a power of two [ns]
+        static const unsigned int BASE_SHIFT = 8;
+
+        /**
+         * \brief A copy of the histogram state suitable for reporting
+         */
+        struct Summary
+        {
+            uint64_t count;
+            uint64_t min;
+            uint64_t max;
+            double mean;
+            double stddev;
+            uint64_t buckets[NUM_BUCKETS];
+
+            /**
+             * \brief Estimate a percentile from the bucket counts
+             * \param p The percentile in the range [0, 100]
+             * \return The upper bound of the bucket containing the percentile [ns]
+             */
+            uint64_t percentile(double p) const;
+        };
+
+        LatencyHistogram()
+        {
+            reset();
+        }
+
+        /**
+         * \brief Clear all samples (not realtime safe with a concurrent writer)
+         */
+        void reset()
+        {
+            for (size_t i = 0; i < NUM_BUCKETS; ++i)
+                buckets_[i].store(0, std::memory_order_relaxed);
+            count_.store(0, std::memory_order_relaxed);
+            min_.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+            max_.store(0, std::memory_order_relaxed);
+            sum_.store(0.0, std::memory_order_relaxed);
+            sum_sq_.store(0.0, std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief Record a sample. Realtime safe, single writer only.
+         * \param ns The sample [ns]
+         */
+        void record(uint64_t ns)
+        {
+            const size_t k = bucketIndex(ns);
+            buckets_[k].store(buckets_[k].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            if (ns < min_.load(std::memory_order_relaxed))
+                min_.store(ns, std::memory_order_relaxed);
+            if (ns > max_.load(std::memory_order_relaxed))
+                max_.store(ns, std::memory_order_relaxed);
+            const double x = static_cast<double>(ns);
+            sum_.store(sum_.load(std::memory_order_relaxed) + x, std::memory_order_relaxed);
+            sum_sq_.store(sum_sq_.load(std::memory_order_relaxed) + x * x, std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief Number of samples recorded
+         */
+        uint64_t count() const
+        {
+            return count_.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * \brief Copy the current state of the histogram
+         */
+        Summary summary() const
+        {
+            Summary s;
+            s.count = count_.load(std::memory_order_relaxed);
+            s.min = s.count > 0 ? min_.load(std::memory_order_relaxed) : 0;
+            s.max = max_.load(std::memory_order_relaxed);
+            const double n = static_cast<double>(s.count);
+            const double sum = sum_.load(std::memory_order_relaxed);
+            const double sum_sq = sum_sq_.load(std::memory_order_relaxed);
+            s.mean = s.count > 0 ? sum / n : 0.0;
+            s.stddev = s.count > 1 ? std::sqrt(std::max(0.0, (sum_sq - sum * s.mean) / (n - 1.0))) : 0.0;
+            for (size_t i = 0; i < NUM_BUCKETS; ++i)
+                s.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+            return s;
+        }
+
+        /**
+         * \brief Upper bound of a bucket [ns]
+         */
+        static uint64_t bucketUpperBound(size_t k)
+        {
+            return (1ULL << BASE_SHIFT) << k;
+        }
+
+        /**
+         * \brief Bucket index for a sample
+         */
+        static size_t bucketIndex(uint64_t ns)
+        {
+            uint64_t v = ns >> BASE_SHIFT;
+            size_t k = 0;
+            while (v != 0 && k < NUM_BUCKETS - 1)
+            {
+                v >>= 1;
+                ++k;
+            }
+            return k;
+        }
+
+    private:
+        std::atomic<uint64_t> buckets_[NUM_BUCKETS];
+        std::atomic<uint64_t> count_;
+        std::atomic<uint64_t> min_;
+        std::atomic<uint64_t> max_;
+        std::atomic<double> sum_;
+        std::atomic<double> sum_sq_;
+    };
+
+    inline uint64_t LatencyHistogram::Summary::percentile(double p) const
+    {
+        if (count == 0)
+            return 0;
+
+        const double target = std::ceil(p / 100.0 * static_cast<double>(count));
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < NUM_BUCKETS; ++i)
+        {
+            cumulative += buckets[i];
+            if (static_cast<double>(cumulative) >= target)
+                return std::min(bucketUpperBound(i), max);
+        }
+        return max;
+    }
+
+    /**
+     * \brief Write a one line summary of a histogram [us]
+     */
+    inline std::ostream& operator<<(std::ostream& os, const LatencyHistogram::Summary& s)
+    {
+        os << "n: " << s.count
+           << ", min: " << s.min * 1.0E-3
+           << ", mean: " << s.mean * 1.0E-3
+           << ", stddev: " << s.stddev * 1.0E-3
+           << ", p50: " << s.percentile(50.0) * 1.0E-3
+           << ", p99: " << s.percentile(99.0) * 1.0E-3
+           << ", p99.9: " << s.percentile(99.9) * 1.0E-3
+           << ", max: " << s.max * 1.0E-3 << " us";
+        return os;
+    }
+
+} // namespace curio_realtime
+
+#endif // CURIO_REALTIME_LATENCY_HISTOGRAM_H_
@@ -0,0 +1,220 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#ifndef CURIO_REALTIME_LATENCY_TRACE_H_
+#define CURIO_REALTIME_LATENCY_TRACE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace curio_realtime
+{
+    /**
+     * \brief Trace velocity commands through the teleop, controller and
+     * hardware processes.
+     *
+     * The processes map the same file (usually on /dev/shm) holding a ring
+     * of events. Each event tags a monotonic clock timestamp with a trace id
+     * and the pipeline stage that reached it. The teleop node starts a trace
+     * for each RC frame. Twist messages have no room for the id, so the
+     * teleop node also stores the id with the published velocity and the
+     * controller matches incoming commands against it. The controller then
+     * marks the id consumed, and the hardware tags its next write with it.
+     *
+     * Recording is lock-free, does not allocate and does no system calls
+     * apart from reading the clock, so it may be used in the realtime loop.
+     * Writers in any number of processes may record concurrently. Readers
+     * (see curio_latency_trace) follow the ring.
+     */
+    class LatencyTrace
+    {
+    public:
+        /// Pipeline stages in order
+        enum Stage
+        {
+            STAGE_RC_RECEIVED = 0,      ///< Teleop received an RC frame
+            STAGE_CMD_PUBLISHED,        ///< Teleop published the twist
+            STAGE_CMD_RECEIVED,         ///< Controller received the twist
+            STAGE_UPDATE,               ///< Controller update read the twist
+            STAGE_WRITE,                ///< Hardware wrote the joint commands
+            NUM_STAGES
+        };
+
+        /// A recorded event
+        struct Event
+        {
+            uint64_t trace_id;
+            uint64_t stamp_ns;          ///< CLOCK_MONOTONIC [ns]
+            uint32_t stage;
+        };
+
+        /// Number of events in the ring, must be a power of two
+        static const uint32_t CAPACITY = 4096;
+
+        static const uint32_t VERSION = 1;
+
+        /**
+         * \brief Name of a stage
+         */
+        static const char* stageName(uint32_t stage);
+
+        LatencyTrace();
+
+        ~LatencyTrace();
+
+        LatencyTrace(const LatencyTrace&) = delete;
+        LatencyTrace& operator=(const LatencyTrace&) = delete;
+
+        /**
+         * \brief Open or create the trace file
+         * \param path File name, e.g. /dev/shm/curio_latency_trace
+         * \return false if the file could not be opened or mapped
+         */
+        bool open(const std::string& path);
+
+        /**
+         * \brief Unmap the file
+         */
+        void close();
+
+        bool isOpen() const
+        {
+            return file_ != nullptr;
+        }
+
+        /**
+         * \brief Start a new trace. Realtime safe.
+         * \return A trace id, never zero
+         */
+        uint64_t newTraceId();
+
+        /**
+         * \brief Record that a trace reached a stage now. Realtime safe.
+         */
+        void record(uint64_t trace_id, Stage stage);
+
+        /**
+         * \brief Store the trace id of a published velocity command
+         * \param trace_id The trace the command belongs to
+         * \param lin      Published linear velocity [m/s]
+         * \param ang      Published angular velocity [rad/s]
+         */
+        void setPublished(uint64_t trace_id, double lin, double ang);
+
+        /**
+         * \brief Find the trace id of a received velocity command
+         *
+         * The command is matched by value, so a command from another source
+         * with the same velocities may take the id. Each publish is matched
+         * at most once, and ids the controller has already consumed are not
+         * matched again.
+         *
+         * \param lin Received linear velocity [m/s]
+         * \param ang Received angular velocity [rad/s]
+         * \return The trace id if the command is the last one published and
+         *         has not been matched, or zero
+         */
+        uint64_t matchPublished(double lin, double ang);
+
+        /**
+         * \brief Store the trace id of the command the controller last
+         * consumed. Realtime safe.
+         */
+        void setConsumed(uint64_t trace_id);
+
+        /**
+         * \brief The trace id of the command the controller last consumed.
+         * Realtime safe.
+         */
+        uint64_t getConsumed() const;
+
+        /**
+         * \brief Number of events recorded since the file was created
+         */
+        uint64_t head() const;
+
+        /**
+         * \brief Read an event from the ring
+         * \param index The event number, less than head()
+         * \param [out] event The event
+         * \return false if the event is still being written or has
+         *         been overwritten
+         */
+        bool read(uint64_t index, Event& event) const;
+
+    private:
+        struct Slot
+        {
+            /// 2 * index + 1 while being written, 2 * index + 2 when complete
+            std::atomic<uint64_t> sequence;
+            std::atomic<uint64_t> trace_id;
+            std::atomic<uint64_t> stamp_ns;
+            std::atomic<uint64_t> stage;
+        };
+
+        struct File
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t capacity;
+            std::atomic<uint64_t> next_trace_id;
+            std::atomic<uint64_t> head;
+
+            /// Last published command, guarded by a sequence lock
+            std::atomic<uint64_t> published_sequence;
+            std::atomic<uint64_t> published_id;
+            std::atomic<uint64_t> published_lin;
+            std::atomic<uint64_t> published_ang;
+
+            std::atomic<uint64_t> consumed_id;
+
+            Slot slots[CAPACITY];
+        };
+
+        File* file_;
+
+        /// Publish sequence of the last matched command
+        std::atomic<uint64_t> matched_sequence_;
+    };
+
+} // namespace curio_realtime
+
+#endif // CURIO_REALTIME_LATENCY_TRACE_H_
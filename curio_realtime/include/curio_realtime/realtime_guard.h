@@ -0,0 +1,131 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#ifndef CURIO_REALTIME_REALTIME_GUARD_H_
+#define CURIO_REALTIME_REALTIME_GUARD_H_
+
+#include <cstdint>
+
+namespace curio_realtime
+{
+    /**
+     * \brief Detect allocations, mutex locks and blocking calls in realtime code.
+     *
+     * A test and diagnostic mode. The checks are done by the
+     * curio_realtime_guard library, which interposes malloc
+     * and free, pthread_mutex_lock and blocking system calls such as read,
+     * write, poll and nanosleep. Load it with
+     *
+     *   LD_PRELOAD=libcurio_realtime_guard.so
+     *
+     * Code marks itself realtime with a Scope. While the guard is armed,
+     * each interposed call made in a scope on the same thread is counted
+     * as a violation and its call stack is recorded once per call site.
+     * The controller arms the guard when it starts and disarms it when it
+     * stops, so the setup done while switching controllers is not checked.
+     *
+     * Without the library every function here is a single branch.
+     */
+    class RealtimeGuard
+    {
+    public:
+        /// The kinds of call checked in a scope
+        enum Check
+        {
+            CHECK_ALLOCATION = 1 << 0,  ///< malloc, free and friends
+            CHECK_MUTEX      = 1 << 1,  ///< pthread_mutex_lock
+            CHECK_BLOCKING   = 1 << 2,  ///< Blocking system calls
+            CHECK_ALL        = CHECK_ALLOCATION | CHECK_MUTEX | CHECK_BLOCKING
+        };
+
+        /**
+         * \brief Mark the calling thread realtime until the scope ends.
+         * Scopes may be nested, the innermost sets the checks.
+         */
+        class Scope
+        {
+        public:
+            explicit Scope(uint32_t checks = CHECK_ALL);
+
+            ~Scope();
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+            /**
+             * \brief Number of violations on this thread since the scope began
+             */
+            uint64_t violations() const;
+
+        private:
+            uint32_t previous_;
+            uint64_t start_;
+        };
+
+        /**
+         * \brief True if the guard library is loaded
+         */
+        static bool isLoaded();
+
+        /**
+         * \brief Start counting violations in scopes
+         */
+        static void arm();
+
+        /**
+         * \brief Stop counting violations
+         */
+        static void disarm();
+
+        /**
+         * \brief Total number of violations of all threads
+         */
+        static uint64_t getViolations();
+
+        /**
+         * \brief Write each violating call site and its call stack (non-realtime)
+         * \param fd File descriptor, e.g. STDERR_FILENO
+         */
+        static void report(int fd);
+    };
+
+} // namespace curio_realtime
+
+#endif // CURIO_REALTIME_REALTIME_GUARD_H_
@@ -0,0 +1,131 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#ifndef CURIO_REALTIME_REALTIME_QUEUE_H_
+#define CURIO_REALTIME_REALTIME_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+
+namespace curio_realtime
+{
+    /**
+     * \brief A fixed capacity, lock-free, single producer single consumer queue.
+     *
+     * The producer (usually the realtime control loop) and the consumer
+     * (a non-realtime worker thread) may run concurrently without locks.
+     * Storage is allocated inline so neither push nor pop allocate.
+     *
+     * \tparam T        Element type, should be cheap to copy
+     * \tparam Capacity Maximum number of elements, must be a power of two
+     */
+    template <typename T, size_t Capacity>
+    class RealtimeQueue
+    {
+        static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0,
+            "RealtimeQueue capacity must be a power of two");
+
+    public:
+        RealtimeQueue() : head_(0), tail_(0)
+        {
+        }
+
+        /**
+         * \brief Push an element onto the queue (producer only)
+         * \param value The element to copy into the queue
+         * \return false if the queue is full and the element was not added
+         */
+        bool push(const T& value)
+        {
+            const size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail - head_.load(std::memory_order_acquire) >= Capacity)
+                return false;
+
+            buffer_[tail & kMask] = value;
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * \brief Pop an element from the queue (consumer only)
+         * \param [out] value The element removed from the queue
+         * \return false if the queue is empty
+         */
+        bool pop(T& value)
+        {
+            const size_t head = head_.load(std::memory_order_relaxed);
+            if (head == tail_.load(std::memory_order_acquire))
+                return false;
+
+            value = buffer_[head & kMask];
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * \brief Approximate number of queued elements
+         */
+        size_t size() const
+        {
+            return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+        }
+
+        /**
+         * \brief Queue capacity
+         */
+        static constexpr size_t capacity()
+        {
+            return Capacity;
+        }
+
+    private:
+        static constexpr size_t kMask = Capacity - 1;
+
+        /// Keep the consumer and producer indices on separate cache lines.
+        std::atomic<size_t> head_;
+        char pad0_[64 - sizeof(std::atomic<size_t>)];
+        std::atomic<size_t> tail_;
+        char pad1_[64 - sizeof(std::atomic<size_t>)];
+        T buffer_[Capacity];
+    };
+
+} // namespace curio_realtime
+
+#endif // CURIO_REALTIME_REALTIME_QUEUE_H_
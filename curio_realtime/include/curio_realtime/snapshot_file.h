@@ -0,0 +1,308 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#ifndef CURIO_REALTIME_SNAPSHOT_FILE_H_
+#define CURIO_REALTIME_SNAPSHOT_FILE_H_
+
+#include <ros/console.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace curio_realtime
+{
+    /**
+     * \brief A small crash consistent state snapshot in a memory mapped file.
+     *
+     * The file holds two slots. Each write goes to the slot not holding
+     * the latest snapshot, and the slot is sealed with a checksum over its
+     * sequence number, timestamp and payload. A write interrupted by a
+     * crash leaves the other slot intact, so read always finds the last
+     * complete snapshot.
+     *
+     * write does no system calls and does not allocate, so it may be called
+     * from the realtime loop. The page cache keeps the data when the process
+     * dies; it reaches the disk with the normal writeback, or on flush.
+     *
+     * \tparam T Payload type, must be trivially copyable
+     */
+    template <typename T>
+    class SnapshotFile
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+            "SnapshotFile payload must be trivially copyable");
+
+    public:
+        static const uint32_t VERSION = 1;
+
+        SnapshotFile() : file_(nullptr), sequence_(0)
+        {
+        }
+
+        ~SnapshotFile()
+        {
+            close();
+        }
+
+        SnapshotFile(const SnapshotFile&) = delete;
+        SnapshotFile& operator=(const SnapshotFile&) = delete;
+
+        /**
+         * \brief Open or create a snapshot file
+         *
+         * An existing file with a different magic, version or payload
+         * size is cleared.
+         *
+         * \param path  File name
+         * \param magic Identifies the payload type (up to 8 characters)
+         * \return false if the file could not be opened or mapped
+         */
+        bool open(const std::string& path, const char* magic)
+        {
+            close();
+
+            const int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+            if (fd < 0)
+            {
+                ROS_ERROR_STREAM("Failed to open snapshot file " << path
+                    << ": " << std::strerror(errno));
+                return false;
+            }
+
+            struct stat st;
+            bool ok = fstat(fd, &st) == 0;
+            if (ok && st.st_size != static_cast<off_t>(sizeof(File)))
+            {
+                ok = ftruncate(fd, 0) == 0 && ftruncate(fd, sizeof(File)) == 0;
+            }
+            void* addr = ok ? mmap(nullptr, sizeof(File), PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0) : MAP_FAILED;
+            const int error = errno;
+            ::close(fd);
+            if (addr == MAP_FAILED)
+            {
+                ROS_ERROR_STREAM("Failed to map snapshot file " << path
+                    << ": " << std::strerror(error));
+                return false;
+            }
+            file_ = static_cast<File*>(addr);
+
+            char name[sizeof(file_->header.magic)] = { 0 };
+            std::strncpy(name, magic, sizeof(name));
+            if (std::memcmp(file_->header.magic, name, sizeof(name)) != 0
+                || file_->header.version != VERSION
+                || file_->header.payload_size != sizeof(T))
+            {
+                std::memset(file_, 0, sizeof(File));
+                std::memcpy(file_->header.magic, name, sizeof(name));
+                file_->header.version = VERSION;
+                file_->header.payload_size = sizeof(T);
+            }
+
+            // Continue the sequence from the latest valid slot and touch
+            // both slots so the first writes do not fault.
+            const Slot* latest = latestSlot();
+            sequence_ = latest != nullptr ? latest->sequence : 0;
+            for (int i = 0; i < 2; ++i)
+            {
+                volatile uint64_t* touch = &file_->slots[i].checksum;
+                *touch = *touch;
+            }
+            return true;
+        }
+
+        /**
+         * \brief Flush and unmap the file
+         */
+        void close()
+        {
+            if (file_ != nullptr)
+            {
+                flush();
+                munmap(file_, sizeof(File));
+                file_ = nullptr;
+            }
+        }
+
+        bool isOpen() const
+        {
+            return file_ != nullptr;
+        }
+
+        /**
+         * \brief Read the latest complete snapshot
+         * \param [out] value   The snapshot payload
+         * \param max_age       Reject snapshots older than this [s], 0 to accept any
+         * \param [out] age     Age of the snapshot [s]
+         * \return false if there is no valid snapshot or it is too old
+         */
+        bool read(T& value, double max_age, double& age) const
+        {
+            const Slot* latest = file_ != nullptr ? latestSlot() : nullptr;
+            if (latest == nullptr)
+                return false;
+
+            age = (now() - latest->stamp_ns) * 1.0e-9;
+            if (age < 0.0 || (max_age > 0.0 && age > max_age))
+                return false;
+
+            std::memcpy(&value, &latest->payload, sizeof(T));
+            return true;
+        }
+
+        /**
+         * \brief Write a snapshot. Realtime safe.
+         * \param value The snapshot payload
+         */
+        void write(const T& value)
+        {
+            if (file_ == nullptr)
+                return;
+
+            const uint64_t sequence = sequence_ + 1;
+            Slot& slot = file_->slots[sequence & 1];
+
+            // Invalidate the slot first so a partial write cannot be
+            // mistaken for a complete one with a stale checksum.
+            slot.sequence = 0;
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            slot.stamp_ns = now();
+            std::memcpy(&slot.payload, &value, sizeof(T));
+            slot.checksum = checksum(slot, sequence);
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            slot.sequence = sequence;
+            sequence_ = sequence;
+        }
+
+        /**
+         * \brief Schedule the file to be written to disk. Not realtime safe.
+         */
+        void flush()
+        {
+            if (file_ != nullptr)
+            {
+                msync(file_, sizeof(File), MS_ASYNC);
+            }
+        }
+
+    private:
+        struct Header
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t payload_size;
+        };
+
+        struct Slot
+        {
+            uint64_t sequence;
+            int64_t stamp_ns;       ///< CLOCK_REALTIME when written [ns]
+            T payload;
+            uint64_t checksum;
+        };
+
+        struct File
+        {
+            Header header;
+            Slot slots[2];
+        };
+
+        /// Wall clock time, so snapshots age across reboots [ns]
+        static int64_t now()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+        }
+
+        /// FNV-1a over the sequence, stamp and payload of a slot
+        static uint64_t checksum(const Slot& slot, uint64_t sequence)
+        {
+            uint64_t hash = 14695981039346656037ULL;
+            hash = fnv1a(hash, &sequence, sizeof(sequence));
+            hash = fnv1a(hash, &slot.stamp_ns, sizeof(slot.stamp_ns));
+            hash = fnv1a(hash, &slot.payload, sizeof(T));
+            return hash;
+        }
+
+        static uint64_t fnv1a(uint64_t hash, const void* data, size_t size)
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            for (size_t i = 0; i < size; ++i)
+            {
+                hash ^= bytes[i];
+                hash *= 1099511628211ULL;
+            }
+            return hash;
+        }
+
+        /// The valid slot with the highest sequence, or nullptr
+        const Slot* latestSlot() const
+        {
+            const Slot* latest = nullptr;
+            for (int i = 0; i < 2; ++i)
+            {
+                const Slot& slot = file_->slots[i];
+                if (slot.sequence != 0 && slot.checksum == checksum(slot, slot.sequence)
+                    && (latest == nullptr || slot.sequence > latest->sequence))
+                {
+                    latest = &slot;
+                }
+            }
+            return latest;
+        }
+
+        File* file_;
+        uint64_t sequence_;
+    };
+
+} // namespace curio_realtime
+
+#endif // CURIO_REALTIME_SNAPSHOT_FILE_H_
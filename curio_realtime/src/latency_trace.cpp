@@ -0,0 +1,260 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#include "curio_realtime/latency_trace.h"
+#include "curio_realtime/latency_histogram.h"
+
+#include <ros/console.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace curio_realtime
+{
+    namespace
+    {
+        const char MAGIC[8] = { 'C', 'M', 'D', 'T', 'R', 'A', 'C', 'E' };
+
+        uint64_t toBits(double value)
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+    }
+
+    const uint32_t LatencyTrace::CAPACITY;
+    const uint32_t LatencyTrace::VERSION;
+
+    const char* LatencyTrace::stageName(uint32_t stage)
+    {
+        switch (stage)
+        {
+            case STAGE_RC_RECEIVED:     return "rc_received";
+            case STAGE_CMD_PUBLISHED:   return "cmd_published";
+            case STAGE_CMD_RECEIVED:    return "cmd_received";
+            case STAGE_UPDATE:          return "update";
+            case STAGE_WRITE:           return "write";
+            default:                    return "unknown";
+        }
+    }
+
+    LatencyTrace::LatencyTrace() :
+        file_(nullptr),
+        matched_sequence_(0)
+    {
+    }
+
+    LatencyTrace::~LatencyTrace()
+    {
+        close();
+    }
+
+    bool LatencyTrace::open(const std::string& path)
+    {
+        close();
+
+        const int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0666);
+        if (fd < 0)
+        {
+            ROS_ERROR_STREAM("Failed to open latency trace " << path
+                << ": " << std::strerror(errno));
+            return false;
+        }
+
+        // The first process to open the file sizes it; a file of any other
+        // size is left from a different build and is recreated.
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0;
+        const bool resized = ok && st.st_size != static_cast<off_t>(sizeof(File));
+        if (resized)
+        {
+            ok = ftruncate(fd, 0) == 0 && ftruncate(fd, sizeof(File)) == 0;
+        }
+        void* addr = ok ? mmap(nullptr, sizeof(File), PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0) : MAP_FAILED;
+        const int error = errno;
+        ::close(fd);
+        if (addr == MAP_FAILED)
+        {
+            ROS_ERROR_STREAM("Failed to map latency trace " << path
+                << ": " << std::strerror(error));
+            return false;
+        }
+        file_ = static_cast<File*>(addr);
+        matched_sequence_.store(0, std::memory_order_relaxed);
+
+        if (resized || std::memcmp(file_->magic, MAGIC, sizeof(MAGIC)) != 0
+            || file_->version != VERSION || file_->capacity != CAPACITY)
+        {
+            std::memset(static_cast<void*>(file_), 0, sizeof(File));
+            std::memcpy(file_->magic, MAGIC, sizeof(MAGIC));
+            file_->version = VERSION;
+            file_->capacity = CAPACITY;
+        }
+        return true;
+    }
+
+    void LatencyTrace::close()
+    {
+        if (file_ != nullptr)
+        {
+            munmap(file_, sizeof(File));
+            file_ = nullptr;
+        }
+    }
+
+    uint64_t LatencyTrace::newTraceId()
+    {
+        if (file_ == nullptr)
+            return 0;
+
+        return file_->next_trace_id.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    void LatencyTrace::record(uint64_t trace_id, Stage stage)
+    {
+        if (file_ == nullptr || trace_id == 0)
+            return;
+
+        const uint64_t stamp_ns = monotonicNanoseconds();
+        const uint64_t index = file_->head.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = file_->slots[index & (CAPACITY - 1)];
+        slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.trace_id.store(trace_id, std::memory_order_relaxed);
+        slot.stamp_ns.store(stamp_ns, std::memory_order_relaxed);
+        slot.stage.store(stage, std::memory_order_relaxed);
+        slot.sequence.store(2 * index + 2, std::memory_order_release);
+    }
+
+    void LatencyTrace::setPublished(uint64_t trace_id, double lin, double ang)
+    {
+        if (file_ == nullptr)
+            return;
+
+        // Single writer (the teleop node)
+        const uint64_t sequence = file_->published_sequence.load(std::memory_order_relaxed);
+        file_->published_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        file_->published_id.store(trace_id, std::memory_order_relaxed);
+        file_->published_lin.store(toBits(lin), std::memory_order_relaxed);
+        file_->published_ang.store(toBits(ang), std::memory_order_relaxed);
+        file_->published_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    uint64_t LatencyTrace::matchPublished(double lin, double ang)
+    {
+        if (file_ == nullptr)
+            return 0;
+
+        for (int attempt = 0; attempt < 4; ++attempt)
+        {
+            const uint64_t sequence = file_->published_sequence.load(std::memory_order_acquire);
+            if (sequence & 1)
+                continue;
+
+            const uint64_t trace_id = file_->published_id.load(std::memory_order_relaxed);
+            const uint64_t lin_bits = file_->published_lin.load(std::memory_order_relaxed);
+            const uint64_t ang_bits = file_->published_ang.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (file_->published_sequence.load(std::memory_order_relaxed) != sequence)
+                continue;
+
+            if (lin_bits != toBits(lin) || ang_bits != toBits(ang)
+                || trace_id <= file_->consumed_id.load(std::memory_order_acquire))
+                return 0;
+
+            // Claim the publish, so a later command with the same velocities
+            // is not tagged with it
+            uint64_t matched = matched_sequence_.load(std::memory_order_relaxed);
+            do
+            {
+                if (matched >= sequence)
+                    return 0;
+            }
+            while (!matched_sequence_.compare_exchange_weak(matched, sequence,
+                std::memory_order_relaxed));
+            return trace_id;
+        }
+        return 0;
+    }
+
+    void LatencyTrace::setConsumed(uint64_t trace_id)
+    {
+        if (file_ != nullptr)
+        {
+            file_->consumed_id.store(trace_id, std::memory_order_release);
+        }
+    }
+
+    uint64_t LatencyTrace::getConsumed() const
+    {
+        return file_ != nullptr ? file_->consumed_id.load(std::memory_order_acquire) : 0;
+    }
+
+    uint64_t LatencyTrace::head() const
+    {
+        return file_ != nullptr ? file_->head.load(std::memory_order_acquire) : 0;
+    }
+
+    bool LatencyTrace::read(uint64_t index, Event& event) const
+    {
+        if (file_ == nullptr)
+            return false;
+
+        const Slot& slot = file_->slots[index & (CAPACITY - 1)];
+        const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * index + 2)
+            return false;
+
+        event.trace_id = slot.trace_id.load(std::memory_order_relaxed);
+        event.stamp_ns = slot.stamp_ns.load(std::memory_order_relaxed);
+        event.stage = static_cast<uint32_t>(slot.stage.load(std::memory_order_relaxed));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.sequence.load(std::memory_order_relaxed) == sequence;
+    }
+
+} // namespace curio_realtime
@@ -0,0 +1,187 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+// Report per stage latency histograms of traced velocity commands.
+//
+// Follows the latency trace ring written by the teleop node, the controller
+// and the hardware interface, and periodically prints the latency of each
+// hop between consecutive stages of a trace and of the whole pipeline.
+//
+// Usage:
+//   curio_latency_trace <trace_file> [<report_period>]
+//
+// Enable tracing by setting the 'latency_trace' parameter of the teleop
+// node, the controller and the hardware interface to the same file.
+
+#include "curio_realtime/latency_histogram.h"
+#include "curio_realtime/latency_trace.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+
+#include <unistd.h>
+
+using namespace curio_realtime;
+
+namespace
+{
+    volatile std::sig_atomic_t g_running = 1;
+
+    void handleSignal(int)
+    {
+        g_running = 0;
+    }
+
+    /// Number of traces in flight that are tracked
+    const size_t NUM_TRACES = 256;
+
+    /// Stage timestamps of a trace in flight
+    struct Trace
+    {
+        uint64_t trace_id;
+        uint64_t stamp_ns[LatencyTrace::NUM_STAGES];
+    };
+
+    void report(const LatencyHistogram hops[], const LatencyHistogram& total,
+        uint64_t events, uint64_t lost)
+    {
+        std::cout << "events: " << events << ", lost: " << lost << "\n";
+        for (uint32_t stage = 1; stage < LatencyTrace::NUM_STAGES; ++stage)
+        {
+            std::cout << LatencyTrace::stageName(stage - 1) << " -> "
+                << LatencyTrace::stageName(stage) << ": "
+                << hops[stage].summary() << "\n";
+        }
+        std::cout << "end to end: " << total.summary() << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argc > 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <trace_file> [<report_period>]" << std::endl;
+        return 1;
+    }
+    const double report_period = argc == 3 ? std::atof(argv[2]) : 5.0;
+
+    LatencyTrace trace;
+    if (!trace.open(argv[1]))
+    {
+        return 1;
+    }
+
+    std::signal(SIGINT, handleSignal);
+    std::signal(SIGTERM, handleSignal);
+
+    // hops[k] holds the latency from stage k - 1 to stage k
+    LatencyHistogram hops[LatencyTrace::NUM_STAGES];
+    LatencyHistogram total;
+    Trace traces[NUM_TRACES] = {};
+    uint64_t events = 0;
+    uint64_t lost = 0;
+
+    // Start from the events recorded after the collector started
+    uint64_t index = trace.head();
+    uint64_t last_report_ns = monotonicNanoseconds();
+    while (g_running)
+    {
+        const uint64_t head = trace.head();
+        if (head - index > LatencyTrace::CAPACITY)
+        {
+            lost += head - index - LatencyTrace::CAPACITY;
+            index = head - LatencyTrace::CAPACITY;
+        }
+
+        LatencyTrace::Event event;
+        while (index < head)
+        {
+            if (!trace.read(index, event))
+            {
+                // Still being written, try again on the next poll
+                if (trace.head() - index <= LatencyTrace::CAPACITY / 2)
+                    break;
+                ++lost;
+                ++index;
+                continue;
+            }
+            ++index;
+            ++events;
+            if (event.stage >= LatencyTrace::NUM_STAGES)
+                continue;
+
+            Trace& t = traces[event.trace_id % NUM_TRACES];
+            if (t.trace_id != event.trace_id)
+            {
+                t = Trace();
+                t.trace_id = event.trace_id;
+            }
+
+            // Only the first time a trace reaches a stage counts
+            if (t.stamp_ns[event.stage] != 0)
+                continue;
+            t.stamp_ns[event.stage] = event.stamp_ns;
+
+            if (event.stage > 0 && t.stamp_ns[event.stage - 1] != 0
+                && event.stamp_ns >= t.stamp_ns[event.stage - 1])
+            {
+                hops[event.stage].record(event.stamp_ns - t.stamp_ns[event.stage - 1]);
+            }
+            if (event.stage == LatencyTrace::STAGE_WRITE
+                && t.stamp_ns[LatencyTrace::STAGE_RC_RECEIVED] != 0
+                && event.stamp_ns >= t.stamp_ns[LatencyTrace::STAGE_RC_RECEIVED])
+            {
+                total.record(event.stamp_ns - t.stamp_ns[LatencyTrace::STAGE_RC_RECEIVED]);
+            }
+        }
+
+        const uint64_t now_ns = monotonicNanoseconds();
+        if (report_period > 0.0 && (now_ns - last_report_ns) * 1.0E-9 >= report_period)
+        {
+            report(hops, total, events, lost);
+            last_report_ns = now_ns;
+        }
+        usleep(10000);
+    }
+
+    report(hops, total, events, lost);
+    return 0;
+}
@@ -0,0 +1,143 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+#include "curio_realtime/realtime_guard.h"
+
+#include <dlfcn.h>
+
+namespace curio_realtime
+{
+    namespace
+    {
+        /// Entry points of the guard library, null if it is not loaded
+        struct GuardLibrary
+        {
+            uint32_t (*enter)(uint32_t checks);
+            void (*leave)(uint32_t previous);
+            uint64_t (*thread_violations)();
+            uint64_t (*violations)();
+            void (*set_armed)(int armed);
+            void (*report)(int fd);
+
+            GuardLibrary()
+            {
+                enter = reinterpret_cast<uint32_t (*)(uint32_t)>(
+                    dlsym(RTLD_DEFAULT, "curio_rt_guard_enter"));
+                leave = reinterpret_cast<void (*)(uint32_t)>(
+                    dlsym(RTLD_DEFAULT, "curio_rt_guard_leave"));
+                thread_violations = reinterpret_cast<uint64_t (*)()>(
+                    dlsym(RTLD_DEFAULT, "curio_rt_guard_thread_violations"));
+                violations = reinterpret_cast<uint64_t (*)()>(
+                    dlsym(RTLD_DEFAULT, "curio_rt_guard_violations"));
+                set_armed = reinterpret_cast<void (*)(int)>(
+                    dlsym(RTLD_DEFAULT, "curio_rt_guard_set_armed"));
+                report = reinterpret_cast<void (*)(int)>(
+                    dlsym(RTLD_DEFAULT, "curio_rt_guard_report"));
+                if (!enter || !leave || !thread_violations || !violations
+                    || !set_armed || !report)
+                {
+                    enter = nullptr;
+                }
+            }
+        };
+
+        /// Resolved during static initialisation, before any realtime loop
+        const GuardLibrary g_library;
+    }
+
+    RealtimeGuard::Scope::Scope(uint32_t checks) :
+        previous_(0),
+        start_(0)
+    {
+        if (g_library.enter)
+        {
+            start_ = g_library.thread_violations();
+            previous_ = g_library.enter(checks);
+        }
+    }
+
+    RealtimeGuard::Scope::~Scope()
+    {
+        if (g_library.enter)
+        {
+            g_library.leave(previous_);
+        }
+    }
+
+    uint64_t RealtimeGuard::Scope::violations() const
+    {
+        return g_library.enter ? g_library.thread_violations() - start_ : 0;
+    }
+
+    bool RealtimeGuard::isLoaded()
+    {
+        return g_library.enter != nullptr;
+    }
+
+    void RealtimeGuard::arm()
+    {
+        if (g_library.enter)
+        {
+            g_library.set_armed(1);
+        }
+    }
+
+    void RealtimeGuard::disarm()
+    {
+        if (g_library.enter)
+        {
+            g_library.set_armed(0);
+        }
+    }
+
+    uint64_t RealtimeGuard::getViolations()
+    {
+        return g_library.enter ? g_library.violations() : 0;
+    }
+
+    void RealtimeGuard::report(int fd)
+    {
+        if (g_library.enter)
+        {
+            g_library.report(fd);
+        }
+    }
+
+} // namespace curio_realtime
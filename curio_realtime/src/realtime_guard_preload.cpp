@@ -0,0 +1,391 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+/*
+ * Author: Rhys Mainwaring
+ */
+
+// Interposed allocation, locking and blocking calls for RealtimeGuard.
+//
+// Built as libcurio_realtime_guard.so and loaded with LD_PRELOAD. Every
+// interposed call checks a thread local mask set by RealtimeGuard::Scope.
+// Outside a scope, or when the guard is not armed, the call is forwarded
+// directly.
+//
+// Calls made inside glibc (e.g. fwrite calling write) do not go through
+// the dynamic linker and are not seen.
+
+#include "curio_realtime/realtime_guard.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/select.h>
+#include <time.h>
+#include <unistd.h>
+
+extern "C"
+{
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* ptr, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void* ptr);
+}
+
+namespace
+{
+    using curio_realtime::RealtimeGuard;
+
+    /// Initial exec TLS never allocates, unlike the default for shared libraries
+    #define RT_GUARD_TLS __thread __attribute__((tls_model("initial-exec")))
+
+    RT_GUARD_TLS uint32_t t_checks = 0;
+    RT_GUARD_TLS uint64_t t_violations = 0;
+    RT_GUARD_TLS bool t_in_guard = false;
+
+    std::atomic<bool> g_armed(false);
+    std::atomic<uint64_t> g_violations(0);
+
+    /// A call site that violated a check, identified by its call stack
+    struct Site
+    {
+        std::atomic<bool> ready;
+        uint64_t hash;
+        const char* call;
+        int depth;
+        void* frames[24];
+        std::atomic<uint64_t> count;
+    };
+
+    const uint32_t MAX_SITES = 64;
+    Site g_sites[MAX_SITES];
+    std::atomic<uint32_t> g_num_sites(0);
+    std::atomic<uint64_t> g_sites_dropped(0);
+
+    /// Frames of recordSite and violation at the top of each call stack
+    const int GUARD_FRAMES = 2;
+
+    __attribute__((noinline)) void recordSite(const char* call)
+    {
+        void* frames[24];
+        const int depth = backtrace(frames, 24);
+        uint64_t hash = 14695981039346656037ULL;
+        for (int i = 0; i < depth; ++i)
+        {
+            hash = (hash ^ reinterpret_cast<uintptr_t>(frames[i])) * 1099511628211ULL;
+        }
+
+        const uint32_t num_sites = std::min(g_num_sites.load(std::memory_order_acquire), MAX_SITES);
+        for (uint32_t i = 0; i < num_sites; ++i)
+        {
+            Site& site = g_sites[i];
+            if (site.ready.load(std::memory_order_acquire) && site.hash == hash)
+            {
+                site.count.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+
+        // Two threads may add the same new site, which is harmless
+        const uint32_t index = g_num_sites.fetch_add(1, std::memory_order_acq_rel);
+        if (index >= MAX_SITES)
+        {
+            g_sites_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Site& site = g_sites[index];
+        site.hash = hash;
+        site.call = call;
+        site.depth = depth;
+        std::memcpy(site.frames, frames, sizeof(frames));
+        site.count.store(1, std::memory_order_relaxed);
+        site.ready.store(true, std::memory_order_release);
+    }
+
+    __attribute__((noinline)) void violation(const char* call)
+    {
+        // backtrace may allocate, which must not be counted again
+        t_in_guard = true;
+        ++t_violations;
+        g_violations.fetch_add(1, std::memory_order_relaxed);
+        recordSite(call);
+        t_in_guard = false;
+    }
+
+    inline void check(uint32_t kind, const char* call)
+    {
+        if ((t_checks & kind) != 0 && !t_in_guard && g_armed.load(std::memory_order_relaxed))
+        {
+            violation(call);
+        }
+    }
+
+    void writeString(int fd, const char* s)
+    {
+        const ssize_t ignored = ::write(fd, s, std::strlen(s));
+        (void)ignored;
+    }
+
+    void writeNumber(int fd, uint64_t value)
+    {
+        char buf[24];
+        char* p = buf + sizeof(buf);
+        *--p = '\0';
+        do
+        {
+            *--p = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        writeString(fd, p);
+    }
+
+    /// The next definition of an interposed function, resolved on first use
+    template <typename Function>
+    Function resolve(Function& real, const char* name, const char* version = nullptr)
+    {
+        if (real == nullptr)
+        {
+            void* symbol = version != nullptr ? dlvsym(RTLD_NEXT, name, version) : nullptr;
+            if (symbol == nullptr)
+                symbol = dlsym(RTLD_NEXT, name);
+            real = reinterpret_cast<Function>(symbol);
+        }
+        return real;
+    }
+
+    /// Load the unwinder before any scope, its first use allocates
+    __attribute__((constructor)) void initialise()
+    {
+        void* frames[2];
+        backtrace(frames, 2);
+    }
+}
+
+#define RT_GUARD_REAL(name) resolve(real_##name, #name)
+
+#define RT_GUARD_DECLARE_REAL(name) \
+    namespace { decltype(&::name) real_##name = nullptr; }
+
+extern "C"
+{
+    // Interface used by RealtimeGuard
+
+    uint32_t curio_rt_guard_enter(uint32_t checks)
+    {
+        const uint32_t previous = t_checks;
+        t_checks = checks;
+        return previous;
+    }
+
+    void curio_rt_guard_leave(uint32_t previous)
+    {
+        t_checks = previous;
+    }
+
+    uint64_t curio_rt_guard_thread_violations()
+    {
+        return t_violations;
+    }
+
+    uint64_t curio_rt_guard_violations()
+    {
+        return g_violations.load(std::memory_order_relaxed);
+    }
+
+    void curio_rt_guard_set_armed(int armed)
+    {
+        g_armed.store(armed != 0, std::memory_order_relaxed);
+    }
+
+    void curio_rt_guard_report(int fd)
+    {
+        const bool in_guard = t_in_guard;
+        t_in_guard = true;
+
+        writeString(fd, "Realtime guard: ");
+        writeNumber(fd, g_violations.load(std::memory_order_relaxed));
+        writeString(fd, " violations\n");
+        const uint32_t num_sites = std::min(g_num_sites.load(std::memory_order_acquire), MAX_SITES);
+        for (uint32_t i = 0; i < num_sites; ++i)
+        {
+            const Site& site = g_sites[i];
+            if (!site.ready.load(std::memory_order_acquire))
+                continue;
+
+            writeString(fd, site.call);
+            writeString(fd, " called ");
+            writeNumber(fd, site.count.load(std::memory_order_relaxed));
+            writeString(fd, " times from:\n");
+            const int skip = std::min(site.depth, GUARD_FRAMES);
+            backtrace_symbols_fd(site.frames + skip, site.depth - skip, fd);
+        }
+        const uint64_t dropped = g_sites_dropped.load(std::memory_order_relaxed);
+        if (dropped != 0)
+        {
+            writeNumber(fd, dropped);
+            writeString(fd, " violations at further call sites were not recorded\n");
+        }
+        t_in_guard = in_guard;
+    }
+
+    // Allocation
+
+    void* malloc(size_t size) noexcept
+    {
+        check(RealtimeGuard::CHECK_ALLOCATION, "malloc");
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size) noexcept
+    {
+        check(RealtimeGuard::CHECK_ALLOCATION, "calloc");
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* ptr, size_t size) noexcept
+    {
+        check(RealtimeGuard::CHECK_ALLOCATION, "realloc");
+        return __libc_realloc(ptr, size);
+    }
+
+    void* memalign(size_t alignment, size_t size) noexcept
+    {
+        check(RealtimeGuard::CHECK_ALLOCATION, "memalign");
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size) noexcept
+    {
+        check(RealtimeGuard::CHECK_ALLOCATION, "aligned_alloc");
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** ptr, size_t alignment, size_t size) noexcept
+    {
+        check(RealtimeGuard::CHECK_ALLOCATION, "posix_memalign");
+        if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+            return EINVAL;
+        void* p = __libc_memalign(alignment, size);
+        if (p == nullptr)
+            return ENOMEM;
+        *ptr = p;
+        return 0;
+    }
+
+    void free(void* ptr) noexcept
+    {
+        if (ptr != nullptr)
+        {
+            check(RealtimeGuard::CHECK_ALLOCATION, "free");
+        }
+        __libc_free(ptr);
+    }
+}
+
+// Locking
+
+RT_GUARD_DECLARE_REAL(pthread_mutex_lock)
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept
+{
+    check(RealtimeGuard::CHECK_MUTEX, "pthread_mutex_lock");
+    return RT_GUARD_REAL(pthread_mutex_lock)(mutex);
+}
+
+// Blocking calls
+
+#define RT_GUARD_BLOCKING(ret, name, params, args) \
+    RT_GUARD_DECLARE_REAL(name) \
+    extern "C" ret name params \
+    { \
+        check(RealtimeGuard::CHECK_BLOCKING, #name); \
+        return RT_GUARD_REAL(name) args; \
+    }
+
+RT_GUARD_BLOCKING(ssize_t, read, (int fd, void* buf, size_t count), (fd, buf, count))
+RT_GUARD_BLOCKING(ssize_t, write, (int fd, const void* buf, size_t count), (fd, buf, count))
+RT_GUARD_BLOCKING(int, poll, (struct pollfd* fds, nfds_t nfds, int timeout), (fds, nfds, timeout))
+RT_GUARD_BLOCKING(int, select, (int nfds, fd_set* readfds, fd_set* writefds,
+    fd_set* exceptfds, struct timeval* timeout), (nfds, readfds, writefds, exceptfds, timeout))
+RT_GUARD_BLOCKING(int, nanosleep, (const struct timespec* req, struct timespec* rem), (req, rem))
+RT_GUARD_BLOCKING(int, usleep, (useconds_t usec), (usec))
+RT_GUARD_BLOCKING(int, fsync, (int fd), (fd))
+RT_GUARD_BLOCKING(int, sem_wait, (sem_t* sem), (sem))
+RT_GUARD_BLOCKING(int, pthread_join, (pthread_t thread, void** retval), (thread, retval))
+
+// The unversioned lookup finds the pre 2.3.2 condition variables on some
+// targets, so ask for the current version first.
+
+RT_GUARD_DECLARE_REAL(pthread_cond_wait)
+extern "C" int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex)
+{
+    check(RealtimeGuard::CHECK_BLOCKING, "pthread_cond_wait");
+    return resolve(real_pthread_cond_wait, "pthread_cond_wait", "GLIBC_2.3.2")(cond, mutex);
+}
+
+RT_GUARD_DECLARE_REAL(pthread_cond_timedwait)
+extern "C" int pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex,
+    const struct timespec* abstime)
+{
+    check(RealtimeGuard::CHECK_BLOCKING, "pthread_cond_timedwait");
+    return resolve(real_pthread_cond_timedwait, "pthread_cond_timedwait", "GLIBC_2.3.2")(
+        cond, mutex, abstime);
+}
+RT_GUARD_DECLARE_REAL(open)
+extern "C" int open(const char* path, int flags, ...)
+{
+    check(RealtimeGuard::CHECK_BLOCKING, "open");
+    mode_t mode = 0;
+    if (flags & O_CREAT)
+    {
+        va_list args;
+        va_start(args, flags);
+        mode = static_cast<mode_t>(va_arg(args, int));
+        va_end(args);
+    }
+    return RT_GUARD_REAL(open)(path, flags, mode);
+}
@@ -0,0 +1,136 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+//
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+/*
+ * Author: Rhys Mainwaring
+ */
+
+// Run with the guard library preloaded, see the test target in
+// CMakeLists.txt. Without it every scope reports no violations.
+
+#include "curio_realtime/realtime_guard.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+
+#include <unistd.h>
+
+using curio_realtime::RealtimeGuard;
+
+namespace
+{
+    /// Allocate and free through a volatile pointer, so the pair is kept
+    void allocate()
+    {
+        void* volatile p = std::malloc(64);
+        std::free(p);
+    }
+}
+
+TEST(RealtimeGuard, isLoaded)
+{
+    ASSERT_TRUE(RealtimeGuard::isLoaded())
+        << "run with LD_PRELOAD=libcurio_realtime_guard.so";
+}
+
+TEST(RealtimeGuard, countsAllocationWhenArmed)
+{
+    RealtimeGuard::arm();
+    uint64_t violations = 0;
+    {
+        RealtimeGuard::Scope scope(RealtimeGuard::CHECK_ALLOCATION);
+        allocate();
+        violations = scope.violations();
+    }
+    RealtimeGuard::disarm();
+    EXPECT_GE(violations, 1u);
+}
+
+TEST(RealtimeGuard, countsSleepWhenArmed)
+{
+    RealtimeGuard::arm();
+    uint64_t violations = 0;
+    {
+        RealtimeGuard::Scope scope(RealtimeGuard::CHECK_BLOCKING);
+        usleep(100);
+        violations = scope.violations();
+    }
+    RealtimeGuard::disarm();
+    EXPECT_EQ(violations, 1u);
+}
+
+TEST(RealtimeGuard, checksOnlySelectedCalls)
+{
+    RealtimeGuard::arm();
+    uint64_t violations = 0;
+    {
+        RealtimeGuard::Scope scope(RealtimeGuard::CHECK_BLOCKING);
+        allocate();
+        violations = scope.violations();
+    }
+    RealtimeGuard::disarm();
+    EXPECT_EQ(violations, 0u);
+}
+
+TEST(RealtimeGuard, countsNothingWhenDisarmed)
+{
+    const uint64_t total = RealtimeGuard::getViolations();
+    uint64_t violations = 0;
+    {
+        RealtimeGuard::Scope scope;
+        allocate();
+        usleep(100);
+        violations = scope.violations();
+    }
+    EXPECT_EQ(violations, 0u);
+    EXPECT_EQ(RealtimeGuard::getViolations(), total);
+}
+
+TEST(RealtimeGuard, countsNothingOutsideScope)
+{
+    RealtimeGuard::arm();
+    const uint64_t total = RealtimeGuard::getViolations();
+    allocate();
+    usleep(100);
+    RealtimeGuard::disarm();
+    EXPECT_EQ(RealtimeGuard::getViolations(), total);
+}
+
+int main(int argc, char** argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -37,9 +37,12 @@
 #ifndef CURIO_TELEOP_CURIO_TELEOP_RC_H_
 #define CURIO_TELEOP_CURIO_TELEOP_RC_H_
 
+#include "curio_teleop/rc_receiver.h"
 #include <curio_msgs/Channels.h>
+#include <curio_realtime/latency_trace.h>
 #include <geometry_msgs/Twist.h>
 #include <ros/ros.h>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -51,6 +54,16 @@ namespace curio_teleop
     /// on topic 'channels' and publishes geometry_msgs::Twist commands to 'cmd_vel'
     /// when teleoperation is enabled.
     ///
+    /// The Twist is computed and published as soon as each RC frame arrives.
+    /// It is published as a shared pointer, so subscribers in the same
+    /// process (e.g. when run as the curio_teleop/TeleopRCNodelet) receive
+    /// it without serialisation.
+    ///
+    /// Alternatively, if the parameter 'receiver/port' is set, the node reads
+    /// an SBUS or iBUS receiver wired directly to that UART instead of
+    /// subscribing to 'channels'. A stop command is published if the
+    /// receiver reports failsafe or no frames arrive for 'receiver/timeout'.
+    ///
     /// Parameters may be used to assign RC transmitter switches to
     /// enable / disable RC teleop control.
     ///
@@ -60,11 +73,6 @@ namespace curio_teleop
         /// \brief Constructor
         TeleopRC(ros::NodeHandle &nh, ros::NodeHandle &private_nh);
 
-        /// \brief Publish messages
-        //
-        /// Publish the Twist message to topic 'cmd_vel' if teleoperation is enabled. 
-        void publishMessages();
-
     private:
         // Node handles
         ros::NodeHandle nh_, private_nh_;
@@ -73,13 +81,19 @@ namespace curio_teleop
         ros::Subscriber channels_sub_;
         std::vector<int> channels_;
 
-        // Publisher Twist message to topic 'cmd_vel' at 10 Hz
-        geometry_msgs::Twist twist_msg_;
+        // Publisher Twist message to topic 'cmd_vel' on each RC frame
         ros::Publisher twist_pub_;
 
-        bool have_new_ = false;
         bool is_teleop_disabled_ = false;
 
+        // A non-zero command has been published since the last stop
+        bool is_commanding_ = false;
+        bool is_signal_lost_ = false;
+
+        // Command latency tracing, a trace starts with each RC frame
+        curio_realtime::LatencyTrace latency_trace_;
+        uint64_t trace_id_ = 0;
+
         // Parameters
         int pwm_min_ = 1100;
         int pwm_max_ = 1900;
@@ -96,6 +110,20 @@ namespace curio_teleop
         /// \brief Subscriber callback for RC channels data received on topic 'channels'. 
         void channelsCallback(const curio_msgs::Channels::ConstPtr &msg);
 
+        /// \brief Receiver callback for each frame read from the UART.
+        void receiverFrameCallback(const RCFrame &frame);
+
+        /// \brief Receiver callback when the signal is lost.
+        void receiverSignalLostCallback();
+
+        /// \brief Publish the Twist message to topic 'cmd_vel' if teleoperation is enabled.
+        void publishTwist();
+
+        /// \brief Publish a zero Twist if teleop is commanding the rover.
+        void publishStop();
+
+        // RC receiver on a UART, declared last so its thread stops first
+        std::unique_ptr<RCReceiver> receiver_;
     };
 } // namespace curio_teleop
 
@@ -0,0 +1,202 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//   
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//   
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+// 
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+#ifndef CURIO_TELEOP_RC_RECEIVER_H_
+#define CURIO_TELEOP_RC_RECEIVER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace curio_teleop
+{
+    /// \brief A decoded RC receiver frame.
+    struct RCFrame
+    {
+        static const size_t MAX_CHANNELS = 18;
+
+        /// Channel pulse widths [µs], nominally 1000 - 2000
+        uint16_t channels[MAX_CHANNELS];
+        size_t num_channels = 0;
+
+        /// The receiver has lost the transmitter and is sending failsafe values
+        bool failsafe = false;
+
+        /// The receiver missed the transmitter frame and repeated the last one
+        bool frame_lost = false;
+    };
+
+    /// \brief Streaming parser for an RC receiver serial protocol.
+    ///
+    /// Bytes are fed one at a time as they arrive from the UART. The parser
+    /// synchronises on the frame header and validates each frame, so it
+    /// recovers from dropped or corrupt bytes by itself.
+    ///
+    class RCParser
+    {
+    public:
+        virtual ~RCParser() {}
+
+        /// \brief Create a parser for a protocol.
+        /// \param protocol 'sbus' or 'ibus'.
+        /// \return The parser, or null if the protocol is unknown.
+        static std::unique_ptr<RCParser> create(const std::string &protocol);
+
+        /// \brief Feed the next byte received.
+        /// \return true if the byte completed a valid frame, see frame().
+        virtual bool parse(uint8_t byte) = 0;
+
+        /// \brief Discard any partial frame.
+        void reset() { size_ = 0; }
+
+        /// \brief The last valid frame.
+        const RCFrame &frame() const { return frame_; }
+
+        /// \brief Number of frames rejected as invalid.
+        uint64_t errors() const { return errors_; }
+
+        /// \brief UART settings of the protocol.
+        virtual int baudrate() const = 0;
+        virtual bool evenParity() const = 0;
+        virtual bool twoStopBits() const = 0;
+
+    protected:
+        /// \brief Drop the first byte of the buffer and resynchronise
+        /// on the next byte that could start a frame.
+        void resync(uint8_t header);
+
+        static const size_t MAX_FRAME_SIZE = 32;
+        uint8_t buffer_[MAX_FRAME_SIZE];
+        size_t size_ = 0;
+        RCFrame frame_;
+        uint64_t errors_ = 0;
+    };
+
+    /// \brief Futaba SBUS parser.
+    ///
+    /// 25 byte frames at 100000 baud, 8E2, inverted: a 0x0F header,
+    /// 16 channels of 11 bits, a flags byte (digital channels 17 and 18,
+    /// frame lost, failsafe) and a footer of 0x00 (or 0x?4 for SBUS2).
+    /// The UART must see the signal through an inverter.
+    ///
+    class SBUSParser : public RCParser
+    {
+    public:
+        virtual bool parse(uint8_t byte);
+        virtual int baudrate() const { return 100000; }
+        virtual bool evenParity() const { return true; }
+        virtual bool twoStopBits() const { return true; }
+
+        static const size_t FRAME_SIZE = 25;
+        static const uint8_t HEADER = 0x0F;
+    };
+
+    /// \brief FlySky iBUS parser.
+    ///
+    /// 32 byte frames at 115200 baud, 8N1: a 0x20 0x40 header, 14 channels
+    /// of 16 bits little endian [µs] and a checksum of 0xFFFF less the sum
+    /// of the preceding bytes. iBUS has no failsafe flag, the receiver
+    /// either stops sending or sends its failsafe positions.
+    ///
+    class IBUSParser : public RCParser
+    {
+    public:
+        virtual bool parse(uint8_t byte);
+        virtual int baudrate() const { return 115200; }
+        virtual bool evenParity() const { return false; }
+        virtual bool twoStopBits() const { return false; }
+
+        static const size_t FRAME_SIZE = 32;
+        static const uint8_t HEADER = 0x20;
+        static const uint8_t COMMAND = 0x40;
+    };
+
+    /// \brief Read an RC receiver connected directly to a UART.
+    ///
+    /// A reader thread blocks on the port, feeds the parser and calls back
+    /// with each valid frame. If no valid frame arrives for the timeout
+    /// the signal lost callback is called once, until frames resume.
+    ///
+    class RCReceiver
+    {
+    public:
+        typedef std::function<void(const RCFrame &)> FrameCallback;
+        typedef std::function<void()> SignalLostCallback;
+
+        RCReceiver() {}
+
+        ~RCReceiver();
+
+        RCReceiver(const RCReceiver &) = delete;
+        RCReceiver &operator=(const RCReceiver &) = delete;
+
+        /// \brief Open and configure the UART for a protocol.
+        /// \param port     The serial device, e.g. /dev/ttyAMA0.
+        /// \param protocol 'sbus' or 'ibus'.
+        /// \return false if the protocol is unknown or the port could not be configured.
+        bool open(const std::string &port, const std::string &protocol);
+
+        /// \brief Start the reader thread.
+        /// \param timeout          Signal lost after no frames for this long [s].
+        /// \param frame_cb         Called with each valid frame.
+        /// \param signal_lost_cb   Called when the signal is lost.
+        void start(double timeout, FrameCallback frame_cb, SignalLostCallback signal_lost_cb);
+
+        /// \brief Stop the reader thread and close the port.
+        void stop();
+
+        /// \brief Number of frames rejected by the parser.
+        uint64_t errors() const { return errors_.load(std::memory_order_relaxed); }
+
+    private:
+        /// \brief Reader thread main loop.
+        void run(double timeout);
+
+        std::unique_ptr<RCParser> parser_;
+        int fd_ = -1;
+        std::thread thread_;
+        std::atomic<bool> running_{false};
+        std::atomic<uint64_t> errors_{0};
+        FrameCallback frame_cb_;
+        SignalLostCallback signal_lost_cb_;
+    };
+} // namespace curio_teleop
+
+#endif // CURIO_TELEOP_RC_RECEIVER_H_
@@ -35,9 +35,12 @@
 //
 
 #include "curio_teleop/curio_teleop_rc.h"
+#include <boost/make_shared.hpp>
 #include <curio_msgs/Channels.h>
 #include <geometry_msgs/Twist.h>
 #include <ros/ros.h>
+#include <algorithm>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -55,6 +58,14 @@ namespace curio_teleop
         private_nh_.param<double>("angular/z/max_velocity", angular_z_max_velocity_, angular_z_max_velocity_);
         private_nh_.param<int>("disable_teleop/channel", disable_teleop_channel_, disable_teleop_channel_);    
 
+        // Optional command latency tracing.
+        std::string latency_trace;
+        private_nh_.param<std::string>("latency_trace", latency_trace, latency_trace);
+        if (!latency_trace.empty() && latency_trace_.open(latency_trace))
+        {
+            ROS_INFO_STREAM("Tracing command latency to " << latency_trace);
+        }
+
         // Resize storage for channel PWM data. Set default midpoint to 1500 µs.
         int max_channel = 0;
         max_channel = std::max(max_channel, linear_x_channel_);
@@ -66,11 +77,32 @@ namespace curio_teleop
         }
         channels_.resize(num_channels_, 1500);    
 
-        // Subscribers.
-        channels_sub_ = nh_.subscribe("channels", 10, &TeleopRC::channelsCallback, this);
-
         // Publishers.
         twist_pub_ = nh_.advertise<geometry_msgs::Twist>("cmd_vel", 10);
+
+        // Read the RC receiver directly if a port is given.
+        std::string receiver_port;
+        std::string receiver_protocol = "sbus";
+        double receiver_timeout = 0.1;
+        private_nh_.param<std::string>("receiver/port", receiver_port, receiver_port);
+        private_nh_.param<std::string>("receiver/protocol", receiver_protocol, receiver_protocol);
+        private_nh_.param<double>("receiver/timeout", receiver_timeout, receiver_timeout);
+        if (!receiver_port.empty())
+        {
+            receiver_.reset(new RCReceiver());
+            if (receiver_->open(receiver_port, receiver_protocol))
+            {
+                ROS_INFO_STREAM("Reading " << receiver_protocol << " RC receiver on " << receiver_port);
+                receiver_->start(receiver_timeout,
+                    std::bind(&TeleopRC::receiverFrameCallback, this, std::placeholders::_1),
+                    std::bind(&TeleopRC::receiverSignalLostCallback, this));
+            }
+            return;
+        }
+
+        // Subscribers. Disable Nagle so RC frames are not held back.
+        channels_sub_ = nh_.subscribe("channels", 10, &TeleopRC::channelsCallback, this,
+            ros::TransportHints().tcpNoDelay());
     }
 
 
@@ -81,6 +113,16 @@ namespace curio_teleop
 
     void TeleopRC::channelsCallback(const curio_msgs::Channels::ConstPtr &msg)
     {    
+        trace_id_ = latency_trace_.newTraceId();
+        latency_trace_.record(trace_id_, curio_realtime::LatencyTrace::STAGE_RC_RECEIVED);
+
+        if (msg->channels.size() < num_channels_)
+        {
+            ROS_ERROR_STREAM_THROTTLE(1.0, "curio_msgs::Channels message must contain at least: "
+                << num_channels_ << " channels");
+            return;
+        }
+
         ROS_DEBUG_STREAM("ch1: " << msg->channels[0]
             << ", ch2: " << msg->channels[1]
             << ", ch3: " << msg->channels[2]
@@ -88,77 +130,104 @@ namespace curio_teleop
             << ", ch5: " << msg->channels[4]
             << ", ch6: " << msg->channels[5]);
 
-            if (msg->channels.size() < num_channels_)
-            {
-                ROS_ERROR_STREAM("curio_msgs::Channels message must contain at least: "
-                    << num_channels_ << " channels");
-            }
-            for (int i=0; i<num_channels_; ++i)
-            {
-                channels_[i] = msg->channels[i];
-            }
-            have_new_ = true;
+        for (int i=0; i<num_channels_; ++i)
+        {
+            channels_[i] = msg->channels[i];
+        }
+        publishTwist();
     }
 
-    void TeleopRC::publishMessages()
+    void TeleopRC::receiverFrameCallback(const RCFrame &frame)
     {
-        if (have_new_)
-        {
-            have_new_ = false;
+        trace_id_ = latency_trace_.newTraceId();
+        latency_trace_.record(trace_id_, curio_realtime::LatencyTrace::STAGE_RC_RECEIVED);
 
-            // Check the off channel - do not publish if off.
-            if (channels_[disable_teleop_channel_ - 1] > 1800)
-            {
-                if (!is_teleop_disabled_)
-                {
-                    ROS_INFO("Teleop RC disabled");
-                    is_teleop_disabled_ = true;
-                }
-                return;
-            }
-            else if (is_teleop_disabled_)
-            {
-                ROS_INFO("Teleop RC enabled");
-                is_teleop_disabled_ = false;
-            }
+        if (frame.failsafe)
+        {
+            receiverSignalLostCallback();
+            return;
+        }
+        if (is_signal_lost_)
+        {
+            ROS_INFO("RC receiver signal recovered");
+            is_signal_lost_ = false;
+        }
+        if (frame.frame_lost)
+        {
+            ROS_WARN_THROTTLE(1.0, "RC receiver repeating frames, signal is weak");
+        }
 
-            // Calculate the linear velocity.
-            double lin_x = map(
-                channels_[linear_x_channel_ - 1],
-                pwm_min_, pwm_max_, -linear_x_max_velocity_, linear_x_max_velocity_);
-
-            // Calculate the angular velocity.
-            double ang_z = map(
-                channels_[angular_z_channel_ - 1],
-                pwm_min_, pwm_max_,
-                -angular_z_max_velocity_, angular_z_max_velocity_);
-
-            // Publish the twist message.
-            twist_msg_.linear.x = lin_x;
-            twist_msg_.angular.z = ang_z;
-            twist_pub_.publish(twist_msg_);
+        // Channels the receiver does not send stay at the midpoint.
+        const size_t n = std::min(frame.num_channels, channels_.size());
+        for (size_t i = 0; i < n; ++i)
+        {
+            channels_[i] = frame.channels[i];
         }
+        publishTwist();
     }
-}
 
-int main(int argc, char *argv[])
-{
-    ROS_INFO("Starting Curio Teleop RC");
+    void TeleopRC::receiverSignalLostCallback()
+    {
+        if (!is_signal_lost_)
+        {
+            ROS_WARN("RC receiver signal lost");
+            is_signal_lost_ = true;
+        }
+        publishStop();
+    }
 
-    // Initialise node.
-    ros::init(argc, argv, "curio_teleop_rc");
-    ros::NodeHandle nh, private_nh("~");
+    void TeleopRC::publishStop()
+    {
+        if (!is_commanding_)
+        {
+            return;
+        }
+        is_commanding_ = false;
 
-    curio_teleop::TeleopRC teleop_rc(nh, private_nh);
+        geometry_msgs::TwistPtr twist_msg = boost::make_shared<geometry_msgs::Twist>();
+        twist_pub_.publish(twist_msg);
+    }
 
-    // Loop.
-    ros::Rate loop_rate(50);
-    while (ros::ok())
+    void TeleopRC::publishTwist()
     {
-        teleop_rc.publishMessages();
-        ros::spinOnce();
-        loop_rate.sleep();
-    }
+        // Check the off channel - do not publish if off.
+        if (channels_[disable_teleop_channel_ - 1] > 1800)
+        {
+            if (!is_teleop_disabled_)
+            {
+                ROS_INFO("Teleop RC disabled");
+                is_teleop_disabled_ = true;
+            }
+            // Another source has control, do not send stops on signal loss.
+            is_commanding_ = false;
+            return;
+        }
+        else if (is_teleop_disabled_)
+        {
+            ROS_INFO("Teleop RC enabled");
+            is_teleop_disabled_ = false;
+        }
 
-    return 0;   
-}
\ No newline at end of file
+        // Calculate the linear velocity.
+        double lin_x = map(
+            channels_[linear_x_channel_ - 1],
+            pwm_min_, pwm_max_, -linear_x_max_velocity_, linear_x_max_velocity_);
+
+        // Calculate the angular velocity.
+        double ang_z = map(
+            channels_[angular_z_channel_ - 1],
+            pwm_min_, pwm_max_,
+            -angular_z_max_velocity_, angular_z_max_velocity_);
+
+        // Publish the twist message. A new message is allocated each time
+        // as intra-process subscribers share it after publishing. The trace
+        // id is stored before publishing so the controller can match the command.
+        geometry_msgs::TwistPtr twist_msg = boost::make_shared<geometry_msgs::Twist>();
+        twist_msg->linear.x = lin_x;
+        twist_msg->angular.z = ang_z;
+        latency_trace_.setPublished(trace_id_, lin_x, ang_z);
+        latency_trace_.record(trace_id_, curio_realtime::LatencyTrace::STAGE_CMD_PUBLISHED);
+        twist_pub_.publish(twist_msg);
+        is_commanding_ = true;
+    }
+} // namespace curio_teleop
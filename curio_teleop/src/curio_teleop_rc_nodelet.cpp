@@ -0,0 +1,62 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//   
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//   
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+// 
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "curio_teleop/curio_teleop_rc.h"
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+#include <memory>
+
+namespace curio_teleop
+{
+    /// \brief Radio Control Teleop nodelet
+    ///
+    /// Runs TeleopRC in a nodelet manager. Twist commands are passed
+    /// to subscribers in the same manager without serialisation.
+    ///
+    class TeleopRCNodelet : public nodelet::Nodelet
+    {
+    private:
+        virtual void onInit()
+        {
+            NODELET_INFO("Starting Curio Teleop RC nodelet");
+            teleop_rc_.reset(new TeleopRC(getNodeHandle(), getPrivateNodeHandle()));
+        }
+
+        std::unique_ptr<TeleopRC> teleop_rc_;
+    };
+} // namespace curio_teleop
+
+PLUGINLIB_EXPORT_CLASS(curio_teleop::TeleopRCNodelet, nodelet::Nodelet)
@@ -0,0 +1,316 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//   
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//   
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+// 
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "curio_teleop/rc_receiver.h"
+#include <ros/console.h>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+
+// termios2 allows the non-standard SBUS baud rate. It cannot be
+// used together with <termios.h> or <sys/ioctl.h>.
+#include <asm/ioctls.h>
+#include <asm/termbits.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+extern "C" int ioctl(int fd, unsigned long request, ...);
+
+namespace curio_teleop
+{
+    namespace
+    {
+        /// A silence this long between bytes marks a frame boundary [ms].
+        /// Both protocols send a frame in under 3 ms every 7 ms or more.
+        const int FRAME_GAP_MS = 2;
+
+        /// \brief Convert an SBUS channel value to a pulse width [µs].
+        ///
+        /// SBUS 172 - 1811 corresponds to 988 - 2012 µs.
+        uint16_t sbusToMicroseconds(uint16_t value)
+        {
+            return static_cast<uint16_t>((5 * value + 7040 + 4) / 8);
+        }
+    } // namespace
+
+    const size_t RCFrame::MAX_CHANNELS;
+    const size_t SBUSParser::FRAME_SIZE;
+    const size_t IBUSParser::FRAME_SIZE;
+
+    std::unique_ptr<RCParser> RCParser::create(const std::string &protocol)
+    {
+        if (protocol == "sbus")
+        {
+            return std::unique_ptr<RCParser>(new SBUSParser());
+        }
+        if (protocol == "ibus")
+        {
+            return std::unique_ptr<RCParser>(new IBUSParser());
+        }
+        return std::unique_ptr<RCParser>();
+    }
+
+    void RCParser::resync(uint8_t header)
+    {
+        size_t i = 1;
+        while (i < size_ && buffer_[i] != header)
+        {
+            ++i;
+        }
+        std::memmove(buffer_, buffer_ + i, size_ - i);
+        size_ -= i;
+    }
+
+    bool SBUSParser::parse(uint8_t byte)
+    {
+        if (size_ == 0 && byte != HEADER)
+        {
+            return false;
+        }
+        buffer_[size_++] = byte;
+        if (size_ < FRAME_SIZE)
+        {
+            return false;
+        }
+
+        // SBUS2 receivers cycle the high nibble of the footer.
+        const uint8_t footer = buffer_[FRAME_SIZE - 1];
+        if (footer != 0x00 && (footer & 0x0F) != 0x04)
+        {
+            ++errors_;
+            resync(HEADER);
+            return false;
+        }
+
+        // 16 channels of 11 bits, least significant bit first.
+        uint32_t bits = 0;
+        int num_bits = 0;
+        size_t j = 1;
+        for (size_t ch = 0; ch < 16; ++ch)
+        {
+            while (num_bits < 11)
+            {
+                bits |= static_cast<uint32_t>(buffer_[j++]) << num_bits;
+                num_bits += 8;
+            }
+            frame_.channels[ch] = sbusToMicroseconds(bits & 0x07FF);
+            bits >>= 11;
+            num_bits -= 11;
+        }
+
+        const uint8_t flags = buffer_[FRAME_SIZE - 2];
+        frame_.channels[16] = sbusToMicroseconds((flags & 0x01) ? 1811 : 172);
+        frame_.channels[17] = sbusToMicroseconds((flags & 0x02) ? 1811 : 172);
+        frame_.num_channels = 18;
+        frame_.frame_lost = (flags & 0x04) != 0;
+        frame_.failsafe = (flags & 0x08) != 0;
+
+        size_ = 0;
+        return true;
+    }
+
+    bool IBUSParser::parse(uint8_t byte)
+    {
+        if (size_ == 0 && byte != HEADER)
+        {
+            return false;
+        }
+        if (size_ == 1 && byte != COMMAND)
+        {
+            size_ = 0;
+            return parse(byte);
+        }
+        buffer_[size_++] = byte;
+        if (size_ < FRAME_SIZE)
+        {
+            return false;
+        }
+
+        uint16_t checksum = 0xFFFF;
+        for (size_t i = 0; i < FRAME_SIZE - 2; ++i)
+        {
+            checksum -= buffer_[i];
+        }
+        if (checksum != (buffer_[FRAME_SIZE - 2] | (buffer_[FRAME_SIZE - 1] << 8)))
+        {
+            ++errors_;
+            resync(HEADER);
+            return false;
+        }
+
+        // 14 channels, the high nibble carries extra channels on some receivers.
+        for (size_t ch = 0; ch < 14; ++ch)
+        {
+            frame_.channels[ch] = (buffer_[2 + 2 * ch] | (buffer_[3 + 2 * ch] << 8)) & 0x0FFF;
+        }
+        frame_.num_channels = 14;
+        frame_.frame_lost = false;
+        frame_.failsafe = false;
+
+        size_ = 0;
+        return true;
+    }
+
+    RCReceiver::~RCReceiver()
+    {
+        stop();
+    }
+
+    bool RCReceiver::open(const std::string &port, const std::string &protocol)
+    {
+        stop();
+
+        parser_ = RCParser::create(protocol);
+        if (!parser_)
+        {
+            ROS_ERROR_STREAM("Unknown RC receiver protocol '" << protocol
+                << "', expected 'sbus' or 'ibus'");
+            return false;
+        }
+
+        fd_ = ::open(port.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if (fd_ < 0)
+        {
+            ROS_ERROR_STREAM("Failed to open RC receiver port " << port
+                << ": " << std::strerror(errno));
+            return false;
+        }
+
+        // Raw mode at the protocol's baud rate. Bytes with parity
+        // errors are dropped and the parser resynchronises.
+        struct termios2 tio;
+        std::memset(&tio, 0, sizeof(tio));
+        tio.c_cflag = CS8 | CREAD | CLOCAL | BOTHER;
+        if (parser_->evenParity())
+        {
+            tio.c_cflag |= PARENB;
+            tio.c_iflag |= INPCK | IGNPAR;
+        }
+        if (parser_->twoStopBits())
+        {
+            tio.c_cflag |= CSTOPB;
+        }
+        tio.c_ispeed = parser_->baudrate();
+        tio.c_ospeed = parser_->baudrate();
+        tio.c_cc[VMIN] = 0;
+        tio.c_cc[VTIME] = 0;
+        if (ioctl(fd_, TCSETS2, &tio) != 0)
+        {
+            ROS_ERROR_STREAM("Failed to configure RC receiver port " << port
+                << " for " << protocol << ": " << std::strerror(errno));
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        ioctl(fd_, TCFLSH, TCIFLUSH);
+        return true;
+    }
+
+    void RCReceiver::start(double timeout, FrameCallback frame_cb, SignalLostCallback signal_lost_cb)
+    {
+        if (fd_ < 0 || running_.exchange(true))
+        {
+            return;
+        }
+        frame_cb_ = frame_cb;
+        signal_lost_cb_ = signal_lost_cb;
+        thread_ = std::thread(&RCReceiver::run, this, timeout);
+    }
+
+    void RCReceiver::stop()
+    {
+        running_ = false;
+        if (thread_.joinable())
+        {
+            thread_.join();
+        }
+        if (fd_ >= 0)
+        {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    void RCReceiver::run(double timeout)
+    {
+        typedef std::chrono::steady_clock Clock;
+        const Clock::duration signal_timeout = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(timeout));
+        Clock::time_point last_frame = Clock::now();
+        bool signal_lost = false;
+
+        uint8_t buffer[64];
+        while (running_)
+        {
+            struct pollfd pfd;
+            pfd.fd = fd_;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            const int ready = ::poll(&pfd, 1, FRAME_GAP_MS);
+            if (ready < 0 && errno != EINTR)
+            {
+                ROS_ERROR_STREAM("RC receiver poll failed: " << std::strerror(errno));
+                break;
+            }
+            else if (ready == 0)
+            {
+                // A gap in the data, the next byte starts a new frame
+                parser_->reset();
+            }
+            else if (ready > 0)
+            {
+                const ssize_t n = ::read(fd_, buffer, sizeof(buffer));
+                for (ssize_t i = 0; i < n; ++i)
+                {
+                    if (parser_->parse(buffer[i]))
+                    {
+                        last_frame = Clock::now();
+                        signal_lost = false;
+                        frame_cb_(parser_->frame());
+                    }
+                }
+                errors_.store(parser_->errors(), std::memory_order_relaxed);
+            }
+
+            if (!signal_lost && Clock::now() - last_frame > signal_timeout)
+            {
+                signal_lost = true;
+                signal_lost_cb_();
+            }
+        }
+    }
+} // namespace curio_teleop
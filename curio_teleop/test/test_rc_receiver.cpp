@@ -0,0 +1,216 @@
+//
+//  Software License Agreement (BSD-3-Clause)
+//   
+//  Copyright (c) 2019 Rhys Mainwaring
+//  All rights reserved
+//   
+//  Redistribution and use in source and binary forms, with or without
+//  modification, are permitted provided that the following conditions
+//  are met:
+//
+//  1.  Redistributions of source code must retain the above copyright
+//      notice, this list of conditions and the following disclaimer.
+//
+//  2.  Redistributions in binary form must reproduce the above
+//      copyright notice, this list of conditions and the following
+//      disclaimer in the documentation and/or other materials provided
+//      with the distribution.
+//
+//  3.  Neither the name of the copyright holder nor the names of its
+//      contributors may be used to endorse or promote products derived
+//      from this software without specific prior written permission.
+// 
+//  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+//  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+//  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+//  FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+//  COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+//  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+//  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+//  CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+//  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+//  ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+//  POSSIBILITY OF SUCH DAMAGE.
+//
+
+#include "curio_teleop/rc_receiver.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <vector>
+
+using curio_teleop::IBUSParser;
+using curio_teleop::RCParser;
+using curio_teleop::SBUSParser;
+
+namespace
+{
+    /// \brief Encode an SBUS frame of 16 channels [SBUS units] and a flags byte.
+    std::vector<uint8_t> sbusFrame(const uint16_t (&channels)[16], uint8_t flags)
+    {
+        std::vector<uint8_t> frame(SBUSParser::FRAME_SIZE, 0);
+        frame[0] = SBUSParser::HEADER;
+        size_t bit = 0;
+        for (size_t ch = 0; ch < 16; ++ch)
+        {
+            for (size_t i = 0; i < 11; ++i, ++bit)
+            {
+                if (channels[ch] & (1 << i))
+                {
+                    frame[1 + bit / 8] |= static_cast<uint8_t>(1 << (bit % 8));
+                }
+            }
+        }
+        frame[23] = flags;
+        frame[24] = 0x00;
+        return frame;
+    }
+
+    /// \brief Encode an iBUS frame of 14 channels [µs].
+    std::vector<uint8_t> ibusFrame(const uint16_t (&channels)[14])
+    {
+        std::vector<uint8_t> frame(IBUSParser::FRAME_SIZE, 0);
+        frame[0] = IBUSParser::HEADER;
+        frame[1] = IBUSParser::COMMAND;
+        for (size_t ch = 0; ch < 14; ++ch)
+        {
+            frame[2 + 2 * ch] = channels[ch] & 0xFF;
+            frame[3 + 2 * ch] = channels[ch] >> 8;
+        }
+        uint16_t checksum = 0xFFFF;
+        for (size_t i = 0; i < IBUSParser::FRAME_SIZE - 2; ++i)
+        {
+            checksum -= frame[i];
+        }
+        frame[30] = checksum & 0xFF;
+        frame[31] = checksum >> 8;
+        return frame;
+    }
+
+    /// \brief Feed bytes to a parser and count the frames completed.
+    int feed(RCParser &parser, const std::vector<uint8_t> &bytes)
+    {
+        int frames = 0;
+        for (uint8_t byte : bytes)
+        {
+            frames += parser.parse(byte) ? 1 : 0;
+        }
+        return frames;
+    }
+} // namespace
+
+TEST(SBUSParser, decodesChannelsAndFlags)
+{
+    uint16_t channels[16];
+    for (size_t ch = 0; ch < 16; ++ch)
+    {
+        channels[ch] = 992;
+    }
+    channels[0] = 172;
+    channels[1] = 1811;
+
+    SBUSParser parser;
+    EXPECT_EQ(feed(parser, sbusFrame(channels, 0x01 | 0x08)), 1);
+    const curio_teleop::RCFrame &frame = parser.frame();
+    EXPECT_EQ(frame.num_channels, 18u);
+    EXPECT_EQ(frame.channels[0], 988);
+    EXPECT_EQ(frame.channels[1], 2012);
+    EXPECT_EQ(frame.channels[2], 1500);
+    EXPECT_EQ(frame.channels[15], 1500);
+    EXPECT_EQ(frame.channels[16], 2012);
+    EXPECT_EQ(frame.channels[17], 988);
+    EXPECT_TRUE(frame.failsafe);
+    EXPECT_FALSE(frame.frame_lost);
+}
+
+TEST(SBUSParser, acceptsSbus2Footer)
+{
+    uint16_t channels[16] = {};
+    std::vector<uint8_t> bytes = sbusFrame(channels, 0x04);
+    bytes[24] = 0x14;
+
+    SBUSParser parser;
+    EXPECT_EQ(feed(parser, bytes), 1);
+    EXPECT_TRUE(parser.frame().frame_lost);
+}
+
+TEST(SBUSParser, resynchronisesAfterCorruptFrame)
+{
+    uint16_t channels[16] = {};
+    std::vector<uint8_t> bytes(3, 0xAA);
+    std::vector<uint8_t> corrupt = sbusFrame(channels, 0);
+    corrupt[24] = 0xFF;
+    bytes.insert(bytes.end(), corrupt.begin(), corrupt.end());
+    const std::vector<uint8_t> good = sbusFrame(channels, 0);
+    bytes.insert(bytes.end(), good.begin(), good.end());
+
+    SBUSParser parser;
+    EXPECT_EQ(feed(parser, bytes), 1);
+    EXPECT_EQ(parser.errors(), 1u);
+}
+
+TEST(IBUSParser, decodesChannels)
+{
+    uint16_t channels[14];
+    for (size_t ch = 0; ch < 14; ++ch)
+    {
+        channels[ch] = static_cast<uint16_t>(1000 + 50 * ch);
+    }
+
+    IBUSParser parser;
+    EXPECT_EQ(feed(parser, ibusFrame(channels)), 1);
+    const curio_teleop::RCFrame &frame = parser.frame();
+    EXPECT_EQ(frame.num_channels, 14u);
+    for (size_t ch = 0; ch < 14; ++ch)
+    {
+        EXPECT_EQ(frame.channels[ch], channels[ch]);
+    }
+    EXPECT_FALSE(frame.failsafe);
+}
+
+TEST(IBUSParser, rejectsBadChecksum)
+{
+    uint16_t channels[14];
+    for (size_t ch = 0; ch < 14; ++ch)
+    {
+        channels[ch] = 1500;
+    }
+    std::vector<uint8_t> bytes = ibusFrame(channels);
+    bytes[10] ^= 0x01;
+    const std::vector<uint8_t> good = ibusFrame(channels);
+    bytes.insert(bytes.end(), good.begin(), good.end());
+
+    IBUSParser parser;
+    EXPECT_EQ(feed(parser, bytes), 1);
+    EXPECT_EQ(parser.errors(), 1u);
+    EXPECT_EQ(parser.frame().channels[4], 1500);
+}
+
+TEST(IBUSParser, ignoresHeaderWithoutCommand)
+{
+    uint16_t channels[14];
+    for (size_t ch = 0; ch < 14; ++ch)
+    {
+        channels[ch] = 1200;
+    }
+    std::vector<uint8_t> bytes = { IBUSParser::HEADER, 0x00 };
+    const std::vector<uint8_t> good = ibusFrame(channels);
+    bytes.insert(bytes.end(), good.begin(), good.end());
+
+    IBUSParser parser;
+    EXPECT_EQ(feed(parser, bytes), 1);
+    EXPECT_EQ(parser.errors(), 0u);
+}
+
+TEST(RCParser, createsKnownProtocols)
+{
+    EXPECT_TRUE(RCParser::create("sbus") != nullptr);
+    EXPECT_TRUE(RCParser::create("ibus") != nullptr);
+    EXPECT_TRUE(RCParser::create("ppm") == nullptr);
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}